@@ -0,0 +1,183 @@
+/* gydict-indexer.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Compiles the headwords of a dictionary into an index file which
+ * libgydict maps with gy_headword_index_new().
+ *
+ * The input has one entry per line: the headword, optionally followed
+ * by a tab and the offset of the entry in the dictionary. If the offset
+ * is missing, the number of the line is used.
+ *
+ * With --lemmas, it compiles an inflection list into a lemma index for
+ * gy_lemma_index_new() instead. Every line holds an inflected form and
+ * its lemma separated by a tab; further columns, like grammatical tags,
+ * are ignored. A form with several lemmas is listed once for each.
+ */
+
+#include <config.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gydict.h>
+
+static gchar *output = NULL;
+static gboolean lemmas = FALSE;
+
+static GOptionEntry entries[] =
+{
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the index to FILE", "FILE" },
+  { "lemmas", 'l', 0, G_OPTION_ARG_NONE, &lemmas, "Compile an inflection list into a lemma index", NULL },
+  { NULL }
+};
+
+static int
+compile_lemmas (GStrv lines)
+{
+  g_autoptr(GPtrArray) forms = g_ptr_array_new ();
+  g_autoptr(GPtrArray) lemma_list = g_ptr_array_new ();
+  GError *error = NULL;
+
+  for (guint i = 0; lines[i] != NULL; i++)
+    {
+      gchar *line = g_strchomp (lines[i]);
+      gchar *lemma;
+      gchar *tab;
+
+      if (*line == '\0')
+        continue;
+
+      if ((lemma = strchr (line, '\t')) == NULL)
+        {
+          g_printerr ("Line %u has no lemma.\n", i + 1);
+          return EXIT_FAILURE;
+        }
+
+      *lemma++ = '\0';
+
+      if ((tab = strchr (lemma, '\t')) != NULL)
+        *tab = '\0';
+
+      if (!g_utf8_validate (line, -1, NULL) || !g_utf8_validate (lemma, -1, NULL))
+        {
+          g_printerr ("Line %u is not valid UTF-8.\n", i + 1);
+          return EXIT_FAILURE;
+        }
+
+      g_ptr_array_add (forms, line);
+      g_ptr_array_add (lemma_list, lemma);
+    }
+
+  if (!gy_lemma_index_write ((const gchar * const *) forms->pdata,
+                             (const gchar * const *) lemma_list->pdata,
+                             forms->len, output, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("%u inflected forms written to %s\n", forms->len, output);
+
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char **argv)
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GPtrArray) headwords = NULL;
+  g_autoptr(GArray) offsets = NULL;
+  g_autofree gchar *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  GError *error = NULL;
+
+  setlocale (LC_ALL, "");
+
+  context = g_option_context_new ("INPUT - compile headwords into a Gydict index");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  if (argc != 2 || output == NULL)
+    {
+      g_printerr ("Usage: %s [--lemmas] --output FILE INPUT\n", g_get_prgname ());
+      return EXIT_FAILURE;
+    }
+
+  if (!g_file_get_contents (argv[1], &contents, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+
+  if (lemmas)
+    return compile_lemmas (lines);
+
+  headwords = g_ptr_array_new ();
+  offsets = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+  for (guint i = 0; lines[i] != NULL; i++)
+    {
+      gchar *line = g_strchomp (lines[i]);
+      gchar *tab;
+      guint64 offset = i;
+
+      if (*line == '\0')
+        continue;
+
+      if ((tab = strchr (line, '\t')) != NULL)
+        {
+          *tab = '\0';
+          offset = g_ascii_strtoull (tab + 1, NULL, 10);
+        }
+
+      if (!g_utf8_validate (line, -1, NULL))
+        {
+          g_printerr ("Line %u is not valid UTF-8.\n", i + 1);
+          return EXIT_FAILURE;
+        }
+
+      g_ptr_array_add (headwords, line);
+      g_array_append_val (offsets, offset);
+    }
+
+  if (!gy_headword_index_write ((const gchar * const *) headwords->pdata,
+                                (const guint64 *) offsets->data,
+                                headwords->len, output, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("%u headwords written to %s\n", headwords->len, output);
+
+  return EXIT_SUCCESS;
+}
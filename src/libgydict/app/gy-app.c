@@ -44,6 +44,9 @@ setup_accels (GyApp *self)
       {"win.print", "<ctrl>p"},
       {"win.close", "<ctrl>w"},
       {"win.clip", "<ctrl>m"},
+      {"win.search-definitions", "<ctrl>Return"},
+      {"win.search-translations", "<ctrl><alt>Return"},
+      {"win.search-all-dictionaries", "<ctrl><shift>Return"},
       {"win.gear-menu", "F10"},
       {"dockbin.top-visible", "<ctrl>f"},
       {"dockbin.left-visible", "F9"},
@@ -20,6 +20,7 @@
 #include "gy-def-list.h"
 #include "gy-text-view.h"
 #include "helpers/gy-utility-func.h"
+#include "services/gy-headword-model.h"
 
 
 struct _GyDefList
@@ -30,6 +31,16 @@ struct _GyDefList
   gchar *selected_value;
   gint   selected_index;
   gboolean has_model;
+
+  GtkEntry         *search_entry;
+  GyDictSearchable *searchable;
+  GCancellable     *search_cancellable;
+  GySearchKeys     *search_keys;
+  GCancellable     *keys_cancellable;
+  gboolean          sorted;
+  gboolean          keys_sorted;
+
+  const GyFoldTable *fold_table;
 };
 
 enum
@@ -46,6 +57,7 @@ static GParamSpec* properties[N_PROPERTIES];
 enum
 {
   MOVE_SELECTION,
+  SEARCH_KEYS_READY,
   LAST_SIGNAL
 };
 
@@ -150,6 +162,244 @@ gy_def_list_selection_move_cb (GyDefList        *self,
     }
 }
 
+typedef struct
+{
+  GyHeadwordModel   *model;   /* read on the worker, its rows never change */
+  gchar            **strings; /* or the rows of another model, copied */
+  const GyFoldTable *fold_table;
+  GySearchKeys      *keys;
+  gboolean           sorted;
+} KeysData;
+
+static void
+keys_data_free (KeysData *data)
+{
+  g_clear_object (&data->model);
+  g_clear_pointer (&data->strings, g_strfreev);
+  g_clear_pointer (&data->keys, gy_search_keys_unref);
+  g_slice_free (KeysData, data);
+}
+
+/* Copies the headwords of @model, which may only be read on the main thread. */
+static gchar **
+gy_def_list_copy_rows (GtkTreeModel *model)
+{
+  GPtrArray *strings;
+  GtkTreeIter iter;
+  gboolean valid;
+
+  strings = g_ptr_array_sized_new (gtk_tree_model_iter_n_children (model, NULL) + 1);
+
+  for (valid = gtk_tree_model_get_iter_first (model, &iter);
+       valid;
+       valid = gtk_tree_model_iter_next (model, &iter))
+    {
+      gchar *value = NULL;
+
+      gtk_tree_model_get (model, &iter, 0, &value, -1);
+      g_ptr_array_add (strings, value != NULL ? value : g_strdup (""));
+    }
+
+  g_ptr_array_add (strings, NULL);
+
+  return (gchar **) g_ptr_array_free (strings, FALSE);
+}
+
+static void
+gy_def_list_build_keys_worker (GTask        *task,
+                               gpointer      source_object,
+                               gpointer      task_data,
+                               GCancellable *cancellable)
+{
+  KeysData *data = task_data;
+  guint n_keys;
+
+  if (data->strings != NULL)
+    data->keys = gy_search_keys_new_from_strv ((const gchar * const *) data->strings, data->fold_table);
+  else if (data->fold_table != NULL)
+    data->keys = gy_search_keys_new_from_model_full (GTK_TREE_MODEL (data->model), 0, data->fold_table);
+  else
+    data->keys = gy_search_keys_ref (gy_headword_model_get_search_keys (data->model));
+
+  n_keys = gy_search_keys_get_n_keys (data->keys);
+
+  /* The forms are sorted here rather than on the first search. */
+  gy_search_keys_get_sorted_rows (data->keys, NULL);
+
+  /* Folding may keep the order of the rows; then their keys are bisected as they are. */
+  data->sorted = TRUE;
+  for (guint i = 1; i < n_keys && data->sorted; i++)
+    data->sorted = g_strcmp0 (gy_search_keys_get_key (data->keys, i - 1, NULL),
+                              gy_search_keys_get_key (data->keys, i, NULL)) <= 0;
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void gy_def_list_search_entry_changed (GyDefList *self,
+                                              GtkEntry  *entry);
+
+static void
+gy_def_list_build_keys_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  GyDefList *self = GY_DEF_LIST (object);
+  KeysData *data = g_task_get_task_data (G_TASK (result));
+
+  if (!g_task_propagate_boolean (G_TASK (result), NULL))
+    return;
+
+  g_clear_object (&self->keys_cancellable);
+  g_clear_pointer (&self->search_keys, gy_search_keys_unref);
+  self->search_keys = g_steal_pointer (&data->keys);
+  self->keys_sorted = data->sorted;
+
+  g_signal_emit (self, signals[SEARCH_KEYS_READY], 0);
+
+  /* A query typed while the keys were built is searched again. */
+  if (self->search_entry != NULL)
+    gy_def_list_search_entry_changed (self, self->search_entry);
+}
+
+/*
+ * Starts building the keys of the model on a worker thread. Only a
+ * #GyHeadwordModel is read there, as its rows never change; the rows
+ * of another model, which may not be thread-safe, are copied first and
+ * only folded there. The keys a #GyHeadwordModel folds by itself are
+ * taken on the worker too, as it folds them on the first call.
+ */
+static void
+gy_def_list_update_search_keys (GyDefList *self)
+{
+  g_autoptr(GTask) task = NULL;
+  GtkTreeModel *model;
+  KeysData *data;
+
+  g_cancellable_cancel (self->keys_cancellable);
+  g_clear_object (&self->keys_cancellable);
+  g_clear_pointer (&self->search_keys, gy_search_keys_unref);
+  self->keys_sorted = FALSE;
+
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (self));
+
+  if (model == NULL)
+    return;
+
+  data = g_slice_new0 (KeysData);
+  data->fold_table = self->fold_table;
+
+  if (GY_IS_HEADWORD_MODEL (model))
+    data->model = g_object_ref (GY_HEADWORD_MODEL (model));
+  else
+    data->strings = gy_def_list_copy_rows (model);
+
+  self->keys_cancellable = g_cancellable_new ();
+
+  task = g_task_new (self, self->keys_cancellable, gy_def_list_build_keys_cb, NULL);
+  g_task_set_source_tag (task, gy_def_list_update_search_keys);
+  g_task_set_task_data (task, data, (GDestroyNotify) keys_data_free);
+  g_task_set_return_on_cancel (task, TRUE);
+  g_task_run_in_thread (task, gy_def_list_build_keys_worker);
+}
+
+/* Matches the rows one by one, the way the search of GtkTreeView does. */
+static gint
+gy_def_list_scan_model (GtkTreeModel *model,
+                        const gchar  *text)
+{
+  GtkTreeIter iter;
+  gboolean valid;
+  gint row = 0;
+
+  for (valid = gtk_tree_model_get_iter_first (model, &iter);
+       valid;
+       valid = gtk_tree_model_iter_next (model, &iter), row++)
+    {
+      if (!gy_def_list_search_equal_func (model, 0, text, &iter, NULL))
+        return row;
+    }
+
+  return -1;
+}
+
+static void
+gy_def_list_search_cb (GObject      *object,
+                       GAsyncResult *result,
+                       gpointer      data)
+{
+  g_autoptr(GyDefList) self = GY_DEF_LIST (data);
+  g_autoptr(GArray) rows = NULL;
+  GError *error = NULL;
+
+  rows = gy_dict_searchable_search_finish (GY_DICT_SEARCHABLE (object), result, &error);
+
+  if (error != NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Search failed: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  if (rows != NULL && rows->len > 0)
+    gy_def_list_select_row (self, g_array_index (rows, guint32, 0));
+}
+
+static void
+gy_def_list_search_entry_changed (GyDefList *self,
+                                  GtkEntry  *entry)
+{
+  GtkTreeModel *model;
+  const gchar *text;
+
+  g_cancellable_cancel (self->search_cancellable);
+  g_clear_object (&self->search_cancellable);
+
+  text = gtk_entry_get_text (entry);
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (self));
+
+  if (*text == '\0' || model == NULL)
+    return;
+
+  /*
+   * The service folds with diacritics, so the list searches by itself
+   * without them; until their keys are built, the service answers.
+   */
+  if (self->searchable != NULL && (self->fold_table == NULL || self->search_keys == NULL))
+    {
+      self->search_cancellable = g_cancellable_new ();
+      gy_dict_searchable_search_async (self->searchable, text,
+                                       GY_SEARCH_FLAGS_PREFIX, 1,
+                                       self->search_cancellable,
+                                       gy_def_list_search_cb,
+                                       g_object_ref (self));
+    }
+  else if (self->search_keys == NULL)
+    {
+      /* Until the keys are built, the rows are scanned as before. */
+      gint row = gy_def_list_scan_model (model, text);
+
+      if (row >= 0)
+        gy_def_list_select_row (self, row);
+    }
+  else
+    {
+      /* The query is folded once; the keys of the rows were folded in advance. */
+      GySearchKeys *keys = gy_def_list_get_search_keys (self);
+      g_autofree gchar *key = NULL;
+      gint row;
+
+      if ((key = gy_search_keys_fold (keys, text, -1)) == NULL)
+        return;
+
+      /* The model is sorted by the keys with diacritics, unless folding kept the order. */
+      row = gy_search_keys_find_prefix (keys, key, self->keys_sorted || (self->sorted && self->fold_table == NULL));
+
+      if (row >= 0)
+        gy_def_list_select_row (self, row);
+    }
+}
+
 static void
 gy_def_list_constructed (GObject *object)
 {
@@ -166,6 +416,26 @@ gy_def_list_constructed (GObject *object)
 }
 
 
+static void
+gy_def_list_dispose (GObject *object)
+{
+  GyDefList *self = (GyDefList *) object;
+
+  g_cancellable_cancel (self->search_cancellable);
+  g_clear_object (&self->search_cancellable);
+  g_clear_object (&self->searchable);
+  g_cancellable_cancel (self->keys_cancellable);
+  g_clear_object (&self->keys_cancellable);
+  g_clear_pointer (&self->search_keys, gy_search_keys_unref);
+  if (self->search_entry != NULL)
+    {
+      g_object_remove_weak_pointer (G_OBJECT (self->search_entry), (gpointer *) &self->search_entry);
+      self->search_entry = NULL;
+    }
+
+  G_OBJECT_CLASS (gy_def_list_parent_class)->dispose (object);
+}
+
 static void
 gy_def_list_finalize (GObject *object)
 {
@@ -233,6 +503,7 @@ gy_def_list_class_init (GyDefListClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->constructed = gy_def_list_constructed;
+  object_class->dispose = gy_def_list_dispose;
   object_class->finalize = gy_def_list_finalize;
   object_class->set_property = gy_def_list_set_property;
   object_class->get_property = gy_def_list_get_property;
@@ -246,6 +517,20 @@ gy_def_list_class_init (GyDefListClass *klass)
                   G_TYPE_NONE, 1,
                   GTK_TYPE_DIRECTION_TYPE);
 
+  /**
+   * GyDefList::search-keys-ready:
+   * @self: #GyDefList object
+   *
+   * Emitted when the search keys built on a worker thread for the model
+   * are ready, see gy_def_list_get_search_keys().
+   */
+  signals[SEARCH_KEYS_READY] =
+    g_signal_new ("search-keys-ready",
+                  GY_TYPE_DEF_LIST,
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 0);
+
   properties[PROP_SELECTED_VALUE] =
      g_param_spec_string ("selected-value",
                           "selected-value",
@@ -358,8 +643,129 @@ gy_def_list_set_model (GyDefList    *self,
   g_return_if_fail (GY_IS_DEF_LIST (self));
 
   gtk_tree_view_set_model (GTK_TREE_VIEW (self), model);
+  gy_def_list_update_search_keys (self);
 
   gboolean has_model = !!model;
 
   g_object_set (G_OBJECT (self), "has-model", has_model, NULL);
 }
+
+/**
+ * gy_def_list_set_search_entry:
+ * @self: #GyDefList object
+ * @entry: (nullable): the entry to search with, or %NULL
+ *
+ * Selects the first headword beginning with the text typed into @entry.
+ * The query goes to the #GyDictSearchable set with
+ * gy_def_list_set_searchable(), if any; otherwise it is matched against
+ * the folded search keys of the model.
+ */
+void
+gy_def_list_set_search_entry (GyDefList *self,
+                              GtkEntry  *entry)
+{
+  g_return_if_fail (GY_IS_DEF_LIST (self));
+  g_return_if_fail (entry == NULL || GTK_IS_ENTRY (entry));
+
+  if (self->search_entry != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (self->search_entry,
+                                            gy_def_list_search_entry_changed, self);
+      g_object_remove_weak_pointer (G_OBJECT (self->search_entry), (gpointer *) &self->search_entry);
+    }
+
+  self->search_entry = entry;
+
+  if (entry != NULL)
+    g_object_add_weak_pointer (G_OBJECT (entry), (gpointer *) &self->search_entry);
+
+  if (entry != NULL)
+    g_signal_connect_object (entry, "changed",
+                             G_CALLBACK (gy_def_list_search_entry_changed),
+                             self, G_CONNECT_SWAPPED);
+
+  /* The list searches by itself, so the search of GtkTreeView is not needed. */
+  gtk_tree_view_set_search_entry (GTK_TREE_VIEW (self), NULL);
+  gtk_tree_view_set_enable_search (GTK_TREE_VIEW (self), entry == NULL);
+}
+
+/**
+ * gy_def_list_set_searchable:
+ * @self: #GyDefList object
+ * @searchable: (nullable): the service whose model is shown, or %NULL
+ *
+ * Lets @searchable answer the queries typed into the search entry
+ * instead of the list. Set it together with the model of the service.
+ */
+void
+gy_def_list_set_searchable (GyDefList        *self,
+                            GyDictSearchable *searchable)
+{
+  g_return_if_fail (GY_IS_DEF_LIST (self));
+  g_return_if_fail (searchable == NULL || GY_IS_DICT_SEARCHABLE (searchable));
+
+  g_cancellable_cancel (self->search_cancellable);
+  g_clear_object (&self->search_cancellable);
+
+  g_set_object (&self->searchable, searchable);
+}
+
+/**
+ * gy_def_list_set_sorted:
+ * @self: #GyDefList object
+ * @sorted: whether the model is sorted
+ *
+ * Tells the list that the rows of its model are sorted by their folded
+ * headwords, see %GY_SERVICE_CAPABILITY_SORTED_MODEL. The list then
+ * bisects the keys of the rows instead of sorting them first.
+ */
+void
+gy_def_list_set_sorted (GyDefList *self,
+                        gboolean   sorted)
+{
+  g_return_if_fail (GY_IS_DEF_LIST (self));
+
+  self->sorted = !!sorted;
+}
+
+/**
+ * gy_def_list_set_fold_table:
+ * @self: #GyDefList object
+ * @fold_table: (nullable): the table to fold the headwords and queries
+ *   with, or %NULL to match them with their diacritics
+ *
+ * Makes the search ignore diacritics the way @fold_table does. The keys
+ * of the rows are folded again on a worker thread;
+ * #GyDefList::search-keys-ready is emitted when they are ready.
+ */
+void
+gy_def_list_set_fold_table (GyDefList         *self,
+                            const GyFoldTable *fold_table)
+{
+  g_return_if_fail (GY_IS_DEF_LIST (self));
+
+  if (self->fold_table == fold_table)
+    return;
+
+  self->fold_table = fold_table;
+  gy_def_list_update_search_keys (self);
+}
+
+/**
+ * gy_def_list_get_search_keys:
+ * @self: #GyDefList object
+ *
+ * Gets the folded search keys of the rows of the model. They are built
+ * on a worker thread whenever the model or the #GyFoldTable changes,
+ * and until #GyDefList::search-keys-ready is emitted there are none.
+ *
+ * Returns: (transfer none) (nullable): the keys, or %NULL without a
+ *   model or while they are built
+ */
+GySearchKeys *
+gy_def_list_get_search_keys (GyDefList *self)
+{
+  g_return_val_if_fail (GY_IS_DEF_LIST (self), NULL);
+
+  return self->search_keys;
+}
@@ -24,6 +24,8 @@
 #endif
 
 #include <gtk/gtk.h>
+#include "services/gy-dict-searchable.h"
+#include "services/gy-search-keys.h"
 
 G_BEGIN_DECLS
 
@@ -37,6 +39,15 @@ void   gy_def_list_select_row                 (GyDefList *self,
 gchar* gy_def_list_get_value_for_selected_row (GyDefList *self);
 void   gy_def_list_set_model                  (GyDefList    *self,
                                                GtkTreeModel *model);
+void   gy_def_list_set_search_entry           (GyDefList    *self,
+                                               GtkEntry     *entry);
+void   gy_def_list_set_searchable             (GyDefList        *self,
+                                               GyDictSearchable *searchable);
+void   gy_def_list_set_sorted                 (GyDefList    *self,
+                                               gboolean      sorted);
+void   gy_def_list_set_fold_table             (GyDefList         *self,
+                                               const GyFoldTable *fold_table);
+GySearchKeys *gy_def_list_get_search_keys     (GyDefList    *self);
 
 G_END_DECLS
 
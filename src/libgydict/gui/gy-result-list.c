@@ -0,0 +1,306 @@
+/* gy-result-list.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <glib/gi18n-lib.h>
+
+#include "gy-result-list.h"
+
+/*
+ * A list of headwords found for the query other than by their prefix,
+ * e.g. the rows within a few typos of it or those whose definitions
+ * contain it. Activating one emits ::result-activated with the row of
+ * the model it stands for, or ::service-result-activated when it was
+ * found in another dictionary.
+ */
+struct _GyResultList
+{
+  GtkBin      __parent__;
+  GtkLabel   *title;
+  GtkListBox *list;
+  guint       n_items;
+};
+
+G_DEFINE_TYPE (GyResultList, gy_result_list, GTK_TYPE_BIN)
+
+enum
+{
+  RESULT_ACTIVATED,
+  SERVICE_RESULT_ACTIVATED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+static void
+gy_result_list_row_activated (GyResultList  *self,
+                              GtkListBoxRow *row,
+                              GtkListBox    *list)
+{
+  GtkWidget *label = gtk_bin_get_child (GTK_BIN (row));
+  const gchar *service_id = g_object_get_data (G_OBJECT (label), "service-id");
+  guint idx = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (label), "row"));
+
+  if (service_id != NULL)
+    g_signal_emit (self, signals[SERVICE_RESULT_ACTIVATED], 0, service_id, idx);
+  else
+    g_signal_emit (self, signals[RESULT_ACTIVATED], 0, idx);
+}
+
+static void
+gy_result_list_class_init (GyResultListClass *klass)
+{
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  /**
+   * GyResultList::result-activated:
+   * @self: the #GyResultList
+   * @row: the row of the model of the activated result
+   */
+  signals[RESULT_ACTIVATED] =
+    g_signal_new ("result-activated",
+                  GY_TYPE_RESULT_LIST,
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__UINT,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_UINT);
+
+  /**
+   * GyResultList::service-result-activated:
+   * @self: the #GyResultList
+   * @service_id: id of the dictionary service the result was found in
+   * @row: the row of the model of that service
+   */
+  signals[SERVICE_RESULT_ACTIVATED] =
+    g_signal_new ("service-result-activated",
+                  GY_TYPE_RESULT_LIST,
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 2,
+                  G_TYPE_STRING,
+                  G_TYPE_UINT);
+
+  gtk_widget_class_set_css_name (widget_class, "gyresultlist");
+}
+
+static void
+gy_result_list_init (GyResultList *self)
+{
+  GtkWidget *box;
+
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+  gtk_container_set_border_width (GTK_CONTAINER (box), 6);
+
+  self->title = GTK_LABEL (gtk_label_new (NULL));
+  gy_result_list_set_title (self, _("Did you mean"));
+  gtk_label_set_xalign (self->title, 0.0);
+
+  self->list = GTK_LIST_BOX (gtk_list_box_new ());
+  gtk_list_box_set_activate_on_single_click (self->list, TRUE);
+
+  gtk_container_add (GTK_CONTAINER (box), GTK_WIDGET (self->title));
+  gtk_container_add (GTK_CONTAINER (box), GTK_WIDGET (self->list));
+  gtk_container_add (GTK_CONTAINER (self), box);
+  gtk_widget_show_all (box);
+
+  g_signal_connect_swapped (self->list, "row-activated",
+                            G_CALLBACK (gy_result_list_row_activated), self);
+}
+
+GtkWidget *
+gy_result_list_new (void)
+{
+  return g_object_new (GY_TYPE_RESULT_LIST, NULL);
+}
+
+/**
+ * gy_result_list_clear:
+ * @self: a #GyResultList
+ *
+ * Removes every result.
+ */
+void
+gy_result_list_clear (GyResultList *self)
+{
+  g_autoptr(GList) children = NULL;
+
+  g_return_if_fail (GY_IS_RESULT_LIST (self));
+
+  children = gtk_container_get_children (GTK_CONTAINER (self->list));
+
+  for (GList *l = children; l != NULL; l = l->next)
+    gtk_widget_destroy (l->data);
+
+  self->n_items = 0;
+}
+
+static void
+append_rows (GyResultList  *self,
+             const gchar   *service_id,
+             GtkTreeModel  *model,
+             const guint32 *rows,
+             guint          n_rows)
+{
+  for (guint i = 0; i < n_rows; i++)
+    {
+      g_autofree gchar *headword = NULL;
+      GtkWidget *label;
+      GtkTreeIter iter;
+
+      if (!gtk_tree_model_iter_nth_child (model, &iter, NULL, rows[i]))
+        continue;
+
+      gtk_tree_model_get (model, &iter, 0, &headword, -1);
+
+      label = gtk_label_new (headword);
+      gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+      gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+      g_object_set_data (G_OBJECT (label), "row", GUINT_TO_POINTER (rows[i]));
+      if (service_id != NULL)
+        g_object_set_data_full (G_OBJECT (label), "service-id", g_strdup (service_id), g_free);
+      gtk_widget_show (label);
+
+      gtk_container_add (GTK_CONTAINER (self->list), label);
+      self->n_items++;
+    }
+}
+
+/**
+ * gy_result_list_append_results:
+ * @self: a #GyResultList
+ * @model: the model the rows belong to
+ * @rows: (array length=n_rows): the rows to offer, in order
+ * @n_rows: the number of rows
+ *
+ * Adds the headwords of @rows, read from the first column of @model,
+ * after the results already shown, e.g. as a search finds them.
+ */
+void
+gy_result_list_append_results (GyResultList  *self,
+                               GtkTreeModel  *model,
+                               const guint32 *rows,
+                               guint          n_rows)
+{
+  g_return_if_fail (GY_IS_RESULT_LIST (self));
+  g_return_if_fail (GTK_IS_TREE_MODEL (model));
+  g_return_if_fail (rows != NULL || n_rows == 0);
+
+  append_rows (self, NULL, model, rows, n_rows);
+}
+
+/**
+ * gy_result_list_append_service_results:
+ * @self: a #GyResultList
+ * @service_id: id of the dictionary service the rows were found in
+ * @model: the model of that service
+ * @rows: (array length=n_rows): the rows to offer, in order
+ * @n_rows: the number of rows
+ *
+ * Like gy_result_list_append_results(), but the rows belong to another
+ * dictionary. They are shown under its id and activating one emits
+ * #GyResultList::service-result-activated.
+ */
+void
+gy_result_list_append_service_results (GyResultList  *self,
+                                       const gchar   *service_id,
+                                       GtkTreeModel  *model,
+                                       const guint32 *rows,
+                                       guint          n_rows)
+{
+  GtkWidget *header;
+  GtkWidget *row;
+  g_autofree gchar *markup = NULL;
+
+  g_return_if_fail (GY_IS_RESULT_LIST (self));
+  g_return_if_fail (service_id != NULL);
+  g_return_if_fail (GTK_IS_TREE_MODEL (model));
+  g_return_if_fail (rows != NULL || n_rows == 0);
+
+  if (n_rows == 0)
+    return;
+
+  markup = g_markup_printf_escaped ("<i>%s</i>", service_id);
+  header = gtk_label_new (NULL);
+  gtk_label_set_markup (GTK_LABEL (header), markup);
+  gtk_label_set_xalign (GTK_LABEL (header), 0.0);
+
+  row = gtk_list_box_row_new ();
+  gtk_list_box_row_set_activatable (GTK_LIST_BOX_ROW (row), FALSE);
+  gtk_list_box_row_set_selectable (GTK_LIST_BOX_ROW (row), FALSE);
+  gtk_container_add (GTK_CONTAINER (row), header);
+  gtk_widget_show_all (row);
+  gtk_container_add (GTK_CONTAINER (self->list), row);
+
+  append_rows (self, service_id, model, rows, n_rows);
+}
+
+/**
+ * gy_result_list_set_results:
+ * @self: a #GyResultList
+ * @model: the model the rows belong to
+ * @rows: (element-type guint32): the rows to offer, in order
+ *
+ * Replaces the results with the headwords of @rows, read from the
+ * first column of @model.
+ */
+void
+gy_result_list_set_results (GyResultList *self,
+                            GtkTreeModel *model,
+                            GArray       *rows)
+{
+  g_return_if_fail (GY_IS_RESULT_LIST (self));
+  g_return_if_fail (rows != NULL);
+
+  gy_result_list_clear (self);
+  gy_result_list_append_results (self, model, (const guint32 *) rows->data, rows->len);
+}
+
+/**
+ * gy_result_list_get_n_items:
+ * @self: a #GyResultList
+ *
+ * Returns: the number of results shown
+ */
+guint
+gy_result_list_get_n_items (GyResultList *self)
+{
+  g_return_val_if_fail (GY_IS_RESULT_LIST (self), 0);
+
+  return self->n_items;
+}
+
+/**
+ * gy_result_list_set_title:
+ * @self: a #GyResultList
+ * @title: the title shown above the results
+ */
+void
+gy_result_list_set_title (GyResultList *self,
+                          const gchar  *title)
+{
+  g_autofree gchar *markup = NULL;
+
+  g_return_if_fail (GY_IS_RESULT_LIST (self));
+  g_return_if_fail (title != NULL);
+
+  markup = g_markup_printf_escaped ("<b>%s</b>", title);
+  gtk_label_set_markup (self->title, markup);
+}
@@ -0,0 +1,56 @@
+/* gy-result-list.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GY_DEF_LIST_H
+
+#ifndef GY_RESULT_LIST_H
+#define GY_RESULT_LIST_H
+
+#if !defined (GYDICT_INSIDE) && !defined (GYDICT_COMPILATION)
+#error "Only <gydict.h> can be included directly."
+#endif
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define GY_TYPE_RESULT_LIST (gy_result_list_get_type())
+
+G_DECLARE_FINAL_TYPE (GyResultList, gy_result_list, GY, RESULT_LIST, GtkBin)
+
+GtkWidget *gy_result_list_new         (void);
+void       gy_result_list_set_results (GyResultList *self,
+                                       GtkTreeModel *model,
+                                       GArray       *rows);
+void       gy_result_list_append_results (GyResultList  *self,
+                                          GtkTreeModel  *model,
+                                          const guint32 *rows,
+                                          guint          n_rows);
+void       gy_result_list_append_service_results (GyResultList  *self,
+                                                  const gchar   *service_id,
+                                                  GtkTreeModel  *model,
+                                                  const guint32 *rows,
+                                                  guint          n_rows);
+void       gy_result_list_clear       (GyResultList *self);
+guint      gy_result_list_get_n_items (GyResultList *self);
+void       gy_result_list_set_title   (GyResultList *self,
+                                       const gchar  *title);
+
+G_END_DECLS
+
+#endif /* GY_RESULT_LIST_H */
@@ -376,6 +376,34 @@ gy_text_buffer_insert_with_attributes (GyTextBuffer   *self,
   gy_text_attr_iterator_destroy (attr_iter);
 }
 
+/**
+ * gy_text_buffer_insert_scheme:
+ * @self: a GyTextBuffer
+ * @scheme: a formatted lexical unit
+ *
+ * Replaces the content of the buffer with the text of @scheme
+ * formatted by its attributes.
+ */
+void
+gy_text_buffer_insert_scheme (GyTextBuffer   *self,
+                              GyFormatScheme *scheme)
+{
+  GtkTextIter iter;
+  GyTextAttrList *attrs;
+  const gchar *lexical_unit;
+
+  g_return_if_fail (GY_IS_TEXT_BUFFER (self));
+  g_return_if_fail (scheme != NULL);
+
+  gy_text_buffer_clean_buffer (self);
+
+  attrs = (GyTextAttrList *) gy_format_scheme_get_attrs (scheme);
+  lexical_unit = gy_format_scheme_get_lexical_unit (scheme);
+
+  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (self), &iter);
+  gy_text_buffer_insert_with_attributes (self, &iter, lexical_unit, attrs);
+}
+
 void
 gy_text_buffer_insert_and_format (GyTextBuffer *self,
                                   const gchar *text,
@@ -385,24 +413,17 @@ gy_text_buffer_insert_and_format (GyTextBuffer *self,
   g_return_if_fail (GY_IS_TEXT_BUFFER (self));
   g_return_if_fail (GY_IS_DICT_FORMATTER (formatter));
 
-  gy_text_buffer_clean_buffer (self);
-
   GyFormatScheme *scheme = gy_dict_formatter_format (formatter,
                                                      text,
                                                      &error);
 
   if (!error)
     {
-      GtkTextIter iter;
-      GyTextAttrList *attrs = (GyTextAttrList *) gy_format_scheme_get_attrs (scheme);
-      const gchar *lexical_unit = gy_format_scheme_get_lexical_unit (scheme);
-
-      gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (self), &iter);
-      gy_text_buffer_insert_with_attributes (self, &iter, lexical_unit, attrs);
+      gy_text_buffer_insert_scheme (self, scheme);
     }
   else
     {
-
+      gy_text_buffer_clean_buffer (self);
       g_critical ("Error: %s", error->message);
       g_error_free(error);
     }
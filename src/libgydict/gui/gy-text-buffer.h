@@ -50,6 +50,8 @@ void gy_text_buffer_insert_with_attributes (GyTextBuffer  *self,
                                             GtkTextIter   *iter,
                                             const gchar   *text,
                                             GyTextAttrList *attributes);
+void gy_text_buffer_insert_scheme (GyTextBuffer   *self,
+                                   GyFormatScheme *scheme);
 void gy_text_buffer_insert_and_format (GyTextBuffer    *self,
                                        const gchar     *text,
                                        GyDictFormatter *formatter);
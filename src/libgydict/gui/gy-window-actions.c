@@ -22,6 +22,72 @@
 #include "helpers/gy-print-compositor.h"
 
 
+static void
+gy_window_actions_set_dict_service_cb (GObject      *object,
+                                       GAsyncResult *result,
+                                       gpointer      data)
+{
+  g_autoptr(GyWindow) self = GY_WINDOW (data);
+  g_autoptr(GtkTreeModel) model = NULL;
+  GError *error = NULL;
+  GAction *action;
+
+  model = gy_dict_service_get_model_finish (GY_DICT_SERVICE (object), result, &error);
+
+  if (error != NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_critical ("Error: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  gy_def_list_set_model (self->deflist, model);
+  gy_def_list_set_searchable (self->deflist,
+                              GY_IS_DICT_SEARCHABLE (object) ? GY_DICT_SEARCHABLE (object) : NULL);
+  gy_def_list_set_sorted (self->deflist,
+                          gy_service_get_capabilities (GY_SERVICE (object)) & GY_SERVICE_CAPABILITY_SORTED_MODEL);
+
+  action = g_action_map_lookup_action (G_ACTION_MAP (self), "set-dict-service");
+  g_action_change_state (action, g_variant_new_string (self->service_id));
+
+  _gy_window_federated_model_shown (self);
+}
+
+static void
+gy_window_actions_service_ready_cb (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      data)
+{
+  g_autoptr(GyWindow) self = GY_WINDOW (data);
+  g_autoptr(GyService) service = NULL;
+  GError *error = NULL;
+
+  service = gy_service_provider_get_service_by_id_finish (GY_SERVICE_PROVIDER (object), result, &error);
+
+  if (error != NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_critical ("The dictionary services: %s is not available.", self->service_id);
+      g_error_free (error);
+      return;
+    }
+
+  if (!GY_IS_DICT_SERVICE (service))
+    {
+      g_critical ("The dictionary services: %s is not available.", self->service_id);
+      return;
+    }
+
+  /* Holding the service keeps the provider from releasing it while in use. */
+  g_set_object (&self->service, service);
+
+  gy_dict_service_get_model_async (GY_DICT_SERVICE (service),
+                                   self->model_cancellable,
+                                   gy_window_actions_set_dict_service_cb,
+                                   g_steal_pointer (&self));
+}
+
 static void
 gy_window_actions_set_dict_service (GSimpleAction *action,
                                     GVariant      *parameter,
@@ -34,26 +100,51 @@ gy_window_actions_set_dict_service (GSimpleAction *action,
 
   if (g_variant_compare (parameter, state) == 0) return;
 
-  self->service_id = g_variant_get_string (parameter, NULL);
-  GyService *service = gy_service_provider_get_service_by_id (self->service_provider,
-                                                              self->service_id);
-  if (GY_IS_DICT_SERVICE (service))
-    {
-      GError *error = NULL;
-      GtkTreeModel *model = gy_dict_service_get_model((GyDictService *)service, &error);
-      if (error != NULL)
-        {
-          g_critical ("Error: %s", error->message);
-          g_error_free(error);
-          return;
-        }
-      gy_def_list_set_model (self->deflist, model);
-    }
-  else
-    g_critical ("The dictionary services: %s is not available.", self->service_id );
+  g_free (self->service_id);
+  self->service_id = g_variant_dup_string (parameter, NULL);
+
+  /* A slower service must not overwrite the model of a newer choice. */
+  g_cancellable_cancel (self->model_cancellable);
+  g_clear_object (&self->model_cancellable);
+  self->model_cancellable = g_cancellable_new ();
+
+  g_cancellable_cancel (self->lookup_cancellable);
+  _gy_window_fulltext_dispose (self);
+  _gy_window_wildcard_dispose (self);
+  gy_def_list_set_searchable (self->deflist, NULL);
+  gy_def_list_set_sorted (self->deflist, FALSE);
+  gy_def_list_set_model (self->deflist, NULL);
+
+  /* A service registered with a factory may still have to be built. */
+  gy_service_provider_get_service_by_id_async (self->service_provider,
+                                               self->service_id,
+                                               self->model_cancellable,
+                                               gy_window_actions_service_ready_cb,
+                                               g_object_ref (self));
+}
 
+static void
+gy_window_actions_search_definitions (GSimpleAction *action    G_GNUC_UNUSED,
+                                      GVariant      *parameter G_GNUC_UNUSED,
+                                      gpointer       data)
+{
+  _gy_window_fulltext_search (GY_WINDOW (data), FALSE);
+}
 
-  g_action_change_state (G_ACTION (action), parameter);
+static void
+gy_window_actions_search_translations (GSimpleAction *action    G_GNUC_UNUSED,
+                                       GVariant      *parameter G_GNUC_UNUSED,
+                                       gpointer       data)
+{
+  _gy_window_fulltext_search (GY_WINDOW (data), TRUE);
+}
+
+static void
+gy_window_actions_search_all_dictionaries (GSimpleAction *action    G_GNUC_UNUSED,
+                                           GVariant      *parameter G_GNUC_UNUSED,
+                                           gpointer       data)
+{
+  _gy_window_federated_search (GY_WINDOW (data));
 }
 
 static void
@@ -242,6 +333,9 @@ static GActionEntry entries[] =
   { "clip", gy_window_actions_respond_clipboard, NULL, "false", NULL },
   { "close", gy_window_actions_quit_win, NULL, NULL, NULL },
   { "set-dict-service", gy_window_actions_set_dict_service, "s", "''", NULL},
+  { "search-definitions", gy_window_actions_search_definitions, NULL, NULL, NULL },
+  { "search-translations", gy_window_actions_search_translations, NULL, NULL, NULL },
+  { "search-all-dictionaries", gy_window_actions_search_all_dictionaries, NULL, NULL, NULL },
 };
 
 void
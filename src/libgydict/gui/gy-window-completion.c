@@ -0,0 +1,360 @@
+/* gy-window-completion.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include <glib/gi18n-lib.h>
+
+#include "gy-window-private.h"
+#include "services/gy-completion-index.h"
+#include "services/gy-lemma-index.h"
+
+/*
+ * While typing in the search entry, a popover under it lists the
+ * headwords which start with the query. The completion index sorts
+ * the folded keys of the model once, on a worker thread, when it is
+ * first needed; every query afterwards is a pair of bisections.
+ *
+ * A query may be an inflected form of a headword, like "went" of "go".
+ * With a lemma index loaded, the lemmas of the query are offered in the
+ * result list, and selected when no headword starts with the query.
+ *
+ * When no headword starts with the query, it was probably mistyped:
+ * the headwords within a few edits of it are offered in the result
+ * list next to the definition list instead. Wildcard patterns are
+ * left to gy-window-wildcard.c.
+ */
+
+#define COMPLETION_LIMIT 10
+#define FUZZY_LIMIT      20
+
+static void
+gy_window_completion_show_fuzzy (GyWindow     *self,
+                                 GtkTreeModel *model,
+                                 const gchar  *key)
+{
+  g_autoptr(GArray) rows = NULL;
+  guint max_distance;
+
+  /* A short word is within two edits of too many others. */
+  max_distance = g_utf8_strlen (key, -1) > 4 ? 2 : 1;
+  rows = gy_search_keys_find_fuzzy (self->completion_keys, key, max_distance, FUZZY_LIMIT);
+
+  gy_result_list_set_title (self->result_list, _("Did you mean"));
+  gy_result_list_set_results (self->result_list, model, rows);
+
+  if (rows->len > 0)
+    g_object_set (self->dockbin, "right-visible", TRUE, NULL);
+}
+
+/* Finds the rows of the lemmas of @text, leaving out the query itself. */
+static GArray *
+gy_window_completion_find_lemmas (GyWindow     *self,
+                                  GySearchKeys *keys,
+                                  const gchar  *text,
+                                  const gchar  *key)
+{
+  GArray *rows = gy_lemma_index_resolve (self->lemmas, keys, text);
+
+  for (guint i = rows->len; i > 0; i--)
+    {
+      guint32 row = g_array_index (rows, guint32, i - 1);
+
+      if (g_strcmp0 (gy_search_keys_get_key (keys, row, NULL), key) == 0)
+        g_array_remove_index (rows, i - 1);
+    }
+
+  return rows;
+}
+
+static void
+gy_window_completion_show_lemmas (GyWindow     *self,
+                                  GtkTreeModel *model,
+                                  GArray       *rows)
+{
+  gy_result_list_set_title (self->result_list, _("Inflected form of"));
+  gy_result_list_set_results (self->result_list, model, rows);
+  g_object_set (self->dockbin, "right-visible", TRUE, NULL);
+}
+
+static void gy_window_completion_update (GyWindow *self);
+
+static void
+gy_window_completion_build_worker (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
+{
+  GySearchKeys *keys = task_data;
+
+  g_task_return_pointer (task, gy_completion_index_new (keys, NULL),
+                         (GDestroyNotify) gy_completion_index_unref);
+}
+
+static void
+gy_window_completion_build_cb (GObject      *source_object,
+                               GAsyncResult *result,
+                               gpointer      user_data)
+{
+  GyWindow *self = GY_WINDOW (source_object);
+  GySearchKeys *keys = g_task_get_task_data (G_TASK (result));
+  GyCompletionIndex *index;
+
+  index = g_task_propagate_pointer (G_TASK (result), NULL);
+
+  if (index == NULL)
+    return;
+
+  if (keys != self->completion_keys)
+    {
+      gy_completion_index_unref (index);
+      return;
+    }
+
+  g_clear_pointer (&self->completion, gy_completion_index_unref);
+  self->completion = index;
+  g_clear_object (&self->completion_cancellable);
+
+  gy_window_completion_update (self);
+}
+
+static void
+gy_window_completion_build (GyWindow     *self,
+                            GySearchKeys *keys)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_cancellable_cancel (self->completion_cancellable);
+  g_clear_object (&self->completion_cancellable);
+  g_clear_pointer (&self->completion, gy_completion_index_unref);
+  g_clear_pointer (&self->completion_keys, gy_search_keys_unref);
+
+  self->completion_keys = gy_search_keys_ref (keys);
+  self->completion_cancellable = g_cancellable_new ();
+
+  task = g_task_new (self, self->completion_cancellable,
+                     gy_window_completion_build_cb, NULL);
+  g_task_set_source_tag (task, gy_window_completion_build);
+  g_task_set_task_data (task, gy_search_keys_ref (keys),
+                        (GDestroyNotify) gy_search_keys_unref);
+  g_task_set_return_on_cancel (task, TRUE);
+  g_task_run_in_thread (task, gy_window_completion_build_worker);
+}
+
+static GtkWidget *
+gy_window_completion_create_row (GtkTreeModel *model,
+                                 guint         row)
+{
+  g_autofree gchar *headword = NULL;
+  GtkWidget *label;
+  GtkTreeIter iter;
+
+  if (!gtk_tree_model_iter_nth_child (model, &iter, NULL, row))
+    return NULL;
+
+  gtk_tree_model_get (model, &iter, 0, &headword, -1);
+
+  label = gtk_label_new (headword);
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+  gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+  g_object_set_data (G_OBJECT (label), "row", GUINT_TO_POINTER (row));
+  gtk_widget_show (label);
+
+  return label;
+}
+
+static void
+gy_window_completion_update (GyWindow *self)
+{
+  g_autoptr(GArray) rows = NULL;
+  g_autoptr(GArray) lemma_rows = NULL;
+  g_autofree gchar *key = NULL;
+  g_autoptr(GList) children = NULL;
+  GtkTreeModel *model;
+  GySearchKeys *keys;
+  const gchar *text;
+
+  text = gtk_entry_get_text (GTK_ENTRY (self->search_entry));
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (self->deflist));
+
+  if (gy_trigram_index_is_pattern (text))
+    {
+      gtk_popover_popdown (self->completion_popover);
+      _gy_window_wildcard_search (self);
+      return;
+    }
+
+  /* The results of a pattern typed before must not trickle in any more. */
+  g_cancellable_cancel (self->wildcard_cancellable);
+
+  if (*text == '\0' || model == NULL
+      || (keys = gy_def_list_get_search_keys (self->deflist)) == NULL
+      || (key = gy_search_keys_fold (keys, text, -1)) == NULL)
+    {
+      gtk_popover_popdown (self->completion_popover);
+      gy_result_list_clear (self->result_list);
+      return;
+    }
+
+  if (keys != self->completion_keys)
+    gy_window_completion_build (self, keys);
+
+  if (self->completion == NULL)
+    return;
+
+  children = gtk_container_get_children (GTK_CONTAINER (self->completion_list));
+
+  for (GList *l = children; l != NULL; l = l->next)
+    gtk_widget_destroy (l->data);
+
+  rows = gy_completion_index_complete (self->completion, key, COMPLETION_LIMIT);
+
+  if (self->lemmas != NULL)
+    lemma_rows = gy_window_completion_find_lemmas (self, keys, text, key);
+
+  for (guint i = 0; i < rows->len; i++)
+    {
+      GtkWidget *label = gy_window_completion_create_row (model, g_array_index (rows, guint32, i));
+
+      if (label != NULL)
+        gtk_container_add (GTK_CONTAINER (self->completion_list), label);
+    }
+
+  if (rows->len > 0)
+    {
+      gtk_popover_popup (self->completion_popover);
+
+      if (lemma_rows != NULL && lemma_rows->len > 0)
+        gy_window_completion_show_lemmas (self, model, lemma_rows);
+      else
+        gy_result_list_clear (self->result_list);
+    }
+  else if (lemma_rows != NULL && lemma_rows->len > 0)
+    {
+      gtk_popover_popdown (self->completion_popover);
+      gy_window_completion_show_lemmas (self, model, lemma_rows);
+      gy_def_list_select_row (self->deflist, g_array_index (lemma_rows, guint32, 0));
+    }
+  else
+    {
+      gtk_popover_popdown (self->completion_popover);
+      gy_window_completion_show_fuzzy (self, model, key);
+    }
+}
+
+static void
+gy_window_completion_row_activated (GyWindow      *self,
+                                    GtkListBoxRow *row,
+                                    GtkListBox    *list)
+{
+  GtkWidget *label = gtk_bin_get_child (GTK_BIN (row));
+
+  gy_def_list_select_row (self->deflist,
+                          GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (label), "row")));
+  gtk_popover_popdown (self->completion_popover);
+}
+
+static void
+gy_window_completion_keys_ready (GyWindow *self)
+{
+  /* A query typed while the keys were built is completed now. */
+  if (*gtk_entry_get_text (GTK_ENTRY (self->search_entry)) != '\0')
+    gy_window_completion_update (self);
+}
+
+static void
+gy_window_completion_popdown (GyWindow *self)
+{
+  gtk_popover_popdown (self->completion_popover);
+}
+
+static void
+gy_window_completion_result_activated (GyWindow     *self,
+                                       guint         row,
+                                       GyResultList *result_list)
+{
+  gy_def_list_select_row (self->deflist, row);
+}
+
+void
+_gy_window_completion_init (GyWindow *self)
+{
+  GtkWidget *scrolled;
+
+  self->completion_popover = GTK_POPOVER (gtk_popover_new (GTK_WIDGET (self->search_entry)));
+  gtk_popover_set_modal (self->completion_popover, FALSE);
+  gtk_popover_set_position (self->completion_popover, GTK_POS_BOTTOM);
+
+  scrolled = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled),
+                                  GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+  gtk_scrolled_window_set_propagate_natural_height (GTK_SCROLLED_WINDOW (scrolled), TRUE);
+  gtk_scrolled_window_set_max_content_height (GTK_SCROLLED_WINDOW (scrolled), 320);
+
+  self->completion_list = GTK_LIST_BOX (gtk_list_box_new ());
+  gtk_list_box_set_activate_on_single_click (self->completion_list, TRUE);
+
+  gtk_container_add (GTK_CONTAINER (scrolled), GTK_WIDGET (self->completion_list));
+  gtk_container_add (GTK_CONTAINER (self->completion_popover), scrolled);
+  gtk_widget_show_all (scrolled);
+
+  g_signal_connect_object (self->completion_list, "row-activated",
+                           G_CALLBACK (gy_window_completion_row_activated),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->result_list, "result-activated",
+                           G_CALLBACK (gy_window_completion_result_activated),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->search_entry, "changed",
+                           G_CALLBACK (gy_window_completion_update),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->deflist, "search-keys-ready",
+                           G_CALLBACK (gy_window_completion_keys_ready),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->search_entry, "activate",
+                           G_CALLBACK (gy_window_completion_popdown),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->search_entry, "stop-search",
+                           G_CALLBACK (gy_window_completion_popdown),
+                           self, G_CONNECT_SWAPPED);
+}
+
+void
+_gy_window_completion_load_lemmas (GyWindow    *self,
+                                   const gchar *filename)
+{
+  g_autoptr(GError) error = NULL;
+
+  g_clear_object (&self->lemmas);
+
+  if (filename == NULL || *filename == '\0')
+    return;
+
+  if ((self->lemmas = gy_lemma_index_new (filename, &error)) == NULL)
+    g_warning ("The inflected forms cannot be looked up: %s", error->message);
+}
+
+void
+_gy_window_completion_dispose (GyWindow *self)
+{
+  g_clear_object (&self->lemmas);
+  g_cancellable_cancel (self->completion_cancellable);
+  g_clear_object (&self->completion_cancellable);
+  g_clear_pointer (&self->completion, gy_completion_index_unref);
+  g_clear_pointer (&self->completion_keys, gy_search_keys_unref);
+}
@@ -0,0 +1,151 @@
+/* gy-window-federated.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <glib/gi18n-lib.h>
+
+#include "gy-window-private.h"
+
+/*
+ * Searches every registered dictionary for the headwords beginning
+ * with the text of the search entry. The dictionaries are searched in
+ * parallel and the headwords of each go to the result list as soon as
+ * it answers; the dictionaries which miss the deadline are left out.
+ * Activating a result switches to its dictionary and selects the row
+ * once the model of that dictionary is shown.
+ */
+
+#define FEDERATED_LIMIT 10
+#define FEDERATED_TIMEOUT_MSEC 1500
+
+static void
+gy_window_federated_results (const gchar   *service_id,
+                             GtkTreeModel  *model,
+                             const guint32 *rows,
+                             guint          n_rows,
+                             gpointer       data)
+{
+  GyWindow *self = GY_WINDOW (data);
+
+  gy_result_list_append_service_results (self->result_list, service_id, model, rows, n_rows);
+}
+
+static void
+gy_window_federated_done_cb (GObject      *object,
+                             GAsyncResult *result,
+                             gpointer      data)
+{
+  g_autoptr(GyWindow) self = GY_WINDOW (data);
+  GError *error = NULL;
+
+  if (!gy_service_provider_search_all_finish (GY_SERVICE_PROVIDER (object), result, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("The dictionaries cannot be searched: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  g_clear_object (&self->federated_cancellable);
+
+  if (gy_result_list_get_n_items (self->result_list) == 0)
+    gy_result_list_set_title (self->result_list, _("Not found in any dictionary"));
+}
+
+static void
+gy_window_federated_result_activated (GyWindow     *self,
+                                      const gchar  *service_id,
+                                      guint         row,
+                                      GyResultList *result_list)
+{
+  GAction *action;
+  g_autoptr(GVariant) state = NULL;
+
+  action = g_action_map_lookup_action (G_ACTION_MAP (self), "set-dict-service");
+  state = g_action_get_state (action);
+
+  if (g_strcmp0 (g_variant_get_string (state, NULL), service_id) == 0)
+    {
+      gy_def_list_select_row (self->deflist, row);
+      return;
+    }
+
+  /* The row is selected when the model of the service is shown. */
+  g_free (self->federated_service_id);
+  self->federated_service_id = g_strdup (service_id);
+  self->federated_row = row;
+
+  g_action_activate (action, g_variant_new_string (service_id));
+}
+
+void
+_gy_window_federated_init (GyWindow *self)
+{
+  g_signal_connect_object (self->result_list, "service-result-activated",
+                           G_CALLBACK (gy_window_federated_result_activated),
+                           self, G_CONNECT_SWAPPED);
+}
+
+void
+_gy_window_federated_model_shown (GyWindow *self)
+{
+  if (self->federated_service_id == NULL)
+    return;
+
+  if (g_strcmp0 (self->federated_service_id, self->service_id) == 0)
+    gy_def_list_select_row (self->deflist, self->federated_row);
+
+  g_clear_pointer (&self->federated_service_id, g_free);
+}
+
+void
+_gy_window_federated_search (GyWindow *self)
+{
+  const gchar *text;
+
+  text = gtk_entry_get_text (GTK_ENTRY (self->search_entry));
+
+  g_cancellable_cancel (self->federated_cancellable);
+  g_clear_object (&self->federated_cancellable);
+
+  if (*text == '\0')
+    return;
+
+  self->federated_cancellable = g_cancellable_new ();
+
+  gy_result_list_clear (self->result_list);
+  gy_result_list_set_title (self->result_list, _("In all dictionaries"));
+  g_object_set (self->dockbin, "right-visible", TRUE, NULL);
+
+  gy_service_provider_search_all_async (self->service_provider, text,
+                                        FEDERATED_LIMIT, FEDERATED_TIMEOUT_MSEC,
+                                        gy_window_federated_results,
+                                        g_object_ref (self), g_object_unref,
+                                        self->federated_cancellable,
+                                        gy_window_federated_done_cb,
+                                        g_object_ref (self));
+}
+
+void
+_gy_window_federated_dispose (GyWindow *self)
+{
+  g_cancellable_cancel (self->federated_cancellable);
+  g_clear_object (&self->federated_cancellable);
+  g_clear_pointer (&self->federated_service_id, g_free);
+}
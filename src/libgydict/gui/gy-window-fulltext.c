@@ -0,0 +1,175 @@
+/* gy-window-fulltext.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include <glib/gi18n-lib.h>
+
+#include "gy-window-private.h"
+#include "services/gy-fulltext-index.h"
+
+/*
+ * Searches the definitions, rather than the headwords, for the words
+ * in the search entry; or only the spans marked as translations, which
+ * finds the headwords translated as the words, the reverse direction of
+ * a bilingual dictionary. The index of the service is loaded, or built
+ * in the background on the first search, and kept while the same
+ * service is shown. The entries found go to the result list.
+ */
+
+#define FULLTEXT_LIMIT 200
+
+typedef struct
+{
+  GyWindow *self;
+  gboolean  translations;
+} LoadData;
+
+static GyWindowFulltext *
+gy_window_fulltext_get (GyWindow *self,
+                        gboolean  translations)
+{
+  return translations ? &self->reverse : &self->fulltext;
+}
+
+static void
+gy_window_fulltext_show (GyWindow *self,
+                         gboolean  translations)
+{
+  GyWindowFulltext *fulltext = gy_window_fulltext_get (self, translations);
+  g_autoptr(GArray) rows = NULL;
+  GtkTreeModel *model;
+  const gchar *text;
+
+  text = gtk_entry_get_text (GTK_ENTRY (self->search_entry));
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (self->deflist));
+
+  if (*text == '\0' || model == NULL)
+    return;
+
+  rows = gy_fulltext_index_query (fulltext->index, text, FULLTEXT_LIMIT);
+
+  gy_result_list_set_title (self->result_list,
+                            translations ? _("Translated as") : _("Definitions containing"));
+  gy_result_list_set_results (self->result_list, model, rows);
+  g_object_set (self->dockbin, "right-visible", TRUE, NULL);
+}
+
+static void
+gy_window_fulltext_load_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  LoadData *data = user_data;
+  g_autoptr(GyWindow) self = data->self;
+  gboolean translations = data->translations;
+  GyWindowFulltext *fulltext = gy_window_fulltext_get (self, translations);
+  g_autoptr(GyFulltextIndex) index = NULL;
+  GError *error = NULL;
+
+  g_slice_free (LoadData, data);
+
+  index = gy_fulltext_index_load_finish (result, &error);
+
+  /* The index of a service shown before is dropped, whatever became of it. */
+  if (object != G_OBJECT (self->service) ||
+      g_strcmp0 (fulltext->service_id, gy_service_get_service_id (self->service)) != 0)
+    {
+      g_clear_error (&error);
+      return;
+    }
+
+  if (error != NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_warning ("The %s cannot be searched: %s",
+                     translations ? "translations" : "definitions", error->message);
+          g_clear_pointer (&fulltext->service_id, g_free);
+        }
+      g_error_free (error);
+      return;
+    }
+
+  g_clear_object (&fulltext->cancellable);
+  g_set_object (&fulltext->index, index);
+
+  gy_window_fulltext_show (self, translations);
+}
+
+static void
+gy_window_fulltext_clear (GyWindowFulltext *fulltext)
+{
+  g_cancellable_cancel (fulltext->cancellable);
+  g_clear_object (&fulltext->cancellable);
+  g_clear_object (&fulltext->index);
+  g_clear_pointer (&fulltext->service_id, g_free);
+}
+
+/*
+ * Searches the words of the entry in the definitions of the service
+ * shown, or in their translations when @translations is %TRUE.
+ */
+void
+_gy_window_fulltext_search (GyWindow *self,
+                            gboolean  translations)
+{
+  GyWindowFulltext *fulltext = gy_window_fulltext_get (self, translations);
+  const gchar *service_id;
+  LoadData *data;
+
+  if (!GY_IS_DICT_SERVICE (self->service))
+    return;
+
+  /* The id of the action changes before the service is swapped. */
+  service_id = gy_service_get_service_id (self->service);
+
+  if (g_strcmp0 (fulltext->service_id, service_id) == 0)
+    {
+      /* Still loading: the search runs once the index is ready. */
+      if (fulltext->index != NULL)
+        gy_window_fulltext_show (self, translations);
+      return;
+    }
+
+  gy_window_fulltext_clear (fulltext);
+
+  fulltext->service_id = g_strdup (service_id);
+  fulltext->cancellable = g_cancellable_new ();
+
+  data = g_slice_new0 (LoadData);
+  data->self = g_object_ref (self);
+  data->translations = translations;
+
+  if (translations)
+    gy_fulltext_index_load_translations_async (GY_DICT_SERVICE (self->service),
+                                               fulltext->cancellable,
+                                               gy_window_fulltext_load_cb, data);
+  else
+    gy_fulltext_index_load_async (GY_DICT_SERVICE (self->service),
+                                  fulltext->cancellable,
+                                  gy_window_fulltext_load_cb, data);
+}
+
+void
+_gy_window_fulltext_dispose (GyWindow *self)
+{
+  gy_window_fulltext_clear (&self->fulltext);
+  gy_window_fulltext_clear (&self->reverse);
+}
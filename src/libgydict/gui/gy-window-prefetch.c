@@ -0,0 +1,95 @@
+/* gy-window-prefetch.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "gy-window-private.h"
+
+/*
+ * When the selection in the list of headwords moves, the neighbours of
+ * the new row are fetched in the background, so stepping through the
+ * list with the arrow keys or the mouse wheel finds them in the cache.
+ * The rows in the direction of the last move are fetched first and
+ * in greater number than the rows behind.
+ */
+
+#define PREFETCH_AHEAD  6
+#define PREFETCH_BEHIND 2
+
+static void
+gy_window_prefetch_notify_selected_index (GyWindow   *self,
+                                          GParamSpec *pspec,
+                                          GyDefList  *deflist)
+{
+  GtkTreeModel *model;
+  guint indices[PREFETCH_AHEAD + PREFETCH_BEHIND];
+  guint n_indices = 0;
+  gint n_rows;
+  gint row;
+  gint step;
+
+  g_object_get (deflist, "selected-index", &row, NULL);
+
+  g_cancellable_cancel (self->prefetch_cancellable);
+  g_clear_object (&self->prefetch_cancellable);
+
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (deflist));
+
+  if (row < 0 || model == NULL || self->service_id == NULL)
+    {
+      self->prefetch_last_row = -1;
+      return;
+    }
+
+  step = (self->prefetch_last_row < 0 || row >= self->prefetch_last_row) ? 1 : -1;
+  self->prefetch_last_row = row;
+  n_rows = gtk_tree_model_iter_n_children (model, NULL);
+
+  for (gint i = 1; i <= PREFETCH_AHEAD; i++)
+    {
+      gint neighbour = row + i * step;
+
+      if (neighbour >= 0 && neighbour < n_rows)
+        indices[n_indices++] = neighbour;
+    }
+
+  for (gint i = 1; i <= PREFETCH_BEHIND; i++)
+    {
+      gint neighbour = row - i * step;
+
+      if (neighbour >= 0 && neighbour < n_rows)
+        indices[n_indices++] = neighbour;
+    }
+
+  if (n_indices == 0)
+    return;
+
+  self->prefetch_cancellable = g_cancellable_new ();
+  gy_service_provider_prefetch (self->service_provider, self->service_id,
+                                indices, n_indices, self->prefetch_cancellable);
+}
+
+void
+_gy_window_prefetch_init (GyWindow *self)
+{
+  self->prefetch_last_row = -1;
+
+  g_signal_connect_object (self->deflist, "notify::selected-index",
+                           G_CALLBACK (gy_window_prefetch_notify_selected_index),
+                           self, G_CONNECT_SWAPPED);
+}
@@ -27,19 +27,33 @@
 #include "gy-window.h"
 #include "gy-search-bar.h"
 #include "gy-def-list.h"
+#include "gy-result-list.h"
 #include "gy-text-view.h"
 #include "gy-text-buffer.h"
 #include "services/gy-dict-service.h"
 #include "services/gy-service-provider.h"
+#include "services/gy-completion-index.h"
+#include "services/gy-lemma-index.h"
+#include "services/gy-fulltext-index.h"
+#include "services/gy-trigram-index.h"
 
 G_BEGIN_DECLS
 
+/* A full-text index of the service shown, see gy-window-fulltext.c. */
+typedef struct
+{
+  GyFulltextIndex *index;
+  gchar           *service_id;
+  GCancellable    *cancellable;
+} GyWindowFulltext;
+
 struct _GyWindow
 {
   DzlApplicationWindow  __parent__;
 
   DzlDockBin           *dockbin;
   GyDefList            *deflist;
+  GyResultList         *result_list;
   GtkTreeSelection     *selection;
   GyTextView           *textview;
   GyTextBuffer         *buffer;
@@ -50,13 +64,51 @@ struct _GyWindow
   GtkClipboard         *clipboard; /* Non free! */
   DzlMenuManager       *menu_manager;
 
-  const gchar       *service_id;
+  gchar             *service_id;
+  GyService         *service;
   GyServiceProvider *service_provider;
+  GCancellable      *model_cancellable;
+  GCancellable      *lookup_cancellable;
+  GCancellable      *prefetch_cancellable;
+  gint               prefetch_last_row;
+
+  GtkPopover        *completion_popover;
+  GtkListBox        *completion_list;
+  GySearchKeys      *completion_keys;
+  GyCompletionIndex *completion;
+  GCancellable      *completion_cancellable;
+  GyLemmaIndex      *lemmas;
+
+  GyWindowFulltext   fulltext;
+  GyWindowFulltext   reverse;
+
+  GyTrigramIndex    *trigram;
+  GySearchKeys      *trigram_keys;
+  GCancellable      *trigram_cancellable;
+  GCancellable      *wildcard_cancellable;
+
+  GCancellable      *federated_cancellable;
+  gchar             *federated_service_id;
+  guint              federated_row;
 };
 
 
 void _gy_window_plugins_init_extens (GyWindow *self);
 void _gy_window_actions_init (GyWindow *self);
 void _gy_window_settings_register (GtkWindow *window);
+void _gy_window_prefetch_init (GyWindow *self);
+void _gy_window_completion_init (GyWindow *self);
+void _gy_window_completion_dispose (GyWindow *self);
+void _gy_window_completion_load_lemmas (GyWindow    *self,
+                                        const gchar *filename);
+void _gy_window_fulltext_search (GyWindow *self,
+                                 gboolean  translations);
+void _gy_window_fulltext_dispose (GyWindow *self);
+void _gy_window_wildcard_search (GyWindow *self);
+void _gy_window_wildcard_dispose (GyWindow *self);
+void _gy_window_federated_init (GyWindow *self);
+void _gy_window_federated_search (GyWindow *self);
+void _gy_window_federated_model_shown (GyWindow *self);
+void _gy_window_federated_dispose (GyWindow *self);
 
 G_END_DECLS
@@ -22,11 +22,19 @@
  */
 
 #include <dazzle.h>
-#include "gy-window.h"
+#include "gy-window-private.h"
 #include "gy-window-settings.h"
+#include "helpers/gy-fold-table.h"
 
 #define SAVE_TIMEOUT_SECS    1
 
+/* The values of the org.gtk.gydict.SearchFolding enum. */
+enum
+{
+  SEARCH_FOLDING_STRICT,
+  SEARCH_FOLDING_IGNORE_DIACRITICS
+};
+
 static GSettings *settings;
 
 static gboolean
@@ -75,6 +83,39 @@ gy_window_settings__window_configure_event (GtkWindow         *window,
   return GDK_EVENT_PROPAGATE;
 }
 
+static void
+gy_window_settings__search_folding_changed (GSettings   *settings,
+                                            const gchar *key,
+                                            GyWindow    *window)
+{
+  g_autofree gchar *language = NULL;
+  const GyFoldTable *fold_table = NULL;
+
+  g_assert (GY_IS_WINDOW (window));
+
+  if (g_settings_get_enum (settings, "search-folding") == SEARCH_FOLDING_IGNORE_DIACRITICS)
+    {
+      language = g_settings_get_string (settings, "search-folding-language");
+      fold_table = gy_fold_table_get (*language != '\0' ? language : g_get_language_names ()[0]);
+    }
+
+  gy_def_list_set_fold_table (window->deflist, fold_table);
+  gy_service_provider_set_fold_table (window->service_provider, fold_table);
+}
+
+static void
+gy_window_settings__lemma_index_changed (GSettings   *settings,
+                                         const gchar *key,
+                                         GyWindow    *window)
+{
+  g_autofree gchar *filename = NULL;
+
+  g_assert (GY_IS_WINDOW (window));
+
+  filename = g_settings_get_string (settings, "lemma-index");
+  _gy_window_completion_load_lemmas (window, filename);
+}
+
 static void
 gy_window_settings__window_realize (GtkWindow *window)
 {
@@ -106,7 +147,15 @@ gy_window_settings__window_realize (GtkWindow *window)
   g_settings_bind (settings, "right-panel-visible", edge, "reveal-child", G_SETTINGS_BIND_DEFAULT);
   g_settings_bind (settings, "right-panel-position", edge, "position", G_SETTINGS_BIND_DEFAULT);
 
+  g_signal_connect_object (settings, "changed::search-folding",
+                           G_CALLBACK (gy_window_settings__search_folding_changed), window, 0);
+  g_signal_connect_object (settings, "changed::search-folding-language",
+                           G_CALLBACK (gy_window_settings__search_folding_changed), window, 0);
+  gy_window_settings__search_folding_changed (settings, NULL, GY_WINDOW (window));
 
+  g_signal_connect_object (settings, "changed::lemma-index",
+                           G_CALLBACK (gy_window_settings__lemma_index_changed), window, 0);
+  gy_window_settings__lemma_index_changed (settings, NULL, GY_WINDOW (window));
 }
 
 static void
@@ -137,6 +186,14 @@ gy_window_settings__window_destroy (GtkWindow *window)
                                         G_CALLBACK (gy_window_settings__window_realize),
                                         NULL);
 
+  g_signal_handlers_disconnect_by_func (settings,
+                                        G_CALLBACK (gy_window_settings__search_folding_changed),
+                                        window);
+
+  g_signal_handlers_disconnect_by_func (settings,
+                                        G_CALLBACK (gy_window_settings__lemma_index_changed),
+                                        window);
+
   g_object_unref (settings);
 }
 
@@ -0,0 +1,159 @@
+/* gy-window-wildcard.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include <glib/gi18n-lib.h>
+
+#include "gy-window-private.h"
+#include "services/gy-trigram-index.h"
+
+/*
+ * A query with '*' or '?' in the search entry is a wildcard pattern.
+ * It is looked up in the trigram index of the headwords, which is
+ * loaded from the cache or built on the first such query, and the
+ * matching headwords are added to the result list as they are found.
+ */
+
+#define WILDCARD_LIMIT 500
+
+static void
+gy_window_wildcard_results (const guint32 *rows,
+                            guint          n_rows,
+                            gpointer       user_data)
+{
+  GyWindow *self = GY_WINDOW (user_data);
+  GtkTreeModel *model = gtk_tree_view_get_model (GTK_TREE_VIEW (self->deflist));
+
+  if (model == NULL)
+    return;
+
+  gy_result_list_append_results (self->result_list, model, rows, n_rows);
+  g_object_set (self->dockbin, "right-visible", TRUE, NULL);
+}
+
+static void
+gy_window_wildcard_search_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      data)
+{
+  GError *error = NULL;
+
+  if (!gy_trigram_index_search_finish (GY_TRIGRAM_INDEX (object), result, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("The wildcard search failed: %s", error->message);
+      g_error_free (error);
+    }
+}
+
+static void
+gy_window_wildcard_load_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      data)
+{
+  g_autoptr(GyWindow) self = GY_WINDOW (data);
+  g_autoptr(GyTrigramIndex) index = NULL;
+  GError *error = NULL;
+
+  index = gy_trigram_index_load_finish (result, &error);
+
+  /* A newer load has taken the place of this one. */
+  if (g_task_get_cancellable (G_TASK (result)) != self->trigram_cancellable)
+    {
+      g_clear_error (&error);
+      return;
+    }
+
+  if (error != NULL)
+    {
+      g_warning ("The headwords cannot be searched with wildcards: %s", error->message);
+      g_error_free (error);
+
+      /* Forget the keys, so the next search loads the index again. */
+      g_clear_object (&self->trigram_cancellable);
+      g_clear_pointer (&self->trigram_keys, gy_search_keys_unref);
+      return;
+    }
+
+  g_clear_object (&self->trigram_cancellable);
+  g_set_object (&self->trigram, index);
+
+  if (gy_trigram_index_is_pattern (gtk_entry_get_text (GTK_ENTRY (self->search_entry))))
+    _gy_window_wildcard_search (self);
+}
+
+void
+_gy_window_wildcard_search (GyWindow *self)
+{
+  GySearchKeys *keys;
+  const gchar *text;
+
+  g_cancellable_cancel (self->wildcard_cancellable);
+  g_clear_object (&self->wildcard_cancellable);
+
+  gy_result_list_clear (self->result_list);
+  gy_result_list_set_title (self->result_list, _("Matching"));
+
+  text = gtk_entry_get_text (GTK_ENTRY (self->search_entry));
+  keys = gy_def_list_get_search_keys (self->deflist);
+
+  if (keys == NULL || !GY_IS_DICT_SERVICE (self->service))
+    return;
+
+  if (keys != self->trigram_keys)
+    {
+      g_cancellable_cancel (self->trigram_cancellable);
+      g_clear_object (&self->trigram_cancellable);
+      g_clear_object (&self->trigram);
+      g_clear_pointer (&self->trigram_keys, gy_search_keys_unref);
+
+      self->trigram_keys = gy_search_keys_ref (keys);
+      self->trigram_cancellable = g_cancellable_new ();
+
+      gy_trigram_index_load_async (GY_DICT_SERVICE (self->service), keys,
+                                   self->trigram_cancellable,
+                                   gy_window_wildcard_load_cb,
+                                   g_object_ref (self));
+      return;
+    }
+
+  /* Still loading: the search runs once the index is ready. */
+  if (self->trigram == NULL)
+    return;
+
+  self->wildcard_cancellable = g_cancellable_new ();
+
+  gy_trigram_index_search_async (self->trigram, text, WILDCARD_LIMIT,
+                                 gy_window_wildcard_results,
+                                 g_object_ref (self), g_object_unref,
+                                 self->wildcard_cancellable,
+                                 gy_window_wildcard_search_cb, NULL);
+}
+
+void
+_gy_window_wildcard_dispose (GyWindow *self)
+{
+  g_cancellable_cancel (self->wildcard_cancellable);
+  g_clear_object (&self->wildcard_cancellable);
+  g_cancellable_cancel (self->trigram_cancellable);
+  g_clear_object (&self->trigram_cancellable);
+  g_clear_object (&self->trigram);
+  g_clear_pointer (&self->trigram_keys, gy_search_keys_unref);
+}
@@ -32,6 +32,32 @@
 
 G_DEFINE_TYPE (GyWindow, gy_window, DZL_TYPE_APPLICATION_WINDOW);
 
+static void
+gy_window_show_lexical_unit_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      data)
+{
+  g_autoptr(GyWindow) self = GY_WINDOW (data);
+  GyFormatScheme *scheme;
+  GError *error = NULL;
+
+  scheme = gy_service_provider_lookup_finish (GY_SERVICE_PROVIDER (object), result, &error);
+
+  if (error != NULL)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_critical ("Error: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  if (scheme != NULL)
+    {
+      gy_text_buffer_insert_scheme (self->buffer, scheme);
+      gy_format_scheme_unref (scheme);
+    }
+}
+
 static void
 gy_window_show_lexical_unit (GtkTreeSelection *selection,
                              gpointer          data)
@@ -47,25 +73,20 @@ gy_window_show_lexical_unit (GtkTreeSelection *selection,
 
       path = gtk_tree_model_get_path (model, &iter);
       row = gtk_tree_path_get_indices (path);
-      GyService *service = gy_service_provider_get_service_by_id (self->service_provider,
-                                                                  self->service_id);
       if (row)
         {
-          if (GY_IS_DICT_SERVICE (service))
+          if (GY_IS_DICT_SERVICE (self->service))
             {
-              GError *error = NULL;
-              g_autofree gchar *lexical_unit =
-                gy_dict_service_get_lexical_unit(GY_DICT_SERVICE (service), *row, &error);
-
-              if (error != NULL)
-                {
-                  g_critical ("Error: %s", error->message);
-                  g_error_free(error);
-                  return;
-                }
-              GyDictFormatter *formatter = gy_dict_service_get_formatter (GY_DICT_SERVICE (service));
-              gy_text_buffer_insert_and_format (self->buffer, lexical_unit, formatter);
-              g_object_unref (formatter);
+              /* Only the most recent selection is worth showing. */
+              g_cancellable_cancel (self->lookup_cancellable);
+              g_clear_object (&self->lookup_cancellable);
+              self->lookup_cancellable = g_cancellable_new ();
+
+              gy_service_provider_lookup_async (self->service_provider,
+                                                gy_service_get_service_id (self->service), *row,
+                                                self->lookup_cancellable,
+                                                gy_window_show_lexical_unit_cb,
+                                                g_object_ref (self));
             }
           else
             g_critical("The dictionary services: %s is not available.", self->service_id );
@@ -108,9 +129,31 @@ gy_window_dispose (GObject *obj)
   if (self->extens != NULL)
     g_clear_object (&self->extens);
 
+  g_cancellable_cancel (self->model_cancellable);
+  g_clear_object (&self->model_cancellable);
+  g_cancellable_cancel (self->lookup_cancellable);
+  g_clear_object (&self->lookup_cancellable);
+  g_cancellable_cancel (self->prefetch_cancellable);
+  g_clear_object (&self->prefetch_cancellable);
+  _gy_window_completion_dispose (self);
+  _gy_window_fulltext_dispose (self);
+  _gy_window_wildcard_dispose (self);
+  _gy_window_federated_dispose (self);
+  g_clear_object (&self->service);
+
   G_OBJECT_CLASS (gy_window_parent_class)->dispose (obj);
 }
 
+static void
+gy_window_finalize (GObject *obj)
+{
+  GyWindow *self = GY_WINDOW (obj);
+
+  g_clear_pointer (&self->service_id, g_free);
+
+  G_OBJECT_CLASS (gy_window_parent_class)->finalize (obj);
+}
+
 static void
 gy_window_constructed(GObject *obj)
 {
@@ -134,8 +177,8 @@ gy_window_init (GyWindow *self)
 
   self->clipboard = gtk_clipboard_get (GDK_SELECTION_PRIMARY);
 
-  gtk_tree_view_set_search_entry (GTK_TREE_VIEW (self->deflist),
-                                  GTK_ENTRY (gtk_header_bar_get_custom_title (GTK_HEADER_BAR (self->header_bar))));
+  gy_def_list_set_search_entry (self->deflist,
+                                GTK_ENTRY (gtk_header_bar_get_custom_title (GTK_HEADER_BAR (self->header_bar))));
 
   g_object_set_data (G_OBJECT (self->buffer), "textview", self->textview);
 
@@ -145,6 +188,10 @@ gy_window_init (GyWindow *self)
   g_signal_connect (self->selection, "changed",
                    G_CALLBACK (gy_window_show_lexical_unit), self);
 
+  _gy_window_prefetch_init (self);
+  _gy_window_completion_init (self);
+  _gy_window_federated_init (self);
+
   g_signal_connect (self, "button-press-event",
                     G_CALLBACK (gy_window_button_press_event), NULL);
   g_signal_connect (self->dockbin, "notify::top-visible",
@@ -158,11 +205,13 @@ gy_window_class_init (GyWindowClass *klass)
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
   object_class->dispose = gy_window_dispose;
+  object_class->finalize = gy_window_finalize;
   object_class->constructed = gy_window_constructed;
 
   gtk_widget_class_set_template_from_resource (widget_class, "/org/gtk/gydict/gy-window.ui");
   gtk_widget_class_bind_template_child (widget_class, GyWindow, dockbin);
   gtk_widget_class_bind_template_child (widget_class, GyWindow, deflist);
+  gtk_widget_class_bind_template_child (widget_class, GyWindow, result_list);
   gtk_widget_class_bind_template_child (widget_class, GyWindow, textview);
   gtk_widget_class_bind_template_child (widget_class, GyWindow, buffer);
   gtk_widget_class_bind_template_child (widget_class, GyWindow, header_bar);
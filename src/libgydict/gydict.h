@@ -28,6 +28,7 @@ G_BEGIN_DECLS
 #include "app/gy-app.h"
 #include "app/gy-app-addin.h"
 #include "helpers/gy-utility-func.h"
+#include "helpers/gy-fold-table.h"
 #include "helpers/gy-text-attribute.h"
 #include "helpers/gy-format-scheme.h"
 #include "preferences/gy-prefs-view.h"
@@ -35,6 +36,14 @@ G_BEGIN_DECLS
 #include "preferences/gy-prefs-window.h"
 #include "services/gy-dict-service.h"
 #include "services/gy-dict-formatter.h"
+#include "services/gy-dict-searchable.h"
+#include "services/gy-headword-index.h"
+#include "services/gy-headword-model.h"
+#include "services/gy-search-keys.h"
+#include "services/gy-completion-index.h"
+#include "services/gy-fulltext-index.h"
+#include "services/gy-lemma-index.h"
+#include "services/gy-trigram-index.h"
 #include "services/gy-service.h"
 #include "services/gy-service-provider.h"
 #include "gui/gy-window.h"
@@ -0,0 +1,237 @@
+/* gy-arena.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+#include "gy-arena.h"
+
+/*
+ * An arena hands out memory from large blocks by bumping a pointer and
+ * frees it all at once, together with the blocks. Requests too large
+ * for a block get a block of their own, so the current block is not
+ * wasted. Objects which own memory outside of the arena register a
+ * cleanup, run when the arena is freed, newest first.
+ */
+
+#define DEFAULT_BLOCK_SIZE 4096
+
+typedef struct _Block Block;
+typedef struct _Cleanup Cleanup;
+
+struct _Block
+{
+  Block *next;
+  gsize  size;
+  gsize  used;
+};
+
+struct _Cleanup
+{
+  Cleanup        *next;
+  GDestroyNotify  notify;
+  gpointer        data;
+};
+
+struct _GyArena
+{
+  Block   *blocks;
+  Cleanup *cleanups;
+  gsize    block_size;
+};
+
+/* The data of a block follows its header, aligned like any allocation. */
+#define BLOCK_HEADER ((sizeof (Block) + G_MEM_ALIGN - 1) & ~(gsize) (G_MEM_ALIGN - 1))
+#define BLOCK_DATA(block) ((guint8 *) (block) + BLOCK_HEADER)
+
+static Block *
+block_new (GyArena *arena,
+           gsize    size)
+{
+  Block *block = g_malloc (BLOCK_HEADER + size);
+
+  block->size = size;
+  block->used = 0;
+
+  return block;
+}
+
+/**
+ * gy_arena_new:
+ * @block_size: the size of a block in bytes, or 0 for the default
+ *
+ * Creates an empty arena. No block is allocated until the first
+ * allocation.
+ *
+ * Returns: (transfer full): a new #GyArena, free it with gy_arena_free()
+ */
+GyArena *
+gy_arena_new (gsize block_size)
+{
+  GyArena *arena = g_slice_new0 (GyArena);
+
+  arena->block_size = block_size > 0 ? block_size : DEFAULT_BLOCK_SIZE;
+
+  return arena;
+}
+
+/**
+ * gy_arena_free:
+ * @arena: (nullable): a #GyArena
+ *
+ * Runs the cleanups of @arena and frees all the memory allocated from it.
+ */
+void
+gy_arena_free (GyArena *arena)
+{
+  if (arena == NULL)
+    return;
+
+  /* The cleanups live in the blocks, so they go first. */
+  for (Cleanup *cleanup = arena->cleanups; cleanup != NULL; cleanup = cleanup->next)
+    cleanup->notify (cleanup->data);
+
+  while (arena->blocks != NULL)
+    {
+      Block *next = arena->blocks->next;
+
+      g_free (arena->blocks);
+      arena->blocks = next;
+    }
+
+  g_slice_free (GyArena, arena);
+}
+
+/**
+ * gy_arena_alloc:
+ * @arena: a #GyArena
+ * @size: the number of bytes to allocate
+ *
+ * Allocates @size bytes from @arena, aligned for any type. The memory
+ * is not initialized and lives until @arena is freed.
+ *
+ * Returns: the allocated memory
+ */
+gpointer
+gy_arena_alloc (GyArena *arena,
+                gsize    size)
+{
+  Block *block;
+  gpointer mem;
+
+  g_return_val_if_fail (arena != NULL, NULL);
+
+  size = (MAX (size, 1) + G_MEM_ALIGN - 1) & ~(gsize) (G_MEM_ALIGN - 1);
+  block = arena->blocks;
+
+  if (block == NULL || block->size - block->used < size)
+    {
+      if (size > arena->block_size / 4)
+        {
+          /* Keep filling the current block after this one. */
+          block = block_new (arena, size);
+
+          if (arena->blocks != NULL)
+            {
+              block->next = arena->blocks->next;
+              arena->blocks->next = block;
+            }
+          else
+            {
+              block->next = NULL;
+              arena->blocks = block;
+            }
+        }
+      else
+        {
+          block = block_new (arena, arena->block_size);
+          block->next = arena->blocks;
+          arena->blocks = block;
+        }
+    }
+
+  mem = BLOCK_DATA (block) + block->used;
+  block->used += size;
+
+  return mem;
+}
+
+/**
+ * gy_arena_alloc0:
+ * @arena: a #GyArena
+ * @size: the number of bytes to allocate
+ *
+ * Like gy_arena_alloc(), but the memory is set to zero.
+ *
+ * Returns: the allocated memory
+ */
+gpointer
+gy_arena_alloc0 (GyArena *arena,
+                 gsize    size)
+{
+  return memset (gy_arena_alloc (arena, size), 0, size);
+}
+
+/**
+ * gy_arena_strdup:
+ * @arena: a #GyArena
+ * @str: (nullable): a string
+ *
+ * Copies @str into @arena.
+ *
+ * Returns: (nullable): the copy of @str, or %NULL if @str is %NULL
+ */
+gchar *
+gy_arena_strdup (GyArena     *arena,
+                 const gchar *str)
+{
+  gsize len;
+
+  if (str == NULL)
+    return NULL;
+
+  len = strlen (str) + 1;
+
+  return memcpy (gy_arena_alloc (arena, len), str, len);
+}
+
+/**
+ * gy_arena_add_cleanup:
+ * @arena: a #GyArena
+ * @notify: the function to call when @arena is freed
+ * @data: the data to pass to @notify
+ *
+ * Registers @notify to release something @arena does not own, such as
+ * an object referenced by memory allocated from it.
+ */
+void
+gy_arena_add_cleanup (GyArena        *arena,
+                      GDestroyNotify  notify,
+                      gpointer        data)
+{
+  Cleanup *cleanup;
+
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (notify != NULL);
+
+  cleanup = gy_arena_alloc (arena, sizeof (Cleanup));
+  cleanup->notify = notify;
+  cleanup->data = data;
+  cleanup->next = arena->cleanups;
+  arena->cleanups = cleanup;
+}
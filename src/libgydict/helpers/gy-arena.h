@@ -0,0 +1,41 @@
+/* gy-arena.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GyArena GyArena;
+
+GyArena  *gy_arena_new         (gsize           block_size);
+void      gy_arena_free        (GyArena        *arena);
+gpointer  gy_arena_alloc       (GyArena        *arena,
+                                gsize           size);
+gpointer  gy_arena_alloc0      (GyArena        *arena,
+                                gsize           size);
+gchar    *gy_arena_strdup      (GyArena        *arena,
+                                const gchar    *str);
+void      gy_arena_add_cleanup (GyArena        *arena,
+                                GDestroyNotify  notify,
+                                gpointer        data);
+
+G_END_DECLS
@@ -0,0 +1,365 @@
+/* gy-fold-table.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+#include "gy-fold-table.h"
+
+/*
+ * A fold table maps every code point of the Basic Multilingual Plane to
+ * its search form: case folded, compatibility decomposed, without
+ * combining marks and with the letters which have no decomposition
+ * (ł, ø, æ, ...) spelled with plain ones. Languages which treat some of
+ * these letters as letters of their own override them.
+ *
+ * The mapping is compiled once, on the first use of a language, into
+ * pages of 256 entries. An entry is 0 for a code point folding to itself,
+ * or the offset of its folded form in a pool of strings shifted left by
+ * 8 bits and ORed with its length. Pages without such code points are
+ * left NULL and language tables share the pages they do not change, so
+ * folding a string is one lookup per character.
+ */
+
+#define N_PAGES 256
+
+struct _GyFoldTable
+{
+  gchar    *language;
+  GString  *pool;
+  guint32  *pages[N_PAGES];
+  gboolean  owned[N_PAGES];
+
+  /* Composes the string first, as some of the overridden letters would
+   * otherwise lose their marks when written decomposed. */
+  gboolean  compose;
+};
+
+typedef struct
+{
+  gunichar     c;
+  const gchar *folded;
+} FoldOverride;
+
+/* Lower case letters, applied to the output of the decomposition. */
+static const FoldOverride plain_letters[] = {
+  { 0x00E6, "ae" }, /* æ */
+  { 0x00F0, "d" },  /* ð */
+  { 0x00F8, "o" },  /* ø */
+  { 0x00FE, "th" }, /* þ */
+  { 0x0111, "d" },  /* đ */
+  { 0x0127, "h" },  /* ħ */
+  { 0x0131, "i" },  /* ı */
+  { 0x0142, "l" },  /* ł */
+  { 0x0153, "oe" }, /* œ */
+  { 0x0167, "t" },  /* ŧ */
+  { 0x0180, "b" },  /* ƀ */
+  { 0x01B6, "z" },  /* ƶ */
+};
+
+static const FoldOverride german[] = {
+  { 0x00C4, "ae" }, { 0x00E4, "ae" },
+  { 0x00D6, "oe" }, { 0x00F6, "oe" },
+  { 0x00DC, "ue" }, { 0x00FC, "ue" },
+};
+
+static const FoldOverride danish[] = {
+  { 0x00C5, "\xc3\xa5" }, { 0x00E5, "\xc3\xa5" },
+  { 0x00C6, "\xc3\xa6" }, { 0x00E6, "\xc3\xa6" },
+  { 0x00D8, "\xc3\xb8" }, { 0x00F8, "\xc3\xb8" },
+};
+
+static const FoldOverride swedish[] = {
+  { 0x00C4, "\xc3\xa4" }, { 0x00E4, "\xc3\xa4" },
+  { 0x00C5, "\xc3\xa5" }, { 0x00E5, "\xc3\xa5" },
+  { 0x00D6, "\xc3\xb6" }, { 0x00F6, "\xc3\xb6" },
+};
+
+static const FoldOverride turkish[] = {
+  { 0x0049, "\xc4\xb1" }, { 0x0131, "\xc4\xb1" },
+  { 0x0130, "i" },
+};
+
+static const struct
+{
+  const gchar        *language;
+  const FoldOverride *overrides;
+  guint               n_overrides;
+} languages[] = {
+  { "de", german, G_N_ELEMENTS (german) },
+  { "da", danish, G_N_ELEMENTS (danish) },
+  { "nb", danish, G_N_ELEMENTS (danish) },
+  { "nn", danish, G_N_ELEMENTS (danish) },
+  { "no", danish, G_N_ELEMENTS (danish) },
+  { "fi", swedish, G_N_ELEMENTS (swedish) },
+  { "sv", swedish, G_N_ELEMENTS (swedish) },
+  { "az", turkish, G_N_ELEMENTS (turkish) },
+  { "tr", turkish, G_N_ELEMENTS (turkish) },
+};
+
+static GMutex      tables_mutex;
+static GHashTable *tables;
+
+/* Appends the generic search form of the characters in @str. */
+static void
+append_folded (GString     *out,
+               const gchar *str,
+               gssize       len)
+{
+  g_autofree gchar *normalized = NULL;
+  g_autofree gchar *folded = NULL;
+
+  if ((normalized = g_utf8_normalize (str, len, G_NORMALIZE_ALL)) == NULL)
+    return;
+
+  folded = g_utf8_casefold (normalized, -1);
+
+  for (const gchar *p = folded; *p != '\0'; p = g_utf8_next_char (p))
+    {
+      gunichar c = g_utf8_get_char (p);
+      const gchar *plain = NULL;
+
+      if (g_unichar_type (c) == G_UNICODE_NON_SPACING_MARK)
+        continue;
+
+      for (guint i = 0; i < G_N_ELEMENTS (plain_letters) && plain == NULL; i++)
+        if (plain_letters[i].c == c)
+          plain = plain_letters[i].folded;
+
+      if (plain != NULL)
+        g_string_append (out, plain);
+      else
+        g_string_append_len (out, p, g_utf8_next_char (p) - p);
+    }
+}
+
+static void
+set_entry (GyFoldTable *self,
+           gunichar     c,
+           const gchar *folded,
+           gsize        len)
+{
+  guint page = c >> 8;
+  gchar buf[6];
+  gint n = g_unichar_to_utf8 (c, buf);
+  guint32 entry = 0;
+
+  g_assert (c < N_PAGES * 256);
+  g_assert (len < 256);
+
+  if ((gsize) n != len || memcmp (buf, folded, n) != 0)
+    {
+      /* Offset 0 is never used, so an empty form still gets an entry. */
+      entry = (guint32) self->pool->len << 8 | (guint32) len;
+      g_string_append_len (self->pool, folded, len);
+    }
+
+  if (self->pages[page] == NULL && entry == 0)
+    return;
+
+  if (self->pages[page] == NULL)
+    {
+      self->pages[page] = g_new0 (guint32, 256);
+      self->owned[page] = TRUE;
+    }
+  else if (!self->owned[page])
+    {
+      guint32 *shared = self->pages[page];
+
+      self->pages[page] = g_new (guint32, 256);
+      memcpy (self->pages[page], shared, 256 * sizeof (guint32));
+      self->owned[page] = TRUE;
+    }
+
+  self->pages[page][c & 0xff] = entry;
+}
+
+static GyFoldTable *
+compile_generic (void)
+{
+  g_autoptr(GString) folded = g_string_new (NULL);
+  GyFoldTable *self;
+
+  self = g_new0 (GyFoldTable, 1);
+  self->language = g_strdup ("");
+  self->pool = g_string_new_len ("", 1);
+
+  for (gunichar c = 0; c < N_PAGES * 256; c++)
+    {
+      gchar buf[6];
+      gint n;
+
+      if ((c >= 0xD800 && c < 0xE000) || g_unichar_type (c) == G_UNICODE_UNASSIGNED)
+        continue;
+
+      n = g_unichar_to_utf8 (c, buf);
+      g_string_truncate (folded, 0);
+      append_folded (folded, buf, n);
+      set_entry (self, c, folded->str, folded->len);
+    }
+
+  return self;
+}
+
+static GyFoldTable *
+compile_language (const GyFoldTable *generic,
+                  guint              idx)
+{
+  GyFoldTable *self;
+
+  self = g_new0 (GyFoldTable, 1);
+  self->language = g_strdup (languages[idx].language);
+  self->pool = g_string_new_len (generic->pool->str, generic->pool->len);
+  self->compose = TRUE;
+
+  /* The offsets into the copied pool stay valid, so are the shared pages. */
+  memcpy (self->pages, generic->pages, sizeof self->pages);
+
+  for (guint i = 0; i < languages[idx].n_overrides; i++)
+    {
+      const FoldOverride *o = &languages[idx].overrides[i];
+
+      set_entry (self, o->c, o->folded, strlen (o->folded));
+    }
+
+  return self;
+}
+
+/**
+ * gy_fold_table_get:
+ * @language: (nullable): a language code like "de" or a locale name
+ *   like "pl_PL.UTF-8", or %NULL
+ *
+ * Gets the fold table of @language, compiling it on the first call.
+ * Languages without letters of their own, and %NULL, get the generic
+ * table. Tables live as long as the program and may be used from any
+ * thread.
+ *
+ * Returns: (transfer none): the fold table
+ */
+const GyFoldTable *
+gy_fold_table_get (const gchar *language)
+{
+  g_autofree gchar *code = NULL;
+  GyFoldTable *generic;
+  GyFoldTable *self;
+  guint idx;
+
+  code = g_ascii_strdown (language ? language : "", strcspn (language ? language : "", "_.@-"));
+
+  for (idx = 0; idx < G_N_ELEMENTS (languages); idx++)
+    if (g_strcmp0 (languages[idx].language, code) == 0)
+      break;
+
+  g_mutex_lock (&tables_mutex);
+
+  if (tables == NULL)
+    tables = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if ((generic = g_hash_table_lookup (tables, "")) == NULL)
+    {
+      generic = compile_generic ();
+      g_hash_table_insert (tables, generic->language, generic);
+    }
+
+  if (idx == G_N_ELEMENTS (languages))
+    self = generic;
+  else if ((self = g_hash_table_lookup (tables, languages[idx].language)) == NULL)
+    {
+      self = compile_language (generic, idx);
+      g_hash_table_insert (tables, self->language, self);
+    }
+
+  g_mutex_unlock (&tables_mutex);
+
+  return self;
+}
+
+/**
+ * gy_fold_table_get_language:
+ * @table: a #GyFoldTable
+ *
+ * Gets the language whose letters @table keeps, or "" for the generic
+ * table. It identifies the folding of keys stored on disk.
+ *
+ * Returns: (transfer none): the language code
+ */
+const gchar *
+gy_fold_table_get_language (const GyFoldTable *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->language;
+}
+
+/**
+ * gy_fold_table_fold:
+ * @table: a #GyFoldTable
+ * @str: a UTF-8 string
+ * @len: length of @str in bytes, or -1 if @str is nul-terminated
+ *
+ * Folds @str into its search form, ignoring case and diacritics. Unlike
+ * gy_utility_fold_search_key(), which keeps the marks, "Żółw" and "zolw"
+ * fold to the same key.
+ *
+ * Returns: (transfer full) (nullable): the folded key, or %NULL if @str
+ * is not valid UTF-8. Free with g_free().
+ */
+gchar *
+gy_fold_table_fold (const GyFoldTable *self,
+                    const gchar       *str,
+                    gssize             len)
+{
+  g_autofree gchar *composed = NULL;
+  const gchar *end;
+  GString *out;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (str != NULL, NULL);
+
+  if (!g_utf8_validate (str, len, &end))
+    return NULL;
+
+  if (self->compose)
+    {
+      composed = g_utf8_normalize (str, end - str, G_NORMALIZE_DEFAULT_COMPOSE);
+      str = composed;
+      end = composed + strlen (composed);
+    }
+
+  out = g_string_sized_new (end - str);
+
+  while (str < end)
+    {
+      gunichar c = g_utf8_get_char (str);
+      const gchar *next = g_utf8_next_char (str);
+      const guint32 *page;
+      guint32 entry;
+
+      if (c >= N_PAGES * 256)
+        append_folded (out, str, next - str);
+      else if ((page = self->pages[c >> 8]) == NULL || (entry = page[c & 0xff]) == 0)
+        g_string_append_len (out, str, next - str);
+      else
+        g_string_append_len (out, self->pool->str + (entry >> 8), entry & 0xff);
+
+      str = next;
+    }
+
+  return g_string_free (out, FALSE);
+}
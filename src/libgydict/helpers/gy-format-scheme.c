@@ -18,13 +18,65 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <string.h>
 #include "gy-format-scheme.h"
+#include "gy-text-attribute-private.h"
+
+/*
+ * The text of a scheme is a piece table: every byte added is appended
+ * to one buffer, and a list of pieces of that buffer gives the order of
+ * the text. Appending grows the last piece, prepending or inserting
+ * adds a piece, so no call moves the text already there. The pieces are
+ * joined into one string only when the text is asked for, and a scheme
+ * which is only appended to never has more than one piece.
+ *
+ * Inserting text before an attribute moves the attribute along, so the
+ * indexes a formatter sets on an attribute afterwards are taken as they
+ * are. Prepending moves every attribute, so it only adds to the shift of
+ * the anchor of the scheme, and each attribute moves by what was added
+ * since its indexes were set when they are read. Text inserted inside
+ * moves the attributes starting at it or after, found by bisecting them
+ * in the order of their starts, and the ends running past it.
+ *
+ * gy_format_scheme_new_attribute() allocates an attribute straight from
+ * an arena of the scheme, made with the first one, and the arena frees
+ * them all at once with the scheme. Such attributes must not outlive
+ * the scheme: gy_text_attribute_copy() makes a copy which does, and
+ * copying the scheme copies its attributes out as well. An attribute
+ * added with gy_format_scheme_add_text_attr() is kept as it is, so it
+ * may still be changed after the call, whichever way it was made.
+ */
+
+#define ARENA_BLOCK_SIZE 8192
+
+typedef struct _Piece Piece;
+
+struct _Piece
+{
+  Piece *prev;
+  Piece *next;
+  gsize  offset;
+  gsize  len;
+};
 
 struct _GyFormatScheme
 {
   guint           ref_count;
-  GString        *lexical_unit;
+  GString        *text;
+  Piece          *head;
+  Piece          *tail;
+  Piece          *cursor;
+  gsize           cursor_pos;
+  gsize           len;
   GyTextAttrList *attrs;
+  GPtrArray      *added; /* the attributes of the list, in the order they were added */
+  GPtrArray      *by_start; /* the same, sorted by start after sorted_changes */
+  GyArena        *arena;
+
+  GyTextAttrAnchor anchor;
+  guint            sorted_changes;
+  guint            listed_changes;
+  gsize            settled_shift;
 };
 
 G_DEFINE_BOXED_TYPE (GyFormatScheme, gy_format_scheme,
@@ -37,12 +89,134 @@ gy_format_scheme_new (void)
   GyFormatScheme *scheme = g_slice_new0(GyFormatScheme);
 
   scheme->ref_count = 1;
-  scheme->lexical_unit = g_string_new (NULL);
+  scheme->text = g_string_new (NULL);
   scheme->attrs = gy_text_attr_list_new ();
+  scheme->added = g_ptr_array_new ();
+  scheme->by_start = g_ptr_array_new ();
 
   return scheme;
 }
 
+static void
+free_pieces (GyFormatScheme *scheme)
+{
+  while (scheme->head != NULL)
+    {
+      Piece *next = scheme->head->next;
+
+      g_slice_free (Piece, scheme->head);
+      scheme->head = next;
+    }
+
+  scheme->tail = scheme->cursor = NULL;
+  scheme->cursor_pos = 0;
+}
+
+static inline void
+move_attr (GyTextAttribute *attr,
+           gsize            pos,
+           gsize            n)
+{
+  guint start = gy_text_attribute_get_start_index (attr);
+  guint end = gy_text_attribute_get_end_index (attr);
+
+  if (start >= pos)
+    gy_text_attribute_set_start_index (attr, start + n);
+
+  if ((start >= pos || end > pos) && end != PANGO_ATTR_INDEX_TO_TEXT_END)
+    gy_text_attribute_set_end_index (attr, end + n);
+}
+
+static gint
+compare_start (gconstpointer a,
+               gconstpointer b)
+{
+  guint start_a = gy_text_attribute_get_start_index (*(GyTextAttribute **) a);
+  guint start_b = gy_text_attribute_get_start_index (*(GyTextAttribute **) b);
+
+  if (start_a == start_b)
+    return 0;
+
+  return start_a < start_b ? -1 : 1;
+}
+
+/* Moves the attributes along with @n bytes inserted at @pos, inside the text. */
+static void
+move_attrs (GyFormatScheme *scheme,
+            gsize           pos,
+            gsize           n)
+{
+  GPtrArray *attrs = scheme->by_start;
+  guint lo = 0;
+  guint hi = attrs->len;
+
+  if (scheme->sorted_changes != scheme->anchor.changes)
+    g_ptr_array_sort (attrs, compare_start);
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (gy_text_attribute_get_start_index (attrs->pdata[mid]) < pos)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  for (guint i = lo; i < attrs->len; i++)
+    move_attr (attrs->pdata[i], pos, n);
+
+  /* Those starting before @pos only have an end to move, if it is past it. */
+  for (guint i = 0; i < lo; i++)
+    {
+      GyTextAttribute *attr = attrs->pdata[i];
+      guint end = gy_text_attribute_get_end_index (attr);
+
+      if (end > pos && end != PANGO_ATTR_INDEX_TO_TEXT_END)
+        gy_text_attribute_set_end_index (attr, end + n);
+    }
+
+  /* Moving the starts from @pos on by the same amount keeps them in order. */
+  scheme->sorted_changes = scheme->anchor.changes;
+}
+
+static void
+add_attr (GyFormatScheme  *scheme,
+          GyTextAttribute *attr)
+{
+  _gy_text_attribute_set_anchor (attr, &scheme->anchor);
+  scheme->anchor.changes++;
+
+  /* Formatters close spans out of order; the list is sorted once when read. */
+  gy_text_attr_list_append (scheme->attrs, attr);
+  g_ptr_array_add (scheme->added, attr);
+  g_ptr_array_add (scheme->by_start, attr);
+}
+
+/* Joins the pieces into one string. */
+static void
+flatten (GyFormatScheme *scheme)
+{
+  GString *text;
+
+  if (scheme->head == NULL ||
+      (scheme->head == scheme->tail && scheme->head->offset == 0 &&
+       scheme->head->len == scheme->text->len))
+    return;
+
+  text = g_string_sized_new (scheme->len);
+
+  for (Piece *piece = scheme->head; piece != NULL; piece = piece->next)
+    g_string_append_len (text, scheme->text->str + piece->offset, piece->len);
+
+  free_pieces (scheme);
+  g_string_free (scheme->text, TRUE);
+  scheme->text = text;
+
+  scheme->head = scheme->tail = scheme->cursor = g_slice_new0 (Piece);
+  scheme->head->len = text->len;
+}
+
 GyFormatScheme *
 gy_format_scheme_copy (GyFormatScheme *scheme)
 {
@@ -50,8 +224,20 @@ gy_format_scheme_copy (GyFormatScheme *scheme)
 
   GyFormatScheme *new = gy_format_scheme_new ();
 
-  new->attrs = gy_text_attr_list_copy (scheme->attrs);
-  new->lexical_unit = g_string_new (scheme->lexical_unit->str);
+  flatten (scheme);
+
+  g_string_append_len (new->text, scheme->text->str, scheme->text->len);
+  new->len = scheme->len;
+
+  if (new->len > 0)
+    {
+      new->head = new->tail = new->cursor = g_slice_new0 (Piece);
+      new->head->len = new->len;
+    }
+
+  /* In the order they were added, so the sorted lists come out the same. */
+  for (guint i = 0; i < scheme->added->len; i++)
+    add_attr (new, gy_text_attribute_copy (g_ptr_array_index (scheme->added, i)));
 
   return new;
 }
@@ -73,17 +259,34 @@ gy_format_scheme_unref (GyFormatScheme *scheme)
 
   if (g_atomic_int_dec_and_test ((int *) &scheme->ref_count))
     {
+      /* The attributes kept elsewhere must not read the anchor of the scheme. */
+      for (guint i = 0; i < scheme->added->len; i++)
+        {
+          GyTextAttribute *attr = g_ptr_array_index (scheme->added, i);
+
+          if (_gy_text_attribute_get_anchor (attr) == &scheme->anchor)
+            _gy_text_attribute_set_anchor (attr, NULL);
+        }
+
       if (scheme->attrs != NULL)
         {
           gy_text_attr_list_unref (scheme->attrs);
           scheme->attrs = NULL;
         }
 
-      if (scheme->lexical_unit != NULL)
+      if (scheme->text != NULL)
         {
-          g_string_free (scheme->lexical_unit, TRUE);
-          scheme->lexical_unit = NULL;
+          g_string_free (scheme->text, TRUE);
+          scheme->text = NULL;
         }
+
+      free_pieces (scheme);
+      g_clear_pointer (&scheme->added, g_ptr_array_unref);
+      g_clear_pointer (&scheme->by_start, g_ptr_array_unref);
+
+      /* After the list, whose attributes may live in it. */
+      g_clear_pointer (&scheme->arena, gy_arena_free);
+      g_slice_free (GyFormatScheme, scheme);
     }
 }
 
@@ -92,6 +295,29 @@ gy_format_scheme_get_attrs (GyFormatScheme *scheme)
 {
   g_return_val_if_fail (scheme != NULL, NULL);
 
+  /* The list reads the indexes as they are stored, without the shift. */
+  if (scheme->settled_shift != scheme->anchor.shift)
+    {
+      for (guint i = 0; i < scheme->added->len; i++)
+        {
+          GyTextAttribute *attr = g_ptr_array_index (scheme->added, i);
+
+          if (_gy_text_attribute_get_anchor (attr) == &scheme->anchor)
+            _gy_text_attribute_set_anchor (attr, &scheme->anchor);
+        }
+
+      scheme->settled_shift = scheme->anchor.shift;
+    }
+
+  /* Indexes set after the attributes were added may be out of order. */
+  if (scheme->listed_changes != scheme->anchor.changes)
+    {
+      _gy_text_attr_list_invalidate (scheme->attrs);
+      scheme->listed_changes = scheme->anchor.changes;
+    }
+
+  gy_text_attr_list_sort (scheme->attrs);
+
   return scheme->attrs;
 }
 
@@ -100,8 +326,252 @@ gy_format_scheme_add_text_attr (GyFormatScheme  *scheme,
                                 GyTextAttribute *attr)
 {
   g_return_if_fail (scheme != NULL);
+  g_return_if_fail (attr != NULL);
+
+  add_attr (scheme, gy_text_attribute_ref (attr));
+}
+
+/**
+ * gy_format_scheme_new_attribute:
+ * @scheme: a #GyFormatScheme
+ * @type: the type of the attribute
+ *
+ * Adds a new attribute of @type to @scheme, covering the whole text
+ * until its indexes are set. It is allocated from an arena of @scheme,
+ * so making it costs no allocation of its own, and it is freed with
+ * the scheme. Its value is set with gy_text_attribute_set_int() and
+ * the like, or for a family, font features or a font description with
+ * gy_format_scheme_set_attribute_string() and
+ * gy_format_scheme_set_attribute_font_desc(), which keep the value in
+ * the arena as well.
+ *
+ * Returns: (transfer none): the new attribute, valid as long as @scheme
+ */
+GyTextAttribute *
+gy_format_scheme_new_attribute (GyFormatScheme *scheme,
+                                GyTextAttrType  type)
+{
+  GyTextAttribute *attr;
+
+  g_return_val_if_fail (scheme != NULL, NULL);
+
+  if (scheme->arena == NULL)
+    scheme->arena = gy_arena_new (ARENA_BLOCK_SIZE);
+
+  attr = _gy_text_attribute_new_in_arena (scheme->arena, type);
+  add_attr (scheme, attr);
+
+  return attr;
+}
+
+/**
+ * gy_format_scheme_set_attribute_string:
+ * @scheme: a #GyFormatScheme
+ * @attr: a %GY_TEXT_ATTR_FAMILY or %GY_TEXT_ATTR_FONT_FEATURES attribute
+ *   made with gy_format_scheme_new_attribute()
+ * @string: the family or the features
+ *
+ * Sets the string of @attr to a copy of @string made in the arena of
+ * @scheme, freed together with it.
+ *
+ * Since: 0.6
+ */
+void
+gy_format_scheme_set_attribute_string (GyFormatScheme  *scheme,
+                                       GyTextAttribute *attr,
+                                       const gchar     *string)
+{
+  g_return_if_fail (scheme != NULL && scheme->arena != NULL);
+  g_return_if_fail (attr != NULL);
+
+  _gy_text_attribute_set_arena_string (attr, gy_arena_strdup (scheme->arena, string));
+}
+
+/**
+ * gy_format_scheme_set_attribute_font_desc:
+ * @scheme: a #GyFormatScheme
+ * @attr: a %GY_TEXT_ATTR_FONT_DESC attribute made with
+ *   gy_format_scheme_new_attribute()
+ * @desc: a #PangoFontDescription
+ *
+ * Sets the font description of @attr to a copy of @desc, which the
+ * arena of @scheme frees together with it.
+ *
+ * Since: 0.6
+ */
+void
+gy_format_scheme_set_attribute_font_desc (GyFormatScheme             *scheme,
+                                          GyTextAttribute            *attr,
+                                          const PangoFontDescription *desc)
+{
+  PangoFontDescription *copy;
+
+  g_return_if_fail (scheme != NULL && scheme->arena != NULL);
+  g_return_if_fail (attr != NULL && desc != NULL);
+
+  copy = pango_font_description_copy (desc);
+  gy_arena_add_cleanup (scheme->arena, (GDestroyNotify) pango_font_description_free, copy);
+  _gy_text_attribute_set_arena_font_desc (attr, copy);
+}
+
+void
+gy_format_scheme_reserve_text (GyFormatScheme *scheme,
+                               gsize           len)
+{
+  gsize used;
+
+  g_return_if_fail (scheme != NULL);
+
+  used = scheme->text->len;
+  g_string_set_size (scheme->text, used + len);
+  g_string_truncate (scheme->text, used);
+}
+
+/* Finds the piece holding the byte at @pos, walking from the nearest of
+ * the head, the tail and the piece written last. */
+static Piece *
+find_piece (GyFormatScheme *scheme,
+            gsize           pos,
+            gsize          *start)
+{
+  Piece *piece = scheme->cursor;
+  gsize piece_start = scheme->cursor_pos;
+
+  if (pos < piece_start / 2)
+    {
+      piece = scheme->head;
+      piece_start = 0;
+    }
+  else if (pos >= piece_start && pos - piece_start > (scheme->len - piece_start) / 2)
+    {
+      piece = scheme->tail;
+      piece_start = scheme->len - piece->len;
+    }
+
+  while (pos < piece_start)
+    {
+      piece = piece->prev;
+      piece_start -= piece->len;
+    }
+
+  while (pos >= piece_start + piece->len)
+    {
+      piece_start += piece->len;
+      piece = piece->next;
+    }
+
+  *start = piece_start;
+
+  return piece;
+}
+
+static void
+insert_text (GyFormatScheme *scheme,
+             gsize           pos,
+             const gchar    *text,
+             gsize           n)
+{
+  gsize offset = scheme->text->len;
+  Piece *prev;
+  Piece *piece;
+
+  if (n == 0)
+    return;
+
+  /* Text at the end comes before attributes, which are often added
+   * before their text; anywhere else it goes in front of them. */
+  if (pos == 0 && scheme->len > 0)
+    scheme->anchor.shift += n;
+  else if (pos < scheme->len)
+    move_attrs (scheme, pos, n);
+
+  g_string_append_len (scheme->text, text, n);
+
+  if (pos == scheme->len)
+    {
+      prev = scheme->tail;
+    }
+  else
+    {
+      gsize start;
+
+      piece = find_piece (scheme, pos, &start);
+
+      if (pos > start)
+        {
+          Piece *rest = g_slice_new (Piece);
+
+          rest->offset = piece->offset + (pos - start);
+          rest->len = piece->len - (pos - start);
+          rest->prev = piece;
+          rest->next = piece->next;
+          piece->len = pos - start;
+          piece->next = rest;
+
+          if (rest->next != NULL)
+            rest->next->prev = rest;
+          else
+            scheme->tail = rest;
+        }
+
+      prev = pos > start ? piece : piece->prev;
+    }
+
+  if (prev != NULL && prev->offset + prev->len == offset)
+    {
+      /* The text follows the piece in the buffer as well. */
+      prev->len += n;
+      piece = prev;
+      scheme->cursor_pos = pos + n - piece->len;
+    }
+  else
+    {
+      piece = g_slice_new (Piece);
+      piece->offset = offset;
+      piece->len = n;
+      piece->prev = prev;
+      piece->next = prev != NULL ? prev->next : scheme->head;
+
+      if (prev != NULL)
+        prev->next = piece;
+      else
+        scheme->head = piece;
+
+      if (piece->next != NULL)
+        piece->next->prev = piece;
+      else
+        scheme->tail = piece;
+
+      scheme->cursor_pos = pos;
+    }
+
+  scheme->cursor = piece;
+  scheme->len += n;
+}
+
+void
+gy_format_scheme_insert_text (GyFormatScheme *scheme,
+                              gsize           pos,
+                              const gchar    *text)
+{
+  g_return_if_fail (scheme != NULL);
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (pos <= scheme->len);
+
+  insert_text (scheme, pos, text, strlen (text));
+}
+
+void
+gy_format_scheme_insert_text_len (GyFormatScheme *scheme,
+                                  gsize           pos,
+                                  const gchar    *text,
+                                  gssize          len)
+{
+  g_return_if_fail (scheme != NULL);
+  g_return_if_fail (text != NULL || len == 0);
+  g_return_if_fail (pos <= scheme->len);
 
-  gy_text_attr_list_insert (scheme->attrs, gy_text_attribute_ref (attr));
+  insert_text (scheme, pos, text, len < 0 ? strlen (text) : (gsize) len);
 }
 
 void
@@ -109,8 +579,9 @@ gy_format_scheme_append_text (GyFormatScheme *scheme,
                               const gchar    *text)
 {
   g_return_if_fail (scheme != NULL);
+  g_return_if_fail (text != NULL);
 
-  scheme->lexical_unit = g_string_append (scheme->lexical_unit, text);
+  insert_text (scheme, scheme->len, text, strlen (text));
 }
 
 void
@@ -119,7 +590,9 @@ gy_format_scheme_append_text_len (GyFormatScheme *scheme,
                                    gssize          len)
 {
   g_return_if_fail (scheme != NULL);
-  scheme->lexical_unit = g_string_append_len (scheme->lexical_unit, text, len);
+  g_return_if_fail (text != NULL || len == 0);
+
+  insert_text (scheme, scheme->len, text, len < 0 ? strlen (text) : (gsize) len);
 }
 
 void
@@ -128,16 +601,18 @@ gy_format_scheme_append_char (GyFormatScheme *scheme,
 {
   g_return_if_fail (scheme != NULL);
 
-  scheme->lexical_unit = g_string_append_c (scheme->lexical_unit, ch);
+  insert_text (scheme, scheme->len, &ch, 1);
 }
 
 void
 gy_format_scheme_append_unichar (GyFormatScheme *scheme,
                                  gunichar        uch)
 {
+  gchar buf[6];
+
   g_return_if_fail (scheme != NULL);
 
-  scheme->lexical_unit = g_string_append_unichar (scheme->lexical_unit, uch);
+  insert_text (scheme, scheme->len, buf, g_unichar_to_utf8 (uch, buf));
 }
 
 void
@@ -145,8 +620,9 @@ gy_format_scheme_prepend_text (GyFormatScheme *scheme,
                                const gchar    *text)
 {
   g_return_if_fail (scheme != NULL);
+  g_return_if_fail (text != NULL);
 
-  scheme->lexical_unit = g_string_prepend (scheme->lexical_unit, text);
+  insert_text (scheme, 0, text, strlen (text));
 }
 
 void
@@ -155,7 +631,9 @@ gy_format_scheme_prepend_text_len (GyFormatScheme *scheme,
                                    gssize          len)
 {
   g_return_if_fail (scheme != NULL);
-  scheme->lexical_unit = g_string_prepend_len (scheme->lexical_unit, text, len);
+  g_return_if_fail (text != NULL || len == 0);
+
+  insert_text (scheme, 0, text, len < 0 ? strlen (text) : (gsize) len);
 }
 
 void
@@ -164,16 +642,18 @@ gy_format_scheme_prepend_char (GyFormatScheme *scheme,
 {
   g_return_if_fail (scheme != NULL);
 
-  scheme->lexical_unit = g_string_prepend_c (scheme->lexical_unit, ch);
+  insert_text (scheme, 0, &ch, 1);
 }
 
 void
 gy_format_scheme_prepend_unichar (GyFormatScheme *scheme,
                                   gunichar        uch)
 {
+  gchar buf[6];
+
   g_return_if_fail (scheme != NULL);
 
-  scheme->lexical_unit = g_string_prepend_unichar (scheme->lexical_unit, uch);
+  insert_text (scheme, 0, buf, g_unichar_to_utf8 (uch, buf));
 }
 
 const gchar*
@@ -181,7 +661,9 @@ gy_format_scheme_get_lexical_unit (GyFormatScheme *scheme)
 {
   g_return_val_if_fail (scheme != NULL, NULL);
 
-  return scheme->lexical_unit->str;
+  flatten (scheme);
+
+  return scheme->text->str;
 }
 
 gsize
@@ -189,5 +671,5 @@ gy_format_scheme_length_lexical_unit (GyFormatScheme *scheme)
 {
   g_return_val_if_fail (scheme != NULL, 0);
 
-  return scheme->lexical_unit->len;
+  return scheme->len;
 }
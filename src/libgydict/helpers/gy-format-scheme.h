@@ -40,6 +40,17 @@ void gy_format_scheme_unref (GyFormatScheme *scheme);
 const GyTextAttrList* gy_format_scheme_get_attrs (GyFormatScheme *scheme);
 void gy_format_scheme_add_text_attr (GyFormatScheme  *scheme,
                                      GyTextAttribute *attr);
+GyTextAttribute* gy_format_scheme_new_attribute (GyFormatScheme *scheme,
+                                                 GyTextAttrType  type);
+void gy_format_scheme_set_attribute_string (GyFormatScheme  *scheme,
+                                            GyTextAttribute *attr,
+                                            const gchar     *string);
+void gy_format_scheme_set_attribute_font_desc (GyFormatScheme             *scheme,
+                                               GyTextAttribute            *attr,
+                                               const PangoFontDescription *desc);
+
+void gy_format_scheme_reserve_text (GyFormatScheme *scheme,
+                                    gsize           len);
 
 void gy_format_scheme_append_text (GyFormatScheme *scheme,
                                    const gchar    *text);
@@ -60,6 +71,15 @@ void gy_format_scheme_prepend_char (GyFormatScheme *scheme,
                                     gchar           ch);
 void gy_format_scheme_prepend_unichar (GyFormatScheme *scheme,
                                        gunichar        uch);
+
+void gy_format_scheme_insert_text (GyFormatScheme *scheme,
+                                   gsize           pos,
+                                   const gchar    *text);
+void gy_format_scheme_insert_text_len (GyFormatScheme *scheme,
+                                       gsize           pos,
+                                       const gchar    *text,
+                                       gssize          len);
+
 const gchar* gy_format_scheme_get_lexical_unit (GyFormatScheme *scheme);
 
 gsize gy_format_scheme_length_lexical_unit (GyFormatScheme *scheme);
@@ -0,0 +1,52 @@
+/* gy-text-attribute-private.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "gy-arena.h"
+#include "gy-text-attribute.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The indexes of the attributes of a #GyFormatScheme, which move all
+ * at once when text is prepended: @shift counts the bytes prepended so
+ * far, and an attribute moves by what was added to it since its indexes
+ * were set. @changes counts the indexes set, so the scheme knows when
+ * its attributes may be out of order.
+ */
+typedef struct
+{
+  gsize shift;
+  guint changes;
+} GyTextAttrAnchor;
+
+GyTextAttribute  *_gy_text_attribute_new_in_arena        (GyArena              *arena,
+                                                          GyTextAttrType        type);
+void              _gy_text_attribute_set_arena_string    (GyTextAttribute      *attr,
+                                                          gchar                *string);
+void              _gy_text_attribute_set_arena_font_desc (GyTextAttribute      *attr,
+                                                          PangoFontDescription *desc);
+void              _gy_text_attribute_set_anchor          (GyTextAttribute      *attr,
+                                                          GyTextAttrAnchor     *anchor);
+GyTextAttrAnchor *_gy_text_attribute_get_anchor          (GyTextAttribute      *attr);
+void              _gy_text_attr_list_invalidate          (GyTextAttrList       *list);
+
+G_END_DECLS
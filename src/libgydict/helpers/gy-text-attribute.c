@@ -18,7 +18,10 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <string.h>
+
 #include "gy-text-attribute.h"
+#include "gy-text-attribute-private.h"
 
 struct _GyTextAttribute
 {
@@ -26,6 +29,10 @@ struct _GyTextAttribute
   guint start_index;
   guint end_index;
   GyTextAttrType type;
+  gboolean in_arena;
+  GyTextAttrAnchor *anchor;
+  gsize start_shift; /* anchor->shift when the indexes were set */
+  gsize end_shift;
   union
     {
       gboolean              attr_bool;
@@ -43,6 +50,25 @@ G_DEFINE_BOXED_TYPE (GyTextAttribute, gy_text_attribute,
                      gy_text_attribute_copy,
                      gy_text_attribute_unref)
 
+/* The indexes of an anchored attribute move by what was prepended since they were set. */
+static inline guint
+anchored_start (const GyTextAttribute *attr)
+{
+  if (attr->anchor == NULL)
+    return attr->start_index;
+
+  return attr->start_index + (attr->anchor->shift - attr->start_shift);
+}
+
+static inline guint
+anchored_end (const GyTextAttribute *attr)
+{
+  if (attr->anchor == NULL || attr->end_index == PANGO_ATTR_INDEX_TO_TEXT_END)
+    return attr->end_index;
+
+  return attr->end_index + (attr->anchor->shift - attr->end_shift);
+}
+
 /**
  * gy_text_attribute_new:
  *
@@ -106,6 +132,10 @@ gy_text_attribute_unref (GyTextAttribute *attr)
 
   if (g_atomic_int_dec_and_test ((int *) &attr->ref_count))
     {
+      /* The arena frees the attribute, which owns nothing else. */
+      if (attr->in_arena)
+        return;
+
       if (attr->type == GY_TEXT_ATTR_FAMILY)
         g_free (attr->attr_string);
 
@@ -119,28 +149,12 @@ gy_text_attribute_unref (GyTextAttribute *attr)
     }
 }
 
-/**
- * gy_text_attribute_copy:
- * @attr: a #GyTextAttribute
- *
- * Make a copy of an text attribute.
- *
- * Return value: (transfer full): the newly allocated #GyTextAttribute,
- *               which should be freed with gy_text_attribute_unref().
- *
- * Since: 0.6
- **/
-GyTextAttribute *
-gy_text_attribute_copy (GyTextAttribute *attr)
+static void
+copy_value (GyTextAttribute *new,
+            GyTextAttribute *attr)
 {
-  GyTextAttribute *new;
-
-  g_return_val_if_fail (attr != NULL, NULL);
-
-  new = gy_text_attribute_new ();
-
-  new->start_index = attr->start_index;
-  new->end_index = attr->end_index;
+  new->start_index = anchored_start (attr);
+  new->end_index = anchored_end (attr);
   new->type = attr->type;
 
   if (attr->type == GY_TEXT_ATTR_FAMILY ||
@@ -181,10 +195,107 @@ gy_text_attribute_copy (GyTextAttribute *attr)
       new->attr_color.blue = attr->attr_color.blue;
       new->attr_color.green = attr->attr_color.green;
     }
+}
+
+/**
+ * gy_text_attribute_copy:
+ * @attr: a #GyTextAttribute
+ *
+ * Make a copy of an text attribute. The copy is always allocated on
+ * its own, so this is also the way of keeping an attribute of a
+ * #GyFormatScheme after the scheme is gone.
+ *
+ * Return value: (transfer full): the newly allocated #GyTextAttribute,
+ *               which should be freed with gy_text_attribute_unref().
+ *
+ * Since: 0.6
+ **/
+GyTextAttribute *
+gy_text_attribute_copy (GyTextAttribute *attr)
+{
+  GyTextAttribute *new;
+
+  g_return_val_if_fail (attr != NULL, NULL);
+
+  new = gy_text_attribute_new ();
+  copy_value (new, attr);
 
   return new;
 }
 
+/*
+ * Allocates an attribute of @type in @arena. It is reference counted
+ * as usual, but its memory goes away with the arena, whatever its
+ * reference count.
+ */
+GyTextAttribute *
+_gy_text_attribute_new_in_arena (GyArena        *arena,
+                                 GyTextAttrType  type)
+{
+  GyTextAttribute *attr;
+
+  g_return_val_if_fail (arena != NULL, NULL);
+
+  attr = gy_arena_alloc0 (arena, sizeof (GyTextAttribute));
+  attr->ref_count = 1;
+  attr->in_arena = TRUE;
+  attr->type = type;
+  attr->start_index = PANGO_ATTR_INDEX_FROM_TEXT_BEGINNING;
+  attr->end_index = PANGO_ATTR_INDEX_TO_TEXT_END;
+
+  return attr;
+}
+
+/*
+ * Sets the string of a family or font features attribute made in an
+ * arena to @string, which lives in the same arena.
+ */
+void
+_gy_text_attribute_set_arena_string (GyTextAttribute *attr,
+                                     gchar           *string)
+{
+  g_return_if_fail (attr->in_arena);
+  g_return_if_fail (attr->type == GY_TEXT_ATTR_FAMILY ||
+                    attr->type == GY_TEXT_ATTR_FONT_FEATURES);
+
+  attr->attr_string = string;
+}
+
+/*
+ * Sets the font description of an attribute made in an arena to @desc,
+ * which the arena frees.
+ */
+void
+_gy_text_attribute_set_arena_font_desc (GyTextAttribute      *attr,
+                                        PangoFontDescription *desc)
+{
+  g_return_if_fail (attr->in_arena);
+  g_return_if_fail (attr->type == GY_TEXT_ATTR_FONT_DESC);
+
+  attr->attr_desc = desc;
+}
+
+/*
+ * Ties the indexes of @attr to @anchor, or unties them if it is %NULL,
+ * keeping the values they have now. An attribute is tied to one anchor
+ * at a time, the one of the scheme it was added to last.
+ */
+void
+_gy_text_attribute_set_anchor (GyTextAttribute  *attr,
+                               GyTextAttrAnchor *anchor)
+{
+  attr->start_index = anchored_start (attr);
+  attr->end_index = anchored_end (attr);
+  attr->anchor = anchor;
+  attr->start_shift = attr->end_shift = anchor != NULL ? anchor->shift : 0;
+}
+
+GyTextAttrAnchor *
+_gy_text_attribute_get_anchor (GyTextAttribute *attr)
+{
+  return attr->anchor;
+}
+
 /**
  * gy_text_attribute_set_start_index:
  * @attr: a text attribute
@@ -201,6 +312,12 @@ gy_text_attribute_set_start_index (GyTextAttribute *attr,
   g_return_if_fail (attr != NULL);
 
   attr->start_index = start_index;
+
+  if (attr->anchor != NULL)
+    {
+      attr->start_shift = attr->anchor->shift;
+      attr->anchor->changes++;
+    }
 }
 
 /**
@@ -218,7 +335,7 @@ gy_text_attribute_get_start_index (GyTextAttribute *attr)
 {
   g_return_val_if_fail (attr != NULL, 0);
 
-  return attr->start_index;
+  return anchored_start (attr);
 }
 
 /**
@@ -238,6 +355,12 @@ gy_text_attribute_set_end_index (GyTextAttribute *attr,
   g_return_if_fail (attr != NULL);
 
   attr->end_index = end_index;
+
+  if (attr->anchor != NULL)
+    {
+      attr->end_shift = attr->anchor->shift;
+      attr->anchor->changes++;
+    }
 }
 
 /**
@@ -255,7 +378,7 @@ gy_text_attribute_get_end_index (GyTextAttribute *attr)
 {
   g_return_val_if_fail (attr != NULL, 0);
 
-  return attr->end_index;
+  return anchored_end (attr);
 }
 
 /**
@@ -424,6 +547,107 @@ gy_text_attribute_get_attr_type (GyTextAttribute *attr)
   return attr->type;
 }
 
+/**
+ * gy_text_attribute_set_boolean:
+ * @attr: a text attribute
+ * @value: the value
+ *
+ * Sets the boolean value of @attr, for an attribute made with
+ * gy_format_scheme_new_attribute().
+ *
+ * Since: 0.6
+ **/
+void
+gy_text_attribute_set_boolean (GyTextAttribute *attr,
+                               gboolean         value)
+{
+  g_return_if_fail (attr != NULL);
+
+  attr->attr_bool = value;
+}
+
+/**
+ * gy_text_attribute_set_int:
+ * @attr: a text attribute
+ * @value: the value
+ *
+ * Sets the integer value of @attr, for an attribute made with
+ * gy_format_scheme_new_attribute().
+ *
+ * Since: 0.6
+ **/
+void
+gy_text_attribute_set_int (GyTextAttribute *attr,
+                           gint             value)
+{
+  g_return_if_fail (attr != NULL);
+
+  attr->attr_int = value;
+}
+
+/**
+ * gy_text_attribute_set_float:
+ * @attr: a text attribute
+ * @value: the value
+ *
+ * Sets the double precision floating point value of @attr, for an
+ * attribute made with gy_format_scheme_new_attribute().
+ *
+ * Since: 0.6
+ **/
+void
+gy_text_attribute_set_float (GyTextAttribute *attr,
+                             gdouble          value)
+{
+  g_return_if_fail (attr != NULL);
+
+  attr->attr_float = value;
+}
+
+/**
+ * gy_text_attribute_set_language:
+ * @attr: a text attribute
+ * @language: the pango language
+ *
+ * Sets the pango language of @attr, for an attribute made with
+ * gy_format_scheme_new_attribute().
+ *
+ * Since: 0.6
+ **/
+void
+gy_text_attribute_set_language (GyTextAttribute *attr,
+                                PangoLanguage   *language)
+{
+  g_return_if_fail (attr != NULL);
+
+  attr->attr_language = language;
+}
+
+/**
+ * gy_text_attribute_set_color:
+ * @attr: a text attribute
+ * @red: the red component
+ * @green: the green component
+ * @blue: the blue component
+ *
+ * Sets the pango color of @attr, for an attribute made with
+ * gy_format_scheme_new_attribute().
+ *
+ * Since: 0.6
+ **/
+void
+gy_text_attribute_set_color (GyTextAttribute *attr,
+                             guint16          red,
+                             guint16          green,
+                             guint16          blue)
+{
+  g_return_if_fail (attr != NULL);
+
+  attr->attr_color.red   = red;
+  attr->attr_color.green = green;
+  attr->attr_color.blue  = blue;
+}
+
 /**
  * gy_text_attribute_language_new:
  * @language: language tag
@@ -947,26 +1171,140 @@ gy_text_attribute_background_alpha_new (guint16 alpha)
   return attr;
 }
 
+/**
+ * gy_text_attribute_translation_new:
+ *
+ * Create a new attribute marking a translation of the headword. A
+ * formatter of a bilingual dictionary puts it over every equivalent
+ * in the target language, so the entry can be found by it.
+ *
+ * Return value: (transfer full): the newly allocated #GyTextAttribute,
+ *               which should be freed with gy_text_attribute_unref().
+ *
+ * Since: 0.6
+ **/
+GyTextAttribute *
+gy_text_attribute_translation_new (void)
+{
+  GyTextAttribute *attr = gy_text_attribute_new ();
+
+  attr->type = GY_TEXT_ATTR_TRANSLATION;
+
+  return attr;
+}
+
 /*
  * Text Attribute List
+ *
+ * The attributes are kept in one array sorted by their start index,
+ * so an attribute is inserted after a binary search and the iterator
+ * walks the array in order. Attributes added with
+ * gy_text_attr_list_append() are only put at the end; the array is
+ * sorted once before it is read again.
  */
 
 struct _GyTextAttrList
 {
   guint ref_count;
-  GSList *attrs;
-  GSList *tail;
+  GPtrArray *attrs;
+  gboolean unsorted;
 };
 
 
+/*
+ * The iterator keeps, for every type, the active attribute which started
+ * last in a slot, so gy_text_attr_iterator_get() is a lookup. The
+ * attribute it covers is linked from @below and comes back when it
+ * ends. The active attributes are also kept in a min-heap by their end
+ * index, which gives the end of the segment and the attributes to drop
+ * at the next step. Both arrays are sized for the whole list up front,
+ * so moving to the next segment allocates nothing.
+ */
+#define NO_ATTR G_MAXUINT
+#define N_SLOTS (GY_TEXT_ATTR_BACKGROUND_ALPHA + 2)
+
 struct _GyTextAttrIterator
 {
-  GSList *next;
-  GList *stack;
+  GPtrArray *attrs;
+  guint next;
   guint start_index;
   guint end_index;
+
+  guint slots[N_SLOTS];
+  guint *below;
+  guint *heap;
+  guint heap_len;
 };
 
+static inline gint
+get_slot (GyTextAttrType type)
+{
+  if ((guint) type <= GY_TEXT_ATTR_BACKGROUND_ALPHA)
+    return type;
+
+  if (type == GY_TEXT_ATTR_TRANSLATION)
+    return N_SLOTS - 1;
+
+  return -1;
+}
+
+static inline guint
+heap_end (GyTextAttrIterator *iterator,
+          guint               pos)
+{
+  return ((GyTextAttribute *) iterator->attrs->pdata[iterator->heap[pos]])->end_index;
+}
+
+static void
+heap_push (GyTextAttrIterator *iterator,
+           guint               attr)
+{
+  guint pos = iterator->heap_len++;
+
+  iterator->heap[pos] = attr;
+
+  while (pos > 0 && heap_end (iterator, (pos - 1) / 2) > heap_end (iterator, pos))
+    {
+      guint parent = (pos - 1) / 2;
+      guint tmp = iterator->heap[parent];
+
+      iterator->heap[parent] = iterator->heap[pos];
+      iterator->heap[pos] = tmp;
+      pos = parent;
+    }
+}
+
+static guint
+heap_pop (GyTextAttrIterator *iterator)
+{
+  guint top = iterator->heap[0];
+  guint pos = 0;
+
+  iterator->heap[0] = iterator->heap[--iterator->heap_len];
+
+  for (;;)
+    {
+      guint child = 2 * pos + 1;
+      guint tmp;
+
+      if (child >= iterator->heap_len)
+        break;
+
+      if (child + 1 < iterator->heap_len && heap_end (iterator, child + 1) < heap_end (iterator, child))
+        child++;
+
+      if (heap_end (iterator, pos) <= heap_end (iterator, child))
+        break;
+
+      tmp = iterator->heap[child];
+      iterator->heap[child] = iterator->heap[pos];
+      iterator->heap[pos] = tmp;
+      pos = child;
+    }
+
+  return top;
+}
+
 G_DEFINE_BOXED_TYPE (GyTextAttrList, gy_text_attr_list,
                      gy_text_attr_list_copy,
                      gy_text_attr_list_unref);
@@ -986,8 +1324,8 @@ gy_text_attr_list_new (void)
   GyTextAttrList *list = g_slice_new (GyTextAttrList);
 
   list->ref_count = 1;
-  list->attrs = NULL;
-  list->tail = NULL;
+  list->attrs = g_ptr_array_new_with_free_func ((GDestroyNotify) gy_text_attribute_unref);
+  list->unsorted = FALSE;
 
   return list;
 }
@@ -1032,14 +1370,56 @@ gy_text_attr_list_unref (GyTextAttrList *list)
 
   if (g_atomic_int_dec_and_test ((gint *) &list->ref_count))
     {
-      for (GSList *iter = list->attrs; iter != NULL; iter = iter->next)
-        gy_text_attribute_unref (iter->data);
-
-      g_slist_free (list->attrs);
+      g_ptr_array_unref (list->attrs);
       g_slice_free (GyTextAttrList, list);
     }
 }
 
+static gint
+compare_start_index (gconstpointer a,
+                     gconstpointer b)
+{
+  const GyTextAttribute *attr_a = *(GyTextAttribute * const *) a;
+  const GyTextAttribute *attr_b = *(GyTextAttribute * const *) b;
+
+  if (attr_a->start_index == attr_b->start_index)
+    return 0;
+
+  return attr_a->start_index < attr_b->start_index ? -1 : 1;
+}
+
+/**
+ * gy_text_attr_list_sort:
+ * @list: a #GyTextAttrList
+ *
+ * Sorts the text attributes added with gy_text_attr_list_append()
+ * by their start index. Attributes with the same start index keep
+ * the order in which they were added. The list is sorted this way
+ * before it is read, so calling this is only needed to choose when
+ * the work is done.
+ *
+ * Since: 0.6
+ */
+void
+gy_text_attr_list_sort (GyTextAttrList *list)
+{
+  g_return_if_fail (list != NULL);
+
+  if (list->unsorted)
+    {
+      /* g_ptr_array_sort() is stable. */
+      g_ptr_array_sort (list->attrs, compare_start_index);
+      list->unsorted = FALSE;
+    }
+}
+
+/* Makes gy_text_attr_list_sort() sort @list, whose indexes were changed in place. */
+void
+_gy_text_attr_list_invalidate (GyTextAttrList *list)
+{
+  list->unsorted = TRUE;
+}
+
 /**
  * gy_text_attr_list_copy:
  * @list: (nullable): a #GyTextAttrList, may be %NULL
@@ -1060,13 +1440,13 @@ gy_text_attr_list_copy (GyTextAttrList *list)
 
   if (list == NULL) return NULL;
 
+  gy_text_attr_list_sort (list);
+
   new = gy_text_attr_list_new ();
+  g_ptr_array_set_size (new->attrs, list->attrs->len);
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-function-type"
-  new->attrs = g_slist_copy_deep (list->attrs, (GCopyFunc) gy_text_attribute_copy, NULL);
-#pragma GCC diagnostic pop
-  new->tail = g_slist_last (new->attrs);
+  for (guint i = 0; i < list->attrs->len; i++)
+    new->attrs->pdata[i] = gy_text_attribute_copy (list->attrs->pdata[i]);
 
   return new;
 }
@@ -1076,49 +1456,37 @@ gy_text_attr_list_insert_internal (GyTextAttrList  *list,
                                    GyTextAttribute *attr,
                                    gboolean         before)
 {
+  GyTextAttribute **attrs;
   guint start_index = attr->start_index;
+  guint lo = 0;
+  guint hi;
 
-  if (!list->attrs)
-    {
-      list->attrs = g_slist_prepend (NULL, attr);
-      list->tail = list->attrs;
-    }
-  else if (((GyTextAttribute *)list->tail->data)->start_index < start_index ||
-           (!before && ((GyTextAttribute *)list->tail->data)->start_index == start_index))
-    {
-      list->tail = g_slist_append (list->tail, attr);
-      list->tail = list->tail->next;
-      g_assert (list->tail);
-    }
-  else
-    {
-      GSList *tmp_list, *prev, *link;
-      prev = link = NULL;
-      tmp_list = list->attrs;
-
-      while (TRUE)
-        {
-          GyTextAttribute *tmp_attr = tmp_list->data;
+  gy_text_attr_list_sort (list);
 
-          if (tmp_attr->start_index > start_index ||
-              (before && tmp_attr->start_index == start_index))
-            {
-              link = g_slist_alloc ();
-              link->next = tmp_list;
-              link->data = attr;
+  attrs = (GyTextAttribute **) list->attrs->pdata;
+  hi = list->attrs->len;
 
-              if (prev)
-                prev->next = link;
-              else
-                list->attrs = link;
+  /* Attributes are mostly added in order, so try the end first. */
+  if (hi == 0 ||
+      attrs[hi - 1]->start_index < start_index ||
+      (!before && attrs[hi - 1]->start_index == start_index))
+    {
+      g_ptr_array_add (list->attrs, attr);
+      return;
+    }
 
-              break;
-            }
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
 
-          prev = tmp_list;
-          tmp_list = tmp_list->next;
-        }
+      if (attrs[mid]->start_index < start_index ||
+          (!before && attrs[mid]->start_index == start_index))
+        lo = mid + 1;
+      else
+        hi = mid;
     }
+
+  g_ptr_array_insert (list->attrs, lo, attr);
 }
 
 /**
@@ -1165,6 +1533,38 @@ gy_text_attr_list_insert_before (GyTextAttrList  *list,
   gy_text_attr_list_insert_internal (list, attr, TRUE);
 }
 
+/**
+ * gy_text_attr_list_append:
+ * @list: a #GyTextAttrList
+ * @attr: (transfer full): the text attribute to append. Ownership of
+ *        this value is assumed by the list.
+ *
+ * Adds the given text attribute at the end of the #GyTextAttrList
+ * without looking for its place. The list is sorted once, the next
+ * time it is read, and ends up as if every attribute had been added
+ * with gy_text_attr_list_insert(). This is the cheapest way of adding
+ * many attributes which do not come in order.
+ *
+ * Since: 0.6
+ **/
+void
+gy_text_attr_list_append (GyTextAttrList  *list,
+                          GyTextAttribute *attr)
+{
+  GPtrArray *attrs;
+
+  g_return_if_fail (list != NULL);
+  g_return_if_fail (attr != NULL);
+
+  attrs = list->attrs;
+
+  if (attrs->len > 0 &&
+      ((GyTextAttribute *) attrs->pdata[attrs->len - 1])->start_index > attr->start_index)
+    list->unsorted = TRUE;
+
+  g_ptr_array_add (attrs, attr);
+}
+
 /**
  * gy_text_attr_list_get_attributes:
  * @list: a #GyTextAttrList
@@ -1181,12 +1581,32 @@ gy_text_attr_list_insert_before (GyTextAttrList  *list,
 GSList *
 gy_text_attr_list_get_attributes (GyTextAttrList *list)
 {
+  GSList *attrs = NULL;
+
   g_return_val_if_fail (list != NULL, NULL);
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-function-type"
-  return g_slist_copy_deep (list->attrs, (GCopyFunc)gy_text_attribute_copy, NULL);
-#pragma GCC diagnostic pop
+  gy_text_attr_list_sort (list);
+
+  for (guint i = list->attrs->len; i > 0; i--)
+    attrs = g_slist_prepend (attrs, gy_text_attribute_copy (list->attrs->pdata[i - 1]));
+
+  return attrs;
+}
+
+/**
+ * gy_text_attr_list_get_length:
+ * @list: a #GyTextAttrList
+ *
+ * Return value: the number of text attributes in @list
+ *
+ * Since: 0.6
+ */
+guint
+gy_text_attr_list_get_length (GyTextAttrList *list)
+{
+  g_return_val_if_fail (list != NULL, 0);
+
+  return list->attrs->len;
 }
 
 /**
@@ -1208,9 +1628,18 @@ gy_text_attr_list_get_iterator (GyTextAttrList *list)
 
   g_return_val_if_fail (list != NULL, NULL);
 
+  gy_text_attr_list_sort (list);
+
   iterator = g_slice_new (GyTextAttrIterator);
-  iterator->next = list->attrs;
-  iterator->stack = NULL;
+  iterator->attrs = list->attrs;
+  iterator->next = 0;
+
+  for (guint i = 0; i < N_SLOTS; i++)
+    iterator->slots[i] = NO_ATTR;
+
+  iterator->below = g_new (guint, 2 * list->attrs->len);
+  iterator->heap = iterator->below + list->attrs->len;
+  iterator->heap_len = 0;
 
   iterator->start_index = 0;
   iterator->end_index = 0;
@@ -1252,7 +1681,9 @@ gy_text_attr_iterator_copy (GyTextAttrIterator *iterator)
 
   *copy = *iterator;
 
-  copy->stack = g_list_copy (iterator->stack);
+  copy->below = g_new (guint, 2 * iterator->attrs->len);
+  memcpy (copy->below, iterator->below, 2 * iterator->attrs->len * sizeof (guint));
+  copy->heap = copy->below + iterator->attrs->len;
 
   return copy;
 }
@@ -1270,7 +1701,7 @@ gy_text_attr_iterator_destroy (GyTextAttrIterator *iterator)
 {
   g_return_if_fail (iterator != NULL);
 
-  g_list_free (iterator->stack);
+  g_free (iterator->below);
   g_slice_free (GyTextAttrIterator, iterator);
 }
 
@@ -1289,41 +1720,54 @@ gy_text_attr_iterator_next (GyTextAttrIterator *iterator)
 {
   g_return_val_if_fail (iterator != NULL, FALSE);
 
-  if (!iterator->next && !iterator->stack)
+  if (iterator->next == iterator->attrs->len && iterator->heap_len == 0)
     return FALSE;
 
   iterator->start_index = iterator->end_index;
   iterator->end_index = PANGO_ATTR_INDEX_TO_TEXT_END;
 
-  GyTextAttribute *attr = NULL;
-  for (GList *tmp_list = iterator->stack, *next = NULL ; tmp_list != NULL; tmp_list = next)
+  while (iterator->heap_len > 0 && heap_end (iterator, 0) == iterator->start_index)
     {
-      next = tmp_list->next;
-      attr = tmp_list->data;
+      GyTextAttribute *attr = iterator->attrs->pdata[heap_pop (iterator)];
+      gint slot = get_slot (attr->type);
+      guint *top;
+
+      if (slot < 0)
+        continue;
+
+      /* Attributes covered by this one may have ended already. */
+      top = &iterator->slots[slot];
+      while (*top != NO_ATTR &&
+             ((GyTextAttribute *) iterator->attrs->pdata[*top])->end_index <= iterator->start_index)
+        *top = iterator->below[*top];
+    }
 
-      if (attr->end_index == iterator->start_index)
-        {
-          iterator->stack = g_list_remove_link (iterator->stack, tmp_list);
-          g_list_free_1 (tmp_list);
-        }
-      else
+  for (; iterator->next < iterator->attrs->len; iterator->next++)
+    {
+      GyTextAttribute *attr = iterator->attrs->pdata[iterator->next];
+      gint slot;
+
+      if (attr->start_index != iterator->start_index)
         {
-          iterator->end_index = MIN (iterator->end_index, attr->end_index);
+          iterator->end_index = MIN (iterator->end_index, attr->start_index);
+          break;
         }
-    }
 
-  while (iterator->next && ((GyTextAttribute *)iterator->next->data)->start_index == iterator->start_index)
-    {
-      if (((GyTextAttribute *)iterator->next->data)->end_index > iterator->start_index)
+      if (attr->end_index <= iterator->start_index)
+        continue;
+
+      heap_push (iterator, iterator->next);
+
+      slot = get_slot (attr->type);
+      if (slot >= 0)
         {
-          iterator->stack = g_list_prepend (iterator->stack, iterator->next->data);
-          iterator->end_index = MIN (iterator->end_index, ((GyTextAttribute *)iterator->next->data)->end_index);
+          iterator->below[iterator->next] = iterator->slots[slot];
+          iterator->slots[slot] = iterator->next;
         }
-      iterator->next = iterator->next->next;
     }
 
-  if (iterator->next)
-    iterator->end_index = MIN (iterator->end_index, ((GyTextAttribute *)iterator->next->data)->start_index);
+  if (iterator->heap_len > 0)
+    iterator->end_index = MIN (iterator->end_index, heap_end (iterator, 0));
 
   return TRUE;
 }
@@ -1371,18 +1815,13 @@ GyTextAttribute *
 gy_text_attr_iterator_get (GyTextAttrIterator *iterator,
                            GyTextAttrType      type)
 {
-  GyTextAttribute *attr = NULL;
+  gint slot = get_slot (type);
 
   g_return_val_if_fail (iterator != NULL, NULL);
 
-  for (GList *iter = iterator->stack; iter != NULL; iter = iter->next)
-    {
-      attr = iter->data;
-
-      if (attr->type == type)
-        return attr;
-    }
+  if (slot < 0 || iterator->slots[slot] == NO_ATTR)
+    return NULL;
 
-  return NULL;
+  return iterator->attrs->pdata[iterator->slots[slot]];
 }
 
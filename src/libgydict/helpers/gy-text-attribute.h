@@ -60,6 +60,8 @@ typedef struct _GyTextAttrIterator GyTextAttrIterator;
  * @GY_TEXT_ATTR_FONT_FEATURES: OpenType font features
  * @GY_TEXT_ATTR_FOREGROUND_ALPHA: foreground alpha
  * @GY_TEXT_ATTR_BACKGROUND_ALPHA: background alpha
+ * @GY_TEXT_ATTR_TRANSLATION: the text is a translation of the headword;
+ *   it is not drawn, but the reverse lookup is built from it
  *
  * The #GyTextAttrType distinguishes between different types of attributes.
  */
@@ -91,6 +93,9 @@ typedef enum
   GY_TEXT_ATTR_FONT_FEATURES       = PANGO_ATTR_FONT_FEATURES,
   GY_TEXT_ATTR_FOREGROUND_ALPHA    = PANGO_ATTR_FOREGROUND_ALPHA,
   GY_TEXT_ATTR_BACKGROUND_ALPHA    = PANGO_ATTR_BACKGROUND_ALPHA,
+
+  /* The attributes of gydict lie beyond those of Pango. */
+  GY_TEXT_ATTR_TRANSLATION         = 64,
 } GyTextAttrType;
 
 /*
@@ -111,6 +116,18 @@ guint gy_text_attribute_get_end_index (GyTextAttribute *attr);
 void gy_text_attribute_set_attr_type (GyTextAttribute *attr,
                                       GyTextAttrType   type);
 GyTextAttrType gy_text_attribute_get_attr_type (GyTextAttribute *attr);
+void gy_text_attribute_set_boolean (GyTextAttribute *attr,
+                                    gboolean         value);
+void gy_text_attribute_set_int (GyTextAttribute *attr,
+                                gint             value);
+void gy_text_attribute_set_float (GyTextAttribute *attr,
+                                  gdouble          value);
+void gy_text_attribute_set_language (GyTextAttribute *attr,
+                                     PangoLanguage   *language);
+void gy_text_attribute_set_color (GyTextAttribute *attr,
+                                  guint16          red,
+                                  guint16          green,
+                                  guint16          blue);
 gboolean gy_text_attribute_get_boolean (GyTextAttribute *attr);
 gint gy_text_attribute_get_int (GyTextAttribute *attr);
 gdouble gy_text_attribute_get_float (GyTextAttribute *attr);
@@ -149,6 +166,7 @@ GyTextAttribute *gy_text_attribute_letter_spacing_new (gint letter_spacing);
 GyTextAttribute *gy_text_attribute_font_features_new (const gchar *features);
 GyTextAttribute *gy_text_attribute_foreground_alpha_new (guint16 alpha);
 GyTextAttribute *gy_text_attribute_background_alpha_new (guint16 alpha);
+GyTextAttribute *gy_text_attribute_translation_new (void);
 
 /*
  * The text attriubte list
@@ -162,7 +180,11 @@ void             gy_text_attr_list_insert         (GyTextAttrList  *list,
                                                    GyTextAttribute *attr);
 void             gy_text_attr_list_insert_before  (GyTextAttrList  *list,
                                                    GyTextAttribute *attr);
+void             gy_text_attr_list_append         (GyTextAttrList  *list,
+                                                   GyTextAttribute *attr);
+void             gy_text_attr_list_sort           (GyTextAttrList *list);
 GSList*          gy_text_attr_list_get_attributes (GyTextAttrList *list);
+guint            gy_text_attr_list_get_length     (GyTextAttrList *list);
 GyTextAttrIterator *gy_text_attr_list_get_iterator (GyTextAttrList *list);
 
 /*
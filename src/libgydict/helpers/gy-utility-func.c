@@ -18,8 +18,14 @@
 
 #include <math.h>
 #include "config.h"
+#include <string.h>
 #include "gy-utility-func.h"
 
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+# include <immintrin.h>
+# define GY_HAVE_X86_SIMD 1
+#endif
+
 gboolean
 gy_utility_handlers_is_blocked_by_func (gpointer instance,
                                         gpointer func,
@@ -99,3 +105,165 @@ gy_utility_compute_md5_for_file (GFile   *file,
 
   return md5;
 }
+
+/**
+ * gy_utility_fold_search_key:
+ * @str: a UTF-8 string
+ * @len: length of @str in bytes, or -1 if @str is nul-terminated
+ *
+ * Folds @str into the form used to compare search keys: the string is
+ * normalized with %G_NORMALIZE_ALL and then case folded.
+ *
+ * Returns: (transfer full) (nullable): the folded key, or %NULL if @str
+ * is not valid UTF-8. Free with g_free().
+ */
+gchar *
+gy_utility_fold_search_key (const gchar *str,
+                            gssize       len)
+{
+  g_autofree gchar *normalized = NULL;
+
+  g_return_val_if_fail (str != NULL, NULL);
+
+  normalized = g_utf8_normalize (str, len, G_NORMALIZE_ALL);
+
+  if (normalized == NULL)
+    return NULL;
+
+  return g_utf8_casefold (normalized, -1);
+}
+
+#ifdef GY_HAVE_X86_SIMD
+/*
+ * The vector loops skip over the leading blocks in which @prefix and @str
+ * are equal. Anything else is left to the scalar loop, which starts from
+ * the first block that did not pass.
+ */
+__attribute__((target ("sse2")))
+static gsize
+skip_equal_blocks_sse2 (const gchar *prefix,
+                        const gchar *str,
+                        gsize        len)
+{
+  gsize i = 0;
+
+  for (; len - i >= 16; i += 16)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (prefix + i));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (str + i));
+
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b)) != 0xffff)
+        break;
+    }
+
+  return i;
+}
+
+__attribute__((target ("avx2")))
+static gsize
+skip_equal_blocks_avx2 (const gchar *prefix,
+                        const gchar *str,
+                        gsize        len)
+{
+  gsize i = 0;
+
+  for (; len - i >= 32; i += 32)
+    {
+      __m256i a = _mm256_loadu_si256 ((const __m256i *) (prefix + i));
+      __m256i b = _mm256_loadu_si256 ((const __m256i *) (str + i));
+
+      if ((guint32) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (a, b)) != 0xffffffff)
+        break;
+    }
+
+  return i + skip_equal_blocks_sse2 (prefix + i, str + i, len - i);
+}
+
+typedef gsize (*SkipEqualBlocks) (const gchar *prefix,
+                                  const gchar *str,
+                                  gsize        len);
+
+static gsize
+skip_equal_blocks (const gchar *prefix,
+                   const gchar *str,
+                   gsize        len)
+{
+  static gsize impl = 0;
+
+  if (g_once_init_enter (&impl))
+    {
+      __builtin_cpu_init ();
+      g_once_init_leave (&impl, __builtin_cpu_supports ("avx2")
+                                ? (gsize) skip_equal_blocks_avx2
+                                : (gsize) skip_equal_blocks_sse2);
+    }
+
+  return ((SkipEqualBlocks) impl) (prefix, str, len);
+}
+#else
+static inline gsize
+skip_equal_blocks (const gchar *prefix,
+                   const gchar *str,
+                   gsize        len)
+{
+  return 0;
+}
+#endif
+
+/**
+ * gy_utility_prefix_cmp_len:
+ * @prefix: a folded search key
+ * @prefix_len: the length of @prefix in bytes
+ * @str: a folded headword
+ * @str_len: the length of @str in bytes
+ *
+ * Compares @prefix with the beginning of @str byte by byte. Neither
+ * string has to be terminated. Long common runs are compared 16 or 32
+ * bytes at a time where the CPU allows it; nothing is allocated. The
+ * alternate forms of a headword are split apart before, see
+ * #GySearchKeys, so '|' is an ordinary byte here.
+ *
+ * Returns: 0 if @str begins with @prefix, a negative value if @prefix
+ * sorts before @str and a positive value if it sorts after it
+ */
+gint
+gy_utility_prefix_cmp_len (const gchar *prefix,
+                           gsize        prefix_len,
+                           const gchar *str,
+                           gsize        str_len)
+{
+  const guchar *p = (const guchar *) prefix;
+  const guchar *s = (const guchar *) str;
+  gsize i;
+
+  g_return_val_if_fail (prefix != NULL && str != NULL, -1);
+
+  for (i = skip_equal_blocks (prefix, str, MIN (prefix_len, str_len)); i < prefix_len; i++)
+    {
+      guchar c = i < str_len ? s[i] : '\0';
+
+      if (p[i] != c)
+        return (gint) p[i] - (gint) c;
+    }
+
+  return 0;
+}
+
+/**
+ * gy_utility_prefix_cmp:
+ * @prefix: a folded search key
+ * @str: a folded headword
+ *
+ * Like gy_utility_prefix_cmp_len() for NUL-terminated strings.
+ *
+ * Returns: 0 if @str begins with @prefix, a negative value if @prefix
+ * sorts before @str and a positive value if it sorts after it
+ */
+gint
+gy_utility_prefix_cmp (const gchar *prefix,
+                       const gchar *str)
+{
+  g_return_val_if_fail (prefix != NULL && str != NULL, -1);
+
+  return gy_utility_prefix_cmp_len (prefix, strlen (prefix), str, strlen (str));
+}
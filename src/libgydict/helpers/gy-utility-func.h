@@ -38,6 +38,14 @@ extern gint gy_utility_strcmp (const gchar *p1,
                                size_t n);
 extern gchar *gy_utility_compute_md5_for_file (GFile  *file,
                                                GError **err);
+gchar *gy_utility_fold_search_key (const gchar *str,
+                                   gssize       len);
+gint gy_utility_prefix_cmp (const gchar *prefix,
+                            const gchar *str);
+gint gy_utility_prefix_cmp_len (const gchar *prefix,
+                                gsize        prefix_len,
+                                const gchar *str,
+                                gsize        str_len);
 
 G_END_DECLS
 
@@ -0,0 +1,288 @@
+/* gy-completion-index.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "gy-completion-index.h"
+
+/*
+ * Completions of a prefix are the rows whose keys begin with it. In the
+ * sorted order of the keys they form one contiguous range, found by two
+ * bisections. Ranking them by weight uses a segment tree over the
+ * weights in that order, where every node holds the position of the
+ * heaviest row below it. The best k rows of a range are taken one by
+ * one from a small heap of sub-ranges: the heaviest row of a popped
+ * range is emitted and the two parts around it are pushed back. This
+ * costs O(log n + k log k) per query, independent of the range size.
+ *
+ * The order is that of the forms of the keys, so a row with alternate
+ * forms may be in a range more than once; it is emitted only once.
+ */
+struct _GyCompletionIndex
+{
+  gint           ref_count;
+
+  GySearchKeys  *keys;
+  const guint32 *order;
+  guint32       *weights; /* in the sorted order, or NULL */
+  guint32       *tree;    /* positions, tree[size + i] = i */
+  guint          size;
+};
+
+typedef struct
+{
+  guint begin;
+  guint end;
+  guint best;
+} Range;
+
+G_DEFINE_BOXED_TYPE (GyCompletionIndex, gy_completion_index,
+                     gy_completion_index_ref, gy_completion_index_unref)
+
+/* The heavier of two positions; the earlier one wins a tie. */
+static inline guint
+heavier (GyCompletionIndex *self,
+         guint              a,
+         guint              b)
+{
+  if (self->weights[b] > self->weights[a] ||
+      (self->weights[b] == self->weights[a] && b < a))
+    return b;
+
+  return a;
+}
+
+static guint
+argmax (GyCompletionIndex *self,
+        guint              begin,
+        guint              end)
+{
+  guint best = begin;
+
+  for (begin += self->size, end += self->size; begin < end; begin /= 2, end /= 2)
+    {
+      if (begin & 1)
+        best = heavier (self, best, self->tree[begin++]);
+      if (end & 1)
+        best = heavier (self, best, self->tree[--end]);
+    }
+
+  return best;
+}
+
+/**
+ * gy_completion_index_new:
+ * @keys: the search keys of a model
+ * @weights: (nullable) (array): a weight for every row, such as the
+ *   frequency of the headword, or %NULL
+ *
+ * Builds an index completing prefixes to rows of the model of @keys.
+ * Without weights the completions come in the order of their keys, so
+ * shorter words go first. Sorting the keys may take a while on the first
+ * use of @keys, so build big indexes on a worker thread.
+ *
+ * Returns: (transfer full): a new #GyCompletionIndex
+ */
+GyCompletionIndex *
+gy_completion_index_new (GySearchKeys  *keys,
+                         const guint32 *weights)
+{
+  GyCompletionIndex *self;
+
+  g_return_val_if_fail (keys != NULL, NULL);
+
+  self = g_slice_new0 (GyCompletionIndex);
+  self->ref_count = 1;
+  self->keys = gy_search_keys_ref (keys);
+  self->order = gy_search_keys_get_sorted_rows (keys, &self->size);
+
+  if (weights != NULL && self->size > 0)
+    {
+      self->weights = g_new (guint32, self->size);
+      self->tree = g_new (guint32, 2 * self->size);
+
+      for (guint i = 0; i < self->size; i++)
+        {
+          self->weights[i] = weights[self->order[i]];
+          self->tree[self->size + i] = i;
+        }
+
+      for (guint i = self->size - 1; i > 0; i--)
+        self->tree[i] = heavier (self, self->tree[2 * i], self->tree[2 * i + 1]);
+    }
+
+  return self;
+}
+
+GyCompletionIndex *
+gy_completion_index_ref (GyCompletionIndex *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+gy_completion_index_unref (GyCompletionIndex *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  g_clear_pointer (&self->keys, gy_search_keys_unref);
+  g_free (self->weights);
+  g_free (self->tree);
+  g_slice_free (GyCompletionIndex, self);
+}
+
+static gboolean
+has_row (GArray  *rows,
+         guint32  row)
+{
+  for (guint i = 0; i < rows->len; i++)
+    {
+      if (g_array_index (rows, guint32, i) == row)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+heap_push (GyCompletionIndex *self,
+           GArray            *heap,
+           guint              begin,
+           guint              end)
+{
+  Range range = { begin, end, 0 };
+  guint i;
+
+  if (begin >= end)
+    return;
+
+  range.best = argmax (self, begin, end);
+  g_array_append_val (heap, range);
+
+  for (i = heap->len - 1; i > 0; i = (i - 1) / 2)
+    {
+      Range *child = &g_array_index (heap, Range, i);
+      Range *parent = &g_array_index (heap, Range, (i - 1) / 2);
+      Range tmp;
+
+      if (heavier (self, parent->best, child->best) == parent->best)
+        break;
+
+      tmp = *parent;
+      *parent = *child;
+      *child = tmp;
+    }
+}
+
+static Range
+heap_pop (GyCompletionIndex *self,
+          GArray            *heap)
+{
+  Range top = g_array_index (heap, Range, 0);
+  guint i = 0;
+
+  g_array_index (heap, Range, 0) = g_array_index (heap, Range, heap->len - 1);
+  g_array_set_size (heap, heap->len - 1);
+
+  for (;;)
+    {
+      guint left = 2 * i + 1;
+      guint best = i;
+      Range tmp;
+
+      if (left < heap->len &&
+          heavier (self, g_array_index (heap, Range, best).best,
+                   g_array_index (heap, Range, left).best) != g_array_index (heap, Range, best).best)
+        best = left;
+      if (left + 1 < heap->len &&
+          heavier (self, g_array_index (heap, Range, best).best,
+                   g_array_index (heap, Range, left + 1).best) != g_array_index (heap, Range, best).best)
+        best = left + 1;
+
+      if (best == i)
+        break;
+
+      tmp = g_array_index (heap, Range, i);
+      g_array_index (heap, Range, i) = g_array_index (heap, Range, best);
+      g_array_index (heap, Range, best) = tmp;
+      i = best;
+    }
+
+  return top;
+}
+
+/**
+ * gy_completion_index_complete:
+ * @index: a #GyCompletionIndex
+ * @prefix: a query folded with gy_search_keys_fold()
+ * @limit: the maximum number of completions
+ *
+ * Finds the best @limit rows whose keys begin with @prefix, the
+ * heaviest first.
+ *
+ * Returns: (transfer full) (element-type guint32): the rows
+ */
+GArray *
+gy_completion_index_complete (GyCompletionIndex *self,
+                              const gchar       *prefix,
+                              guint              limit)
+{
+  g_autoptr(GArray) heap = NULL;
+  GArray *rows;
+  guint begin, end;
+
+  g_return_val_if_fail (self != NULL && prefix != NULL, NULL);
+
+  rows = g_array_sized_new (FALSE, FALSE, sizeof (guint32), limit);
+
+  if (!gy_search_keys_get_prefix_range (self->keys, prefix, &begin, &end))
+    return rows;
+
+  if (self->weights == NULL)
+    {
+      for (guint i = begin; i < end && rows->len < limit; i++)
+        {
+          if (!has_row (rows, self->order[i]))
+            g_array_append_val (rows, self->order[i]);
+        }
+
+      return rows;
+    }
+
+  heap = g_array_sized_new (FALSE, FALSE, sizeof (Range), 2 * limit + 1);
+  heap_push (self, heap, begin, end);
+
+  while (heap->len > 0 && rows->len < limit)
+    {
+      Range range = heap_pop (self, heap);
+
+      if (!has_row (rows, self->order[range.best]))
+        g_array_append_val (rows, self->order[range.best]);
+      heap_push (self, heap, range.begin, range.best);
+      heap_push (self, heap, range.best + 1, range.end);
+    }
+
+  return rows;
+}
@@ -0,0 +1,46 @@
+/* gy-completion-index.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#if !defined (GYDICT_INSIDE) && !defined (GYDICT_COMPILATION)
+#error "Only <gydict.h> can be included directly."
+#endif
+
+#include "gy-search-keys.h"
+
+G_BEGIN_DECLS
+
+#define GY_TYPE_COMPLETION_INDEX (gy_completion_index_get_type ())
+
+typedef struct _GyCompletionIndex GyCompletionIndex;
+
+GType              gy_completion_index_get_type (void) G_GNUC_CONST;
+GyCompletionIndex *gy_completion_index_new      (GySearchKeys      *keys,
+                                                 const guint32     *weights);
+GyCompletionIndex *gy_completion_index_ref      (GyCompletionIndex *index);
+void               gy_completion_index_unref    (GyCompletionIndex *index);
+GArray            *gy_completion_index_complete (GyCompletionIndex *index,
+                                                 const gchar       *prefix,
+                                                 guint              limit);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GyCompletionIndex, gy_completion_index_unref)
+
+G_END_DECLS
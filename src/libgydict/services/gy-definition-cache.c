@@ -0,0 +1,495 @@
+/* gy-definition-cache.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+#include "gy-definition-cache.h"
+
+/*
+ * The cache keeps two tiers of entries keyed by (service id, index):
+ * the raw lexical units returned by the services and the format schemes
+ * built from them. Both tiers share one LRU list and one byte budget, so
+ * a scheme evicted before its lexical unit can be rebuilt without any
+ * I/O. Concurrent lookups of the same key are merged into one "flight":
+ * the first caller does the work, the others wait for its result.
+ *
+ * Invalidating bumps a generation counter. A flight or a batch fill
+ * which started before that does not insert what it read, as it may
+ * come from the service which was replaced.
+ */
+
+/* A rough cost of one attribute together with its slot in the list. */
+#define ATTRIBUTE_COST 64
+
+typedef enum
+{
+  TIER_LEXICAL_UNIT,
+  TIER_SCHEME
+} Tier;
+
+typedef struct
+{
+  const gchar *service_id; /* interned */
+  guint        idx;
+} Key;
+
+typedef struct
+{
+  Key    key;
+  Tier   tier;
+  gsize  size;
+  GList  link;
+  union
+    {
+      gchar          *lexical_unit;
+      GyFormatScheme *scheme;
+    };
+} Entry;
+
+typedef struct
+{
+  Key             key;
+  gint            ref_count;
+  guint           generation;
+  gboolean        done;
+  GyFormatScheme *scheme;
+  GError         *error;
+} Flight;
+
+struct _GyDefinitionCache
+{
+  GMutex      mutex;
+  GCond       cond;
+  GHashTable *lexical_units;
+  GHashTable *schemes;
+  GHashTable *flights;
+  GQueue      lru;
+  gsize       size;
+  gsize       budget;
+  guint       generation;
+  guint64     hits;
+  guint64     misses;
+  guint64     merged;
+};
+
+static guint
+key_hash (gconstpointer data)
+{
+  const Key *key = data;
+
+  return g_direct_hash (key->service_id) ^ (key->idx * 2654435761u);
+}
+
+static gboolean
+key_equal (gconstpointer a,
+           gconstpointer b)
+{
+  const Key *key_a = a;
+  const Key *key_b = b;
+
+  return key_a->service_id == key_b->service_id && key_a->idx == key_b->idx;
+}
+
+static inline GHashTable *
+table_for_tier (GyDefinitionCache *cache,
+                Tier               tier)
+{
+  return tier == TIER_SCHEME ? cache->schemes : cache->lexical_units;
+}
+
+static void
+entry_free (Entry *entry)
+{
+  if (entry->tier == TIER_SCHEME)
+    gy_format_scheme_unref (entry->scheme);
+  else
+    g_free (entry->lexical_unit);
+
+  g_slice_free (Entry, entry);
+}
+
+static void
+remove_entry (GyDefinitionCache *cache,
+              Entry             *entry)
+{
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_hash_table_remove (table_for_tier (cache, entry->tier), &entry->key);
+  cache->size -= entry->size;
+  entry_free (entry);
+}
+
+static void
+touch_entry (GyDefinitionCache *cache,
+             Entry             *entry)
+{
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+}
+
+static void
+trim (GyDefinitionCache *cache)
+{
+  while (cache->size > cache->budget && cache->lru.tail != NULL)
+    remove_entry (cache, cache->lru.tail->data);
+}
+
+static gsize
+scheme_size (GyFormatScheme *scheme)
+{
+  GyTextAttrList *attrs = (GyTextAttrList *) gy_format_scheme_get_attrs (scheme);
+
+  return sizeof (Entry) + gy_format_scheme_length_lexical_unit (scheme)
+         + gy_text_attr_list_get_length (attrs) * ATTRIBUTE_COST;
+}
+
+static void
+insert_entry (GyDefinitionCache *cache,
+              const Key         *key,
+              Tier               tier,
+              gpointer           data)
+{
+  GHashTable *table = table_for_tier (cache, tier);
+  Entry *entry;
+
+  if ((entry = g_hash_table_lookup (table, key)) != NULL)
+    remove_entry (cache, entry);
+
+  entry = g_slice_new0 (Entry);
+  entry->key = *key;
+  entry->tier = tier;
+  entry->link.data = entry;
+
+  if (tier == TIER_SCHEME)
+    {
+      entry->scheme = data;
+      entry->size = scheme_size (entry->scheme);
+    }
+  else
+    {
+      entry->lexical_unit = data;
+      entry->size = sizeof (Entry) + strlen (entry->lexical_unit) + 1;
+    }
+
+  g_hash_table_insert (table, &entry->key, entry);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+  cache->size += entry->size;
+}
+
+static void
+flight_unref (Flight *flight)
+{
+  if (--flight->ref_count > 0)
+    return;
+
+  g_clear_pointer (&flight->scheme, gy_format_scheme_unref);
+  g_clear_error (&flight->error);
+  g_slice_free (Flight, flight);
+}
+
+GyDefinitionCache *
+gy_definition_cache_new (gsize budget)
+{
+  GyDefinitionCache *cache = g_slice_new0 (GyDefinitionCache);
+
+  g_mutex_init (&cache->mutex);
+  g_cond_init (&cache->cond);
+  cache->lexical_units = g_hash_table_new (key_hash, key_equal);
+  cache->schemes = g_hash_table_new (key_hash, key_equal);
+  cache->flights = g_hash_table_new (key_hash, key_equal);
+  g_queue_init (&cache->lru);
+  cache->budget = budget;
+
+  return cache;
+}
+
+void
+gy_definition_cache_free (GyDefinitionCache *cache)
+{
+  if (cache == NULL)
+    return;
+
+  g_assert (g_hash_table_size (cache->flights) == 0);
+
+  while (cache->lru.head != NULL)
+    remove_entry (cache, cache->lru.head->data);
+
+  g_hash_table_unref (cache->lexical_units);
+  g_hash_table_unref (cache->schemes);
+  g_hash_table_unref (cache->flights);
+  g_cond_clear (&cache->cond);
+  g_mutex_clear (&cache->mutex);
+  g_slice_free (GyDefinitionCache, cache);
+}
+
+void
+gy_definition_cache_set_budget (GyDefinitionCache *cache,
+                                gsize              budget)
+{
+  g_mutex_lock (&cache->mutex);
+  cache->budget = budget;
+  trim (cache);
+  g_mutex_unlock (&cache->mutex);
+}
+
+gsize
+gy_definition_cache_get_budget (GyDefinitionCache *cache)
+{
+  gsize budget;
+
+  g_mutex_lock (&cache->mutex);
+  budget = cache->budget;
+  g_mutex_unlock (&cache->mutex);
+
+  return budget;
+}
+
+void
+gy_definition_cache_get_stats (GyDefinitionCache *cache,
+                               guint64           *hits,
+                               guint64           *misses,
+                               guint64           *merged)
+{
+  g_mutex_lock (&cache->mutex);
+
+  if (hits != NULL)
+    *hits = cache->hits;
+  if (misses != NULL)
+    *misses = cache->misses;
+  if (merged != NULL)
+    *merged = cache->merged;
+
+  g_mutex_unlock (&cache->mutex);
+}
+
+/*
+ * Loads the lexical units of @indices which are not cached yet with one
+ * batch call to @service. Formatting is left to later lookups. Like
+ * gy_definition_cache_lookup(), it blocks.
+ */
+void
+gy_definition_cache_fill (GyDefinitionCache *cache,
+                          GyDictService     *service,
+                          const guint       *indices,
+                          guint              n_indices)
+{
+  g_autoptr(GArray) missing = NULL;
+  g_autoptr(GPtrArray) lexical_units = NULL;
+  guint generation;
+  Key key;
+
+  key.service_id = g_intern_string (gy_service_get_service_id (GY_SERVICE (service)));
+  missing = g_array_sized_new (FALSE, FALSE, sizeof (guint), n_indices);
+
+  g_mutex_lock (&cache->mutex);
+
+  generation = cache->generation;
+
+  for (guint i = 0; i < n_indices; i++)
+    {
+      key.idx = indices[i];
+
+      if (!g_hash_table_contains (cache->schemes, &key) &&
+          !g_hash_table_contains (cache->lexical_units, &key) &&
+          !g_hash_table_contains (cache->flights, &key))
+        g_array_append_val (missing, indices[i]);
+    }
+
+  g_mutex_unlock (&cache->mutex);
+
+  if (missing->len == 0)
+    return;
+
+  lexical_units = gy_dict_service_get_lexical_units (service, (const guint *) missing->data,
+                                                     missing->len, NULL);
+  if (lexical_units == NULL)
+    return;
+
+  g_mutex_lock (&cache->mutex);
+
+  for (guint i = 0; i < missing->len && generation == cache->generation; i++)
+    {
+      key.idx = g_array_index (missing, guint, i);
+
+      if (g_ptr_array_index (lexical_units, i) != NULL &&
+          !g_hash_table_contains (cache->lexical_units, &key))
+        {
+          insert_entry (cache, &key, TIER_LEXICAL_UNIT, g_ptr_array_index (lexical_units, i));
+          g_ptr_array_index (lexical_units, i) = NULL;
+        }
+    }
+
+  trim (cache);
+
+  g_mutex_unlock (&cache->mutex);
+}
+
+/*
+ * Drops all entries of the service @service_id. The lookups of it still
+ * running finish, but their results are not cached and later lookups do
+ * not wait for them.
+ */
+void
+gy_definition_cache_invalidate (GyDefinitionCache *cache,
+                                const gchar       *service_id)
+{
+  const gchar *interned = g_intern_string (service_id);
+  GHashTableIter iter;
+  Flight *flight;
+  GList *link;
+
+  g_mutex_lock (&cache->mutex);
+
+  cache->generation++;
+
+  /* The owner of a flight holds it, the table only points to it. */
+  g_hash_table_iter_init (&iter, cache->flights);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &flight))
+    {
+      if (flight->key.service_id == interned)
+        g_hash_table_iter_remove (&iter);
+    }
+
+  for (link = cache->lru.head; link != NULL;)
+    {
+      Entry *entry = link->data;
+
+      link = link->next;
+
+      if (entry->key.service_id == interned)
+        remove_entry (cache, entry);
+    }
+
+  g_mutex_unlock (&cache->mutex);
+}
+
+/*
+ * Returns the format scheme of the entry @idx of @service. It may block
+ * on the service and the formatter, so it is meant to be run on
+ * a worker thread.
+ */
+GyFormatScheme *
+gy_definition_cache_lookup (GyDefinitionCache  *cache,
+                            GyDictService      *service,
+                            guint               idx,
+                            GError            **err)
+{
+  g_autofree gchar *lexical_unit = NULL;
+  GyFormatScheme *scheme = NULL;
+  GError *error = NULL;
+  Flight *flight;
+  Entry *entry;
+  Key key;
+
+  key.service_id = g_intern_string (gy_service_get_service_id (GY_SERVICE (service)));
+  key.idx = idx;
+
+  g_mutex_lock (&cache->mutex);
+
+  if ((entry = g_hash_table_lookup (cache->schemes, &key)) != NULL)
+    {
+      cache->hits++;
+      touch_entry (cache, entry);
+      scheme = gy_format_scheme_ref (entry->scheme);
+      g_mutex_unlock (&cache->mutex);
+
+      return scheme;
+    }
+
+  if ((flight = g_hash_table_lookup (cache->flights, &key)) != NULL)
+    {
+      cache->merged++;
+      flight->ref_count++;
+
+      while (!flight->done)
+        g_cond_wait (&cache->cond, &cache->mutex);
+
+      scheme = gy_format_scheme_ref (flight->scheme);
+      if (flight->error != NULL)
+        g_propagate_error (err, g_error_copy (flight->error));
+
+      flight_unref (flight);
+      g_mutex_unlock (&cache->mutex);
+
+      return scheme;
+    }
+
+  cache->misses++;
+
+  flight = g_slice_new0 (Flight);
+  flight->key = key;
+  flight->ref_count = 1;
+  flight->generation = cache->generation;
+  g_hash_table_insert (cache->flights, &flight->key, flight);
+
+  if ((entry = g_hash_table_lookup (cache->lexical_units, &key)) != NULL)
+    {
+      touch_entry (cache, entry);
+      lexical_unit = g_strdup (entry->lexical_unit);
+    }
+
+  g_mutex_unlock (&cache->mutex);
+
+  if (lexical_unit == NULL)
+    lexical_unit = gy_dict_service_get_lexical_unit (service, idx, &error);
+
+  if (error == NULL && lexical_unit != NULL)
+    {
+      g_autoptr(GyDictFormatter) formatter = gy_dict_service_get_formatter (service);
+
+      scheme = gy_dict_formatter_format (formatter, lexical_unit, &error);
+
+      if (error != NULL)
+        g_clear_pointer (&scheme, gy_format_scheme_unref);
+
+      /* Reading a scheme joins its text and sorts its attributes, so do
+       * it before other threads can see the scheme. */
+      if (scheme != NULL)
+        {
+          gy_format_scheme_get_lexical_unit (scheme);
+          gy_format_scheme_get_attrs (scheme);
+        }
+    }
+
+  g_mutex_lock (&cache->mutex);
+
+  if (flight->generation == cache->generation)
+    {
+      if (error == NULL && lexical_unit != NULL)
+        insert_entry (cache, &key, TIER_LEXICAL_UNIT, g_strdup (lexical_unit));
+      if (scheme != NULL)
+        insert_entry (cache, &key, TIER_SCHEME, gy_format_scheme_ref (scheme));
+      trim (cache);
+    }
+
+  flight->done = TRUE;
+  flight->scheme = gy_format_scheme_ref (scheme);
+  flight->error = error != NULL ? g_error_copy (error) : NULL;
+  /* An invalidation may have dropped it, and a newer flight may have taken its place. */
+  if (g_hash_table_lookup (cache->flights, &flight->key) == flight)
+    g_hash_table_remove (cache->flights, &flight->key);
+  g_cond_broadcast (&cache->cond);
+  flight_unref (flight);
+
+  g_mutex_unlock (&cache->mutex);
+
+  if (error != NULL)
+    g_propagate_error (err, error);
+
+  return scheme;
+}
@@ -0,0 +1,49 @@
+/* gy-definition-cache.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "gy-dict-service.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GyDefinitionCache GyDefinitionCache;
+
+GyDefinitionCache *gy_definition_cache_new        (gsize               budget);
+void               gy_definition_cache_free       (GyDefinitionCache  *cache);
+void               gy_definition_cache_set_budget (GyDefinitionCache  *cache,
+                                                   gsize               budget);
+gsize              gy_definition_cache_get_budget (GyDefinitionCache  *cache);
+void               gy_definition_cache_get_stats  (GyDefinitionCache  *cache,
+                                                   guint64            *hits,
+                                                   guint64            *misses,
+                                                   guint64            *merged);
+void               gy_definition_cache_fill       (GyDefinitionCache  *cache,
+                                                   GyDictService      *service,
+                                                   const guint        *indices,
+                                                   guint               n_indices);
+void               gy_definition_cache_invalidate (GyDefinitionCache  *cache,
+                                                   const gchar        *service_id);
+GyFormatScheme    *gy_definition_cache_lookup     (GyDefinitionCache  *cache,
+                                                   GyDictService      *service,
+                                                   guint               idx,
+                                                   GError            **err);
+
+G_END_DECLS
@@ -34,6 +34,10 @@ gy_dict_formatter_default_init (GyDictFormatterInterface *iface)
  * @text_to_format: text to parse
  * @err: addres of return location for errors, or %NULL
  *
+ * Formats an entry for display. An implementation makes the attributes
+ * of the scheme with gy_format_scheme_new_attribute(), so they come
+ * from an arena freed at once with the scheme.
+ *
  * Returns: (transfer full) (nullable): #GyDictDataScheme
  */
 GyFormatScheme* gy_dict_formatter_format (GyDictFormatter  *self,
@@ -0,0 +1,209 @@
+/* gy-dict-searchable.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "gy-dict-searchable.h"
+#include "gy-service-private.h"
+
+/**
+ * SECTION:gy-dict-searchable
+ * @short_description: a dictionary service with its own search index
+ *
+ * A #GyDictService implements #GyDictSearchable when it can find
+ * headwords faster than a scan of its model, typically because the
+ * dictionary ships with a sorted or hashed index. #GyDefList uses it
+ * instead of the row by row search of #GtkTreeView.
+ */
+
+G_DEFINE_INTERFACE (GyDictSearchable, gy_dict_searchable, GY_TYPE_DICT_SERVICE)
+
+typedef struct
+{
+  gchar         *query;
+  GySearchFlags  flags;
+  guint          limit;
+} SearchData;
+
+static void
+search_data_free (SearchData *data)
+{
+  g_free (data->query);
+  g_slice_free (SearchData, data);
+}
+
+static void
+search_worker (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+  GyDictSearchable *self = source_object;
+  SearchData *data = task_data;
+  GArray *indices;
+  GError *error = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  indices = gy_dict_searchable_search (self, data->query, data->flags, data->limit, &error);
+
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, indices, (GDestroyNotify) g_array_unref);
+}
+
+static void
+gy_dict_searchable_real_search_async (GyDictSearchable    *self,
+                                      const gchar         *query,
+                                      GySearchFlags        flags,
+                                      guint                limit,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  SearchData *data;
+
+  data = g_slice_new0 (SearchData);
+  data->query = g_strdup (query);
+  data->flags = flags;
+  data->limit = limit;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gy_dict_searchable_real_search_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) search_data_free);
+  g_task_set_return_on_cancel (task, TRUE);
+
+  _gy_service_run_task (GY_SERVICE (self), task, search_worker);
+}
+
+static GArray *
+gy_dict_searchable_real_search_finish (GyDictSearchable  *self,
+                                       GAsyncResult      *result,
+                                       GError           **err)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), err);
+}
+
+static void
+gy_dict_searchable_default_init (GyDictSearchableInterface *iface)
+{
+  iface->search_async = gy_dict_searchable_real_search_async;
+  iface->search_finish = gy_dict_searchable_real_search_finish;
+}
+
+/**
+ * gy_dict_searchable_search:
+ * @self: a searchable dictionary service
+ * @query: the text to search for
+ * @flags: #GySearchFlags
+ * @limit: the maximum number of results, or 0 for no limit
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Finds the headwords matching @query. The call may block, so use it
+ * from a worker thread or use gy_dict_searchable_search_async().
+ *
+ * Returns: (transfer full) (element-type guint32) (nullable): the rows
+ * of the model of the service that match, the best match first
+ */
+GArray *
+gy_dict_searchable_search (GyDictSearchable  *self,
+                           const gchar       *query,
+                           GySearchFlags      flags,
+                           guint              limit,
+                           GError           **err)
+{
+  GyDictSearchableInterface *iface;
+
+  g_return_val_if_fail (GY_IS_DICT_SEARCHABLE (self), NULL);
+  g_return_val_if_fail (query != NULL, NULL);
+
+  iface = GY_DICT_SEARCHABLE_GET_IFACE (self);
+
+  g_assert (iface->search != NULL);
+
+  return iface->search (self, query, flags, limit, err);
+}
+
+/**
+ * gy_dict_searchable_search_async:
+ * @self: a searchable dictionary service
+ * @query: the text to search for
+ * @flags: #GySearchFlags
+ * @limit: the maximum number of results, or 0 for no limit
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the search is done
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of gy_dict_searchable_search(). Unless the
+ * service overrides it, the blocking search is run on a worker thread,
+ * the one of the service if it is not %GY_SERVICE_CAPABILITY_THREAD_SAFE.
+ */
+void
+gy_dict_searchable_search_async (GyDictSearchable    *self,
+                                 const gchar         *query,
+                                 GySearchFlags        flags,
+                                 guint                limit,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  GyDictSearchableInterface *iface;
+
+  g_return_if_fail (GY_IS_DICT_SEARCHABLE (self));
+  g_return_if_fail (query != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  iface = GY_DICT_SEARCHABLE_GET_IFACE (self);
+
+  g_assert (iface->search_async != NULL);
+
+  iface->search_async (self, query, flags, limit, cancellable, callback, user_data);
+}
+
+/**
+ * gy_dict_searchable_search_finish:
+ * @self: a searchable dictionary service
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Completes a search started with gy_dict_searchable_search_async().
+ *
+ * Returns: (transfer full) (element-type guint32) (nullable): the rows
+ * that match
+ */
+GArray *
+gy_dict_searchable_search_finish (GyDictSearchable  *self,
+                                  GAsyncResult      *result,
+                                  GError           **err)
+{
+  GyDictSearchableInterface *iface;
+
+  g_return_val_if_fail (GY_IS_DICT_SEARCHABLE (self), NULL);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), NULL);
+
+  iface = GY_DICT_SEARCHABLE_GET_IFACE (self);
+
+  g_assert (iface->search_finish != NULL);
+
+  return iface->search_finish (self, result, err);
+}
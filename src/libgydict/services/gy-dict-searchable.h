@@ -0,0 +1,87 @@
+/* gy-dict-searchable.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "gy-dict-service.h"
+
+G_BEGIN_DECLS
+
+/**
+ * GySearchFlags:
+ * @GY_SEARCH_FLAGS_NONE: match the headwords equal to the query
+ * @GY_SEARCH_FLAGS_PREFIX: match the headwords which begin with the query
+ * @GY_SEARCH_FLAGS_CASE_SENSITIVE: do not fold the case of the query
+ *
+ * Flags modifying a search of a #GyDictSearchable.
+ */
+typedef enum
+{
+  GY_SEARCH_FLAGS_NONE           = 0,
+  GY_SEARCH_FLAGS_PREFIX         = 1 << 0,
+  GY_SEARCH_FLAGS_CASE_SENSITIVE = 1 << 1,
+} GySearchFlags;
+
+#define GY_TYPE_DICT_SEARCHABLE (gy_dict_searchable_get_type ())
+
+G_DECLARE_INTERFACE (GyDictSearchable, gy_dict_searchable, GY, DICT_SEARCHABLE, GyDictService)
+
+struct _GyDictSearchableInterface
+{
+  GTypeInterface parent;
+
+  GArray* (*search) (GyDictSearchable  *self,
+                     const gchar       *query,
+                     GySearchFlags      flags,
+                     guint              limit,
+                     GError           **err);
+
+  void (*search_async) (GyDictSearchable    *self,
+                        const gchar         *query,
+                        GySearchFlags        flags,
+                        guint                limit,
+                        GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data);
+
+  GArray* (*search_finish) (GyDictSearchable  *self,
+                            GAsyncResult      *result,
+                            GError           **err);
+};
+
+GArray* gy_dict_searchable_search (GyDictSearchable  *self,
+                                   const gchar       *query,
+                                   GySearchFlags      flags,
+                                   guint              limit,
+                                   GError           **err);
+
+void gy_dict_searchable_search_async (GyDictSearchable    *self,
+                                      const gchar         *query,
+                                      GySearchFlags        flags,
+                                      guint                limit,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data);
+
+GArray* gy_dict_searchable_search_finish (GyDictSearchable  *self,
+                                          GAsyncResult      *result,
+                                          GError           **err);
+
+G_END_DECLS
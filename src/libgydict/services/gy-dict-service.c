@@ -19,13 +19,214 @@
  */
 
 #include "gy-dict-service.h"
+#include "gy-service-private.h"
 
 G_DEFINE_INTERFACE (GyDictService, gy_dict_service, GY_TYPE_SERVICE)
 
+/*
+ * Runs @task_func on a worker thread, the one of the service if it is
+ * not thread safe; the callback of @task is invoked from the main loop
+ * either way.
+ */
+static void
+run_task (GyDictService   *self,
+          GTask           *task,
+          GTaskThreadFunc  task_func)
+{
+  _gy_service_run_task (GY_SERVICE (self), task, task_func);
+}
+
+static void
+get_model_worker (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+  GyDictService *self = source_object;
+  GtkTreeModel *model;
+  GError *error = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  model = gy_dict_service_get_model (self, &error);
+
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, model ? g_object_ref (model) : NULL, g_object_unref);
+}
+
+static void
+gy_dict_service_real_get_model_async (GyDictService       *self,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gy_dict_service_real_get_model_async);
+  g_task_set_return_on_cancel (task, TRUE);
+  run_task (self, task, get_model_worker);
+}
+
+static GtkTreeModel *
+gy_dict_service_real_get_model_finish (GyDictService  *self,
+                                       GAsyncResult   *result,
+                                       GError        **err)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), err);
+}
+
+static void
+get_lexical_unit_worker (GTask        *task,
+                         gpointer      source_object,
+                         gpointer      task_data,
+                         GCancellable *cancellable)
+{
+  GyDictService *self = source_object;
+  guint idx = GPOINTER_TO_UINT (task_data);
+  gchar *lexical_unit;
+  GError *error = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  lexical_unit = gy_dict_service_get_lexical_unit (self, idx, &error);
+
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, lexical_unit, g_free);
+}
+
+static void
+gy_dict_service_real_get_lexical_unit_async (GyDictService       *self,
+                                             guint                idx,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gy_dict_service_real_get_lexical_unit_async);
+  g_task_set_task_data (task, GUINT_TO_POINTER (idx), NULL);
+  g_task_set_return_on_cancel (task, TRUE);
+  run_task (self, task, get_lexical_unit_worker);
+}
+
+static gchar *
+gy_dict_service_real_get_lexical_unit_finish (GyDictService  *self,
+                                              GAsyncResult   *result,
+                                              GError        **err)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), err);
+}
+
+static GPtrArray *
+gy_dict_service_real_get_lexical_units (GyDictService  *self,
+                                        const guint    *indices,
+                                        guint           n_indices,
+                                        GError        **err)
+{
+  g_autoptr(GPtrArray) lexical_units = NULL;
+
+  lexical_units = g_ptr_array_new_full (n_indices, g_free);
+
+  for (guint i = 0; i < n_indices; i++)
+    {
+      GError *error = NULL;
+      gchar *lexical_unit = gy_dict_service_get_lexical_unit (self, indices[i], &error);
+
+      if (error != NULL)
+        {
+          g_propagate_error (err, error);
+          return NULL;
+        }
+
+      g_ptr_array_add (lexical_units, lexical_unit);
+    }
+
+  return g_steal_pointer (&lexical_units);
+}
+
+/*
+ * Finds the file of the dictionary through a "file" property holding
+ * a #GFile, or a "filename" or "path" property holding its name.
+ */
+static GFile *
+get_dictionary_file (GyDictService *self)
+{
+  static const gchar * const names[] = { "file", "filename", "path" };
+  GObjectClass *klass = G_OBJECT_GET_CLASS (self);
+
+  for (guint i = 0; i < G_N_ELEMENTS (names); i++)
+    {
+      GParamSpec *pspec = g_object_class_find_property (klass, names[i]);
+      g_autofree gchar *filename = NULL;
+      GFile *file = NULL;
+
+      if (pspec == NULL || !(pspec->flags & G_PARAM_READABLE))
+        continue;
+
+      if (G_IS_PARAM_SPEC_OBJECT (pspec) && g_type_is_a (pspec->value_type, G_TYPE_FILE))
+        g_object_get (self, names[i], &file, NULL);
+      else if (G_IS_PARAM_SPEC_STRING (pspec))
+        {
+          g_object_get (self, names[i], &filename, NULL);
+          if (filename != NULL && *filename != '\0')
+            file = g_file_new_for_path (filename);
+        }
+
+      if (file != NULL)
+        return file;
+    }
+
+  return NULL;
+}
+
+static gchar *
+gy_dict_service_real_get_fingerprint (GyDictService *self)
+{
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFileInfo) info = NULL;
+  g_autofree gchar *path = NULL;
+
+  if ((file = get_dictionary_file (self)) == NULL)
+    return NULL;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  if (info == NULL)
+    return NULL;
+
+  path = g_file_get_path (file);
+
+  return g_strdup_printf ("%s:%" G_GOFFSET_FORMAT ":%" G_GUINT64_FORMAT ".%06u",
+                          path != NULL ? path : "",
+                          g_file_info_get_size (info),
+                          g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                          g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC));
+}
 
 static void
 gy_dict_service_default_init (GyDictServiceInterface *iface)
 {
+  iface->get_model_async = gy_dict_service_real_get_model_async;
+  iface->get_model_finish = gy_dict_service_real_get_model_finish;
+  iface->get_lexical_unit_async = gy_dict_service_real_get_lexical_unit_async;
+  iface->get_lexical_unit_finish = gy_dict_service_real_get_lexical_unit_finish;
+  iface->get_lexical_units = gy_dict_service_real_get_lexical_units;
+  iface->get_fingerprint = gy_dict_service_real_get_fingerprint;
 }
 
 /**
@@ -86,3 +287,229 @@ gy_dict_service_get_formatter (GyDictService *self)
   return iface->get_formatter (self);
 
 }
+
+/**
+ * gy_dict_service_get_model_async:
+ * @self: a dictionary service
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the model is ready
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronously gets the model of the service. Unless the service
+ * overrides it, the blocking gy_dict_service_get_model() is run on a
+ * worker thread, the one of the service if it is not
+ * %GY_SERVICE_CAPABILITY_THREAD_SAFE.
+ */
+void
+gy_dict_service_get_model_async (GyDictService       *self,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  GyDictServiceInterface *iface;
+
+  g_return_if_fail (GY_IS_DICT_SERVICE (self));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  iface = GY_DICT_SERVICE_GET_IFACE (self);
+
+  g_assert (iface->get_model_async != NULL);
+
+  iface->get_model_async (self, cancellable, callback, user_data);
+}
+
+/**
+ * gy_dict_service_get_model_finish:
+ * @self: a dictionary service
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Completes a request started with gy_dict_service_get_model_async().
+ *
+ * Returns: (transfer full) (nullable): Returns #GtkTreeModel
+ */
+GtkTreeModel *
+gy_dict_service_get_model_finish (GyDictService  *self,
+                                  GAsyncResult   *result,
+                                  GError        **err)
+{
+  GyDictServiceInterface *iface;
+
+  g_return_val_if_fail (GY_IS_DICT_SERVICE (self), NULL);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), NULL);
+
+  iface = GY_DICT_SERVICE_GET_IFACE (self);
+
+  g_assert (iface->get_model_finish != NULL);
+
+  return iface->get_model_finish (self, result, err);
+}
+
+/**
+ * gy_dict_service_get_lexical_unit_async:
+ * @self: a dictionary service
+ * @idx: index of the lexical unit
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the lexical unit is ready
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronously gets the lexical unit at @idx. Unless the service
+ * overrides it, the blocking gy_dict_service_get_lexical_unit() is run
+ * on a worker thread, the one of the service if it is not
+ * %GY_SERVICE_CAPABILITY_THREAD_SAFE. Cancelling @cancellable completes
+ * the request with %G_IO_ERROR_CANCELLED, immediately for a thread safe
+ * service and otherwise once the worker of the service gets to it.
+ */
+void
+gy_dict_service_get_lexical_unit_async (GyDictService       *self,
+                                        guint                idx,
+                                        GCancellable        *cancellable,
+                                        GAsyncReadyCallback  callback,
+                                        gpointer             user_data)
+{
+  GyDictServiceInterface *iface;
+
+  g_return_if_fail (GY_IS_DICT_SERVICE (self));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  iface = GY_DICT_SERVICE_GET_IFACE (self);
+
+  g_assert (iface->get_lexical_unit_async != NULL);
+
+  iface->get_lexical_unit_async (self, idx, cancellable, callback, user_data);
+}
+
+/**
+ * gy_dict_service_get_lexical_unit_finish:
+ * @self: a dictionary service
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Completes a request started with gy_dict_service_get_lexical_unit_async().
+ *
+ * Returns: (transfer full) (nullable): the lexical unit
+ */
+gchar *
+gy_dict_service_get_lexical_unit_finish (GyDictService  *self,
+                                         GAsyncResult   *result,
+                                         GError        **err)
+{
+  GyDictServiceInterface *iface;
+
+  g_return_val_if_fail (GY_IS_DICT_SERVICE (self), NULL);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), NULL);
+
+  iface = GY_DICT_SERVICE_GET_IFACE (self);
+
+  g_assert (iface->get_lexical_unit_finish != NULL);
+
+  return iface->get_lexical_unit_finish (self, result, err);
+}
+
+/**
+ * gy_dict_service_get_lexical_units:
+ * @self: a dictionary service
+ * @indices: (array length=n_indices): indices of the lexical units
+ * @n_indices: the number of indices
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Gets many lexical units in one call. A service can override it to
+ * read the entries in the order of their offsets and to share the I/O
+ * and decompression between them; otherwise
+ * gy_dict_service_get_lexical_unit() is called for each index. Like
+ * the latter, it may block.
+ *
+ * Returns: (transfer full) (element-type utf8) (nullable): an array
+ * whose n-th element is the lexical unit at the n-th index, or %NULL
+ * on error
+ */
+GPtrArray *
+gy_dict_service_get_lexical_units (GyDictService  *self,
+                                   const guint    *indices,
+                                   guint           n_indices,
+                                   GError        **err)
+{
+  GyDictServiceInterface *iface;
+  GPtrArray *lexical_units;
+
+  g_return_val_if_fail (GY_IS_DICT_SERVICE (self), NULL);
+  g_return_val_if_fail (indices != NULL || n_indices == 0, NULL);
+
+  iface = GY_DICT_SERVICE_GET_IFACE (self);
+
+  g_assert (iface->get_lexical_units != NULL);
+
+  lexical_units = iface->get_lexical_units (self, indices, n_indices, err);
+
+  g_return_val_if_fail (lexical_units == NULL || lexical_units->len == n_indices, lexical_units);
+
+  return lexical_units;
+}
+
+/**
+ * gy_dict_service_get_fingerprint:
+ * @self: a dictionary service
+ *
+ * Gets a string which changes whenever the dictionary behind the
+ * service changes, e.g. its size and modification time, or a checksum.
+ * Data derived from the dictionary, like a full-text index, is cached
+ * on disk under it.
+ *
+ * By default it is built from the path, the size and the modification
+ * time of the file named by a "file" (#GFile), "filename" or "path"
+ * property of the service. A service without such a property, or whose
+ * dictionary is not a single file, should implement it; otherwise it
+ * returns %NULL and nothing is cached for the service.
+ *
+ * Returns: (transfer full) (nullable): the fingerprint, or %NULL
+ */
+gchar *
+gy_dict_service_get_fingerprint (GyDictService *self)
+{
+  GyDictServiceInterface *iface;
+
+  g_return_val_if_fail (GY_IS_DICT_SERVICE (self), NULL);
+
+  iface = GY_DICT_SERVICE_GET_IFACE (self);
+
+  g_assert (iface->get_fingerprint != NULL);
+
+  return iface->get_fingerprint (self);
+}
+
+/**
+ * gy_dict_service_get_cache_filename:
+ * @self: a dictionary service
+ * @kind: the kind of the cached data, e.g. "fulltext"
+ *
+ * Builds the name of a file in the user cache directory for data of
+ * @kind derived from the dictionary. The name depends on the id and
+ * the fingerprint of the service, so a changed dictionary gets a new
+ * file rather than stale data.
+ *
+ * Returns: (transfer full) (nullable): the filename, or %NULL if the
+ * service has no fingerprint
+ */
+gchar *
+gy_dict_service_get_cache_filename (GyDictService *self,
+                                    const gchar   *kind)
+{
+  g_autofree gchar *fingerprint = NULL;
+  g_autofree gchar *key = NULL;
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *basename = NULL;
+
+  g_return_val_if_fail (GY_IS_DICT_SERVICE (self), NULL);
+  g_return_val_if_fail (kind != NULL, NULL);
+
+  fingerprint = gy_dict_service_get_fingerprint (self);
+
+  if (fingerprint == NULL)
+    return NULL;
+
+  key = g_strdup_printf ("%s\n%s", gy_service_get_service_id (GY_SERVICE (self)), fingerprint);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+  basename = g_strconcat (checksum, ".idx", NULL);
+
+  return g_build_filename (g_get_user_cache_dir (), "gydict", kind, basename, NULL);
+}
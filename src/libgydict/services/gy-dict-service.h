@@ -43,6 +43,31 @@ struct _GyDictServiceInterface
 
   GyDictFormatter* (*get_formatter) (GyDictService *self);
 
+  void (*get_model_async) (GyDictService       *self,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data);
+
+  GtkTreeModel *(*get_model_finish) (GyDictService  *self,
+                                     GAsyncResult   *result,
+                                     GError        **err);
+
+  void (*get_lexical_unit_async) (GyDictService       *self,
+                                  guint                idx,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data);
+
+  gchar* (*get_lexical_unit_finish) (GyDictService  *self,
+                                     GAsyncResult   *result,
+                                     GError        **err);
+
+  GPtrArray* (*get_lexical_units) (GyDictService  *self,
+                                   const guint    *indices,
+                                   guint           n_indices,
+                                   GError        **err);
+
+  gchar* (*get_fingerprint) (GyDictService *self);
 };
 
 GtkTreeModel* gy_dict_service_get_model (GyDictService  *self,
@@ -54,5 +79,33 @@ gchar* gy_dict_service_get_lexical_unit (GyDictService  *self,
 
 GyDictFormatter *gy_dict_service_get_formatter (GyDictService *self);
 
+void gy_dict_service_get_model_async (GyDictService       *self,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data);
+
+GtkTreeModel* gy_dict_service_get_model_finish (GyDictService  *self,
+                                                GAsyncResult   *result,
+                                                GError        **err);
+
+void gy_dict_service_get_lexical_unit_async (GyDictService       *self,
+                                             guint                idx,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             user_data);
+
+gchar* gy_dict_service_get_lexical_unit_finish (GyDictService  *self,
+                                                GAsyncResult   *result,
+                                                GError        **err);
+
+GPtrArray* gy_dict_service_get_lexical_units (GyDictService  *self,
+                                              const guint    *indices,
+                                              guint           n_indices,
+                                              GError        **err);
+
+gchar* gy_dict_service_get_fingerprint (GyDictService *self);
+
+gchar* gy_dict_service_get_cache_filename (GyDictService *self,
+                                           const gchar   *kind);
 
 G_END_DECLS
@@ -0,0 +1,1152 @@
+/* gy-fulltext-index.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <errno.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+#include "gy-fulltext-index.h"
+#include "gy-service-private.h"
+#include "gy-varint.h"
+#include "helpers/gy-utility-func.h"
+
+/*
+ * An inverted index of the words in the formatted text of every entry.
+ *
+ * The words are cut at every character which is neither a letter nor
+ * a digit and folded with gy_utility_fold_search_key(). Each term has
+ * a posting list of the entries it occurs in, with its positions in
+ * each of them. Both are delta coded as base-128 varints:
+ *
+ *   n_entries
+ *   for every entry: entry delta, n_positions, size of positions, positions
+ *
+ * The size of the positions lets an intersection step over an entry
+ * without decoding them. The layout of the index, with every section
+ * at a multiple of eight bytes so it can be used straight from a
+ * mapped file, is:
+ *
+ *   header
+ *   terms          NUL-terminated terms in bytewise order
+ *   term index     guint32[n_terms], offsets into terms
+ *   postings       the posting lists of the terms, in the same order
+ *   posting index  guint64[n_terms + 1], offsets into postings
+ *
+ * The reverse lookup of a bilingual dictionary is an index of the same
+ * layout over only the spans marked with %GY_TEXT_ATTR_TRANSLATION.
+ */
+#define INDEX_MAGIC      "GYFTX\0\0\0"
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_ALIGN      8
+
+/* The entries read from the service at once while the index is built. */
+#define BUILD_BATCH 128
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 n_entries;
+  guint32 n_terms;
+  guint64 terms_offset;
+  guint64 terms_size;
+  guint64 term_index_offset;
+  guint64 postings_offset;
+  guint64 postings_size;
+  guint64 posting_index_offset;
+} IndexHeader;
+
+struct _GyFulltextIndex
+{
+  GObject parent_instance;
+
+  GBytes        *bytes;
+  const gchar   *terms;
+  gsize          terms_size;
+  const guint32 *term_index;
+  const guint8  *postings;
+  gsize          postings_size;
+  const guint64 *posting_index;
+  guint          n_terms;
+  guint          n_entries;
+};
+
+G_DEFINE_TYPE (GyFulltextIndex, gy_fulltext_index, G_TYPE_OBJECT)
+
+G_DEFINE_QUARK (gy-fulltext-index-error-quark, gy_fulltext_index_error)
+
+static void
+gy_fulltext_index_finalize (GObject *object)
+{
+  GyFulltextIndex *self = (GyFulltextIndex *)object;
+
+  g_clear_pointer (&self->bytes, g_bytes_unref);
+
+  G_OBJECT_CLASS (gy_fulltext_index_parent_class)->finalize (object);
+}
+
+static void
+gy_fulltext_index_class_init (GyFulltextIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gy_fulltext_index_finalize;
+}
+
+static void
+gy_fulltext_index_init (GyFulltextIndex *self)
+{
+}
+
+/* Tokenizing */
+
+typedef void (*TokenFunc) (gchar    *term,
+                           guint     position,
+                           gpointer  user_data);
+
+/* Calls @func with every folded word of @text, in order; @func takes the term. */
+static void
+tokenize (const gchar *text,
+          TokenFunc    func,
+          gpointer     user_data)
+{
+  const gchar *start = NULL;
+  const gchar *p = text;
+  guint position = 0;
+
+  for (;;)
+    {
+      gunichar c = *p != '\0' ? g_utf8_get_char_validated (p, -1) : 0;
+      gboolean word = c != 0 && c < (gunichar) -2 && g_unichar_isalnum (c);
+
+      if (word && start == NULL)
+        start = p;
+
+      if (!word && start != NULL)
+        {
+          gchar *term = gy_utility_fold_search_key (start, p - start);
+
+          if (term != NULL)
+            func (term, position++, user_data);
+
+          start = NULL;
+        }
+
+      if (*p == '\0')
+        break;
+
+      /* An invalid byte is skipped on its own. */
+      p = c < (gunichar) -2 ? g_utf8_next_char (p) : p + 1;
+    }
+}
+
+/* Building */
+
+typedef struct
+{
+  gchar      *term;
+  GByteArray *postings;
+  guint32     n_entries;
+  guint32     last_entry;
+  GArray     *positions;
+} TermPostings;
+
+struct _GyFulltextIndexBuilder
+{
+  GHashTable *terms;
+  GPtrArray  *pending;
+  GByteArray *scratch;
+  guint32     n_entries;
+};
+
+static void
+term_postings_free (gpointer data)
+{
+  TermPostings *postings = data;
+
+  g_free (postings->term);
+  g_byte_array_unref (postings->postings);
+  g_array_unref (postings->positions);
+  g_slice_free (TermPostings, postings);
+}
+
+/**
+ * gy_fulltext_index_builder_new:
+ *
+ * Creates a builder which collects the text of the entries in memory
+ * until gy_fulltext_index_builder_end() compiles it into an index.
+ *
+ * Returns: (transfer full): a new #GyFulltextIndexBuilder
+ */
+GyFulltextIndexBuilder *
+gy_fulltext_index_builder_new (void)
+{
+  GyFulltextIndexBuilder *builder = g_slice_new0 (GyFulltextIndexBuilder);
+
+  builder->terms = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, term_postings_free);
+  builder->pending = g_ptr_array_new ();
+  builder->scratch = g_byte_array_new ();
+
+  return builder;
+}
+
+void
+gy_fulltext_index_builder_free (GyFulltextIndexBuilder *builder)
+{
+  if (builder == NULL)
+    return;
+
+  g_hash_table_unref (builder->terms);
+  g_ptr_array_unref (builder->pending);
+  g_byte_array_unref (builder->scratch);
+  g_slice_free (GyFulltextIndexBuilder, builder);
+}
+
+static void
+builder_add_token (gchar    *term,
+                   guint     position,
+                   gpointer  user_data)
+{
+  GyFulltextIndexBuilder *builder = user_data;
+  TermPostings *postings;
+
+  postings = g_hash_table_lookup (builder->terms, term);
+
+  if (postings == NULL)
+    {
+      postings = g_slice_new0 (TermPostings);
+      postings->term = term;
+      postings->postings = g_byte_array_new ();
+      postings->positions = g_array_new (FALSE, FALSE, sizeof (guint32));
+      g_hash_table_insert (builder->terms, term, postings);
+    }
+  else
+    {
+      g_free (term);
+    }
+
+  if (postings->positions->len == 0)
+    g_ptr_array_add (builder->pending, postings);
+
+  g_array_append_val (postings->positions, position);
+}
+
+/**
+ * gy_fulltext_index_builder_add:
+ * @builder: a #GyFulltextIndexBuilder
+ * @entry: the row of the entry, greater than that of the previous call
+ * @text: the plain text of the entry
+ *
+ * Adds the words of @text to the posting lists, at @entry.
+ */
+void
+gy_fulltext_index_builder_add (GyFulltextIndexBuilder *builder,
+                               guint                   entry,
+                               const gchar            *text)
+{
+  g_return_if_fail (builder != NULL);
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (entry >= builder->n_entries);
+
+  tokenize (text, builder_add_token, builder);
+
+  for (guint i = 0; i < builder->pending->len; i++)
+    {
+      TermPostings *postings = g_ptr_array_index (builder->pending, i);
+      guint32 last_position = 0;
+
+      g_byte_array_set_size (builder->scratch, 0);
+
+      for (guint j = 0; j < postings->positions->len; j++)
+        {
+          guint32 position = g_array_index (postings->positions, guint32, j);
+
+          gy_varint_write (builder->scratch, position - last_position);
+          last_position = position;
+        }
+
+      gy_varint_write (postings->postings, entry - postings->last_entry);
+      gy_varint_write (postings->postings, postings->positions->len);
+      gy_varint_write (postings->postings, builder->scratch->len);
+      g_byte_array_append (postings->postings, builder->scratch->data, builder->scratch->len);
+
+      postings->last_entry = entry;
+      postings->n_entries++;
+      g_array_set_size (postings->positions, 0);
+    }
+
+  g_ptr_array_set_size (builder->pending, 0);
+  builder->n_entries = entry + 1;
+}
+
+static gint
+compare_terms (gconstpointer a,
+               gconstpointer b)
+{
+  const TermPostings *p1 = *(TermPostings * const *) a;
+  const TermPostings *p2 = *(TermPostings * const *) b;
+
+  return strcmp (p1->term, p2->term);
+}
+
+static void
+align_section (GByteArray *data)
+{
+  static const guint8 padding[INDEX_ALIGN] = { 0 };
+
+  if (data->len % INDEX_ALIGN != 0)
+    g_byte_array_append (data, padding, INDEX_ALIGN - data->len % INDEX_ALIGN);
+}
+
+/**
+ * gy_fulltext_index_builder_end:
+ * @builder: (transfer full): a #GyFulltextIndexBuilder
+ *
+ * Compiles the collected posting lists into an index and frees @builder.
+ *
+ * Returns: (transfer full): the index, for gy_fulltext_index_new_from_bytes()
+ */
+GBytes *
+gy_fulltext_index_builder_end (GyFulltextIndexBuilder *builder)
+{
+  g_autoptr(GByteArray) data = NULL;
+  g_autoptr(GPtrArray) terms = NULL;
+  g_autofree guint32 *offsets = NULL;
+  g_autofree guint64 *posting_offsets = NULL;
+  IndexHeader header = { 0 };
+  GHashTableIter iter;
+  gpointer value;
+
+  g_return_val_if_fail (builder != NULL, NULL);
+
+  terms = g_ptr_array_sized_new (g_hash_table_size (builder->terms));
+  g_hash_table_iter_init (&iter, builder->terms);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_ptr_array_add (terms, value);
+
+  g_ptr_array_sort (terms, compare_terms);
+
+  data = g_byte_array_new ();
+  offsets = g_new (guint32, MAX (terms->len, 1));
+  posting_offsets = g_new (guint64, terms->len + 1);
+  g_byte_array_append (data, (const guint8 *) &header, sizeof (IndexHeader));
+
+  memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+  header.version = GY_FULLTEXT_INDEX_VERSION;
+  header.byte_order = INDEX_BYTE_ORDER;
+  header.n_entries = builder->n_entries;
+  header.n_terms = terms->len;
+
+  header.terms_offset = data->len;
+  for (guint i = 0; i < terms->len; i++)
+    {
+      const TermPostings *postings = g_ptr_array_index (terms, i);
+
+      offsets[i] = data->len - header.terms_offset;
+      g_byte_array_append (data, (const guint8 *) postings->term, strlen (postings->term) + 1);
+    }
+  g_byte_array_append (data, (const guint8 *) "", 1);
+  header.terms_size = data->len - header.terms_offset;
+  align_section (data);
+
+  header.term_index_offset = data->len;
+  g_byte_array_append (data, (const guint8 *) offsets, terms->len * sizeof (guint32));
+  align_section (data);
+
+  header.postings_offset = data->len;
+  for (guint i = 0; i < terms->len; i++)
+    {
+      const TermPostings *postings = g_ptr_array_index (terms, i);
+
+      posting_offsets[i] = data->len - header.postings_offset;
+      gy_varint_write (data, postings->n_entries);
+      g_byte_array_append (data, postings->postings->data, postings->postings->len);
+    }
+  posting_offsets[terms->len] = data->len - header.postings_offset;
+  header.postings_size = data->len - header.postings_offset;
+  align_section (data);
+
+  header.posting_index_offset = data->len;
+  g_byte_array_append (data, (const guint8 *) posting_offsets, (terms->len + 1) * sizeof (guint64));
+
+  memcpy (data->data, &header, sizeof (IndexHeader));
+
+  gy_fulltext_index_builder_free (builder);
+
+  return g_byte_array_free_to_bytes (g_steal_pointer (&data));
+}
+
+/* Loading */
+
+static gboolean
+check_section (gsize    size,
+               guint64  offset,
+               guint64  length,
+               GError **err)
+{
+  if (offset % INDEX_ALIGN != 0 || offset > size || length > size - offset)
+    {
+      g_set_error (err, GY_FULLTEXT_INDEX_ERROR, GY_FULLTEXT_INDEX_ERROR_INVALID,
+                   "A section of the full-text index is out of bounds.");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * gy_fulltext_index_new_from_bytes:
+ * @bytes: an index made by gy_fulltext_index_builder_end()
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Wraps an index without copying it.
+ *
+ * Returns: (transfer full) (nullable): a new #GyFulltextIndex, or %NULL on error
+ */
+GyFulltextIndex *
+gy_fulltext_index_new_from_bytes (GBytes  *bytes,
+                                  GError **err)
+{
+  GyFulltextIndex *self;
+  const IndexHeader *header;
+  const gchar *contents;
+  gsize size;
+
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  contents = g_bytes_get_data (bytes, &size);
+
+  if (size < sizeof (IndexHeader) || memcmp (contents, INDEX_MAGIC, 8) != 0)
+    {
+      g_set_error (err, GY_FULLTEXT_INDEX_ERROR, GY_FULLTEXT_INDEX_ERROR_INVALID,
+                   "The data is not a full-text index.");
+      return NULL;
+    }
+
+  header = (const IndexHeader *) contents;
+
+  if (header->byte_order != INDEX_BYTE_ORDER)
+    {
+      g_set_error (err, GY_FULLTEXT_INDEX_ERROR, GY_FULLTEXT_INDEX_ERROR_BYTE_ORDER,
+                   "The full-text index was written on a host of different byte order.");
+      return NULL;
+    }
+
+  if (header->version != GY_FULLTEXT_INDEX_VERSION)
+    {
+      g_set_error (err, GY_FULLTEXT_INDEX_ERROR, GY_FULLTEXT_INDEX_ERROR_VERSION,
+                   "The full-text index has version %u; version %u is supported.",
+                   header->version, GY_FULLTEXT_INDEX_VERSION);
+      return NULL;
+    }
+
+  if (!check_section (size, header->terms_offset, header->terms_size, err) ||
+      !check_section (size, header->term_index_offset, (guint64) header->n_terms * sizeof (guint32), err) ||
+      !check_section (size, header->postings_offset, header->postings_size, err) ||
+      !check_section (size, header->posting_index_offset, ((guint64) header->n_terms + 1) * sizeof (guint64), err))
+    return NULL;
+
+  if (header->terms_size == 0 || contents[header->terms_offset + header->terms_size - 1] != '\0')
+    {
+      g_set_error (err, GY_FULLTEXT_INDEX_ERROR, GY_FULLTEXT_INDEX_ERROR_INVALID,
+                   "The terms of the full-text index are not terminated.");
+      return NULL;
+    }
+
+  self = g_object_new (GY_TYPE_FULLTEXT_INDEX, NULL);
+  self->bytes = g_bytes_ref (bytes);
+  self->terms = contents + header->terms_offset;
+  self->terms_size = header->terms_size;
+  self->term_index = (const guint32 *) (contents + header->term_index_offset);
+  self->postings = (const guint8 *) contents + header->postings_offset;
+  self->postings_size = header->postings_size;
+  self->posting_index = (const guint64 *) (contents + header->posting_index_offset);
+  self->n_terms = header->n_terms;
+  self->n_entries = header->n_entries;
+
+  return self;
+}
+
+/**
+ * gy_fulltext_index_new:
+ * @filename: the index file
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Maps an index saved with gy_fulltext_index_save() into memory.
+ *
+ * Returns: (transfer full) (nullable): a new #GyFulltextIndex, or %NULL on error
+ */
+GyFulltextIndex *
+gy_fulltext_index_new (const gchar  *filename,
+                       GError      **err)
+{
+  g_autoptr(GMappedFile) file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  file = g_mapped_file_new (filename, FALSE, err);
+
+  if (file == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+
+  return gy_fulltext_index_new_from_bytes (bytes, err);
+}
+
+/**
+ * gy_fulltext_index_save:
+ * @self: a #GyFulltextIndex
+ * @filename: the file to write the index to
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gy_fulltext_index_save (GyFulltextIndex  *self,
+                        const gchar      *filename,
+                        GError          **err)
+{
+  gconstpointer data;
+  gsize size;
+
+  g_return_val_if_fail (GY_IS_FULLTEXT_INDEX (self), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  data = g_bytes_get_data (self->bytes, &size);
+
+  return g_file_set_contents (filename, data, size, err);
+}
+
+/**
+ * gy_fulltext_index_get_n_terms:
+ * @self: a #GyFulltextIndex
+ *
+ * Returns: the number of distinct terms in the index
+ */
+guint
+gy_fulltext_index_get_n_terms (GyFulltextIndex *self)
+{
+  g_return_val_if_fail (GY_IS_FULLTEXT_INDEX (self), 0);
+
+  return self->n_terms;
+}
+
+/* Querying */
+
+typedef struct
+{
+  const guint8 *p;
+  const guint8 *end;
+  guint64       remaining;
+  guint64       entry;
+  guint64       n_positions;
+  const guint8 *positions;
+  const guint8 *positions_end;
+} Cursor;
+
+static const gchar *
+term_at (GyFulltextIndex *self,
+         guint            idx)
+{
+  guint32 offset = self->term_index[idx];
+
+  return offset < self->terms_size ? self->terms + offset : "";
+}
+
+/* Moves to the next entry of the posting list. */
+static gboolean
+cursor_next (Cursor *cursor)
+{
+  guint64 delta, size;
+  const guint8 *p = cursor->p;
+
+  if (cursor->remaining == 0 ||
+      (p = gy_varint_read (p, cursor->end, &delta)) == NULL ||
+      (p = gy_varint_read (p, cursor->end, &cursor->n_positions)) == NULL ||
+      (p = gy_varint_read (p, cursor->end, &size)) == NULL ||
+      size > (guint64) (cursor->end - p))
+    {
+      cursor->remaining = 0;
+      return FALSE;
+    }
+
+  cursor->entry += delta;
+  cursor->positions = p;
+  cursor->positions_end = p + size;
+  cursor->p = p + size;
+  cursor->remaining--;
+
+  return TRUE;
+}
+
+/* Positions the cursor on the first entry of @term, by bisecting the terms. */
+static gboolean
+cursor_init (GyFulltextIndex *self,
+             const gchar     *term,
+             Cursor          *cursor)
+{
+  guint lo = 0;
+  guint hi = self->n_terms;
+  guint64 begin, end;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (strcmp (term_at (self, mid), term) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo == self->n_terms || strcmp (term_at (self, lo), term) != 0)
+    return FALSE;
+
+  begin = self->posting_index[lo];
+  end = self->posting_index[lo + 1];
+
+  if (begin > end || end > self->postings_size)
+    return FALSE;
+
+  cursor->end = self->postings + end;
+  cursor->p = gy_varint_read (self->postings + begin, cursor->end, &cursor->remaining);
+  cursor->entry = 0;
+
+  if (cursor->p == NULL)
+    return FALSE;
+
+  return cursor_next (cursor);
+}
+
+static gboolean
+cursor_seek (Cursor  *cursor,
+             guint64  entry)
+{
+  while (cursor->entry < entry)
+    if (!cursor_next (cursor))
+      return FALSE;
+
+  return TRUE;
+}
+
+static GArray *
+cursor_get_positions (Cursor *cursor)
+{
+  GArray *positions = g_array_new (FALSE, FALSE, sizeof (guint64));
+  const guint8 *p = cursor->positions;
+  guint64 position = 0;
+
+  for (guint64 i = 0; i < cursor->n_positions; i++)
+    {
+      guint64 delta;
+
+      if ((p = gy_varint_read (p, cursor->positions_end, &delta)) == NULL)
+        break;
+
+      position += delta;
+      g_array_append_val (positions, position);
+    }
+
+  return positions;
+}
+
+static gboolean
+has_position (GArray  *positions,
+              guint64  position)
+{
+  guint lo = 0;
+  guint hi = positions->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (g_array_index (positions, guint64, mid) < position)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo < positions->len && g_array_index (positions, guint64, lo) == position;
+}
+
+/* Whether the @n_cursors terms at @cursors occur one after another in the current entry. */
+static gboolean
+match_phrase (Cursor *cursors,
+              guint   n_cursors)
+{
+  g_autoptr(GPtrArray) positions = NULL;
+  GArray *first;
+
+  positions = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+
+  for (guint i = 0; i < n_cursors; i++)
+    g_ptr_array_add (positions, cursor_get_positions (&cursors[i]));
+
+  first = g_ptr_array_index (positions, 0);
+
+  for (guint i = 0; i < first->len; i++)
+    {
+      guint64 start = g_array_index (first, guint64, i);
+      guint j;
+
+      for (j = 1; j < n_cursors; j++)
+        if (!has_position (g_ptr_array_index (positions, j), start + j))
+          break;
+
+      if (j == n_cursors)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+typedef struct
+{
+  GPtrArray *terms;
+  GArray    *groups;
+} Query;
+
+static void
+query_add_token (gchar    *term,
+                 guint     position,
+                 gpointer  user_data)
+{
+  g_ptr_array_add (user_data, term);
+}
+
+/*
+ * Splits @text into its terms and records the terms of every phrase,
+ * given in quotes, or single word as a group: the number of terms in it.
+ */
+static void
+parse_query (const gchar *text,
+             Query       *query)
+{
+  g_auto(GStrv) parts = g_strsplit (text, "\"", -1);
+
+  query->terms = g_ptr_array_new_with_free_func (g_free);
+  query->groups = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = 0; parts[i] != NULL; i++)
+    {
+      guint before = query->terms->len;
+      guint n;
+
+      tokenize (parts[i], query_add_token, query->terms);
+      n = query->terms->len - before;
+
+      if (i % 2 == 1 && n > 0)
+        {
+          g_array_append_val (query->groups, n);
+        }
+      else
+        {
+          guint one = 1;
+
+          for (guint j = 0; j < n; j++)
+            g_array_append_val (query->groups, one);
+        }
+    }
+}
+
+/**
+ * gy_fulltext_index_query:
+ * @self: a #GyFulltextIndex
+ * @query: words, and phrases in double quotes
+ * @limit: the greatest number of rows to return
+ *
+ * Finds the entries which contain every word and every phrase of
+ * @query. The posting lists are intersected by stepping each of them
+ * up to the greatest entry of the others; the positions are decoded
+ * only for the entries in which all terms of a phrase occur.
+ *
+ * Returns: (transfer full) (element-type guint32): the rows of the entries, in order
+ */
+GArray *
+gy_fulltext_index_query (GyFulltextIndex *self,
+                         const gchar     *query,
+                         guint            limit)
+{
+  g_autofree Cursor *cursors = NULL;
+  Query parsed;
+  GArray *rows;
+  guint64 target = 0;
+  guint n;
+
+  g_return_val_if_fail (GY_IS_FULLTEXT_INDEX (self), NULL);
+  g_return_val_if_fail (query != NULL, NULL);
+
+  rows = g_array_new (FALSE, FALSE, sizeof (guint32));
+  parse_query (query, &parsed);
+  n = parsed.terms->len;
+  cursors = g_new0 (Cursor, MAX (n, 1));
+
+  for (guint i = 0; i < n; i++)
+    {
+      if (!cursor_init (self, g_ptr_array_index (parsed.terms, i), &cursors[i]))
+        goto out;
+
+      target = MAX (target, cursors[i].entry);
+    }
+
+  while (n > 0 && rows->len < limit)
+    {
+      gboolean aligned = TRUE;
+      guint first = 0;
+
+      for (guint i = 0; i < n; i++)
+        {
+          if (!cursor_seek (&cursors[i], target))
+            goto out;
+
+          if (cursors[i].entry > target)
+            {
+              target = cursors[i].entry;
+              aligned = FALSE;
+            }
+        }
+
+      if (!aligned)
+        continue;
+
+      for (guint g = 0; g < parsed.groups->len; g++)
+        {
+          guint length = g_array_index (parsed.groups, guint, g);
+
+          if (length > 1 && !match_phrase (&cursors[first], length))
+            aligned = FALSE;
+
+          first += length;
+        }
+
+      if (aligned && target <= G_MAXUINT32)
+        {
+          guint32 row = target;
+
+          g_array_append_val (rows, row);
+        }
+
+      target++;
+    }
+
+out:
+  g_ptr_array_unref (parsed.terms);
+  g_array_unref (parsed.groups);
+
+  return rows;
+}
+
+/* Loading or building in the background */
+
+/* Joins the spans of @scheme marked as translations, one per line. */
+static gchar *
+get_translations (GyFormatScheme *scheme)
+{
+  const gchar *text = gy_format_scheme_get_lexical_unit (scheme);
+  gsize length = gy_format_scheme_length_lexical_unit (scheme);
+  GString *translations = g_string_new (NULL);
+  GSList *attrs;
+
+  attrs = gy_text_attr_list_get_attributes ((GyTextAttrList *) gy_format_scheme_get_attrs (scheme));
+
+  for (GSList *l = attrs; l != NULL; l = l->next)
+    {
+      GyTextAttribute *attr = l->data;
+      gsize start, end;
+
+      if (gy_text_attribute_get_attr_type (attr) != GY_TEXT_ATTR_TRANSLATION)
+        continue;
+
+      start = MIN (gy_text_attribute_get_start_index (attr), length);
+      end = MIN (gy_text_attribute_get_end_index (attr), length);
+
+      if (start < end)
+        {
+          g_string_append_len (translations, text + start, end - start);
+          g_string_append_c (translations, '\n');
+        }
+    }
+
+  g_slist_free_full (attrs, (GDestroyNotify) gy_text_attribute_unref);
+
+  return g_string_free (translations, FALSE);
+}
+
+typedef struct
+{
+  gboolean                translations;
+  GyFulltextIndexBuilder *builder;
+  GyDictFormatter        *formatter;
+  guint                   n_entries;
+  guint                   start;
+  GPtrArray              *lexical_units; /* of the batch from @start on */
+  GError                 *error;
+} BuildData;
+
+static void
+build_begin (GyService *service,
+             BuildData *data)
+{
+  GtkTreeModel *model = gy_dict_service_get_model (GY_DICT_SERVICE (service), &data->error);
+
+  if (model == NULL)
+    return;
+
+  data->n_entries = gtk_tree_model_iter_n_children (model, NULL);
+  data->formatter = gy_dict_service_get_formatter (GY_DICT_SERVICE (service));
+}
+
+/* Reads the entries from @data->start on; nothing more is done on the worker. */
+static void
+fetch_batch (GyService *service,
+             BuildData *data)
+{
+  guint indices[BUILD_BATCH];
+  guint n = MIN (BUILD_BATCH, data->n_entries - data->start);
+
+  for (guint i = 0; i < n; i++)
+    indices[i] = data->start + i;
+
+  data->lexical_units = gy_dict_service_get_lexical_units (GY_DICT_SERVICE (service),
+                                                           indices, n, &data->error);
+}
+
+/* Formats and indexes the entries read by fetch_batch(), on the build thread. */
+static void
+index_batch (BuildData *data)
+{
+  g_autoptr(GPtrArray) lexical_units = g_steal_pointer (&data->lexical_units);
+
+  if (lexical_units == NULL)
+    return;
+
+  for (guint i = 0; i < lexical_units->len; i++)
+    {
+      const gchar *lexical_unit = g_ptr_array_index (lexical_units, i);
+      GyFormatScheme *scheme;
+
+      if (lexical_unit == NULL)
+        continue;
+
+      /* An entry which cannot be formatted is left out of the index. */
+      scheme = gy_dict_formatter_format (data->formatter, lexical_unit, NULL);
+
+      if (scheme == NULL)
+        continue;
+
+      if (data->translations)
+        {
+          g_autofree gchar *text = get_translations (scheme);
+
+          gy_fulltext_index_builder_add (data->builder, data->start + i, text);
+        }
+      else
+        {
+          gy_fulltext_index_builder_add (data->builder, data->start + i,
+                                         gy_format_scheme_get_lexical_unit (scheme));
+        }
+      gy_format_scheme_unref (scheme);
+    }
+}
+
+/*
+ * The service is called one batch at a time through _gy_service_invoke(),
+ * so the worker of a service which is not thread safe serves the lookups
+ * of the user in between. It only reads the entries there; they are
+ * formatted and tokenized on the build thread.
+ */
+static GyFulltextIndex *
+build_index (GyDictService  *service,
+             gboolean        translations,
+             GCancellable   *cancellable,
+             GError        **err)
+{
+  g_autoptr(GBytes) bytes = NULL;
+  BuildData data = { 0, };
+
+  data.translations = translations;
+  data.builder = gy_fulltext_index_builder_new ();
+
+  _gy_service_invoke (GY_SERVICE (service), (GFunc) build_begin, &data);
+
+  for (data.start = 0; data.error == NULL && data.start < data.n_entries; data.start += BUILD_BATCH)
+    {
+      if (g_cancellable_set_error_if_cancelled (cancellable, &data.error))
+        break;
+
+      _gy_service_invoke (GY_SERVICE (service), (GFunc) fetch_batch, &data);
+      index_batch (&data);
+    }
+
+  g_clear_object (&data.formatter);
+
+  if (data.error != NULL)
+    {
+      g_propagate_error (err, data.error);
+      g_clear_pointer (&data.builder, gy_fulltext_index_builder_free);
+      return NULL;
+    }
+
+  bytes = gy_fulltext_index_builder_end (data.builder);
+
+  return gy_fulltext_index_new_from_bytes (bytes, err);
+}
+
+static gpointer
+load_thread (gpointer data)
+{
+  g_autoptr(GTask) task = data;
+  GyDictService *service = g_task_get_source_object (task);
+  gboolean translations = GPOINTER_TO_INT (g_task_get_task_data (task));
+  g_autofree gchar *path = NULL;
+  GyFulltextIndex *index;
+  GError *error = NULL;
+
+#ifdef __linux__
+  /* On Linux the nice value belongs to the thread, not the process. */
+  setpriority (PRIO_PROCESS, 0, 10);
+#endif
+
+  path = gy_dict_service_get_cache_filename (service, translations ? "reverse" : "fulltext");
+
+  if (path != NULL && (index = gy_fulltext_index_new (path, NULL)) != NULL)
+    {
+      g_task_return_pointer (task, index, g_object_unref);
+      return NULL;
+    }
+
+  index = build_index (service, translations, g_task_get_cancellable (task), &error);
+
+  if (index == NULL)
+    {
+      g_task_return_error (task, error);
+      return NULL;
+    }
+
+  if (path != NULL)
+    {
+      g_autofree gchar *dirname = g_path_get_dirname (path);
+
+      if (g_mkdir_with_parents (dirname, 0700) != 0 ||
+          !gy_fulltext_index_save (index, path, &error))
+        {
+          g_debug ("Failed to save the %s index to %s: %s",
+                   translations ? "reverse" : "full-text",
+                   path, error ? error->message : g_strerror (errno));
+          g_clear_error (&error);
+        }
+    }
+
+  g_task_return_pointer (task, index, g_object_unref);
+
+  return NULL;
+}
+
+static void
+load_index (GyDictService       *service,
+            gboolean             translations,
+            GCancellable        *cancellable,
+            GAsyncReadyCallback  callback,
+            gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  task = g_task_new (service, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gy_fulltext_index_load_async);
+  g_task_set_task_data (task, GINT_TO_POINTER (translations), NULL);
+
+  g_thread_unref (g_thread_new ("gydict-fulltext", load_thread, g_steal_pointer (&task)));
+}
+
+/**
+ * gy_fulltext_index_load_async:
+ * @service: a dictionary service
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the index is ready
+ * @user_data: data to pass to @callback
+ *
+ * Loads the full-text index of @service from the cache, keyed by the
+ * id and the fingerprint of the service. If there is none, every entry
+ * is read, formatted and indexed on a thread of lowered priority, and
+ * the index is saved to the cache for the next session. Services
+ * without a fingerprint are indexed every time. A service which is not
+ * %GY_SERVICE_CAPABILITY_THREAD_SAFE is read on its own worker thread,
+ * one batch of entries at a time.
+ */
+void
+gy_fulltext_index_load_async (GyDictService       *service,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  g_return_if_fail (GY_IS_DICT_SERVICE (service));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  load_index (service, FALSE, cancellable, callback, user_data);
+}
+
+/**
+ * gy_fulltext_index_load_translations_async:
+ * @service: a dictionary service
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the index is ready
+ * @user_data: data to pass to @callback
+ *
+ * Like gy_fulltext_index_load_async(), but only the spans which the
+ * formatter marked with %GY_TEXT_ATTR_TRANSLATION are indexed. A query
+ * of the index finds the entries which translate to the words, which
+ * is the reverse lookup of a bilingual dictionary. Complete it with
+ * gy_fulltext_index_load_finish().
+ */
+void
+gy_fulltext_index_load_translations_async (GyDictService       *service,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data)
+{
+  g_return_if_fail (GY_IS_DICT_SERVICE (service));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  load_index (service, TRUE, cancellable, callback, user_data);
+}
+
+/**
+ * gy_fulltext_index_load_finish:
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Completes a request started with gy_fulltext_index_load_async().
+ *
+ * Returns: (transfer full) (nullable): the index, or %NULL on error
+ */
+GyFulltextIndex *
+gy_fulltext_index_load_finish (GAsyncResult  *result,
+                               GError       **err)
+{
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), err);
+}
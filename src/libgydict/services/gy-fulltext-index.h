@@ -0,0 +1,90 @@
+/* gy-fulltext-index.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#if !defined (GYDICT_INSIDE) && !defined (GYDICT_COMPILATION)
+#error "Only <gydict.h> can be included directly."
+#endif
+
+#include <gtk/gtk.h>
+#include "gy-dict-service.h"
+
+G_BEGIN_DECLS
+
+#define GY_FULLTEXT_INDEX_VERSION 1
+
+#define GY_FULLTEXT_INDEX_ERROR (gy_fulltext_index_error_quark ())
+
+/**
+ * GyFulltextIndexError:
+ * @GY_FULLTEXT_INDEX_ERROR_INVALID: the data is not a full-text index or is damaged
+ * @GY_FULLTEXT_INDEX_ERROR_VERSION: the index was written in an unsupported version
+ * @GY_FULLTEXT_INDEX_ERROR_BYTE_ORDER: the index was written on a host of different byte order
+ *
+ * Errors returned while loading a full-text index.
+ */
+typedef enum
+{
+  GY_FULLTEXT_INDEX_ERROR_INVALID,
+  GY_FULLTEXT_INDEX_ERROR_VERSION,
+  GY_FULLTEXT_INDEX_ERROR_BYTE_ORDER,
+} GyFulltextIndexError;
+
+#define GY_TYPE_FULLTEXT_INDEX (gy_fulltext_index_get_type())
+
+G_DECLARE_FINAL_TYPE (GyFulltextIndex, gy_fulltext_index, GY, FULLTEXT_INDEX, GObject)
+
+typedef struct _GyFulltextIndexBuilder GyFulltextIndexBuilder;
+
+GQuark gy_fulltext_index_error_quark (void);
+
+GyFulltextIndexBuilder *gy_fulltext_index_builder_new  (void);
+void                    gy_fulltext_index_builder_free (GyFulltextIndexBuilder *builder);
+void                    gy_fulltext_index_builder_add  (GyFulltextIndexBuilder *builder,
+                                                        guint                   entry,
+                                                        const gchar            *text);
+GBytes                 *gy_fulltext_index_builder_end  (GyFulltextIndexBuilder *builder);
+
+GyFulltextIndex *gy_fulltext_index_new             (const gchar          *filename,
+                                                    GError              **err);
+GyFulltextIndex *gy_fulltext_index_new_from_bytes  (GBytes               *bytes,
+                                                    GError              **err);
+gboolean         gy_fulltext_index_save            (GyFulltextIndex      *self,
+                                                    const gchar          *filename,
+                                                    GError              **err);
+guint            gy_fulltext_index_get_n_terms     (GyFulltextIndex      *self);
+GArray          *gy_fulltext_index_query           (GyFulltextIndex      *self,
+                                                    const gchar          *query,
+                                                    guint                 limit);
+void             gy_fulltext_index_load_async      (GyDictService        *service,
+                                                    GCancellable         *cancellable,
+                                                    GAsyncReadyCallback   callback,
+                                                    gpointer              user_data);
+void             gy_fulltext_index_load_translations_async (GyDictService       *service,
+                                                            GCancellable        *cancellable,
+                                                            GAsyncReadyCallback  callback,
+                                                            gpointer             user_data);
+GyFulltextIndex *gy_fulltext_index_load_finish     (GAsyncResult         *result,
+                                                    GError              **err);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GyFulltextIndexBuilder, gy_fulltext_index_builder_free)
+
+G_END_DECLS
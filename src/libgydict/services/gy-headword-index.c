@@ -0,0 +1,526 @@
+/* gy-headword-index.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+#include "gy-headword-index.h"
+#include "gy-headword-model.h"
+#include "gy-search-keys-private.h"
+#include "helpers/gy-utility-func.h"
+
+/*
+ * The layout of an index file. Every section starts at a multiple of
+ * eight bytes, so the arrays can be used straight from the mapping.
+ *
+ *   header
+ *   headwords       NUL-terminated headwords sorted by their search keys
+ *   headword index  guint32[n_entries], offsets into headwords
+ *   keys            NUL-terminated folded search keys
+ *   key index       guint32[n_entries], offsets into keys
+ *   entries         guint64[n_entries], offsets of the entries in the dictionary
+ *   forms           NUL-terminated forms of the keys, sorted, see #GySearchKeys
+ *   form index      guint32[n_forms + 1], offsets into forms, the last one past the end
+ *   form rows       guint32[n_forms], the row of every form
+ */
+#define INDEX_MAGIC      "GYIDX\0\0\0"
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_ALIGN      8
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 n_entries;
+  guint32 n_forms;
+  guint64 headwords_offset;
+  guint64 headwords_size;
+  guint64 headword_index_offset;
+  guint64 keys_offset;
+  guint64 keys_size;
+  guint64 key_index_offset;
+  guint64 entries_offset;
+  guint64 forms_offset;
+  guint64 forms_size;
+  guint64 form_index_offset;
+  guint64 form_rows_offset;
+} IndexHeader;
+
+struct _GyHeadwordIndex
+{
+  GObject parent_instance;
+
+  GMappedFile     *file;
+  GyHeadwordModel *model;
+
+  const gchar     *keys;
+  gsize            keys_size;
+  const guint32   *key_index;
+  const guint64   *entries;
+  guint            n_entries;
+};
+
+G_DEFINE_TYPE (GyHeadwordIndex, gy_headword_index, G_TYPE_OBJECT)
+
+G_DEFINE_QUARK (gy-headword-index-error-quark, gy_headword_index_error)
+
+static void
+gy_headword_index_finalize (GObject *object)
+{
+  GyHeadwordIndex *self = (GyHeadwordIndex *)object;
+
+  g_clear_object (&self->model);
+  g_clear_pointer (&self->file, g_mapped_file_unref);
+
+  G_OBJECT_CLASS (gy_headword_index_parent_class)->finalize (object);
+}
+
+static void
+gy_headword_index_class_init (GyHeadwordIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gy_headword_index_finalize;
+}
+
+static void
+gy_headword_index_init (GyHeadwordIndex *self)
+{
+}
+
+/* Writing */
+
+typedef struct
+{
+  const gchar * const *headwords;
+  gchar              **keys;
+} SortData;
+
+static gint
+compare_rows (gconstpointer a,
+              gconstpointer b,
+              gpointer      data)
+{
+  SortData *sort_data = data;
+  guint row_a = *(const guint *) a;
+  guint row_b = *(const guint *) b;
+  gint res;
+
+  res = strcmp (sort_data->keys[row_a], sort_data->keys[row_b]);
+
+  if (res == 0)
+    res = strcmp (sort_data->headwords[row_a], sort_data->headwords[row_b]);
+
+  return res;
+}
+
+static void
+align_section (GByteArray *data)
+{
+  static const guint8 padding[INDEX_ALIGN] = { 0 };
+
+  if (data->len % INDEX_ALIGN != 0)
+    g_byte_array_append (data, padding, INDEX_ALIGN - data->len % INDEX_ALIGN);
+}
+
+/**
+ * gy_headword_index_write:
+ * @headwords: (array length=n_headwords): the headwords of a dictionary
+ * @entry_offsets: (array length=n_headwords): the offset of every headword's
+ *   entry in the dictionary
+ * @n_headwords: the number of headwords
+ * @filename: the file to write the index to
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Compiles @headwords into an index file which can be loaded later
+ * with gy_headword_index_new(). The headwords are sorted by their folded
+ * search keys; @entry_offsets travel along with them. The alternate
+ * forms of the keys are expanded and sorted here as well, so a loaded
+ * index is searched without sorting anything.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gy_headword_index_write (const gchar * const  *headwords,
+                         const guint64        *entry_offsets,
+                         guint                 n_headwords,
+                         const gchar          *filename,
+                         GError              **err)
+{
+  g_autoptr(GByteArray) data = NULL;
+  g_autofree guint *order = NULL;
+  g_autofree guint32 *offsets = NULL;
+  g_autoptr(GySearchKeys) search_keys = NULL;
+  g_autoptr(GBytes) keys = NULL;
+  g_autoptr(GBytes) key_index = NULL;
+  g_autoptr(GBytes) forms = NULL;
+  g_autoptr(GBytes) form_index = NULL;
+  g_autoptr(GBytes) form_rows = NULL;
+  SortData sort_data;
+  IndexHeader header = { 0 };
+
+  g_return_val_if_fail (headwords != NULL || n_headwords == 0, FALSE);
+  g_return_val_if_fail (entry_offsets != NULL || n_headwords == 0, FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  sort_data.headwords = headwords;
+  sort_data.keys = g_new0 (gchar *, n_headwords + 1);
+  order = g_new (guint, n_headwords);
+
+  for (guint i = 0; i < n_headwords; i++)
+    {
+      sort_data.keys[i] = gy_utility_fold_search_key (headwords[i], -1);
+
+      if (sort_data.keys[i] == NULL)
+        sort_data.keys[i] = g_strdup (headwords[i]);
+
+      order[i] = i;
+    }
+
+  g_qsort_with_data (order, n_headwords, sizeof (guint), compare_rows, &sort_data);
+
+  data = g_byte_array_new ();
+  offsets = g_new (guint32, n_headwords);
+  g_byte_array_append (data, (const guint8 *) &header, sizeof (IndexHeader));
+
+  memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+  header.version = GY_HEADWORD_INDEX_VERSION;
+  header.byte_order = INDEX_BYTE_ORDER;
+  header.n_entries = n_headwords;
+
+  header.headwords_offset = data->len;
+  for (guint i = 0; i < n_headwords; i++)
+    {
+      const gchar *headword = headwords[order[i]];
+
+      offsets[i] = data->len - header.headwords_offset;
+      g_byte_array_append (data, (const guint8 *) headword, strlen (headword) + 1);
+    }
+  g_byte_array_append (data, (const guint8 *) "", 1);
+  header.headwords_size = data->len - header.headwords_offset;
+  align_section (data);
+
+  header.headword_index_offset = data->len;
+  g_byte_array_append (data, (const guint8 *) offsets, n_headwords * sizeof (guint32));
+  align_section (data);
+
+  header.keys_offset = data->len;
+  for (guint i = 0; i < n_headwords; i++)
+    {
+      const gchar *key = sort_data.keys[order[i]];
+
+      offsets[i] = data->len - header.keys_offset;
+      g_byte_array_append (data, (const guint8 *) key, strlen (key) + 1);
+    }
+  g_byte_array_append (data, (const guint8 *) "", 1);
+  header.keys_size = data->len - header.keys_offset;
+  align_section (data);
+
+  header.key_index_offset = data->len;
+  g_byte_array_append (data, (const guint8 *) offsets, n_headwords * sizeof (guint32));
+  align_section (data);
+
+  header.entries_offset = data->len;
+  for (guint i = 0; i < n_headwords; i++)
+    g_byte_array_append (data, (const guint8 *) &entry_offsets[order[i]], sizeof (guint64));
+  align_section (data);
+
+  keys = g_bytes_new (data->data + header.keys_offset, header.keys_size);
+  key_index = g_bytes_new (offsets, n_headwords * sizeof (guint32));
+  search_keys = gy_search_keys_new (keys, key_index);
+  _gy_search_keys_get_forms (search_keys, &forms, &form_index, &form_rows);
+  header.n_forms = g_bytes_get_size (form_rows) / sizeof (guint32);
+
+  header.forms_offset = data->len;
+  g_byte_array_append (data, g_bytes_get_data (forms, NULL), g_bytes_get_size (forms));
+  g_byte_array_append (data, (const guint8 *) "", 1);
+  header.forms_size = data->len - header.forms_offset;
+  align_section (data);
+
+  header.form_index_offset = data->len;
+  g_byte_array_append (data, g_bytes_get_data (form_index, NULL), g_bytes_get_size (form_index));
+  align_section (data);
+
+  header.form_rows_offset = data->len;
+  g_byte_array_append (data, g_bytes_get_data (form_rows, NULL), g_bytes_get_size (form_rows));
+
+  memcpy (data->data, &header, sizeof (IndexHeader));
+
+  g_strfreev (sort_data.keys);
+
+  /* The offsets of the string sections are 32-bit wide. */
+  if (header.headwords_size > G_MAXUINT32 || header.keys_size > G_MAXUINT32 ||
+      header.forms_size > G_MAXUINT32)
+    {
+      g_set_error (err, GY_HEADWORD_INDEX_ERROR, GY_HEADWORD_INDEX_ERROR_INVALID,
+                   "The headwords do not fit into an index file.");
+      return FALSE;
+    }
+
+  return g_file_set_contents (filename, (const gchar *) data->data, data->len, err);
+}
+
+/* Loading */
+
+static gboolean
+check_section (gsize    file_size,
+               guint64  offset,
+               guint64  size,
+               GError **err)
+{
+  if (offset % INDEX_ALIGN != 0 || offset > file_size || size > file_size - offset)
+    {
+      g_set_error (err, GY_HEADWORD_INDEX_ERROR, GY_HEADWORD_INDEX_ERROR_INVALID,
+                   "A section of the index file is out of bounds.");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+check_blob (const gchar  *contents,
+            guint64       offset,
+            guint64       size,
+            GError      **err)
+{
+  if (size == 0 || contents[offset + size - 1] != '\0')
+    {
+      g_set_error (err, GY_HEADWORD_INDEX_ERROR, GY_HEADWORD_INDEX_ERROR_INVALID,
+                   "A string section of the index file is not terminated.");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * gy_headword_index_new:
+ * @filename: the index file
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Maps an index file written by gy_headword_index_write() into memory.
+ * Nothing is parsed or copied; pages are read in by the kernel as the
+ * model and the lookup table are used.
+ *
+ * Returns: (transfer full) (nullable): a new #GyHeadwordIndex, or %NULL on error
+ */
+GyHeadwordIndex *
+gy_headword_index_new (const gchar  *filename,
+                       GError      **err)
+{
+  g_autoptr(GMappedFile) file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GBytes) headwords = NULL;
+  g_autoptr(GBytes) headword_index = NULL;
+  g_autoptr(GBytes) keys = NULL;
+  g_autoptr(GBytes) key_index = NULL;
+  g_autoptr(GBytes) forms = NULL;
+  g_autoptr(GBytes) form_index = NULL;
+  g_autoptr(GBytes) form_rows = NULL;
+  g_autoptr(GySearchKeys) search_keys = NULL;
+  GyHeadwordIndex *self;
+  const IndexHeader *header;
+  const gchar *contents;
+  gsize size;
+  guint64 n;
+  guint64 n_forms;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  file = g_mapped_file_new (filename, FALSE, err);
+
+  if (file == NULL)
+    return NULL;
+
+  contents = g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+
+  if (size < sizeof (IndexHeader) || memcmp (contents, INDEX_MAGIC, 8) != 0)
+    {
+      g_set_error (err, GY_HEADWORD_INDEX_ERROR, GY_HEADWORD_INDEX_ERROR_INVALID,
+                   "The file %s is not a headword index.", filename);
+      return NULL;
+    }
+
+  header = (const IndexHeader *) contents;
+
+  if (header->byte_order != INDEX_BYTE_ORDER)
+    {
+      g_set_error (err, GY_HEADWORD_INDEX_ERROR, GY_HEADWORD_INDEX_ERROR_BYTE_ORDER,
+                   "The index %s was written on a host of different byte order.", filename);
+      return NULL;
+    }
+
+  if (header->version != GY_HEADWORD_INDEX_VERSION)
+    {
+      g_set_error (err, GY_HEADWORD_INDEX_ERROR, GY_HEADWORD_INDEX_ERROR_VERSION,
+                   "The index %s has unsupported version %u.", filename, header->version);
+      return NULL;
+    }
+
+  n = header->n_entries;
+  n_forms = header->n_forms;
+
+  if (!check_section (size, header->headwords_offset, header->headwords_size, err) ||
+      !check_section (size, header->headword_index_offset, n * sizeof (guint32), err) ||
+      !check_section (size, header->keys_offset, header->keys_size, err) ||
+      !check_section (size, header->key_index_offset, n * sizeof (guint32), err) ||
+      !check_section (size, header->entries_offset, n * sizeof (guint64), err) ||
+      !check_section (size, header->forms_offset, header->forms_size, err) ||
+      !check_section (size, header->form_index_offset, (n_forms + 1) * sizeof (guint32), err) ||
+      !check_section (size, header->form_rows_offset, n_forms * sizeof (guint32), err) ||
+      !check_blob (contents, header->headwords_offset, header->headwords_size, err) ||
+      !check_blob (contents, header->keys_offset, header->keys_size, err) ||
+      !check_blob (contents, header->forms_offset, header->forms_size, err))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+  headwords = g_bytes_new_from_bytes (bytes, header->headwords_offset, header->headwords_size);
+  headword_index = g_bytes_new_from_bytes (bytes, header->headword_index_offset, n * sizeof (guint32));
+
+  self = g_object_new (GY_TYPE_HEADWORD_INDEX, NULL);
+  self->file = g_steal_pointer (&file);
+  self->model = gy_headword_model_new (headwords, headword_index);
+
+  /* The folded keys and their sorted forms are used straight from the mapping as well. */
+  keys = g_bytes_new_from_bytes (bytes, header->keys_offset, header->keys_size);
+  key_index = g_bytes_new_from_bytes (bytes, header->key_index_offset, n * sizeof (guint32));
+  forms = g_bytes_new_from_bytes (bytes, header->forms_offset, header->forms_size);
+  form_index = g_bytes_new_from_bytes (bytes, header->form_index_offset, (n_forms + 1) * sizeof (guint32));
+  form_rows = g_bytes_new_from_bytes (bytes, header->form_rows_offset, n_forms * sizeof (guint32));
+  search_keys = gy_search_keys_new_with_forms (keys, key_index, forms, form_index, form_rows);
+  gy_headword_model_set_search_keys (self->model, search_keys);
+  self->keys = contents + header->keys_offset;
+  self->keys_size = header->keys_size;
+  self->key_index = (const guint32 *) (contents + header->key_index_offset);
+  self->entries = (const guint64 *) (contents + header->entries_offset);
+  self->n_entries = n;
+
+  return self;
+}
+
+/**
+ * gy_headword_index_get_model:
+ * @self: a #GyHeadwordIndex
+ *
+ * Returns: (transfer none): the headwords as a #GtkTreeModel. The row
+ * numbers are the indexes used by the other functions of the index.
+ */
+GtkTreeModel *
+gy_headword_index_get_model (GyHeadwordIndex *self)
+{
+  g_return_val_if_fail (GY_IS_HEADWORD_INDEX (self), NULL);
+
+  return GTK_TREE_MODEL (self->model);
+}
+
+guint
+gy_headword_index_get_n_entries (GyHeadwordIndex *self)
+{
+  g_return_val_if_fail (GY_IS_HEADWORD_INDEX (self), 0);
+
+  return self->n_entries;
+}
+
+/**
+ * gy_headword_index_get_entry_offset:
+ * @self: a #GyHeadwordIndex
+ * @idx: the row
+ *
+ * Returns: the offset of the dictionary entry stored for the row @idx
+ */
+guint64
+gy_headword_index_get_entry_offset (GyHeadwordIndex *self,
+                                    guint            idx)
+{
+  g_return_val_if_fail (GY_IS_HEADWORD_INDEX (self), 0);
+  g_return_val_if_fail (idx < self->n_entries, 0);
+
+  return self->entries[idx];
+}
+
+static inline const gchar *
+get_key (GyHeadwordIndex *self,
+         guint            idx)
+{
+  guint32 offset = self->key_index[idx];
+
+  return offset < self->keys_size ? self->keys + offset : "";
+}
+
+/**
+ * gy_headword_index_get_search_key:
+ * @self: a #GyHeadwordIndex
+ * @idx: the row
+ *
+ * Returns: (transfer none) (nullable): the folded search key of the row @idx
+ */
+const gchar *
+gy_headword_index_get_search_key (GyHeadwordIndex *self,
+                                  guint            idx)
+{
+  g_return_val_if_fail (GY_IS_HEADWORD_INDEX (self), NULL);
+  g_return_val_if_fail (idx < self->n_entries, NULL);
+  g_return_val_if_fail (self->key_index[idx] < self->keys_size, NULL);
+
+  return self->keys + self->key_index[idx];
+}
+
+/**
+ * gy_headword_index_lookup:
+ * @self: a #GyHeadwordIndex
+ * @word: the word to find
+ *
+ * Finds the first row whose search key equals the folded @word.
+ *
+ * Returns: the row, or -1 if @word is not in the index
+ */
+gint
+gy_headword_index_lookup (GyHeadwordIndex *self,
+                          const gchar     *word)
+{
+  g_autofree gchar *key = NULL;
+  guint lo = 0, hi;
+
+  g_return_val_if_fail (GY_IS_HEADWORD_INDEX (self), -1);
+  g_return_val_if_fail (word != NULL, -1);
+
+  key = gy_utility_fold_search_key (word, -1);
+
+  if (key == NULL)
+    return -1;
+
+  hi = self->n_entries;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (strcmp (get_key (self, mid), key) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo < self->n_entries && strcmp (get_key (self, lo), key) == 0)
+    return lo;
+
+  return -1;
+}
@@ -0,0 +1,72 @@
+/* gy-headword-index.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#if !defined (GYDICT_INSIDE) && !defined (GYDICT_COMPILATION)
+#error "Only <gydict.h> can be included directly."
+#endif
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define GY_HEADWORD_INDEX_VERSION 2
+
+#define GY_HEADWORD_INDEX_ERROR (gy_headword_index_error_quark ())
+
+/**
+ * GyHeadwordIndexError:
+ * @GY_HEADWORD_INDEX_ERROR_INVALID: the file is not a headword index or is damaged
+ * @GY_HEADWORD_INDEX_ERROR_VERSION: the file was written in an unsupported version
+ * @GY_HEADWORD_INDEX_ERROR_BYTE_ORDER: the file was written on a host of different byte order
+ *
+ * Errors returned while loading a headword index.
+ */
+typedef enum
+{
+  GY_HEADWORD_INDEX_ERROR_INVALID,
+  GY_HEADWORD_INDEX_ERROR_VERSION,
+  GY_HEADWORD_INDEX_ERROR_BYTE_ORDER,
+} GyHeadwordIndexError;
+
+#define GY_TYPE_HEADWORD_INDEX (gy_headword_index_get_type())
+
+G_DECLARE_FINAL_TYPE (GyHeadwordIndex, gy_headword_index, GY, HEADWORD_INDEX, GObject)
+
+GQuark gy_headword_index_error_quark (void);
+
+gboolean         gy_headword_index_write            (const gchar * const  *headwords,
+                                                     const guint64        *entry_offsets,
+                                                     guint                 n_headwords,
+                                                     const gchar          *filename,
+                                                     GError              **err);
+GyHeadwordIndex *gy_headword_index_new              (const gchar  *filename,
+                                                     GError      **err);
+GtkTreeModel    *gy_headword_index_get_model        (GyHeadwordIndex *self);
+guint            gy_headword_index_get_n_entries    (GyHeadwordIndex *self);
+guint64          gy_headword_index_get_entry_offset (GyHeadwordIndex *self,
+                                                     guint            idx);
+const gchar     *gy_headword_index_get_search_key   (GyHeadwordIndex *self,
+                                                     guint            idx);
+gint             gy_headword_index_lookup           (GyHeadwordIndex *self,
+                                                     const gchar     *word);
+
+G_END_DECLS
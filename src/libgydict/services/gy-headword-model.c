@@ -0,0 +1,434 @@
+/* gy-headword-model.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+#include "gy-headword-model.h"
+
+/*
+ * The model keeps all headwords in one blob of NUL-terminated strings.
+ * The n-th row is the string starting at offsets[n]. Rows are never
+ * allocated: an iterator only carries the row number and get_value()
+ * hands out static strings pointing into the blob.
+ */
+struct _GyHeadwordModel
+{
+  GObject parent_instance;
+
+  gint stamp;
+
+  GBytes        *headwords;
+  GBytes        *offsets;
+  const gchar   *blob;
+  gsize          blob_size;
+  const guint32 *index;
+  guint          n_headwords;
+
+  GySearchKeys  *search_keys;
+};
+
+static void gy_headword_model_tree_model_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GyHeadwordModel, gy_headword_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+                                                gy_headword_model_tree_model_init))
+
+#define ITER_ROW(iter) (GPOINTER_TO_UINT ((iter)->user_data))
+#define VALID_ITER(self, iter) ((iter) != NULL && (iter)->stamp == (self)->stamp && ITER_ROW (iter) < (self)->n_headwords)
+
+static inline void
+set_iter (GyHeadwordModel *self,
+          GtkTreeIter     *iter,
+          guint            row)
+{
+  iter->stamp = self->stamp;
+  iter->user_data = GUINT_TO_POINTER (row);
+  iter->user_data2 = NULL;
+  iter->user_data3 = NULL;
+}
+
+static GtkTreeModelFlags
+gy_headword_model_get_flags (GtkTreeModel *model)
+{
+  return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+gy_headword_model_get_n_columns (GtkTreeModel *model)
+{
+  return 1;
+}
+
+static GType
+gy_headword_model_get_column_type (GtkTreeModel *model,
+                                   gint          index)
+{
+  g_return_val_if_fail (index == 0, G_TYPE_INVALID);
+
+  return G_TYPE_STRING;
+}
+
+static gboolean
+gy_headword_model_get_iter (GtkTreeModel *model,
+                            GtkTreeIter  *iter,
+                            GtkTreePath  *path)
+{
+  GyHeadwordModel *self = GY_HEADWORD_MODEL (model);
+  gint *indices;
+
+  if (gtk_tree_path_get_depth (path) != 1)
+    return FALSE;
+
+  indices = gtk_tree_path_get_indices (path);
+
+  if (indices[0] < 0 || (guint) indices[0] >= self->n_headwords)
+    return FALSE;
+
+  set_iter (self, iter, indices[0]);
+
+  return TRUE;
+}
+
+static GtkTreePath *
+gy_headword_model_get_path (GtkTreeModel *model,
+                            GtkTreeIter  *iter)
+{
+  GyHeadwordModel *self = GY_HEADWORD_MODEL (model);
+
+  g_return_val_if_fail (VALID_ITER (self, iter), NULL);
+
+  return gtk_tree_path_new_from_indices (ITER_ROW (iter), -1);
+}
+
+static void
+gy_headword_model_get_value (GtkTreeModel *model,
+                             GtkTreeIter  *iter,
+                             gint          column,
+                             GValue       *value)
+{
+  GyHeadwordModel *self = GY_HEADWORD_MODEL (model);
+
+  g_return_if_fail (column == 0);
+  g_return_if_fail (VALID_ITER (self, iter));
+
+  g_value_init (value, G_TYPE_STRING);
+  g_value_set_static_string (value, gy_headword_model_get_headword (self, ITER_ROW (iter)));
+}
+
+static gboolean
+gy_headword_model_iter_next (GtkTreeModel *model,
+                             GtkTreeIter  *iter)
+{
+  GyHeadwordModel *self = GY_HEADWORD_MODEL (model);
+  guint row;
+
+  g_return_val_if_fail (VALID_ITER (self, iter), FALSE);
+
+  row = ITER_ROW (iter) + 1;
+
+  if (row >= self->n_headwords)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+
+  set_iter (self, iter, row);
+
+  return TRUE;
+}
+
+static gboolean
+gy_headword_model_iter_previous (GtkTreeModel *model,
+                                 GtkTreeIter  *iter)
+{
+  GyHeadwordModel *self = GY_HEADWORD_MODEL (model);
+  guint row;
+
+  g_return_val_if_fail (VALID_ITER (self, iter), FALSE);
+
+  row = ITER_ROW (iter);
+
+  if (row == 0)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+
+  set_iter (self, iter, row - 1);
+
+  return TRUE;
+}
+
+static gboolean
+gy_headword_model_iter_nth_child (GtkTreeModel *model,
+                                  GtkTreeIter  *iter,
+                                  GtkTreeIter  *parent,
+                                  gint          n)
+{
+  GyHeadwordModel *self = GY_HEADWORD_MODEL (model);
+
+  if (parent != NULL || n < 0 || (guint) n >= self->n_headwords)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+
+  set_iter (self, iter, n);
+
+  return TRUE;
+}
+
+static gboolean
+gy_headword_model_iter_children (GtkTreeModel *model,
+                                 GtkTreeIter  *iter,
+                                 GtkTreeIter  *parent)
+{
+  return gy_headword_model_iter_nth_child (model, iter, parent, 0);
+}
+
+static gboolean
+gy_headword_model_iter_has_child (GtkTreeModel *model,
+                                  GtkTreeIter  *iter)
+{
+  return FALSE;
+}
+
+static gint
+gy_headword_model_iter_n_children (GtkTreeModel *model,
+                                   GtkTreeIter  *iter)
+{
+  GyHeadwordModel *self = GY_HEADWORD_MODEL (model);
+
+  if (iter == NULL)
+    return self->n_headwords;
+
+  return 0;
+}
+
+static gboolean
+gy_headword_model_iter_parent (GtkTreeModel *model,
+                               GtkTreeIter  *iter,
+                               GtkTreeIter  *child)
+{
+  iter->stamp = 0;
+
+  return FALSE;
+}
+
+static void
+gy_headword_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = gy_headword_model_get_flags;
+  iface->get_n_columns = gy_headword_model_get_n_columns;
+  iface->get_column_type = gy_headword_model_get_column_type;
+  iface->get_iter = gy_headword_model_get_iter;
+  iface->get_path = gy_headword_model_get_path;
+  iface->get_value = gy_headword_model_get_value;
+  iface->iter_next = gy_headword_model_iter_next;
+  iface->iter_previous = gy_headword_model_iter_previous;
+  iface->iter_children = gy_headword_model_iter_children;
+  iface->iter_has_child = gy_headword_model_iter_has_child;
+  iface->iter_n_children = gy_headword_model_iter_n_children;
+  iface->iter_nth_child = gy_headword_model_iter_nth_child;
+  iface->iter_parent = gy_headword_model_iter_parent;
+}
+
+static void
+gy_headword_model_finalize (GObject *object)
+{
+  GyHeadwordModel *self = (GyHeadwordModel *)object;
+
+  g_clear_pointer (&self->headwords, g_bytes_unref);
+  g_clear_pointer (&self->offsets, g_bytes_unref);
+  g_clear_pointer (&self->search_keys, gy_search_keys_unref);
+
+  G_OBJECT_CLASS (gy_headword_model_parent_class)->finalize (object);
+}
+
+static void
+gy_headword_model_class_init (GyHeadwordModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gy_headword_model_finalize;
+}
+
+static void
+gy_headword_model_init (GyHeadwordModel *self)
+{
+  do
+    self->stamp = g_random_int ();
+  while (self->stamp == 0);
+}
+
+/**
+ * gy_headword_model_new:
+ * @headwords: a blob of NUL-terminated headwords
+ * @offsets: an array of #guint32 offsets into @headwords, one per row
+ *
+ * Creates a list model of headwords without copying them. Both blobs
+ * are only referenced, so they may point into a memory mapped file.
+ *
+ * Returns: (transfer full): a new #GyHeadwordModel
+ */
+GyHeadwordModel *
+gy_headword_model_new (GBytes *headwords,
+                       GBytes *offsets)
+{
+  GyHeadwordModel *self;
+  gsize offsets_size;
+
+  g_return_val_if_fail (headwords != NULL, NULL);
+  g_return_val_if_fail (offsets != NULL, NULL);
+
+  self = g_object_new (GY_TYPE_HEADWORD_MODEL, NULL);
+
+  self->headwords = g_bytes_ref (headwords);
+  self->offsets = g_bytes_ref (offsets);
+  self->blob = g_bytes_get_data (headwords, &self->blob_size);
+  self->index = g_bytes_get_data (offsets, &offsets_size);
+  self->n_headwords = offsets_size / sizeof (guint32);
+
+  if (self->blob_size == 0 || self->blob[self->blob_size - 1] != '\0')
+    {
+      g_critical ("The blob of headwords is not terminated by NUL.");
+      self->n_headwords = 0;
+    }
+
+  return self;
+}
+
+/**
+ * gy_headword_model_new_from_strv:
+ * @headwords: a %NULL-terminated array of headwords
+ *
+ * Creates a list model of headwords by packing @headwords into one blob.
+ *
+ * Returns: (transfer full): a new #GyHeadwordModel
+ */
+GyHeadwordModel *
+gy_headword_model_new_from_strv (const gchar * const *headwords)
+{
+  g_autoptr(GByteArray) blob = NULL;
+  g_autoptr(GArray) offsets = NULL;
+  g_autoptr(GBytes) blob_bytes = NULL;
+  g_autoptr(GBytes) offsets_bytes = NULL;
+  guint n;
+
+  g_return_val_if_fail (headwords != NULL, NULL);
+
+  n = g_strv_length ((gchar **) headwords);
+  blob = g_byte_array_new ();
+  offsets = g_array_sized_new (FALSE, FALSE, sizeof (guint32), n);
+
+  for (guint i = 0; i < n; i++)
+    {
+      guint32 offset = blob->len;
+
+      g_array_append_val (offsets, offset);
+      g_byte_array_append (blob, (const guint8 *) headwords[i], strlen (headwords[i]) + 1);
+    }
+
+  if (blob->len == 0)
+    g_byte_array_append (blob, (const guint8 *) "", 1);
+
+  blob_bytes = g_byte_array_free_to_bytes (g_steal_pointer (&blob));
+  offsets_bytes = g_bytes_new (offsets->data, offsets->len * sizeof (guint32));
+
+  return gy_headword_model_new (blob_bytes, offsets_bytes);
+}
+
+guint
+gy_headword_model_get_n_headwords (GyHeadwordModel *self)
+{
+  g_return_val_if_fail (GY_IS_HEADWORD_MODEL (self), 0);
+
+  return self->n_headwords;
+}
+
+/**
+ * gy_headword_model_get_headword:
+ * @self: a #GyHeadwordModel
+ * @idx: the row
+ *
+ * Returns: (transfer none) (nullable): the headword at @idx. The string
+ * lives as long as @self.
+ */
+const gchar *
+gy_headword_model_get_headword (GyHeadwordModel *self,
+                                guint            idx)
+{
+  g_return_val_if_fail (GY_IS_HEADWORD_MODEL (self), NULL);
+  g_return_val_if_fail (idx < self->n_headwords, NULL);
+  g_return_val_if_fail (self->index[idx] < self->blob_size, NULL);
+
+  return self->blob + self->index[idx];
+}
+
+/**
+ * gy_headword_model_get_search_keys:
+ * @self: a #GyHeadwordModel
+ *
+ * Gets the folded search keys of the rows, folding the headwords on the
+ * first call unless keys were given with gy_headword_model_set_search_keys().
+ * The headwords never change, so it may be called from any thread; a
+ * worker calling it first keeps the folding off the main thread.
+ *
+ * Returns: (transfer none): the search keys
+ */
+GySearchKeys *
+gy_headword_model_get_search_keys (GyHeadwordModel *self)
+{
+  GySearchKeys *keys;
+
+  g_return_val_if_fail (GY_IS_HEADWORD_MODEL (self), NULL);
+
+  if ((keys = g_atomic_pointer_get (&self->search_keys)) != NULL)
+    return keys;
+
+  keys = gy_search_keys_new_from_model (GTK_TREE_MODEL (self), 0);
+
+  /* Two threads may fold at once; the keys of the first one are kept. */
+  if (!g_atomic_pointer_compare_and_exchange (&self->search_keys, NULL, keys))
+    {
+      gy_search_keys_unref (keys);
+      keys = g_atomic_pointer_get (&self->search_keys);
+    }
+
+  return keys;
+}
+
+/**
+ * gy_headword_model_set_search_keys:
+ * @self: a #GyHeadwordModel
+ * @keys: the folded keys of the rows, one per row
+ *
+ * Sets keys folded in advance, for example the ones stored in an index file.
+ */
+void
+gy_headword_model_set_search_keys (GyHeadwordModel *self,
+                                   GySearchKeys    *keys)
+{
+  g_return_if_fail (GY_IS_HEADWORD_MODEL (self));
+  g_return_if_fail (keys != NULL);
+  g_return_if_fail (gy_search_keys_get_n_keys (keys) == self->n_headwords);
+
+  g_clear_pointer (&self->search_keys, gy_search_keys_unref);
+  self->search_keys = gy_search_keys_ref (keys);
+}
@@ -0,0 +1,47 @@
+/* gy-headword-model.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#if !defined (GYDICT_INSIDE) && !defined (GYDICT_COMPILATION)
+#error "Only <gydict.h> can be included directly."
+#endif
+
+#include <gtk/gtk.h>
+#include "gy-search-keys.h"
+
+G_BEGIN_DECLS
+
+#define GY_TYPE_HEADWORD_MODEL (gy_headword_model_get_type())
+
+G_DECLARE_FINAL_TYPE (GyHeadwordModel, gy_headword_model, GY, HEADWORD_MODEL, GObject)
+
+GyHeadwordModel *gy_headword_model_new (GBytes *headwords,
+                                        GBytes *offsets);
+GyHeadwordModel *gy_headword_model_new_from_strv (const gchar * const *headwords);
+
+guint        gy_headword_model_get_n_headwords (GyHeadwordModel *self);
+const gchar *gy_headword_model_get_headword    (GyHeadwordModel *self,
+                                                guint            idx);
+GySearchKeys *gy_headword_model_get_search_keys (GyHeadwordModel *self);
+void          gy_headword_model_set_search_keys (GyHeadwordModel *self,
+                                                 GySearchKeys    *keys);
+
+G_END_DECLS
@@ -0,0 +1,680 @@
+/* gy-lemma-index.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+#include "gy-lemma-index.h"
+#include "helpers/gy-utility-func.h"
+
+/*
+ * A lemma index maps inflected forms to their lemmas with a minimal
+ * acyclic automaton. Every (form, lemma) pair becomes one string,
+ *
+ *   folded form  SEPARATOR  code  suffix
+ *
+ * where the code tells how many bytes to cut off the end of the form
+ * and the suffix is what to append to get the lemma. Since a language
+ * inflects most words the same way, the ends of the strings are shared
+ * by thousands of forms and the automaton stays small. A lookup walks
+ * the form and the separator, then reads every string below.
+ *
+ * The automaton is stored as one array of arcs. The arcs leaving a
+ * state are consecutive and sorted by label, the last one flagged; a
+ * state is the index of its first arc. States are written after the
+ * states they lead to, so every arc points backwards, which makes a
+ * damaged file unable to loop. Every section starts at a multiple of
+ * eight bytes:
+ *
+ *   header
+ *   arcs      Arc[n_arcs]
+ */
+#define INDEX_MAGIC      "GYLEMMA\0"
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_ALIGN      8
+
+#define SEPARATOR    0x01
+#define CODE_OFFSET  2
+#define CODE_REPLACE 0xff
+#define NO_ARCS      G_MAXUINT32
+#define MAX_LENGTH   1024
+
+enum
+{
+  ARC_LAST  = 1 << 0,
+  ARC_FINAL = 1 << 1,
+};
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 n_arcs;
+  guint32 root;
+  guint64 arcs_offset;
+} IndexHeader;
+
+typedef struct
+{
+  guint32 target;
+  guint8  label;
+  guint8  flags;
+  guint16 reserved;
+} Arc;
+
+struct _GyLemmaIndex
+{
+  GObject parent_instance;
+
+  GMappedFile *file;
+  const Arc   *arcs;
+  guint        n_arcs;
+  guint32      root;
+};
+
+G_DEFINE_TYPE (GyLemmaIndex, gy_lemma_index, G_TYPE_OBJECT)
+
+G_DEFINE_QUARK (gy-lemma-index-error-quark, gy_lemma_index_error)
+
+static void
+gy_lemma_index_finalize (GObject *object)
+{
+  GyLemmaIndex *self = (GyLemmaIndex *)object;
+
+  g_clear_pointer (&self->file, g_mapped_file_unref);
+
+  G_OBJECT_CLASS (gy_lemma_index_parent_class)->finalize (object);
+}
+
+static void
+gy_lemma_index_class_init (GyLemmaIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gy_lemma_index_finalize;
+}
+
+static void
+gy_lemma_index_init (GyLemmaIndex *self)
+{
+}
+
+/* Writing */
+
+typedef struct _State State;
+
+typedef struct
+{
+  guint8  label;
+  State  *target;
+} BuildArc;
+
+struct _State
+{
+  GArray   *arcs;
+  gboolean  final;
+  guint32   id;
+};
+
+static State *
+state_new (void)
+{
+  State *state = g_slice_new0 (State);
+
+  state->arcs = g_array_new (FALSE, FALSE, sizeof (BuildArc));
+  state->id = NO_ARCS;
+
+  return state;
+}
+
+static void
+state_free (gpointer data)
+{
+  State *state = data;
+
+  g_array_unref (state->arcs);
+  g_slice_free (State, state);
+}
+
+static guint
+state_hash (gconstpointer data)
+{
+  const State *state = data;
+  guint hash = state->final;
+
+  for (guint i = 0; i < state->arcs->len; i++)
+    {
+      const BuildArc *arc = &g_array_index (state->arcs, BuildArc, i);
+
+      hash = hash * 31 + arc->label;
+      hash = hash * 31 + g_direct_hash (arc->target);
+    }
+
+  return hash;
+}
+
+/* The targets are registered already, so they are equal only if they are the same. */
+static gboolean
+state_equal (gconstpointer a,
+             gconstpointer b)
+{
+  const State *s1 = a;
+  const State *s2 = b;
+
+  if (s1->final != s2->final || s1->arcs->len != s2->arcs->len)
+    return FALSE;
+
+  for (guint i = 0; i < s1->arcs->len; i++)
+    {
+      const BuildArc *arc1 = &g_array_index (s1->arcs, BuildArc, i);
+      const BuildArc *arc2 = &g_array_index (s2->arcs, BuildArc, i);
+
+      if (arc1->label != arc2->label || arc1->target != arc2->target)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static inline BuildArc *
+last_arc (State *state)
+{
+  return &g_array_index (state->arcs, BuildArc, state->arcs->len - 1);
+}
+
+/*
+ * Replaces the states below the last arc of @state, which no string
+ * added later can reach, with equal states met before. The register
+ * owns every state but the ones on the path of the last string.
+ */
+static void
+replace_or_register (GHashTable *states,
+                     State      *state)
+{
+  BuildArc *arc = last_arc (state);
+  State *child = arc->target;
+  State *same;
+
+  if (child->arcs->len > 0)
+    replace_or_register (states, child);
+
+  if ((same = g_hash_table_lookup (states, child)) != NULL)
+    {
+      arc->target = same;
+      state_free (child);
+    }
+  else
+    {
+      g_hash_table_add (states, child);
+    }
+}
+
+static void
+add_string (GHashTable  *states,
+            State       *root,
+            const gchar *prev,
+            const gchar *str)
+{
+  State *state = root;
+  gsize i = 0;
+
+  while (prev[i] != '\0' && prev[i] == str[i])
+    {
+      state = last_arc (state)->target;
+      i++;
+    }
+
+  if (state->arcs->len > 0)
+    replace_or_register (states, state);
+
+  for (; str[i] != '\0'; i++)
+    {
+      BuildArc arc = { (guint8) str[i], state_new () };
+
+      g_array_append_val (state->arcs, arc);
+      state = arc.target;
+    }
+
+  state->final = TRUE;
+}
+
+static void
+emit_state (GArray *arcs,
+            State  *state)
+{
+  guint32 first;
+
+  if (state->id != NO_ARCS || state->arcs->len == 0)
+    return;
+
+  for (guint i = 0; i < state->arcs->len; i++)
+    emit_state (arcs, g_array_index (state->arcs, BuildArc, i).target);
+
+  first = arcs->len;
+
+  for (guint i = 0; i < state->arcs->len; i++)
+    {
+      const BuildArc *build_arc = &g_array_index (state->arcs, BuildArc, i);
+      Arc arc = { 0 };
+
+      arc.target = build_arc->target->id;
+      arc.label = build_arc->label;
+      arc.flags = (build_arc->target->final ? ARC_FINAL : 0) |
+                  (i == state->arcs->len - 1 ? ARC_LAST : 0);
+      g_array_append_val (arcs, arc);
+    }
+
+  state->id = first;
+}
+
+/* Spells the pair as the string stored in the automaton, or returns NULL if it cannot be. */
+static gchar *
+encode_pair (const gchar *form,
+             const gchar *lemma)
+{
+  g_autofree gchar *folded_form = gy_utility_fold_search_key (form, -1);
+  g_autofree gchar *folded_lemma = gy_utility_fold_search_key (lemma, -1);
+  gsize form_len, common = 0, cut;
+
+  if (folded_form == NULL || folded_lemma == NULL ||
+      *folded_form == '\0' || *folded_lemma == '\0' ||
+      strchr (folded_form, SEPARATOR) != NULL)
+    return NULL;
+
+  form_len = strlen (folded_form);
+
+  if (form_len + strlen (folded_lemma) + 2 > MAX_LENGTH)
+    return NULL;
+
+  while (folded_form[common] != '\0' && folded_form[common] == folded_lemma[common])
+    common++;
+
+  cut = form_len - common;
+
+  if (cut + CODE_OFFSET >= CODE_REPLACE)
+    return g_strdup_printf ("%s%c%c%s", folded_form, SEPARATOR, CODE_REPLACE, folded_lemma);
+
+  return g_strdup_printf ("%s%c%c%s", folded_form, SEPARATOR,
+                          (gchar) (cut + CODE_OFFSET), folded_lemma + common);
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+/**
+ * gy_lemma_index_write:
+ * @forms: (array length=n_pairs): inflected forms
+ * @lemmas: (array length=n_pairs): the lemma of every form
+ * @n_pairs: the number of pairs
+ * @filename: the file to write the index to
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Compiles an inflection list into an index file which can be loaded
+ * later with gy_lemma_index_new(). A form with several lemmas is given
+ * once for each of them. The forms and lemmas are folded with
+ * gy_utility_fold_search_key(); empty ones are skipped.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gy_lemma_index_write (const gchar * const  *forms,
+                      const gchar * const  *lemmas,
+                      guint                 n_pairs,
+                      const gchar          *filename,
+                      GError              **err)
+{
+  g_autoptr(GPtrArray) strings = NULL;
+  g_autoptr(GHashTable) states = NULL;
+  g_autoptr(GArray) arcs = NULL;
+  g_autoptr(GByteArray) data = NULL;
+  IndexHeader header = { 0 };
+  const gchar *prev = "";
+  State *root;
+
+  g_return_val_if_fail (forms != NULL || n_pairs == 0, FALSE);
+  g_return_val_if_fail (lemmas != NULL || n_pairs == 0, FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  strings = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint i = 0; i < n_pairs; i++)
+    {
+      gchar *str = encode_pair (forms[i], lemmas[i]);
+
+      if (str != NULL)
+        g_ptr_array_add (strings, str);
+    }
+
+  /* The automaton is built in one pass over the strings in byte order. */
+  g_ptr_array_sort (strings, compare_strings);
+
+  states = g_hash_table_new_full (state_hash, state_equal, state_free, NULL);
+  root = state_new ();
+
+  for (guint i = 0; i < strings->len; i++)
+    {
+      const gchar *str = g_ptr_array_index (strings, i);
+
+      if (strcmp (str, prev) != 0)
+        add_string (states, root, prev, str);
+
+      prev = str;
+    }
+
+  if (root->arcs->len > 0)
+    replace_or_register (states, root);
+
+  arcs = g_array_new (FALSE, FALSE, sizeof (Arc));
+  emit_state (arcs, root);
+
+  memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+  header.version = GY_LEMMA_INDEX_VERSION;
+  header.byte_order = INDEX_BYTE_ORDER;
+  header.n_arcs = arcs->len;
+  header.root = root->id;
+  header.arcs_offset = sizeof (IndexHeader);
+
+  state_free (root);
+
+  data = g_byte_array_new ();
+  g_byte_array_append (data, (const guint8 *) &header, sizeof (IndexHeader));
+  g_byte_array_append (data, (const guint8 *) arcs->data, arcs->len * sizeof (Arc));
+
+  return g_file_set_contents (filename, (const gchar *) data->data, data->len, err);
+}
+
+/* Loading */
+
+/**
+ * gy_lemma_index_new:
+ * @filename: the index file
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Maps an index file written by gy_lemma_index_write() into memory.
+ * Nothing is parsed; a lookup reads only the arcs on its way.
+ *
+ * Returns: (transfer full) (nullable): a new #GyLemmaIndex, or %NULL on error
+ */
+GyLemmaIndex *
+gy_lemma_index_new (const gchar  *filename,
+                    GError      **err)
+{
+  g_autoptr(GMappedFile) file = NULL;
+  const IndexHeader *header;
+  const gchar *contents;
+  GyLemmaIndex *self;
+  gsize size;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  file = g_mapped_file_new (filename, FALSE, err);
+
+  if (file == NULL)
+    return NULL;
+
+  contents = g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+
+  if (size < sizeof (IndexHeader) || memcmp (contents, INDEX_MAGIC, 8) != 0)
+    {
+      g_set_error (err, GY_LEMMA_INDEX_ERROR, GY_LEMMA_INDEX_ERROR_INVALID,
+                   "The file %s is not a lemma index.", filename);
+      return NULL;
+    }
+
+  header = (const IndexHeader *) contents;
+
+  if (header->byte_order != INDEX_BYTE_ORDER)
+    {
+      g_set_error (err, GY_LEMMA_INDEX_ERROR, GY_LEMMA_INDEX_ERROR_BYTE_ORDER,
+                   "The index %s was written on a host of different byte order.", filename);
+      return NULL;
+    }
+
+  if (header->version != GY_LEMMA_INDEX_VERSION)
+    {
+      g_set_error (err, GY_LEMMA_INDEX_ERROR, GY_LEMMA_INDEX_ERROR_VERSION,
+                   "The index %s has unsupported version %u.", filename, header->version);
+      return NULL;
+    }
+
+  if (header->arcs_offset % INDEX_ALIGN != 0 || header->arcs_offset > size ||
+      (guint64) header->n_arcs * sizeof (Arc) > size - header->arcs_offset ||
+      (header->root != NO_ARCS && header->root >= header->n_arcs))
+    {
+      g_set_error (err, GY_LEMMA_INDEX_ERROR, GY_LEMMA_INDEX_ERROR_INVALID,
+                   "The arcs of the index %s are out of bounds.", filename);
+      return NULL;
+    }
+
+  self = g_object_new (GY_TYPE_LEMMA_INDEX, NULL);
+  self->file = g_steal_pointer (&file);
+  self->arcs = (const Arc *) (contents + header->arcs_offset);
+  self->n_arcs = header->n_arcs;
+  self->root = header->root;
+
+  return self;
+}
+
+/**
+ * gy_lemma_index_get_n_arcs:
+ * @self: a #GyLemmaIndex
+ *
+ * Returns: the number of arcs of the automaton, a measure of its size
+ */
+guint
+gy_lemma_index_get_n_arcs (GyLemmaIndex *self)
+{
+  g_return_val_if_fail (GY_IS_LEMMA_INDEX (self), 0);
+
+  return self->n_arcs;
+}
+
+/* Follows the arc labelled @label out of @state, or returns FALSE. */
+static gboolean
+step (GyLemmaIndex *self,
+      guint32      *state,
+      guint8        label,
+      gboolean     *final)
+{
+  for (guint32 i = *state; i < self->n_arcs; i++)
+    {
+      const Arc *arc = &self->arcs[i];
+
+      if (arc->label == label)
+        {
+          /* Arcs point backwards; anything else is damage. */
+          if (arc->target != NO_ARCS && arc->target >= *state)
+            return FALSE;
+
+          *state = arc->target;
+          *final = (arc->flags & ARC_FINAL) != 0;
+          return TRUE;
+        }
+
+      if (arc->label > label || (arc->flags & ARC_LAST) != 0)
+        break;
+    }
+
+  return FALSE;
+}
+
+/* Reads every string below @state into @outputs, @path holding the bytes on the way. */
+static void
+collect (GyLemmaIndex *self,
+         guint32       state,
+         GString      *path,
+         GPtrArray    *outputs)
+{
+  if (state == NO_ARCS || path->len >= MAX_LENGTH)
+    return;
+
+  for (guint32 i = state; i < self->n_arcs; i++)
+    {
+      const Arc *arc = &self->arcs[i];
+
+      if (arc->target == NO_ARCS || arc->target < state)
+        {
+          g_string_append_c (path, (gchar) arc->label);
+
+          if (arc->flags & ARC_FINAL)
+            g_ptr_array_add (outputs, g_strndup (path->str, path->len));
+
+          collect (self, arc->target, path, outputs);
+          g_string_truncate (path, path->len - 1);
+        }
+
+      if (arc->flags & ARC_LAST)
+        break;
+    }
+}
+
+/**
+ * gy_lemma_index_lookup:
+ * @self: a #GyLemmaIndex
+ * @form: an inflected form
+ *
+ * Finds the lemmas of @form. They are folded with
+ * gy_utility_fold_search_key().
+ *
+ * Returns: (transfer full) (nullable): the lemmas, or %NULL if @form is
+ * not in the index. Free with g_strfreev().
+ */
+GStrv
+gy_lemma_index_lookup (GyLemmaIndex *self,
+                       const gchar  *form)
+{
+  g_autofree gchar *folded = NULL;
+  g_autoptr(GPtrArray) outputs = NULL;
+  g_autoptr(GString) path = NULL;
+  GPtrArray *lemmas;
+  guint32 state;
+  gboolean final = FALSE;
+  gsize len;
+
+  g_return_val_if_fail (GY_IS_LEMMA_INDEX (self), NULL);
+  g_return_val_if_fail (form != NULL, NULL);
+
+  if ((folded = gy_utility_fold_search_key (form, -1)) == NULL || *folded == '\0')
+    return NULL;
+
+  len = strlen (folded);
+  state = self->root;
+
+  for (gsize i = 0; i <= len; i++)
+    {
+      guint8 label = i < len ? (guint8) folded[i] : SEPARATOR;
+
+      if (state == NO_ARCS || !step (self, &state, label, &final))
+        return NULL;
+    }
+
+  outputs = g_ptr_array_new_with_free_func (g_free);
+  path = g_string_new (NULL);
+  collect (self, state, path, outputs);
+
+  lemmas = g_ptr_array_new ();
+
+  for (guint i = 0; i < outputs->len; i++)
+    {
+      const guint8 *output = g_ptr_array_index (outputs, i);
+      guint cut;
+
+      if (output[0] == CODE_REPLACE)
+        {
+          g_ptr_array_add (lemmas, g_strdup ((const gchar *) output + 1));
+          continue;
+        }
+
+      if (output[0] < CODE_OFFSET || (cut = output[0] - CODE_OFFSET) > len)
+        continue;
+
+      g_ptr_array_add (lemmas, g_strdup_printf ("%.*s%s", (gint) (len - cut), folded,
+                                                (const gchar *) output + 1));
+    }
+
+  if (lemmas->len == 0)
+    {
+      g_ptr_array_unref (lemmas);
+      return NULL;
+    }
+
+  g_ptr_array_add (lemmas, NULL);
+
+  return (GStrv) g_ptr_array_free (lemmas, FALSE);
+}
+
+/**
+ * gy_lemma_index_resolve:
+ * @self: a #GyLemmaIndex
+ * @keys: the search keys of the model to look the lemmas up in
+ * @form: an inflected form
+ *
+ * Finds the rows whose keys are the lemmas of @form. The lemmas are
+ * folded again with gy_search_keys_fold(), so the keys may ignore
+ * diacritics.
+ *
+ * Returns: (transfer full): the rows, lemma by lemma
+ */
+GArray *
+gy_lemma_index_resolve (GyLemmaIndex *self,
+                        GySearchKeys *keys,
+                        const gchar  *form)
+{
+  g_auto(GStrv) lemmas = NULL;
+  GArray *rows;
+
+  g_return_val_if_fail (GY_IS_LEMMA_INDEX (self), NULL);
+  g_return_val_if_fail (keys != NULL, NULL);
+  g_return_val_if_fail (form != NULL, NULL);
+
+  rows = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  if ((lemmas = gy_lemma_index_lookup (self, form)) == NULL)
+    return rows;
+
+  for (guint i = 0; lemmas[i] != NULL; i++)
+    {
+      g_autofree gchar *key = gy_search_keys_fold (keys, lemmas[i], -1);
+      g_autoptr(GArray) found = NULL;
+
+      if (key == NULL)
+        continue;
+
+      found = gy_search_keys_find_equal (keys, key);
+
+      for (guint j = 0; j < found->len; j++)
+        {
+          guint32 row = g_array_index (found, guint32, j);
+          gboolean seen = FALSE;
+
+          for (guint k = 0; k < rows->len && !seen; k++)
+            seen = g_array_index (rows, guint32, k) == row;
+
+          if (!seen)
+            g_array_append_val (rows, row);
+        }
+    }
+
+  return rows;
+}
@@ -0,0 +1,71 @@
+/* gy-lemma-index.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#if !defined (GYDICT_INSIDE) && !defined (GYDICT_COMPILATION)
+#error "Only <gydict.h> can be included directly."
+#endif
+
+#include <gtk/gtk.h>
+#include "gy-search-keys.h"
+
+G_BEGIN_DECLS
+
+#define GY_LEMMA_INDEX_VERSION 1
+
+#define GY_LEMMA_INDEX_ERROR (gy_lemma_index_error_quark ())
+
+/**
+ * GyLemmaIndexError:
+ * @GY_LEMMA_INDEX_ERROR_INVALID: the file is not a lemma index or is damaged
+ * @GY_LEMMA_INDEX_ERROR_VERSION: the file was written in an unsupported version
+ * @GY_LEMMA_INDEX_ERROR_BYTE_ORDER: the file was written on a host of different byte order
+ *
+ * Errors returned while loading a lemma index.
+ */
+typedef enum
+{
+  GY_LEMMA_INDEX_ERROR_INVALID,
+  GY_LEMMA_INDEX_ERROR_VERSION,
+  GY_LEMMA_INDEX_ERROR_BYTE_ORDER,
+} GyLemmaIndexError;
+
+#define GY_TYPE_LEMMA_INDEX (gy_lemma_index_get_type())
+
+G_DECLARE_FINAL_TYPE (GyLemmaIndex, gy_lemma_index, GY, LEMMA_INDEX, GObject)
+
+GQuark gy_lemma_index_error_quark (void);
+
+gboolean      gy_lemma_index_write           (const gchar * const  *forms,
+                                              const gchar * const  *lemmas,
+                                              guint                 n_pairs,
+                                              const gchar          *filename,
+                                              GError              **err);
+GyLemmaIndex *gy_lemma_index_new             (const gchar          *filename,
+                                              GError              **err);
+guint         gy_lemma_index_get_n_arcs      (GyLemmaIndex         *self);
+GStrv         gy_lemma_index_lookup          (GyLemmaIndex         *self,
+                                              const gchar          *form);
+GArray       *gy_lemma_index_resolve         (GyLemmaIndex         *self,
+                                              GySearchKeys         *keys,
+                                              const gchar          *form);
+
+G_END_DECLS
@@ -0,0 +1,1170 @@
+/* gy-search-keys.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <string.h>
+#include "gy-search-keys.h"
+#include "gy-search-keys-private.h"
+#include "helpers/gy-utility-func.h"
+
+/*
+ * The folded search keys of a model, one per row, packed like the
+ * headwords of GyHeadwordModel: a blob of NUL-terminated strings and
+ * an array of guint32 offsets into it. The keys are folded once, so
+ * a search only folds the query and compares bytes.
+ *
+ * A key may hold alternate forms of the headword separated by '|'.
+ * Every key is expanded into its forms: the key without the separators
+ * and each part between them. The forms are sorted and packed like the
+ * keys, with the row of each one in an array of their own. A row is
+ * thus found by any of its forms, and no comparison has to skip the
+ * separators. A headword index stores the forms, so they are used
+ * straight from the mapping, see gy_search_keys_new_with_forms();
+ * otherwise they are expanded and sorted on the first search.
+ *
+ * Keys folded with a #GyFoldTable ignore diacritics; the table is kept
+ * so the queries are folded the same way, see gy_search_keys_fold().
+ */
+
+/* While expanding, the offset of a form points into the joined forms if this bit is set. */
+#define JOINED_FORM 0x80000000u
+
+typedef struct
+{
+  guint32 offset;
+  guint32 length;
+  guint32 row;
+} KeyForm;
+
+typedef struct
+{
+  GySearchKeys *keys;
+  GByteArray   *joined;
+} Expansion;
+
+struct _GySearchKeys
+{
+  gint           ref_count;
+
+  GBytes        *keys;
+  GBytes        *offsets;
+  const gchar   *blob;
+  gsize          blob_size;
+  const guint32 *index;
+  guint          n_keys;
+
+  const GyFoldTable *fold_table;
+
+  /* The sorted forms and, in @order, the row of each of them. */
+  GMutex         order_mutex;
+  GBytes        *forms;
+  GBytes        *form_offsets;
+  GBytes        *form_rows;
+  const gchar   *form_blob;
+  gsize          form_blob_size;
+  const guint32 *form_index; /* n_forms + 1 offsets, the last one past the end */
+  const guint32 *order;
+  guint          n_forms;
+  gboolean       has_forms;
+};
+
+G_DEFINE_BOXED_TYPE (GySearchKeys, gy_search_keys,
+                     gy_search_keys_ref, gy_search_keys_unref)
+
+/**
+ * gy_search_keys_new:
+ * @keys: a blob of NUL-terminated folded keys
+ * @offsets: an array of #guint32 offsets into @keys, one per row
+ *
+ * Wraps keys folded with gy_utility_fold_search_key() without copying
+ * them, so they may point into a memory mapped file.
+ *
+ * Returns: (transfer full): a new #GySearchKeys
+ */
+GySearchKeys *
+gy_search_keys_new (GBytes *keys,
+                    GBytes *offsets)
+{
+  GySearchKeys *self;
+  gsize offsets_size;
+
+  g_return_val_if_fail (keys != NULL, NULL);
+  g_return_val_if_fail (offsets != NULL, NULL);
+
+  self = g_slice_new0 (GySearchKeys);
+  self->ref_count = 1;
+  self->keys = g_bytes_ref (keys);
+  self->offsets = g_bytes_ref (offsets);
+  self->blob = g_bytes_get_data (keys, &self->blob_size);
+  self->index = g_bytes_get_data (offsets, &offsets_size);
+  self->n_keys = offsets_size / sizeof (guint32);
+  g_mutex_init (&self->order_mutex);
+
+  if (self->blob_size == 0 || self->blob[self->blob_size - 1] != '\0')
+    {
+      g_critical ("The blob of search keys is not terminated by NUL.");
+      self->n_keys = 0;
+    }
+
+  return self;
+}
+
+/* Takes the sorted forms of the keys; called once, with the order mutex held or before sharing. */
+static void
+set_forms (GySearchKeys *self,
+           GBytes       *forms,
+           GBytes       *form_offsets,
+           GBytes       *form_rows)
+{
+  self->forms = forms;
+  self->form_offsets = form_offsets;
+  self->form_rows = form_rows;
+  self->form_blob = g_bytes_get_data (forms, &self->form_blob_size);
+  self->form_index = g_bytes_get_data (form_offsets, NULL);
+  self->order = g_bytes_get_data (form_rows, NULL);
+  self->n_forms = g_bytes_get_size (form_rows) / sizeof (guint32);
+  self->has_forms = TRUE;
+}
+
+/**
+ * gy_search_keys_new_with_forms:
+ * @keys: a blob of NUL-terminated folded keys
+ * @offsets: an array of #guint32 offsets into @keys, one per row
+ * @forms: a blob of the NUL-terminated forms of the keys, sorted bytewise
+ * @form_offsets: an array of #guint32 offsets into @forms, one per form
+ *   and one past the last form
+ * @form_rows: an array of #guint32 rows, the row of every form
+ *
+ * Like gy_search_keys_new(), but with the forms of the keys expanded
+ * and sorted already, as they are stored in a headword index. Nothing
+ * is copied or sorted. If the forms do not fit the keys, they are left
+ * out and expanded again on the first search.
+ *
+ * Returns: (transfer full): a new #GySearchKeys
+ */
+GySearchKeys *
+gy_search_keys_new_with_forms (GBytes *keys,
+                               GBytes *offsets,
+                               GBytes *forms,
+                               GBytes *form_offsets,
+                               GBytes *form_rows)
+{
+  GySearchKeys *self;
+  const guint32 *rows;
+  gsize n_forms;
+
+  g_return_val_if_fail (forms != NULL, NULL);
+  g_return_val_if_fail (form_offsets != NULL, NULL);
+  g_return_val_if_fail (form_rows != NULL, NULL);
+
+  self = gy_search_keys_new (keys, offsets);
+  rows = g_bytes_get_data (form_rows, NULL);
+  n_forms = g_bytes_get_size (form_rows) / sizeof (guint32);
+
+  if (g_bytes_get_size (form_offsets) != (n_forms + 1) * sizeof (guint32) ||
+      n_forms < self->n_keys)
+    {
+      g_critical ("The forms of the search keys do not match the keys.");
+      return self;
+    }
+
+  /* The rows index the arrays of the model, so they are checked once. */
+  for (gsize i = 0; i < n_forms; i++)
+    {
+      if (rows[i] >= self->n_keys)
+        {
+          g_critical ("A form of the search keys points past the last row.");
+          return self;
+        }
+    }
+
+  set_forms (self, g_bytes_ref (forms), g_bytes_ref (form_offsets), g_bytes_ref (form_rows));
+
+  return self;
+}
+
+/* Folds @value and appends it to the keys. */
+static void
+append_key (GByteArray        *blob,
+            GArray            *offsets,
+            const gchar       *value,
+            const GyFoldTable *fold_table)
+{
+  g_autofree gchar *key = NULL;
+  guint32 offset = blob->len;
+
+  if (value != NULL && fold_table != NULL)
+    key = gy_fold_table_fold (fold_table, value, -1);
+  else if (value != NULL)
+    key = gy_utility_fold_search_key (value, -1);
+
+  g_array_append_val (offsets, offset);
+  g_byte_array_append (blob, (const guint8 *) (key ? key : ""), (key ? strlen (key) : 0) + 1);
+}
+
+static GySearchKeys *
+keys_new_take (GByteArray        *blob,
+               GArray            *offsets,
+               const GyFoldTable *fold_table)
+{
+  GySearchKeys *self;
+  g_autoptr(GBytes) blob_bytes = NULL;
+  g_autoptr(GBytes) offsets_bytes = NULL;
+
+  if (blob->len == 0)
+    g_byte_array_append (blob, (const guint8 *) "", 1);
+
+  blob_bytes = g_byte_array_free_to_bytes (blob);
+  offsets_bytes = g_bytes_new (offsets->data, offsets->len * sizeof (guint32));
+
+  self = gy_search_keys_new (blob_bytes, offsets_bytes);
+  self->fold_table = fold_table;
+
+  return self;
+}
+
+/**
+ * gy_search_keys_new_from_model:
+ * @model: a list model
+ * @column: a column of type %G_TYPE_STRING
+ *
+ * Folds the strings of @column of every row of @model.
+ *
+ * Returns: (transfer full): a new #GySearchKeys
+ */
+GySearchKeys *
+gy_search_keys_new_from_model (GtkTreeModel *model,
+                               gint          column)
+{
+  return gy_search_keys_new_from_model_full (model, column, NULL);
+}
+
+/**
+ * gy_search_keys_new_from_model_full:
+ * @model: a list model
+ * @column: a column of type %G_TYPE_STRING
+ * @fold_table: (nullable): the table to fold the strings with, or %NULL
+ *   for gy_utility_fold_search_key()
+ *
+ * Folds the strings of @column of every row of @model with @fold_table.
+ *
+ * Returns: (transfer full): a new #GySearchKeys
+ */
+GySearchKeys *
+gy_search_keys_new_from_model_full (GtkTreeModel      *model,
+                                    gint               column,
+                                    const GyFoldTable *fold_table)
+{
+  g_autoptr(GByteArray) blob = NULL;
+  g_autoptr(GArray) offsets = NULL;
+  GtkTreeIter iter;
+  gboolean valid;
+
+  g_return_val_if_fail (GTK_IS_TREE_MODEL (model), NULL);
+
+  blob = g_byte_array_new ();
+  offsets = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+                               gtk_tree_model_iter_n_children (model, NULL));
+
+  for (valid = gtk_tree_model_get_iter_first (model, &iter);
+       valid;
+       valid = gtk_tree_model_iter_next (model, &iter))
+    {
+      g_autofree gchar *value = NULL;
+
+      gtk_tree_model_get (model, &iter, column, &value, -1);
+      append_key (blob, offsets, value, fold_table);
+    }
+
+  return keys_new_take (g_steal_pointer (&blob), offsets, fold_table);
+}
+
+/**
+ * gy_search_keys_new_from_strv:
+ * @strings: (array zero-terminated=1): the strings of the rows, in order
+ * @fold_table: (nullable): the table to fold the strings with, or %NULL
+ *   for gy_utility_fold_search_key()
+ *
+ * Like gy_search_keys_new_from_model_full(), but from strings copied out
+ * of a model, so they can be folded on another thread than the one the
+ * model belongs to.
+ *
+ * Returns: (transfer full): a new #GySearchKeys
+ */
+GySearchKeys *
+gy_search_keys_new_from_strv (const gchar * const *strings,
+                              const GyFoldTable   *fold_table)
+{
+  g_autoptr(GByteArray) blob = NULL;
+  g_autoptr(GArray) offsets = NULL;
+
+  g_return_val_if_fail (strings != NULL, NULL);
+
+  blob = g_byte_array_new ();
+  offsets = g_array_sized_new (FALSE, FALSE, sizeof (guint32), g_strv_length ((gchar **) strings));
+
+  for (guint i = 0; strings[i] != NULL; i++)
+    append_key (blob, offsets, strings[i], fold_table);
+
+  return keys_new_take (g_steal_pointer (&blob), offsets, fold_table);
+}
+
+GySearchKeys *
+gy_search_keys_ref (GySearchKeys *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+gy_search_keys_unref (GySearchKeys *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  g_clear_pointer (&self->keys, g_bytes_unref);
+  g_clear_pointer (&self->offsets, g_bytes_unref);
+  g_clear_pointer (&self->forms, g_bytes_unref);
+  g_clear_pointer (&self->form_offsets, g_bytes_unref);
+  g_clear_pointer (&self->form_rows, g_bytes_unref);
+  g_mutex_clear (&self->order_mutex);
+  g_slice_free (GySearchKeys, self);
+}
+
+guint
+gy_search_keys_get_n_keys (GySearchKeys *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_keys;
+}
+
+/**
+ * gy_search_keys_get_fold_table:
+ * @keys: a #GySearchKeys
+ *
+ * Returns: (transfer none) (nullable): the table the keys were folded
+ * with, or %NULL if they were folded with gy_utility_fold_search_key()
+ */
+const GyFoldTable *
+gy_search_keys_get_fold_table (GySearchKeys *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->fold_table;
+}
+
+/**
+ * gy_search_keys_fold:
+ * @keys: a #GySearchKeys
+ * @str: a UTF-8 string
+ * @len: length of @str in bytes, or -1 if @str is nul-terminated
+ *
+ * Folds a query the way the keys were folded.
+ *
+ * Returns: (transfer full) (nullable): the folded query, or %NULL if
+ * @str is not valid UTF-8. Free with g_free().
+ */
+gchar *
+gy_search_keys_fold (GySearchKeys *self,
+                     const gchar  *str,
+                     gssize        len)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (str != NULL, NULL);
+
+  if (self->fold_table != NULL)
+    return gy_fold_table_fold (self->fold_table, str, len);
+
+  return gy_utility_fold_search_key (str, len);
+}
+
+static inline const gchar *
+key_at (GySearchKeys *self,
+        guint         idx)
+{
+  guint32 offset = self->index[idx];
+
+  return offset < self->blob_size ? self->blob + offset : "";
+}
+
+static inline const gchar *
+get_key (GySearchKeys *self,
+         guint         idx,
+         gsize        *length)
+{
+  const gchar *key = key_at (self, idx);
+
+  *length = strlen (key);
+
+  return key;
+}
+
+/**
+ * gy_search_keys_get_key:
+ * @keys: a #GySearchKeys
+ * @idx: the row
+ * @length: (out) (optional): return location for the length of the key
+ *
+ * Returns: (transfer none): the folded key of the row @idx
+ */
+const gchar *
+gy_search_keys_get_key (GySearchKeys *self,
+                        guint         idx,
+                        gsize        *length)
+{
+  gsize len;
+  const gchar *key;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (idx < self->n_keys, NULL);
+
+  key = get_key (self, idx, &len);
+
+  if (length != NULL)
+    *length = len;
+
+  return key;
+}
+
+static inline const gchar *
+expanded_text (Expansion     *expansion,
+               const KeyForm *form)
+{
+  if (form->offset & JOINED_FORM)
+    return (const gchar *) expansion->joined->data + (form->offset & ~JOINED_FORM);
+
+  return expansion->keys->blob + form->offset;
+}
+
+static gint
+compare_forms (gconstpointer a,
+               gconstpointer b,
+               gpointer      data)
+{
+  Expansion *expansion = data;
+  const KeyForm *form_a = a;
+  const KeyForm *form_b = b;
+  gint res;
+
+  res = memcmp (expanded_text (expansion, form_a), expanded_text (expansion, form_b),
+                MIN (form_a->length, form_b->length));
+
+  if (res == 0)
+    res = (form_a->length > form_b->length) - (form_a->length < form_b->length);
+
+  return res != 0 ? res : (form_a->row > form_b->row) - (form_a->row < form_b->row);
+}
+
+static gboolean
+has_form (Expansion   *expansion,
+          GArray      *forms,
+          guint        first,
+          const gchar *text,
+          gsize        length)
+{
+  for (guint i = first; i < forms->len; i++)
+    {
+      const KeyForm *form = &g_array_index (forms, KeyForm, i);
+
+      if (form->length == length && memcmp (expanded_text (expansion, form), text, length) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Appends the forms of the key of @row to @forms. */
+static void
+add_forms (Expansion *expansion,
+           GArray    *forms,
+           guint32    row)
+{
+  GySearchKeys *self = expansion->keys;
+  GByteArray *joined = expansion->joined;
+  const gchar *key = self->index[row] < self->blob_size ? self->blob + self->index[row] : NULL;
+  const gchar *end;
+  KeyForm form;
+  guint first;
+
+  form.offset = key != NULL ? self->index[row] : 0;
+  form.length = key != NULL ? strlen (key) : 0;
+  form.row = row;
+
+  if (key == NULL || memchr (key, '|', form.length) == NULL)
+    {
+      g_array_append_val (forms, form);
+      return;
+    }
+
+  end = key + form.length;
+  first = forms->len;
+
+  form.offset = joined->len | JOINED_FORM;
+  for (const gchar *p = key; p < end; p++)
+    {
+      if (*p != '|')
+        g_byte_array_append (joined, (const guint8 *) p, 1);
+    }
+  form.length = joined->len - (form.offset & ~JOINED_FORM);
+  g_array_append_val (forms, form);
+
+  for (const gchar *p = key; p <= end;)
+    {
+      const gchar *bar = memchr (p, '|', end - p);
+
+      if (bar == NULL)
+        bar = end;
+
+      if (bar > p && !has_form (expansion, forms, first, p, bar - p))
+        {
+          form.offset = p - self->blob;
+          form.length = bar - p;
+          g_array_append_val (forms, form);
+        }
+
+      p = bar + 1;
+    }
+}
+
+/* Expands the keys into their forms, sorts and packs them. */
+static void
+expand_forms (GySearchKeys *self)
+{
+  g_autoptr(GArray) forms = NULL;
+  g_autoptr(GByteArray) joined = NULL;
+  GByteArray *blob;
+  guint32 *offsets;
+  guint32 *rows;
+  Expansion expansion;
+
+  forms = g_array_sized_new (FALSE, FALSE, sizeof (KeyForm), MAX (self->n_keys, 1));
+  joined = g_byte_array_new ();
+  expansion.keys = self;
+  expansion.joined = joined;
+
+  for (guint i = 0; i < self->n_keys; i++)
+    add_forms (&expansion, forms, i);
+
+  g_array_sort_with_data (forms, compare_forms, &expansion);
+
+  blob = g_byte_array_new ();
+  offsets = g_new (guint32, forms->len + 1);
+  rows = g_new (guint32, MAX (forms->len, 1));
+
+  for (guint i = 0; i < forms->len; i++)
+    {
+      const KeyForm *form = &g_array_index (forms, KeyForm, i);
+
+      offsets[i] = blob->len;
+      rows[i] = form->row;
+      g_byte_array_append (blob, (const guint8 *) expanded_text (&expansion, form), form->length);
+      g_byte_array_append (blob, (const guint8 *) "", 1);
+    }
+  offsets[forms->len] = blob->len;
+
+  set_forms (self,
+             g_byte_array_free_to_bytes (blob),
+             g_bytes_new_take (offsets, (forms->len + 1) * sizeof (guint32)),
+             g_bytes_new_take (rows, forms->len * sizeof (guint32)));
+}
+
+/* Expands the keys into their forms on the first call, unless they came with them. */
+static const guint32 *
+get_order (GySearchKeys *self)
+{
+  g_mutex_lock (&self->order_mutex);
+
+  if (!self->has_forms)
+    expand_forms (self);
+
+  g_mutex_unlock (&self->order_mutex);
+
+  return self->order;
+}
+
+static inline const gchar *
+form_at (GySearchKeys *self,
+         guint         pos,
+         gsize        *length)
+{
+  guint32 offset = self->form_index[pos];
+  guint32 next = self->form_index[pos + 1];
+
+  if (offset >= next || next > self->form_blob_size)
+    {
+      *length = 0;
+      return "";
+    }
+
+  *length = next - offset - 1;
+
+  return self->form_blob + offset;
+}
+
+/*
+ * Gets the sorted forms of @self, packed as gy_search_keys_new_with_forms()
+ * takes them, to be stored along with the keys.
+ */
+void
+_gy_search_keys_get_forms (GySearchKeys  *self,
+                           GBytes       **forms,
+                           GBytes       **form_offsets,
+                           GBytes       **form_rows)
+{
+  get_order (self);
+
+  *forms = g_bytes_ref (self->forms);
+  *form_offsets = g_bytes_ref (self->form_offsets);
+  *form_rows = g_bytes_ref (self->form_rows);
+}
+
+static inline gint
+prefix_cmp_form (GySearchKeys *self,
+                 guint         pos,
+                 const gchar  *prefix,
+                 gsize         prefix_len)
+{
+  gsize length;
+  const gchar *form = form_at (self, pos, &length);
+
+  return gy_utility_prefix_cmp_len (prefix, prefix_len, form, length);
+}
+
+/* Returns the first position in the sorted forms not sorting before @prefix. */
+static guint
+lower_bound (GySearchKeys *self,
+             const gchar  *prefix,
+             gsize         prefix_len)
+{
+  guint lo = 0;
+  guint hi = self->n_forms;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (prefix_cmp_form (self, mid, prefix, prefix_len) > 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+/* Returns the first position in the sorted forms from @from on which does not begin with @prefix. */
+static guint
+upper_bound (GySearchKeys *self,
+             guint         from,
+             const gchar  *prefix,
+             gsize         prefix_len)
+{
+  guint lo = from;
+  guint hi = self->n_forms;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (prefix_cmp_form (self, mid, prefix, prefix_len) == 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+/* Bisects the keys of rows sorted by them, without expanding the forms. */
+static gint
+find_sorted_row (GySearchKeys *self,
+                 const gchar  *prefix,
+                 gsize         prefix_len)
+{
+  guint lo = 0;
+  guint hi = self->n_keys;
+  const gchar *key;
+  gsize len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      key = get_key (self, mid, &len);
+
+      if (gy_utility_prefix_cmp_len (prefix, prefix_len, key, len) > 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo == self->n_keys)
+    return -1;
+
+  key = get_key (self, lo, &len);
+
+  return gy_utility_prefix_cmp_len (prefix, prefix_len, key, len) == 0 ? (gint) lo : -1;
+}
+
+/**
+ * gy_search_keys_find_prefix:
+ * @keys: a #GySearchKeys
+ * @prefix: a query folded with gy_search_keys_fold()
+ * @sorted: whether the rows are sorted by their keys
+ *
+ * Finds the first row with a form beginning with @prefix. For sorted
+ * rows it first bisects the keys as they are. Otherwise, or if that
+ * finds nothing, it bisects the sorted forms and returns the lowest
+ * matching row, the one a scan from the top would find.
+ *
+ * Returns: the row, or -1 if no form begins with @prefix
+ */
+gint
+gy_search_keys_find_prefix (GySearchKeys *self,
+                            const gchar  *prefix,
+                            gboolean      sorted)
+{
+  gsize prefix_len;
+  guint pos;
+  gint row = -1;
+
+  g_return_val_if_fail (self != NULL, -1);
+  g_return_val_if_fail (prefix != NULL, -1);
+
+  prefix_len = strlen (prefix);
+
+  if (sorted && (row = find_sorted_row (self, prefix, prefix_len)) >= 0)
+    return row;
+
+  get_order (self);
+
+  for (pos = lower_bound (self, prefix, prefix_len);
+       pos < self->n_forms && prefix_cmp_form (self, pos, prefix, prefix_len) == 0;
+       pos++)
+    {
+      if (row < 0 || self->order[pos] < (guint32) row)
+        row = self->order[pos];
+    }
+
+  return row;
+}
+
+/**
+ * gy_search_keys_get_sorted_rows:
+ * @keys: a #GySearchKeys
+ * @n_rows: (out) (optional): return location for the length of the array
+ *
+ * Gets the rows in the order of their forms, expanding and sorting
+ * them on the first call unless the keys came with their forms. A row
+ * with alternate forms is in the array once for each of them, so it
+ * has more elements than there are keys.
+ *
+ * Returns: (transfer none) (array length=n_rows): the sorted rows
+ */
+const guint32 *
+gy_search_keys_get_sorted_rows (GySearchKeys *self,
+                                guint        *n_rows)
+{
+  const guint32 *order;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  order = get_order (self);
+
+  if (n_rows != NULL)
+    *n_rows = self->n_forms;
+
+  return order;
+}
+
+/**
+ * gy_search_keys_get_prefix_range:
+ * @keys: a #GySearchKeys
+ * @prefix: a query folded with gy_search_keys_fold()
+ * @begin: (out): return location for the first position
+ * @end: (out): return location for the position past the last one
+ *
+ * Finds the positions in gy_search_keys_get_sorted_rows() of the forms
+ * which begin with @prefix. They are contiguous; a row may be in the
+ * range more than once.
+ *
+ * Returns: %TRUE if any form begins with @prefix
+ */
+gboolean
+gy_search_keys_get_prefix_range (GySearchKeys *self,
+                                 const gchar  *prefix,
+                                 guint        *begin,
+                                 guint        *end)
+{
+  gsize prefix_len;
+  guint lo, hi;
+
+  g_return_val_if_fail (self != NULL && prefix != NULL, FALSE);
+  g_return_val_if_fail (begin != NULL && end != NULL, FALSE);
+
+  get_order (self);
+  prefix_len = strlen (prefix);
+  lo = lower_bound (self, prefix, prefix_len);
+  hi = upper_bound (self, lo, prefix, prefix_len);
+
+  *begin = lo;
+  *end = hi;
+
+  return lo < hi;
+}
+
+static gint
+compare_guint32 (gconstpointer a,
+                 gconstpointer b)
+{
+  guint32 x = *(const guint32 *) a;
+  guint32 y = *(const guint32 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * gy_search_keys_find_equal:
+ * @keys: a #GySearchKeys
+ * @key: a query folded with gy_search_keys_fold()
+ *
+ * Finds the rows with a form which is @key as a whole.
+ *
+ * Returns: (transfer full): the rows in ascending order
+ */
+GArray *
+gy_search_keys_find_equal (GySearchKeys *self,
+                           const gchar  *key)
+{
+  GArray *rows;
+  gsize key_len;
+  guint begin, end;
+  guint n = 0;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  rows = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  if (*key == '\0' || !gy_search_keys_get_prefix_range (self, key, &begin, &end))
+    return rows;
+
+  /* The forms equal to the prefix sort first in its range. */
+  key_len = strlen (key);
+
+  for (guint pos = begin; pos < end; pos++)
+    {
+      gsize length;
+
+      form_at (self, pos, &length);
+
+      if (length != key_len)
+        break;
+
+      g_array_append_val (rows, self->order[pos]);
+    }
+
+  g_array_sort (rows, compare_guint32);
+
+  /* Two forms of a row may be equal once folded. */
+  for (guint i = 0; i < rows->len; i++)
+    {
+      if (n == 0 || g_array_index (rows, guint32, n - 1) != g_array_index (rows, guint32, i))
+        g_array_index (rows, guint32, n++) = g_array_index (rows, guint32, i);
+    }
+  g_array_set_size (rows, n);
+
+  return rows;
+}
+
+typedef struct
+{
+  guint32 row;
+  guint   distance;
+} FuzzyMatch;
+
+static gint
+compare_fuzzy_matches (gconstpointer a,
+                       gconstpointer b)
+{
+  const FuzzyMatch *m1 = a;
+  const FuzzyMatch *m2 = b;
+
+  if (m1->distance != m2->distance)
+    return m1->distance < m2->distance ? -1 : 1;
+
+  return m1->row < m2->row ? -1 : m1->row > m2->row;
+}
+
+/*
+ * The best @limit matches found so far, in a heap whose root is the
+ * worst of them, so a better match takes its place in O(log limit).
+ * @slots maps a row to its position in the heap, so a row found again
+ * by another of its forms keeps only the nearer match.
+ */
+typedef struct
+{
+  GArray     *heap;
+  GHashTable *slots;
+  guint       limit;
+} FuzzyHeap;
+
+#define FUZZY_AT(h, i) (&g_array_index ((h)->heap, FuzzyMatch, (i)))
+
+static void
+fuzzy_heap_set (FuzzyHeap        *h,
+                guint             i,
+                const FuzzyMatch *match)
+{
+  *FUZZY_AT (h, i) = *match;
+  g_hash_table_insert (h->slots, GUINT_TO_POINTER (match->row), GUINT_TO_POINTER (i));
+}
+
+static void
+fuzzy_heap_sift_up (FuzzyHeap *h,
+                    guint      i)
+{
+  FuzzyMatch match = *FUZZY_AT (h, i);
+
+  while (i > 0 && compare_fuzzy_matches (&match, FUZZY_AT (h, (i - 1) / 2)) > 0)
+    {
+      fuzzy_heap_set (h, i, FUZZY_AT (h, (i - 1) / 2));
+      i = (i - 1) / 2;
+    }
+
+  fuzzy_heap_set (h, i, &match);
+}
+
+static void
+fuzzy_heap_sift_down (FuzzyHeap *h,
+                      guint      i)
+{
+  FuzzyMatch match = *FUZZY_AT (h, i);
+
+  for (;;)
+    {
+      guint child = 2 * i + 1;
+
+      if (child >= h->heap->len)
+        break;
+      if (child + 1 < h->heap->len &&
+          compare_fuzzy_matches (FUZZY_AT (h, child + 1), FUZZY_AT (h, child)) > 0)
+        child++;
+      if (compare_fuzzy_matches (FUZZY_AT (h, child), &match) <= 0)
+        break;
+
+      fuzzy_heap_set (h, i, FUZZY_AT (h, child));
+      i = child;
+    }
+
+  fuzzy_heap_set (h, i, &match);
+}
+
+static void
+fuzzy_heap_add (FuzzyHeap        *h,
+                const FuzzyMatch *match)
+{
+  gpointer slot;
+
+  if (g_hash_table_lookup_extended (h->slots, GUINT_TO_POINTER (match->row), NULL, &slot))
+    {
+      FuzzyMatch *old = FUZZY_AT (h, GPOINTER_TO_UINT (slot));
+
+      /* A nearer match is better, so it moves away from the root. */
+      if (match->distance < old->distance)
+        {
+          old->distance = match->distance;
+          fuzzy_heap_sift_down (h, GPOINTER_TO_UINT (slot));
+        }
+    }
+  else if (h->heap->len < h->limit)
+    {
+      g_array_set_size (h->heap, h->heap->len + 1);
+      fuzzy_heap_set (h, h->heap->len - 1, match);
+      fuzzy_heap_sift_up (h, h->heap->len - 1);
+    }
+  else if (compare_fuzzy_matches (match, FUZZY_AT (h, 0)) < 0)
+    {
+      g_hash_table_remove (h->slots, GUINT_TO_POINTER (FUZZY_AT (h, 0)->row));
+      fuzzy_heap_set (h, 0, match);
+      fuzzy_heap_sift_down (h, 0);
+    }
+}
+
+/* The greatest distance a match may still have to get into the heap. */
+static inline guint
+fuzzy_heap_bound (FuzzyHeap *h,
+                  guint      max_distance)
+{
+  if (h->heap->len < h->limit)
+    return max_distance;
+
+  return MIN (max_distance, FUZZY_AT (h, 0)->distance);
+}
+
+/**
+ * gy_search_keys_find_fuzzy:
+ * @keys: a #GySearchKeys
+ * @query: a query folded with gy_search_keys_fold()
+ * @max_distance: the greatest number of edits allowed
+ * @limit: the greatest number of rows to return
+ *
+ * Finds the rows with a form at most @max_distance insertions,
+ * deletions or substitutions of a character away from @query.
+ *
+ * The forms are walked in sorted order, so a row of the edit distance
+ * table computed for a prefix serves every form beginning with it. As
+ * soon as no cell of a row is within @max_distance, no form with that
+ * prefix can match, and the whole range of them is skipped with a
+ * bisection. Only a small part of the forms is ever looked at. Once
+ * @limit rows are found, only nearer ones are looked for.
+ *
+ * Returns: (transfer full) (element-type guint32): the rows, nearest first
+ */
+GArray *
+gy_search_keys_find_fuzzy (GySearchKeys *self,
+                           const gchar  *query,
+                           guint         max_distance,
+                           guint         limit)
+{
+  g_autofree gunichar *pattern = NULL;
+  g_autoptr(GArray) table = NULL;
+  g_autoptr(GArray) chars = NULL;
+  g_autoptr(GHashTable) slots = NULL;
+  g_autoptr(GArray) found = NULL;
+  FuzzyHeap heap;
+  GArray *rows;
+  glong n_pattern;
+  guint width;
+  guint depth = 0;
+  guint pos = 0;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (query != NULL, NULL);
+
+  rows = g_array_new (FALSE, FALSE, sizeof (guint32));
+  pattern = g_utf8_to_ucs4_fast (query, -1, &n_pattern);
+  width = n_pattern + 1;
+
+  /* Row d of the table holds the distances between the first d characters
+   * of the current form and every prefix of the query. */
+  table = g_array_sized_new (FALSE, FALSE, sizeof (guint), width * 32);
+  g_array_set_size (table, width);
+  for (guint j = 0; j < width; j++)
+    g_array_index (table, guint, j) = j;
+
+  chars = g_array_new (FALSE, FALSE, sizeof (gunichar));
+  found = g_array_sized_new (FALSE, FALSE, sizeof (FuzzyMatch), limit);
+  slots = g_hash_table_new (g_direct_hash, g_direct_equal);
+  heap.heap = found;
+  heap.slots = slots;
+  heap.limit = limit;
+  get_order (self);
+
+  while (pos < self->n_forms && limit > 0)
+    {
+      gsize length;
+      const gchar *p = form_at (self, pos, &length);
+      const gchar *end = p + length;
+      gboolean pruned = FALSE;
+      guint common = 0;
+
+      /* The rows of the prefix shared with the previous form are still valid. */
+      while (p < end)
+        {
+          if (common == depth || g_array_index (chars, gunichar, common) != g_utf8_get_char (p))
+            break;
+
+          common++;
+          p = g_utf8_next_char (p);
+        }
+
+      depth = common;
+      g_array_set_size (chars, depth);
+
+      for (; p < end; p = g_utf8_next_char (p))
+        {
+          gunichar c;
+          guint *prev;
+          guint *row;
+          guint best;
+
+          c = g_utf8_get_char (p);
+          g_array_append_val (chars, c);
+          g_array_set_size (table, (depth + 2) * width);
+
+          prev = &g_array_index (table, guint, depth * width);
+          row = prev + width;
+          row[0] = best = depth + 1;
+
+          for (guint j = 1; j < width; j++)
+            {
+              guint cost = prev[j - 1] + (pattern[j - 1] != c);
+
+              cost = MIN (cost, prev[j] + 1);
+              cost = MIN (cost, row[j - 1] + 1);
+              row[j] = cost;
+              best = MIN (best, cost);
+            }
+
+          depth++;
+
+          if (best > fuzzy_heap_bound (&heap, max_distance))
+            {
+              pruned = TRUE;
+              break;
+            }
+        }
+
+      if (pruned)
+        {
+          g_autofree gchar *prefix = NULL;
+          glong prefix_len;
+
+          prefix = g_ucs4_to_utf8 ((gunichar *) (gpointer) chars->data, depth,
+                                   NULL, &prefix_len, NULL);
+          pos = upper_bound (self, pos + 1, prefix, prefix_len);
+        }
+      else
+        {
+          FuzzyMatch match;
+
+          match.row = self->order[pos];
+          match.distance = g_array_index (table, guint, depth * width + n_pattern);
+
+          if (match.distance <= fuzzy_heap_bound (&heap, max_distance))
+            fuzzy_heap_add (&heap, &match);
+
+          pos++;
+        }
+    }
+
+  g_array_sort (found, compare_fuzzy_matches);
+
+  for (guint i = 0; i < found->len; i++)
+    g_array_append_val (rows, g_array_index (found, FuzzyMatch, i).row);
+
+  return rows;
+}
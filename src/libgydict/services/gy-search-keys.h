@@ -0,0 +1,79 @@
+/* gy-search-keys.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#if !defined (GYDICT_INSIDE) && !defined (GYDICT_COMPILATION)
+#error "Only <gydict.h> can be included directly."
+#endif
+
+#include <gtk/gtk.h>
+#include "helpers/gy-fold-table.h"
+
+G_BEGIN_DECLS
+
+#define GY_TYPE_SEARCH_KEYS (gy_search_keys_get_type ())
+
+typedef struct _GySearchKeys GySearchKeys;
+
+GType         gy_search_keys_get_type        (void) G_GNUC_CONST;
+GySearchKeys *gy_search_keys_new             (GBytes       *keys,
+                                              GBytes       *offsets);
+GySearchKeys *gy_search_keys_new_with_forms  (GBytes       *keys,
+                                              GBytes       *offsets,
+                                              GBytes       *forms,
+                                              GBytes       *form_offsets,
+                                              GBytes       *form_rows);
+GySearchKeys *gy_search_keys_new_from_model  (GtkTreeModel *model,
+                                              gint          column);
+GySearchKeys *gy_search_keys_new_from_model_full (GtkTreeModel      *model,
+                                                  gint               column,
+                                                  const GyFoldTable *fold_table);
+GySearchKeys *gy_search_keys_new_from_strv  (const gchar * const *strings,
+                                              const GyFoldTable   *fold_table);
+GySearchKeys *gy_search_keys_ref             (GySearchKeys *keys);
+void          gy_search_keys_unref           (GySearchKeys *keys);
+guint         gy_search_keys_get_n_keys      (GySearchKeys *keys);
+const GyFoldTable *gy_search_keys_get_fold_table (GySearchKeys *keys);
+gchar        *gy_search_keys_fold            (GySearchKeys *keys,
+                                              const gchar  *str,
+                                              gssize        len);
+const gchar  *gy_search_keys_get_key         (GySearchKeys *keys,
+                                              guint         idx,
+                                              gsize        *length);
+gint          gy_search_keys_find_prefix     (GySearchKeys *keys,
+                                              const gchar  *prefix,
+                                              gboolean      sorted);
+const guint32 *gy_search_keys_get_sorted_rows (GySearchKeys *keys,
+                                               guint        *n_rows);
+gboolean      gy_search_keys_get_prefix_range (GySearchKeys *keys,
+                                               const gchar  *prefix,
+                                               guint        *begin,
+                                               guint        *end);
+GArray       *gy_search_keys_find_equal      (GySearchKeys *keys,
+                                              const gchar  *key);
+GArray       *gy_search_keys_find_fuzzy      (GySearchKeys *keys,
+                                              const gchar  *query,
+                                              guint         max_distance,
+                                              guint         limit);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GySearchKeys, gy_search_keys_unref)
+
+G_END_DECLS
@@ -18,17 +18,499 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <string.h>
+
 #include "gy-service-provider.h"
+#include "gy-definition-cache.h"
+#include "gy-dict-searchable.h"
+#include "gy-headword-model.h"
+#include "gy-search-keys.h"
+#include "gy-service-private.h"
+
+#define DEFAULT_CACHE_BUDGET (16 * 1024 * 1024)
+#define DEFAULT_IDLE_TIMEOUT 300
+
+/* How often the services built by factories are checked for idleness. */
+#define IDLE_CHECK_INTERVAL 30
+
+/* How long a prefetch waits before it checks again whether it was cancelled. */
+#define PREFETCH_YIELD_USEC (50 * G_TIME_SPAN_MILLISECOND)
+
+/* The number of services searched at the same time by a federated search. */
+#define SEARCH_THREADS 4
 
 struct _GyServiceProvider
 {
   GObject parent_instance;
 
-  GSList *services;
+  /* Readers use the current snapshot without locking, see snapshot_enter(). */
+  GHashTable *snapshot;
+  GPtrArray  *retired;
+  gint        n_retired;
+  gint        n_readers;
+  GMutex      writer_mutex;
+
+  GyDefinitionCache *cache;
+
+  guint idle_timeout;
+  guint idle_source;
+
+  /* Prefetching runs on its own thread and gives way to interactive lookups. */
+  GThreadPool *prefetch_pool;
+  GMutex       interactive_mutex;
+  GCond        interactive_cond;
+  guint        n_interactive;
+  gint         disposed;
+
+  /* Federated searches ask several services at once. */
+  GThreadPool       *search_pool;
+  const GyFoldTable *fold_table;
 };
 
+typedef struct
+{
+  GyDefinitionCache *cache;
+  GyDictService     *service;
+  GCancellable      *cancellable;
+  guint             *indices;
+  guint              n_indices;
+  guint              current;
+  gboolean           batch;
+} PrefetchJob;
+
+typedef struct
+{
+  gint              ref_count;
+  gchar            *service_id;
+
+  /* Set for a service built on demand. */
+  GType             service_type;
+  GyServiceFactory  factory;
+  gpointer          factory_data;
+  GDestroyNotify    factory_destroy;
+
+  GMutex            mutex;
+  GyService        *service;
+  gint64            last_used;
+  gboolean          removed;
+
+  /* Whether anybody but the entry holds a service built on demand. */
+  gint              in_use;
+
+  /* Keys of the model of a service which cannot search by itself,
+   * folded with the table they report. */
+  GySearchKeys     *search_keys;
+} ServiceEntry;
+
+typedef struct
+{
+  gint                  ref_count;
+  GMainContext         *context;
+  GTask                *task;
+  GCancellable         *cancellable;
+  gchar                *query;
+  const GyFoldTable    *fold_table;
+  guint                 limit;
+  gint64                deadline;
+  GSource              *timeout_source;
+  GSource              *cancel_source;
+  GyServiceResultsFunc  results_func;
+  gpointer              results_data;
+  GDestroyNotify        results_destroy;
+
+  /* Touched only in the context of the search. */
+  guint                 n_pending;
+  /* Set once the task has returned, read by the workers. */
+  gint                  finished;
+} FederatedSearch;
+
+typedef struct
+{
+  FederatedSearch *search;
+  ServiceEntry    *entry;
+  GyDictService   *service;
+  GtkTreeModel    *model;
+  GArray          *rows;
+} SearchJob;
+
 G_DEFINE_TYPE (GyServiceProvider, gy_service_provider, G_TYPE_OBJECT)
 
+enum
+{
+  PROP_0,
+  PROP_CACHE_BUDGET,
+  PROP_IDLE_TIMEOUT,
+  N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES];
+
+enum
+{
+  SERVICE_REGISTERED,
+  SERVICE_UNREGISTERED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/*
+ * A service built on demand is held through a toggle reference, which
+ * tells the entry when it is the last holder, see unload_idle_services().
+ */
+static void
+service_entry_toggle_notify (gpointer  data,
+                             GObject  *object,
+                             gboolean  is_last_ref)
+{
+  ServiceEntry *entry = data;
+
+  if (g_atomic_pointer_get (&entry->service) == (gpointer) object)
+    g_atomic_int_set (&entry->in_use, !is_last_ref);
+}
+
+static inline gboolean
+service_entry_is_lazy (ServiceEntry *entry)
+{
+  return entry->service_type != G_TYPE_INVALID || entry->factory != NULL;
+}
+
+/* Drops a service taken out of @entry, best done without its mutex held. */
+static void
+service_entry_release_service (ServiceEntry *entry,
+                               GyService    *service)
+{
+  if (service == NULL)
+    return;
+
+  if (service_entry_is_lazy (entry))
+    g_object_remove_toggle_ref (G_OBJECT (service), service_entry_toggle_notify, entry);
+  else
+    g_object_unref (service);
+}
+
+static ServiceEntry *
+service_entry_ref (ServiceEntry *entry)
+{
+  g_atomic_int_inc (&entry->ref_count);
+  return entry;
+}
+
+static void
+service_entry_unref (ServiceEntry *entry)
+{
+  if (!g_atomic_int_dec_and_test (&entry->ref_count))
+    return;
+
+  service_entry_release_service (entry, g_steal_pointer (&entry->service));
+  g_clear_pointer (&entry->search_keys, gy_search_keys_unref);
+  if (entry->factory_destroy != NULL)
+    entry->factory_destroy (entry->factory_data);
+  g_mutex_clear (&entry->mutex);
+  g_free (entry->service_id);
+  g_slice_free (ServiceEntry, entry);
+}
+
+/*
+ * Returns the service of @entry, building it first if it comes from
+ * a factory. Only one thread builds the service, the others wait for it.
+ */
+static GyService *
+service_entry_get_service (ServiceEntry  *entry,
+                           GError       **err)
+{
+  GyService *service = NULL;
+
+  g_mutex_lock (&entry->mutex);
+
+  if (entry->service == NULL && service_entry_is_lazy (entry) && !entry->removed)
+    {
+      if (entry->factory != NULL)
+        service = entry->factory (entry->service_id, entry->factory_data);
+      else
+        service = g_object_new (entry->service_type, NULL);
+
+      if (!GY_IS_SERVICE (service))
+        g_clear_object (&service);
+      else if (g_strcmp0 (gy_service_get_service_id (service), entry->service_id) != 0)
+        {
+          g_critical ("The factory of [%s] built the service [%s].",
+                      entry->service_id, gy_service_get_service_id (service));
+          g_clear_object (&service);
+        }
+
+      if (service != NULL)
+        {
+          g_atomic_pointer_set (&entry->service, service);
+          g_atomic_int_set (&entry->in_use, TRUE);
+          g_object_add_toggle_ref (G_OBJECT (service), service_entry_toggle_notify, entry);
+          g_object_unref (service);
+        }
+    }
+
+  if (entry->service != NULL)
+    {
+      service = g_object_ref (entry->service);
+      entry->last_used = g_get_monotonic_time ();
+    }
+  else
+    {
+      g_set_error (err, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "The service %s could not be created.", entry->service_id);
+    }
+
+  g_mutex_unlock (&entry->mutex);
+
+  return service;
+}
+
+/*
+ * The registry is a hash table which is never changed once published.
+ * Readers load the current table without taking a lock, between
+ * snapshot_enter() and snapshot_leave(); writers copy it under the
+ * writer mutex, change the copy and swap it in. A replaced table may
+ * still be read by another thread, so it is retired and freed once no
+ * reader is left, by whichever of the writer and the last reader comes
+ * later, see snapshot_reclaim().
+ */
+static GHashTable *
+snapshot_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                (GDestroyNotify) service_entry_unref);
+}
+
+static GHashTable *
+snapshot_copy (GHashTable   *snapshot,
+               ServiceEntry *skip)
+{
+  GHashTable *copy = snapshot_new ();
+  GHashTableIter iter;
+  ServiceEntry *entry;
+
+  g_hash_table_iter_init (&iter, snapshot);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+      if (entry != skip)
+        g_hash_table_insert (copy, entry->service_id, service_entry_ref (entry));
+    }
+
+  return copy;
+}
+
+/*
+ * Must be called with the writer mutex held, and followed by
+ * snapshot_reclaim() once it is released.
+ */
+static void
+snapshot_publish (GyServiceProvider *self,
+                  GHashTable        *snapshot)
+{
+  GHashTable *old = self->snapshot;
+
+  g_atomic_pointer_set (&self->snapshot, snapshot);
+  g_ptr_array_add (self->retired, old);
+  g_atomic_int_set (&self->n_retired, self->retired->len);
+}
+
+/*
+ * Frees the retired snapshots if no reader is left. A reader counted
+ * now entered after they were retired, so it cannot be reading them.
+ * The entries they drop may release services, so it is done without
+ * the writer mutex held.
+ */
+static void
+snapshot_reclaim (GyServiceProvider *self)
+{
+  g_autoptr(GPtrArray) retired = NULL;
+
+  g_mutex_lock (&self->writer_mutex);
+
+  if (self->retired->len > 0 && g_atomic_int_get (&self->n_readers) == 0)
+    {
+      retired = g_steal_pointer (&self->retired);
+      self->retired = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+      g_atomic_int_set (&self->n_retired, 0);
+    }
+
+  g_mutex_unlock (&self->writer_mutex);
+}
+
+/* Returns the current snapshot, valid until snapshot_leave(). */
+static GHashTable *
+snapshot_enter (GyServiceProvider *self)
+{
+  g_atomic_int_inc (&self->n_readers);
+
+  return g_atomic_pointer_get (&self->snapshot);
+}
+
+static void
+snapshot_leave (GyServiceProvider *self)
+{
+  /* Either this sees the count of a writer, or the writer sees no reader. */
+  if (g_atomic_int_dec_and_test (&self->n_readers) &&
+      g_atomic_int_get (&self->n_retired) > 0)
+    snapshot_reclaim (self);
+}
+
+/* Returns a reference to the entry of @service_id, or %NULL. */
+static ServiceEntry *
+lookup_entry (GyServiceProvider *self,
+              const gchar       *service_id)
+{
+  ServiceEntry *entry;
+
+  entry = g_hash_table_lookup (snapshot_enter (self), service_id);
+  if (entry != NULL)
+    service_entry_ref (entry);
+
+  snapshot_leave (self);
+
+  return entry;
+}
+
+static void
+add_entry (GyServiceProvider *self,
+           ServiceEntry      *entry)
+{
+  g_mutex_lock (&self->writer_mutex);
+
+  if (g_hash_table_contains (self->snapshot, entry->service_id))
+    {
+      g_mutex_unlock (&self->writer_mutex);
+      g_critical ("The service [%s] already exists in the service provider. The service can be added. Try to change service_id.",
+                  entry->service_id);
+      service_entry_unref (entry);
+      return;
+    }
+
+  {
+    GHashTable *copy = snapshot_copy (self->snapshot, NULL);
+
+    g_hash_table_insert (copy, entry->service_id, entry);
+    snapshot_publish (self, copy);
+  }
+
+  g_mutex_unlock (&self->writer_mutex);
+
+  snapshot_reclaim (self);
+
+  /* Nothing cached under this id may belong to the new service. */
+  gy_definition_cache_invalidate (self->cache, entry->service_id);
+  g_signal_emit (self, signals[SERVICE_REGISTERED], 0, entry->service_id);
+}
+
+static void
+remove_entry (GyServiceProvider *self,
+              ServiceEntry      *entry)
+{
+  g_autoptr(GySearchKeys) search_keys = NULL;
+  g_autofree gchar *service_id = NULL;
+  GyService *service;
+
+  g_mutex_lock (&self->writer_mutex);
+
+  if (g_hash_table_lookup (self->snapshot, entry->service_id) != entry)
+    {
+      g_mutex_unlock (&self->writer_mutex);
+      return;
+    }
+
+  snapshot_publish (self, snapshot_copy (self->snapshot, entry));
+
+  g_mutex_unlock (&self->writer_mutex);
+
+  snapshot_reclaim (self);
+
+  /* Readers which looked the entry up still hold it, so it has to let go of the service. */
+  g_mutex_lock (&entry->mutex);
+  entry->removed = TRUE;
+  service = g_steal_pointer (&entry->service);
+  search_keys = g_steal_pointer (&entry->search_keys);
+  g_mutex_unlock (&entry->mutex);
+
+  service_entry_release_service (entry, service);
+
+  service_id = g_strdup (entry->service_id);
+  gy_definition_cache_invalidate (self->cache, service_id);
+  g_signal_emit (self, signals[SERVICE_UNREGISTERED], 0, service_id);
+}
+
+static ServiceEntry *
+service_entry_new (const gchar *service_id)
+{
+  ServiceEntry *entry = g_slice_new0 (ServiceEntry);
+
+  entry->ref_count = 1;
+  entry->service_id = g_strdup (service_id);
+  g_mutex_init (&entry->mutex);
+
+  return entry;
+}
+
+/*
+ * Drops the services built by factories which nobody but the provider
+ * holds and which have not been asked for within the idle timeout. They
+ * are built again on the next request. Whether anybody else holds the
+ * service is tracked by service_entry_toggle_notify().
+ */
+static gboolean
+unload_idle_services (gpointer user_data)
+{
+  GyServiceProvider *self = user_data;
+  gint64 now = g_get_monotonic_time ();
+  GHashTableIter iter;
+  ServiceEntry *entry;
+
+  if (self->idle_timeout == 0)
+    return G_SOURCE_CONTINUE;
+
+  g_hash_table_iter_init (&iter, snapshot_enter (self));
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+      GyService *service = NULL;
+      GySearchKeys *search_keys = NULL;
+
+      if (!service_entry_is_lazy (entry))
+        continue;
+
+      g_mutex_lock (&entry->mutex);
+
+      if (entry->service != NULL &&
+          !g_atomic_int_get (&entry->in_use) &&
+          now - entry->last_used >= self->idle_timeout * G_TIME_SPAN_SECOND)
+        {
+          service = g_steal_pointer (&entry->service);
+          search_keys = g_steal_pointer (&entry->search_keys);
+        }
+
+      g_mutex_unlock (&entry->mutex);
+
+      g_clear_pointer (&search_keys, gy_search_keys_unref);
+      service_entry_release_service (entry, service);
+    }
+
+  snapshot_leave (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* A timeout shorter than the usual interval is checked as often as it elapses. */
+static void
+gy_service_provider_schedule_idle_check (GyServiceProvider *self)
+{
+  guint interval = IDLE_CHECK_INTERVAL;
+
+  if (self->idle_timeout > 0)
+    interval = MIN (interval, self->idle_timeout);
+
+  if (self->idle_source != 0)
+    g_source_remove (self->idle_source);
+
+  self->idle_source = g_timeout_add_seconds (interval, unload_idle_services, self);
+}
+
 GyServiceProvider *
 gy_service_provider_new (void)
 {
@@ -40,82 +522,594 @@ gy_service_provider_finalize (GObject *object)
 {
   GyServiceProvider *self = (GyServiceProvider *)object;
 
-  if (self->services != NULL)
+  if (self->idle_source != 0)
+    g_source_remove (self->idle_source);
+
+  g_clear_pointer (&self->snapshot, g_hash_table_unref);
+  g_clear_pointer (&self->retired, g_ptr_array_unref);
+  g_mutex_clear (&self->writer_mutex);
+
+  /* The queued jobs see the flag and return without doing anything. */
+  g_atomic_int_set (&self->disposed, TRUE);
+  g_thread_pool_free (self->prefetch_pool, FALSE, TRUE);
+  g_thread_pool_free (self->search_pool, FALSE, TRUE);
+
+  g_clear_pointer (&self->cache, gy_definition_cache_free);
+  g_mutex_clear (&self->interactive_mutex);
+  g_cond_clear (&self->interactive_cond);
+
+  G_OBJECT_CLASS (gy_service_provider_parent_class)->finalize (object);
+}
+
+static void
+begin_interactive (GyServiceProvider *self)
+{
+  g_mutex_lock (&self->interactive_mutex);
+  self->n_interactive++;
+  g_mutex_unlock (&self->interactive_mutex);
+}
+
+static void
+end_interactive (GyServiceProvider *self)
+{
+  g_mutex_lock (&self->interactive_mutex);
+  if (--self->n_interactive == 0)
+    g_cond_broadcast (&self->interactive_cond);
+  g_mutex_unlock (&self->interactive_mutex);
+}
+
+static gboolean
+prefetch_job_is_cancelled (GyServiceProvider *self,
+                           PrefetchJob       *job)
+{
+  return g_atomic_int_get (&self->disposed) || g_cancellable_is_cancelled (job->cancellable);
+}
+
+/* Blocks while any interactive lookup is running. */
+static void
+yield_to_interactive (GyServiceProvider *self,
+                      PrefetchJob       *job)
+{
+  g_mutex_lock (&self->interactive_mutex);
+
+  while (self->n_interactive > 0 && !prefetch_job_is_cancelled (self, job))
     {
-      g_slist_free_full (self->services, g_object_unref);
-      self->services = NULL;
+      gint64 deadline = g_get_monotonic_time () + PREFETCH_YIELD_USEC;
+      g_cond_wait_until (&self->interactive_cond, &self->interactive_mutex, deadline);
     }
 
-  G_OBJECT_CLASS (gy_service_provider_parent_class)->finalize (object);
+  g_mutex_unlock (&self->interactive_mutex);
 }
 
 static void
-gy_service_provider_class_init (GyServiceProviderClass *klass)
+prefetch_job_free (PrefetchJob *job)
 {
-  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  g_clear_object (&job->service);
+  g_clear_object (&job->cancellable);
+  g_free (job->indices);
+  g_slice_free (PrefetchJob, job);
+}
 
-  object_class->finalize = gy_service_provider_finalize;
+static void
+prefetch_fill (GyService   *service,
+               PrefetchJob *job)
+{
+  gy_definition_cache_fill (job->cache, job->service, job->indices, job->n_indices);
 }
 
 static void
-gy_service_provider_init (GyServiceProvider *self)
+prefetch_one (GyService   *service,
+              PrefetchJob *job)
 {
-  self->services = NULL;
+  GyFormatScheme *scheme;
+
+  scheme = gy_definition_cache_lookup (job->cache, job->service, job->indices[job->current], NULL);
+  g_clear_pointer (&scheme, gy_format_scheme_unref);
 }
 
-static gpointer *
-get_service_by_id (GyServiceProvider *self,
-                   const gchar       *id_searched_service)
+/*
+ * The waiting is done here and only the reads go to the service, so a
+ * service which is not thread safe does not hold back lookups queued
+ * on its worker while a prefetch gives way to them.
+ */
+static void
+prefetch_worker (gpointer data,
+                 gpointer user_data)
 {
-  for (GSList *iter = self->services; iter != NULL; iter = g_slist_next (iter))
+  GyServiceProvider *self = user_data;
+  PrefetchJob *job = data;
+
+  yield_to_interactive (self, job);
+
+  /* One batch read for the whole job, the formatting is done one by one. */
+  if (job->batch && !prefetch_job_is_cancelled (self, job))
+    _gy_service_invoke (GY_SERVICE (job->service), (GFunc) prefetch_fill, job);
+
+  for (job->current = 0; job->current < job->n_indices; job->current++)
     {
-      if (g_strcmp0 (id_searched_service, gy_service_get_service_id (iter->data)) == 0)
-        return iter->data;
+      yield_to_interactive (self, job);
+
+      if (prefetch_job_is_cancelled (self, job))
+        break;
+
+      _gy_service_invoke (GY_SERVICE (job->service), (GFunc) prefetch_one, job);
     }
-  return NULL;
+
+  prefetch_job_free (job);
+}
+
+static FederatedSearch *
+federated_search_ref (FederatedSearch *search)
+{
+  g_atomic_int_inc (&search->ref_count);
+  return search;
+}
+
+static void
+federated_search_unref (FederatedSearch *search)
+{
+  if (!g_atomic_int_dec_and_test (&search->ref_count))
+    return;
+
+  if (search->results_destroy != NULL)
+    search->results_destroy (search->results_data);
+  g_clear_object (&search->task);
+  g_clear_object (&search->cancellable);
+  g_main_context_unref (search->context);
+  g_free (search->query);
+  g_slice_free (FederatedSearch, search);
 }
 
 static gboolean
-service_exist (GyServiceProvider *self,
-               GyService     *service)
+federated_search_is_over (FederatedSearch *search)
 {
-  return get_service_by_id (self, gy_service_get_service_id (service)) != NULL;
+  return g_atomic_int_get (&search->finished) ||
+         g_cancellable_is_cancelled (search->cancellable) ||
+         g_get_monotonic_time () >= search->deadline;
 }
 
-void
-gy_service_provider_register_service (GyServiceProvider *self,
-                                      GyService     *service)
+/* Returns the task, so the services which have not answered yet are ignored. */
+static void
+federated_search_finish (FederatedSearch *search)
 {
-  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) &&
-                    GY_IS_SERVICE (service));
+  g_autoptr(GTask) task = g_steal_pointer (&search->task);
 
-  if (service_exist (self, service))
+  if (task == NULL)
+    return;
+
+  g_atomic_int_set (&search->finished, TRUE);
+
+  if (search->timeout_source != NULL)
     {
-      g_critical ("The service [%s] already exists in the service provider. The service can be added. Try to change service_id.",
-                  gy_service_get_service_id (service));
-      return;
+      g_source_destroy (search->timeout_source);
+      g_clear_pointer (&search->timeout_source, g_source_unref);
     }
 
-  self->services = g_slist_append (self->services, (gpointer) service);
+  if (search->cancel_source != NULL)
+    {
+      g_source_destroy (search->cancel_source);
+      g_clear_pointer (&search->cancel_source, g_source_unref);
+    }
+
+  if (!g_task_return_error_if_cancelled (task))
+    g_task_return_boolean (task, TRUE);
 }
 
-void
-gy_service_provider_unregister_service (GyServiceProvider *self,
-                                        GyService     *service)
+static gboolean
+federated_search_timeout_cb (gpointer user_data)
 {
-  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) &&
-                    GY_IS_SERVICE (service));
+  federated_search_finish (user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+federated_search_cancelled_cb (GCancellable *cancellable,
+                               gpointer      user_data)
+{
+  federated_search_finish (user_data);
+
+  return G_SOURCE_REMOVE;
+}
 
-  if (service_exist (self, service))
+static void
+search_job_free (SearchJob *job)
+{
+  federated_search_unref (job->search);
+  service_entry_unref (job->entry);
+  g_clear_object (&job->service);
+  g_clear_object (&job->model);
+  g_clear_pointer (&job->rows, g_array_unref);
+  g_slice_free (SearchJob, job);
+}
+
+/*
+ * Gets the keys of the model of @job folded with the table of the search.
+ * Without a table, a #GyHeadwordModel lends its own keys; otherwise they
+ * are built once and kept with the entry until the table changes.
+ */
+static GySearchKeys *
+search_job_get_keys (SearchJob *job)
+{
+  const GyFoldTable *fold_table = job->search->fold_table;
+  ServiceEntry *entry = job->entry;
+  GySearchKeys *keys = NULL;
+
+  if (fold_table == NULL && GY_IS_HEADWORD_MODEL (job->model))
+    return gy_search_keys_ref (gy_headword_model_get_search_keys (GY_HEADWORD_MODEL (job->model)));
+
+  g_mutex_lock (&entry->mutex);
+  if (entry->search_keys != NULL && gy_search_keys_get_fold_table (entry->search_keys) == fold_table)
+    keys = gy_search_keys_ref (entry->search_keys);
+  g_mutex_unlock (&entry->mutex);
+
+  if (keys != NULL)
+    return keys;
+
+  /* Built outside the lock, the entry must not block lookups meanwhile. */
+  keys = gy_search_keys_new_from_model_full (job->model, 0, fold_table);
+
+  g_mutex_lock (&entry->mutex);
+  if (!entry->removed)
     {
-      self->services = g_slist_remove (self->services, service);
+      g_clear_pointer (&entry->search_keys, gy_search_keys_unref);
+      entry->search_keys = gy_search_keys_ref (keys);
     }
+  g_mutex_unlock (&entry->mutex);
+
+  return keys;
 }
 
-/**
- * gy_service_provider_get_service_by_id:
- * @self: #GyServiceProvider object
- * @service_id: id of service
+/*
+ * Finds the rows of the service whose headwords begin with the query. A
+ * service which cannot search by itself is searched through the keys of
+ * its model, see search_job_get_keys(). Runs where @service may be used,
+ * see _gy_service_invoke().
+ */
+static void
+search_job_run (GyService *service,
+                SearchJob *job)
+{
+  FederatedSearch *search = job->search;
+  g_autoptr(GySearchKeys) keys = NULL;
+  g_autoptr(GHashTable) seen = NULL;
+  g_autofree gchar *prefix = NULL;
+  const guint32 *order;
+  guint begin, end;
+
+  if ((job->model = gy_dict_service_get_model (job->service, NULL)) == NULL)
+    return;
+
+  g_object_ref (job->model);
+
+  if (GY_IS_DICT_SEARCHABLE (job->service))
+    {
+      job->rows = gy_dict_searchable_search (GY_DICT_SEARCHABLE (job->service), search->query,
+                                             GY_SEARCH_FLAGS_PREFIX, search->limit, NULL);
+      return;
+    }
+
+  keys = search_job_get_keys (job);
+  prefix = gy_search_keys_fold (keys, search->query, -1);
+
+  if (prefix == NULL || !gy_search_keys_get_prefix_range (keys, prefix, &begin, &end))
+    return;
+
+  order = gy_search_keys_get_sorted_rows (keys, NULL);
+  job->rows = g_array_sized_new (FALSE, FALSE, sizeof (guint32), MIN (end - begin, search->limit));
+  seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  /* A row matching by several of its forms is taken once. */
+  for (guint pos = begin; pos < end && job->rows->len < search->limit; pos++)
+    {
+      if (g_hash_table_add (seen, GUINT_TO_POINTER (order[pos])))
+        g_array_append_val (job->rows, order[pos]);
+    }
+}
+
+/* Runs in the context of the search. */
+static gboolean
+search_job_deliver (gpointer data)
+{
+  SearchJob *job = data;
+  FederatedSearch *search = job->search;
+
+  if (search->task == NULL)
+    return G_SOURCE_REMOVE;
+
+  if (job->rows != NULL && job->rows->len > 0 && search->results_func != NULL)
+    search->results_func (job->entry->service_id, job->model,
+                          (const guint32 *) job->rows->data, job->rows->len,
+                          search->results_data);
+
+  if (--search->n_pending == 0)
+    federated_search_finish (search);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+search_worker (gpointer data,
+               gpointer user_data)
+{
+  GyServiceProvider *self = user_data;
+  SearchJob *job = data;
+
+  if (!g_atomic_int_get (&self->disposed) && !federated_search_is_over (job->search))
+    {
+      g_autoptr(GyService) service = service_entry_get_service (job->entry, NULL);
+
+      if (GY_IS_DICT_SERVICE (service))
+        {
+          job->service = GY_DICT_SERVICE (g_steal_pointer (&service));
+          _gy_service_invoke (GY_SERVICE (job->service), (GFunc) search_job_run, job);
+        }
+    }
+
+  g_main_context_invoke_full (job->search->context, G_PRIORITY_DEFAULT,
+                              search_job_deliver, job,
+                              (GDestroyNotify) search_job_free);
+}
+
+static void
+gy_service_provider_get_property (GObject    *object,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+  GyServiceProvider *self = GY_SERVICE_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_CACHE_BUDGET:
+      g_value_set_uint64 (value, gy_service_provider_get_cache_budget (self));
+      break;
+    case PROP_IDLE_TIMEOUT:
+      g_value_set_uint (value, self->idle_timeout);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gy_service_provider_set_property (GObject      *object,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  GyServiceProvider *self = GY_SERVICE_PROVIDER (object);
+
+  switch (prop_id)
+    {
+    case PROP_CACHE_BUDGET:
+      gy_service_provider_set_cache_budget (self, g_value_get_uint64 (value));
+      break;
+    case PROP_IDLE_TIMEOUT:
+      if (self->idle_timeout != g_value_get_uint (value))
+        {
+          self->idle_timeout = g_value_get_uint (value);
+          gy_service_provider_schedule_idle_check (self);
+          g_object_notify_by_pspec (object, pspec);
+        }
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+gy_service_provider_class_init (GyServiceProviderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gy_service_provider_finalize;
+  object_class->get_property = gy_service_provider_get_property;
+  object_class->set_property = gy_service_provider_set_property;
+
+  properties[PROP_CACHE_BUDGET] =
+    g_param_spec_uint64 ("cache-budget",
+                         "Cache budget",
+                         "The number of bytes the cache of definitions may use.",
+                         0, G_MAXSIZE, DEFAULT_CACHE_BUDGET,
+                         G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  properties[PROP_IDLE_TIMEOUT] =
+    g_param_spec_uint ("idle-timeout",
+                       "Idle timeout",
+                       "Seconds after which an unused service built by a factory is released, or 0 to keep it.",
+                       0, G_MAXUINT, DEFAULT_IDLE_TIMEOUT,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, N_PROPERTIES, properties);
+
+  /**
+   * GyServiceProvider::service-registered:
+   * @self: #GyServiceProvider object
+   * @service_id: id of the new service
+   *
+   * Emitted after a service or a factory has been registered. The signal
+   * is emitted in the thread which registered it.
+   */
+  signals[SERVICE_REGISTERED] =
+    g_signal_new ("service-registered",
+                  GY_TYPE_SERVICE_PROVIDER,
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__STRING,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_STRING);
+
+  /**
+   * GyServiceProvider::service-unregistered:
+   * @self: #GyServiceProvider object
+   * @service_id: id of the removed service
+   *
+   * Emitted after a service has been removed, so the data kept for it
+   * elsewhere can be dropped. The signal is emitted in the thread which
+   * removed it.
+   */
+  signals[SERVICE_UNREGISTERED] =
+    g_signal_new ("service-unregistered",
+                  GY_TYPE_SERVICE_PROVIDER,
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__STRING,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_STRING);
+}
+
+static void
+gy_service_provider_init (GyServiceProvider *self)
+{
+  self->snapshot = snapshot_new ();
+  self->retired = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+  g_mutex_init (&self->writer_mutex);
+  self->cache = gy_definition_cache_new (DEFAULT_CACHE_BUDGET);
+
+  g_mutex_init (&self->interactive_mutex);
+  g_cond_init (&self->interactive_cond);
+  self->prefetch_pool = g_thread_pool_new (prefetch_worker, self, 1, FALSE, NULL);
+  self->search_pool = g_thread_pool_new (search_worker, self, SEARCH_THREADS, FALSE, NULL);
+
+  self->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+  gy_service_provider_schedule_idle_check (self);
+}
+
+/**
+ * gy_service_provider_register_service:
+ * @self: #GyServiceProvider object
+ * @service: (transfer full): a service
+ *
+ * Adds a ready service to the provider, which takes ownership of it.
+ */
+void
+gy_service_provider_register_service (GyServiceProvider *self,
+                                      GyService     *service)
+{
+  ServiceEntry *entry;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) &&
+                    GY_IS_SERVICE (service));
+
+  entry = service_entry_new (gy_service_get_service_id (service));
+  entry->service = service;
+  add_entry (self, entry);
+}
+
+/**
+ * gy_service_provider_register_factory:
+ * @self: #GyServiceProvider object
+ * @service_id: id of the service
+ * @service_type: a #GType implementing #GyService
+ *
+ * Registers a service which is created with g_object_new() the first
+ * time it is requested. A service created this way is released again
+ * when it stays unused for #GyServiceProvider:idle-timeout seconds.
+ */
+void
+gy_service_provider_register_factory (GyServiceProvider *self,
+                                      const gchar       *service_id,
+                                      GType              service_type)
+{
+  ServiceEntry *entry;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL);
+  g_return_if_fail (g_type_is_a (service_type, GY_TYPE_SERVICE));
+  g_return_if_fail (G_TYPE_IS_INSTANTIATABLE (service_type) && !G_TYPE_IS_ABSTRACT (service_type));
+
+  entry = service_entry_new (service_id);
+  entry->service_type = service_type;
+  add_entry (self, entry);
+}
+
+/**
+ * gy_service_provider_register_factory_func:
+ * @self: #GyServiceProvider object
+ * @service_id: id of the service
+ * @factory: (scope notified): a function building the service
+ * @user_data: data to pass to @factory
+ * @destroy: (nullable): a function to free @user_data, or %NULL
+ *
+ * Like gy_service_provider_register_factory(), but the service is built
+ * by @factory. The factory may be called from any thread and more than
+ * once, since an idle service is released and built again on demand.
+ */
+void
+gy_service_provider_register_factory_func (GyServiceProvider *self,
+                                           const gchar       *service_id,
+                                           GyServiceFactory   factory,
+                                           gpointer           user_data,
+                                           GDestroyNotify     destroy)
+{
+  ServiceEntry *entry;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL && factory != NULL);
+
+  entry = service_entry_new (service_id);
+  entry->factory = factory;
+  entry->factory_data = user_data;
+  entry->factory_destroy = destroy;
+  add_entry (self, entry);
+}
+
+void
+gy_service_provider_unregister_service (GyServiceProvider *self,
+                                        GyService     *service)
+{
+  ServiceEntry *entry;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) &&
+                    GY_IS_SERVICE (service));
+
+  if ((entry = lookup_entry (self, gy_service_get_service_id (service))) != NULL)
+    {
+      gboolean is_registered;
+
+      g_mutex_lock (&entry->mutex);
+      is_registered = entry->service == service;
+      g_mutex_unlock (&entry->mutex);
+
+      if (is_registered)
+        remove_entry (self, entry);
+
+      service_entry_unref (entry);
+    }
+}
+
+/**
+ * gy_service_provider_unregister_service_by_id:
+ * @self: #GyServiceProvider object
+ * @service_id: id of service
+ *
+ * Removes the service or the factory registered for @service_id.
+ */
+void
+gy_service_provider_unregister_service_by_id (GyServiceProvider *self,
+                                              const gchar       *service_id)
+{
+  ServiceEntry *entry;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL);
+
+  if ((entry = lookup_entry (self, service_id)) != NULL)
+    {
+      remove_entry (self, entry);
+      service_entry_unref (entry);
+    }
+}
+
+/**
+ * gy_service_provider_get_service_by_id:
+ * @self: #GyServiceProvider object
+ * @service_id: id of service
+ *
+ * Gets the service, building it first if it was registered with
+ * a factory. Use gy_service_provider_get_service_by_id_async() to
+ * build it without blocking. The service is owned by the provider,
+ * which may drop it when it is unregistered or left idle, so use
+ * gy_service_provider_ref_service_by_id() to keep it or to use it
+ * from another thread.
  *
  * Returns: (transfer none) (nullable): a service
  **/
@@ -123,7 +1117,540 @@ GyService *
 gy_service_provider_get_service_by_id (GyServiceProvider *self,
                                        const gchar       *service_id)
 {
+  GyService *service;
+  ServiceEntry *entry;
+
+  g_return_val_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL, NULL);
+
+  if ((entry = lookup_entry (self, service_id)) == NULL)
+    return NULL;
+
+  /* The entry keeps its own reference. */
+  if ((service = service_entry_get_service (entry, NULL)) != NULL)
+    g_object_unref (service);
+
+  service_entry_unref (entry);
+
+  return service;
+}
+
+/**
+ * gy_service_provider_ref_service_by_id:
+ * @self: #GyServiceProvider object
+ * @service_id: id of service
+ *
+ * Like gy_service_provider_get_service_by_id(), but the service stays
+ * valid until the returned reference is dropped. It is safe to call
+ * from any thread.
+ *
+ * Returns: (transfer full) (nullable): a service
+ **/
+GyService *
+gy_service_provider_ref_service_by_id (GyServiceProvider *self,
+                                       const gchar       *service_id)
+{
+  GyService *service;
+  ServiceEntry *entry;
+
   g_return_val_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL, NULL);
 
-  return (GyService *) get_service_by_id (self, service_id);
+  if ((entry = lookup_entry (self, service_id)) == NULL)
+    return NULL;
+
+  service = service_entry_get_service (entry, NULL);
+  service_entry_unref (entry);
+
+  return service;
+}
+
+static void
+get_service_worker (GTask        *task,
+                    gpointer      source_object,
+                    gpointer      task_data,
+                    GCancellable *cancellable)
+{
+  ServiceEntry *entry = task_data;
+  GyService *service;
+  GError *error = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if ((service = service_entry_get_service (entry, &error)) == NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, service, g_object_unref);
+}
+
+/**
+ * gy_service_provider_get_service_by_id_async:
+ * @self: #GyServiceProvider object
+ * @service_id: id of service
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the service is ready
+ * @user_data: data to pass to @callback
+ *
+ * Gets the service, building it on a worker thread if it was registered
+ * with a factory and is not built yet.
+ */
+void
+gy_service_provider_get_service_by_id_async (GyServiceProvider   *self,
+                                             const gchar         *service_id,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  ServiceEntry *entry;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gy_service_provider_get_service_by_id_async);
+
+  if ((entry = lookup_entry (self, service_id)) == NULL)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                               "The service %s is not registered.", service_id);
+      return;
+    }
+
+  g_task_set_task_data (task, entry, (GDestroyNotify) service_entry_unref);
+  g_task_run_in_thread (task, get_service_worker);
+}
+
+/**
+ * gy_service_provider_get_service_by_id_finish:
+ * @self: #GyServiceProvider object
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Returns: (transfer full) (nullable): a service
+ */
+GyService *
+gy_service_provider_get_service_by_id_finish (GyServiceProvider  *self,
+                                              GAsyncResult       *result,
+                                              GError            **err)
+{
+  g_return_val_if_fail (GY_IS_SERVICE_PROVIDER (self), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), err);
+}
+
+typedef struct
+{
+  GyServiceProvider *self;
+  guint              idx;
+  GyFormatScheme    *scheme;
+  GError            *error;
+} InvokeData;
+
+static void
+lookup_invoke (GyDictService *service,
+               InvokeData    *data)
+{
+  data->scheme = gy_definition_cache_lookup (data->self->cache, service,
+                                             data->idx, &data->error);
+}
+
+typedef struct
+{
+  GyDictService *service;
+  guint          idx;
+} LookupData;
+
+/**
+ * gy_service_provider_lookup:
+ * @self: #GyServiceProvider object
+ * @service_id: id of a dictionary service
+ * @idx: index of the lexical unit
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Gets the lexical unit at @idx and formats it, going through the cache
+ * of definitions. Concurrent lookups of the same entry are merged. The
+ * service is read and the unit formatted where it may be used, on its
+ * own worker unless it is thread safe, and the call waits for it; use
+ * it from a worker thread or use gy_service_provider_lookup_async().
+ *
+ * Returns: (transfer full) (nullable): the formatted lexical unit
+ */
+GyFormatScheme *
+gy_service_provider_lookup (GyServiceProvider  *self,
+                            const gchar        *service_id,
+                            guint               idx,
+                            GError            **err)
+{
+  g_autoptr(GyService) service = NULL;
+  InvokeData data = { 0, };
+
+  g_return_val_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL, NULL);
+
+  service = gy_service_provider_ref_service_by_id (self, service_id);
+
+  if (!GY_IS_DICT_SERVICE (service))
+    {
+      g_set_error (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "The dictionary service %s is not available.", service_id);
+      return NULL;
+    }
+
+  data.self = self;
+  data.idx = idx;
+  _gy_service_invoke (service, (GFunc) lookup_invoke, &data);
+
+  if (data.error != NULL)
+    g_propagate_error (err, data.error);
+
+  return data.scheme;
+}
+
+static void
+lookup_data_free (LookupData *data)
+{
+  g_clear_object (&data->service);
+  g_slice_free (LookupData, data);
+}
+
+static void
+lookup_worker (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+  GyServiceProvider *self = source_object;
+  LookupData *data = task_data;
+  GyFormatScheme *scheme;
+  GError *error = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    {
+      end_interactive (self);
+      return;
+    }
+
+  scheme = gy_definition_cache_lookup (self->cache, data->service, data->idx, &error);
+  end_interactive (self);
+
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, scheme, (GDestroyNotify) gy_format_scheme_unref);
+}
+
+/**
+ * gy_service_provider_lookup_async:
+ * @self: #GyServiceProvider object
+ * @service_id: id of a dictionary service
+ * @idx: index of the lexical unit
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the lookup is done
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of gy_service_provider_lookup(). A repeated
+ * lookup is answered from the cache without touching the service or
+ * its formatter.
+ */
+void
+gy_service_provider_lookup_async (GyServiceProvider   *self,
+                                  const gchar         *service_id,
+                                  guint                idx,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GyService) service = NULL;
+  LookupData *data;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gy_service_provider_lookup_async);
+  g_task_set_return_on_cancel (task, TRUE);
+
+  service = gy_service_provider_ref_service_by_id (self, service_id);
+
+  if (!GY_IS_DICT_SERVICE (service))
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                               "The dictionary service %s is not available.", service_id);
+      return;
+    }
+
+  data = g_slice_new0 (LookupData);
+  data->service = g_object_ref (GY_DICT_SERVICE (service));
+  data->idx = idx;
+  g_task_set_task_data (task, data, (GDestroyNotify) lookup_data_free);
+
+  /* Counted from here, so a prefetch queued just before does not get ahead. */
+  begin_interactive (self);
+
+  _gy_service_run_task (service, task, lookup_worker);
+}
+
+/**
+ * gy_service_provider_lookup_finish:
+ * @self: #GyServiceProvider object
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Returns: (transfer full) (nullable): the formatted lexical unit
+ */
+GyFormatScheme *
+gy_service_provider_lookup_finish (GyServiceProvider  *self,
+                                   GAsyncResult       *result,
+                                   GError            **err)
+{
+  g_return_val_if_fail (GY_IS_SERVICE_PROVIDER (self), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), err);
+}
+
+/**
+ * gy_service_provider_prefetch:
+ * @self: #GyServiceProvider object
+ * @service_id: id of a dictionary service
+ * @indices: (array length=n_indices): the entries to prefetch, most wanted first
+ * @n_indices: the number of entries
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ *
+ * Fetches and formats the given entries into the cache of definitions on
+ * a background thread, so a later lookup of them costs no plugin I/O.
+ * Prefetching pauses while an interactive lookup is running and stops
+ * as soon as @cancellable is cancelled. A service which is not
+ * %GY_SERVICE_CAPABILITY_THREAD_SAFE is read on its own worker thread.
+ */
+void
+gy_service_provider_prefetch (GyServiceProvider *self,
+                              const gchar       *service_id,
+                              const guint       *indices,
+                              guint              n_indices,
+                              GCancellable      *cancellable)
+{
+  g_autoptr(GyService) service = NULL;
+  GyServiceCapabilities capabilities;
+  PrefetchJob *job;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) && service_id != NULL);
+  g_return_if_fail (indices != NULL || n_indices == 0);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  service = gy_service_provider_ref_service_by_id (self, service_id);
+
+  if (!GY_IS_DICT_SERVICE (service) || n_indices == 0)
+    return;
+
+  capabilities = gy_service_get_capabilities (service);
+
+  job = g_slice_new0 (PrefetchJob);
+  job->cache = self->cache;
+  job->batch = (capabilities & GY_SERVICE_CAPABILITY_HAS_BATCH) != 0;
+  job->service = g_object_ref (GY_DICT_SERVICE (service));
+  job->cancellable = cancellable != NULL ? g_object_ref (cancellable) : g_cancellable_new ();
+  job->indices = g_new (guint, n_indices);
+  memcpy (job->indices, indices, n_indices * sizeof (guint));
+  job->n_indices = n_indices;
+
+  g_thread_pool_push (self->prefetch_pool, job, NULL);
+}
+
+/**
+ * gy_service_provider_search_all_async:
+ * @self: #GyServiceProvider object
+ * @query: the beginning of the headwords to find
+ * @limit: the maximum number of rows taken from one service
+ * @timeout_msec: milliseconds the services have to answer
+ * @results_func: (scope notified): a function receiving the rows of each service
+ * @results_data: data to pass to @results_func
+ * @results_destroy: (nullable): a function to free @results_data, or %NULL
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the search is done
+ * @user_data: data to pass to @callback
+ *
+ * Searches every registered dictionary service for the headwords which
+ * begin with @query. The services are searched in parallel on a pool of
+ * threads and @results_func is called in the thread-default main context
+ * of the caller as soon as a service answers, so a slow service does
+ * not hold back the others. The search ends when all services answered
+ * or when @timeout_msec runs out, whichever comes first; the answers of
+ * the services which miss the deadline are dropped. The headwords and
+ * @query are folded with the table set by
+ * gy_service_provider_set_fold_table(). A service which is
+ * not %GY_SERVICE_CAPABILITY_THREAD_SAFE is searched on its own worker
+ * thread.
+ */
+void
+gy_service_provider_search_all_async (GyServiceProvider    *self,
+                                      const gchar          *query,
+                                      guint                 limit,
+                                      guint                 timeout_msec,
+                                      GyServiceResultsFunc  results_func,
+                                      gpointer              results_data,
+                                      GDestroyNotify        results_destroy,
+                                      GCancellable         *cancellable,
+                                      GAsyncReadyCallback   callback,
+                                      gpointer              user_data)
+{
+  FederatedSearch *search;
+  GHashTableIter iter;
+  ServiceEntry *entry;
+
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self) && query != NULL && limit > 0);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  search = g_slice_new0 (FederatedSearch);
+  search->ref_count = 1;
+  search->context = g_main_context_ref_thread_default ();
+  search->task = g_task_new (self, cancellable, callback, user_data);
+  search->cancellable = cancellable != NULL ? g_object_ref (cancellable) : NULL;
+  search->query = g_strdup (query);
+  search->fold_table = g_atomic_pointer_get (&self->fold_table);
+  search->limit = limit;
+  search->deadline = g_get_monotonic_time () + timeout_msec * G_TIME_SPAN_MILLISECOND;
+  search->results_func = results_func;
+  search->results_data = results_data;
+  search->results_destroy = results_destroy;
+  g_task_set_source_tag (search->task, gy_service_provider_search_all_async);
+
+  g_hash_table_iter_init (&iter, snapshot_enter (self));
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+      SearchJob *job = g_slice_new0 (SearchJob);
+
+      job->search = federated_search_ref (search);
+      job->entry = service_entry_ref (entry);
+      search->n_pending++;
+
+      g_thread_pool_push (self->search_pool, job, NULL);
+    }
+
+  snapshot_leave (self);
+
+  if (search->n_pending == 0)
+    {
+      federated_search_finish (search);
+    }
+  else
+    {
+      search->timeout_source = g_timeout_source_new (timeout_msec);
+      g_source_set_callback (search->timeout_source, federated_search_timeout_cb,
+                             federated_search_ref (search),
+                             (GDestroyNotify) federated_search_unref);
+      g_source_attach (search->timeout_source, search->context);
+
+      if (cancellable != NULL)
+        {
+          search->cancel_source = g_cancellable_source_new (cancellable);
+          g_source_set_callback (search->cancel_source,
+                                 (GSourceFunc) federated_search_cancelled_cb,
+                                 federated_search_ref (search),
+                                 (GDestroyNotify) federated_search_unref);
+          g_source_attach (search->cancel_source, search->context);
+        }
+    }
+
+  federated_search_unref (search);
+}
+
+/**
+ * gy_service_provider_search_all_finish:
+ * @self: #GyServiceProvider object
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Returns: %TRUE unless the search was cancelled
+ */
+gboolean
+gy_service_provider_search_all_finish (GyServiceProvider  *self,
+                                       GAsyncResult       *result,
+                                       GError            **err)
+{
+  g_return_val_if_fail (GY_IS_SERVICE_PROVIDER (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), err);
+}
+
+/**
+ * gy_service_provider_set_cache_budget:
+ * @self: #GyServiceProvider object
+ * @budget: the number of bytes
+ *
+ * Sets how many bytes the cache of definitions may use. Least recently
+ * used entries are dropped until the cache fits into @budget.
+ */
+void
+gy_service_provider_set_cache_budget (GyServiceProvider *self,
+                                      guint64            budget)
+{
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self));
+
+  if (gy_definition_cache_get_budget (self->cache) == budget)
+    return;
+
+  gy_definition_cache_set_budget (self->cache, budget);
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_CACHE_BUDGET]);
+}
+
+guint64
+gy_service_provider_get_cache_budget (GyServiceProvider *self)
+{
+  g_return_val_if_fail (GY_IS_SERVICE_PROVIDER (self), 0);
+
+  return gy_definition_cache_get_budget (self->cache);
+}
+
+/**
+ * gy_service_provider_get_cache_stats:
+ * @self: #GyServiceProvider object
+ * @hits: (out) (optional): location for the number of lookups answered by the cache
+ * @misses: (out) (optional): location for the number of lookups that reached a service
+ * @merged: (out) (optional): location for the number of lookups that
+ *   waited for the same entry being read by another lookup
+ */
+void
+gy_service_provider_get_cache_stats (GyServiceProvider *self,
+                                     guint64           *hits,
+                                     guint64           *misses,
+                                     guint64           *merged)
+{
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self));
+
+  gy_definition_cache_get_stats (self->cache, hits, misses, merged);
+}
+
+/**
+ * gy_service_provider_set_fold_table:
+ * @self: #GyServiceProvider object
+ * @fold_table: (nullable): the table to fold the headwords and queries
+ *   with, or %NULL to match them with their diacritics
+ *
+ * Makes gy_service_provider_search_all_async() ignore diacritics the way
+ * @fold_table does. The searches already running keep the previous table.
+ */
+void
+gy_service_provider_set_fold_table (GyServiceProvider *self,
+                                    const GyFoldTable *fold_table)
+{
+  g_return_if_fail (GY_IS_SERVICE_PROVIDER (self));
+
+  g_atomic_pointer_set (&self->fold_table, fold_table);
+}
+
+/**
+ * gy_service_provider_get_fold_table:
+ * @self: #GyServiceProvider object
+ *
+ * Returns: (transfer none) (nullable): the table the searches fold with
+ */
+const GyFoldTable *
+gy_service_provider_get_fold_table (GyServiceProvider *self)
+{
+  g_return_val_if_fail (GY_IS_SERVICE_PROVIDER (self), NULL);
+
+  return g_atomic_pointer_get (&self->fold_table);
 }
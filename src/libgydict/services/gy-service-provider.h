@@ -21,6 +21,8 @@
 #pragma once
 
 #include "gy-service.h"
+#include "gy-dict-service.h"
+#include "gy-search-keys.h"
 
 G_BEGIN_DECLS
 
@@ -28,13 +30,108 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (GyServiceProvider, gy_service_provider, GY, SERVICE_PROVIDER, GObject)
 
+/**
+ * GyServiceFactory:
+ * @service_id: id of the service to build
+ * @user_data: data passed to gy_service_provider_register_factory_func()
+ *
+ * Builds a service on demand. It may be called from a worker thread.
+ *
+ * Returns: (transfer full) (nullable): a new service
+ */
+typedef GyService *(*GyServiceFactory) (const gchar *service_id,
+                                        gpointer     user_data);
+
+/**
+ * GyServiceResultsFunc:
+ * @service_id: id of the service which answered
+ * @model: the model of the service the rows belong to
+ * @rows: (array length=n_rows): the rows found, best first
+ * @n_rows: the number of rows
+ * @user_data: the data passed to gy_service_provider_search_all_async()
+ *
+ * Receives the rows one service found for
+ * gy_service_provider_search_all_async().
+ */
+typedef void (*GyServiceResultsFunc) (const gchar   *service_id,
+                                      GtkTreeModel  *model,
+                                      const guint32 *rows,
+                                      guint          n_rows,
+                                      gpointer       user_data);
+
 GyServiceProvider *gy_service_provider_new (void);
 
 void gy_service_provider_register_service (GyServiceProvider *self,
                                            GyService         *service);
+void gy_service_provider_register_factory (GyServiceProvider *self,
+                                           const gchar       *service_id,
+                                           GType              service_type);
+void gy_service_provider_register_factory_func (GyServiceProvider *self,
+                                                const gchar       *service_id,
+                                                GyServiceFactory   factory,
+                                                gpointer           user_data,
+                                                GDestroyNotify     destroy);
 void gy_service_provider_unregister_service (GyServiceProvider *self,
                                              GyService         *service);
+void gy_service_provider_unregister_service_by_id (GyServiceProvider *self,
+                                                   const gchar       *service_id);
 GyService *gy_service_provider_get_service_by_id (GyServiceProvider *self,
                                                   const gchar       *service_id);
+GyService *gy_service_provider_ref_service_by_id (GyServiceProvider *self,
+                                                  const gchar       *service_id);
+void gy_service_provider_get_service_by_id_async (GyServiceProvider   *self,
+                                                  const gchar         *service_id,
+                                                  GCancellable        *cancellable,
+                                                  GAsyncReadyCallback  callback,
+                                                  gpointer             user_data);
+GyService *gy_service_provider_get_service_by_id_finish (GyServiceProvider  *self,
+                                                         GAsyncResult       *result,
+                                                         GError            **err);
+
+GyFormatScheme *gy_service_provider_lookup (GyServiceProvider  *self,
+                                            const gchar        *service_id,
+                                            guint               idx,
+                                            GError            **err);
+void gy_service_provider_lookup_async (GyServiceProvider   *self,
+                                       const gchar         *service_id,
+                                       guint                idx,
+                                       GCancellable        *cancellable,
+                                       GAsyncReadyCallback  callback,
+                                       gpointer             user_data);
+GyFormatScheme *gy_service_provider_lookup_finish (GyServiceProvider  *self,
+                                                   GAsyncResult       *result,
+                                                   GError            **err);
+
+void gy_service_provider_prefetch (GyServiceProvider *self,
+                                   const gchar       *service_id,
+                                   const guint       *indices,
+                                   guint              n_indices,
+                                   GCancellable      *cancellable);
+
+void gy_service_provider_search_all_async (GyServiceProvider    *self,
+                                           const gchar          *query,
+                                           guint                 limit,
+                                           guint                 timeout_msec,
+                                           GyServiceResultsFunc  results_func,
+                                           gpointer              results_data,
+                                           GDestroyNotify        results_destroy,
+                                           GCancellable         *cancellable,
+                                           GAsyncReadyCallback   callback,
+                                           gpointer              user_data);
+gboolean gy_service_provider_search_all_finish (GyServiceProvider  *self,
+                                                GAsyncResult       *result,
+                                                GError            **err);
+
+void gy_service_provider_set_cache_budget (GyServiceProvider *self,
+                                           guint64            budget);
+guint64 gy_service_provider_get_cache_budget (GyServiceProvider *self);
+void gy_service_provider_get_cache_stats (GyServiceProvider *self,
+                                          guint64           *hits,
+                                          guint64           *misses,
+                                          guint64           *merged);
+
+void gy_service_provider_set_fold_table (GyServiceProvider *self,
+                                         const GyFoldTable *fold_table);
+const GyFoldTable *gy_service_provider_get_fold_table (GyServiceProvider *self);
 
 G_END_DECLS
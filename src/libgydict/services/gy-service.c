@@ -19,9 +19,100 @@
  */
 
 #include "gy-service.h"
+#include "gy-service-private.h"
+#include "gy-dict-searchable.h"
 
 G_DEFINE_INTERFACE (GyService, gy_service, G_TYPE_OBJECT)
 
+/*
+ * A service which is not thread safe is used from a single thread of
+ * its own, so the main thread never blocks on it and the calls to it
+ * are serialized.
+ */
+typedef struct
+{
+  GyService       *service;
+
+  GTask           *task;
+  GTaskThreadFunc  task_func;
+
+  /* Set for a job the caller waits for. */
+  GFunc            func;
+  gpointer         data;
+  GMutex           mutex;
+  GCond            cond;
+  gboolean         done;
+} WorkerJob;
+
+static GQuark   worker_quark;
+static GMutex   worker_mutex;
+/* The service whose worker runs on the current thread, if any. */
+static GPrivate current_worker;
+
+static void
+worker_func (gpointer data,
+             gpointer user_data)
+{
+  WorkerJob *job = data;
+  GyService *service = job->service;
+
+  g_private_set (&current_worker, service);
+
+  if (job->task != NULL)
+    {
+      job->task_func (job->task,
+                      g_task_get_source_object (job->task),
+                      g_task_get_task_data (job->task),
+                      g_task_get_cancellable (job->task));
+      g_object_unref (job->task);
+      g_slice_free (WorkerJob, job);
+    }
+  else
+    {
+      job->func (service, job->data);
+
+      g_mutex_lock (&job->mutex);
+      job->done = TRUE;
+      g_cond_signal (&job->cond);
+      g_mutex_unlock (&job->mutex);
+    }
+
+  g_private_set (&current_worker, NULL);
+
+  /* The last reference may go here, taking the worker with it. */
+  g_object_unref (service);
+}
+
+static void
+worker_free (gpointer data)
+{
+  /* Every job holds the service, so nothing is queued any more. */
+  g_thread_pool_free (data, FALSE, FALSE);
+}
+
+static GThreadPool *
+get_worker (GyService *self)
+{
+  GThreadPool *worker;
+
+  g_mutex_lock (&worker_mutex);
+
+  if (worker_quark == 0)
+    worker_quark = g_quark_from_static_string ("gy-service-worker");
+
+  worker = g_object_get_qdata (G_OBJECT (self), worker_quark);
+
+  if (worker == NULL)
+    {
+      worker = g_thread_pool_new (worker_func, NULL, 1, FALSE, NULL);
+      g_object_set_qdata_full (G_OBJECT (self), worker_quark, worker, worker_free);
+    }
+
+  g_mutex_unlock (&worker_mutex);
+
+  return worker;
+}
+
 static void
 gy_service_default_init (GyServiceInterface *iface)
 {
@@ -47,3 +138,95 @@ gy_service_get_service_id (GyService *self)
 
   return iface->get_service_id (self);
 }
+
+/**
+ * gy_service_get_capabilities:
+ * @self: a service
+ *
+ * Gets the capabilities the service declares. The blocking calls to a
+ * service which is not %GY_SERVICE_CAPABILITY_THREAD_SAFE are made one
+ * at a time on a worker thread of its own.
+ *
+ * Returns: #GyServiceCapabilities of the service
+ */
+GyServiceCapabilities
+gy_service_get_capabilities (GyService *self)
+{
+  GyServiceInterface *iface;
+  GyServiceCapabilities capabilities = GY_SERVICE_CAPABILITY_NONE;
+
+  g_return_val_if_fail (GY_IS_SERVICE (self), GY_SERVICE_CAPABILITY_NONE);
+
+  iface = GY_SERVICE_GET_IFACE (self);
+
+  if (iface->get_capabilities != NULL)
+    capabilities = iface->get_capabilities (self);
+
+  if (GY_IS_DICT_SEARCHABLE (self))
+    capabilities |= GY_SERVICE_CAPABILITY_HAS_SEARCH;
+
+  return capabilities;
+}
+
+/*
+ * Runs @task_func for @task on a thread where @self may be used: a
+ * thread of the pool of #GTask for a thread safe service, otherwise
+ * the worker of the service. A queued task is not dropped when it is
+ * cancelled, @task_func is expected to check the cancellable first.
+ */
+void
+_gy_service_run_task (GyService       *self,
+                      GTask           *task,
+                      GTaskThreadFunc  task_func)
+{
+  WorkerJob *job;
+
+  if (gy_service_get_capabilities (self) & GY_SERVICE_CAPABILITY_THREAD_SAFE)
+    {
+      g_task_run_in_thread (task, task_func);
+      return;
+    }
+
+  job = g_slice_new0 (WorkerJob);
+  job->service = g_object_ref (self);
+  job->task = g_object_ref (task);
+  job->task_func = task_func;
+
+  g_thread_pool_push (get_worker (self), job, NULL);
+}
+
+/*
+ * Calls @func with @self and @data where @self may be used and waits
+ * for it: in place for a thread safe service or on the worker of the
+ * service itself, otherwise on the worker.
+ */
+void
+_gy_service_invoke (GyService *self,
+                    GFunc      func,
+                    gpointer   data)
+{
+  WorkerJob job = { 0, };
+
+  if ((gy_service_get_capabilities (self) & GY_SERVICE_CAPABILITY_THREAD_SAFE) ||
+      g_private_get (&current_worker) == self)
+    {
+      func (self, data);
+      return;
+    }
+
+  job.service = g_object_ref (self);
+  job.func = func;
+  job.data = data;
+  g_mutex_init (&job.mutex);
+  g_cond_init (&job.cond);
+
+  g_thread_pool_push (get_worker (self), &job, NULL);
+
+  g_mutex_lock (&job.mutex);
+  while (!job.done)
+    g_cond_wait (&job.cond, &job.mutex);
+  g_mutex_unlock (&job.mutex);
+
+  g_mutex_clear (&job.mutex);
+  g_cond_clear (&job.cond);
+}
@@ -24,6 +24,31 @@
 
 G_BEGIN_DECLS
 
+/**
+ * GyServiceCapabilities:
+ * @GY_SERVICE_CAPABILITY_NONE: the service is called from one thread at a time
+ * @GY_SERVICE_CAPABILITY_THREAD_SAFE: the service may be called from any thread
+ * @GY_SERVICE_CAPABILITY_SORTED_MODEL: the rows of the model are sorted
+ *   bytewise by their headwords folded with gy_utility_fold_search_key(),
+ *   ignoring the '|' separators
+ * @GY_SERVICE_CAPABILITY_HAS_SEARCH: the service implements #GyDictSearchable
+ * @GY_SERVICE_CAPABILITY_HAS_BATCH: the service implements a batch
+ *   gy_dict_service_get_lexical_units() cheaper than single reads
+ * @GY_SERVICE_CAPABILITY_ZERO_COPY_TEXT: the strings of the model stay
+ *   valid as long as the model, so they may be used without copying
+ *
+ * What the core may assume about a service when picking a code path.
+ */
+typedef enum
+{
+  GY_SERVICE_CAPABILITY_NONE           = 0,
+  GY_SERVICE_CAPABILITY_THREAD_SAFE    = 1 << 0,
+  GY_SERVICE_CAPABILITY_SORTED_MODEL   = 1 << 1,
+  GY_SERVICE_CAPABILITY_HAS_SEARCH     = 1 << 2,
+  GY_SERVICE_CAPABILITY_HAS_BATCH      = 1 << 3,
+  GY_SERVICE_CAPABILITY_ZERO_COPY_TEXT = 1 << 4,
+} GyServiceCapabilities;
+
 #define GY_TYPE_SERVICE (gy_service_get_type ())
 
 G_DECLARE_INTERFACE (GyService, gy_service, GY, SERVICE, GObject)
@@ -33,8 +58,12 @@ struct _GyServiceInterface
   GTypeInterface parent;
 
   const gchar* (*get_service_id) (GyService *self);
+
+  GyServiceCapabilities (*get_capabilities) (GyService *self);
 };
 
 const gchar* gy_service_get_service_id (GyService *self);
 
+GyServiceCapabilities gy_service_get_capabilities (GyService *self);
+
 G_END_DECLS
@@ -0,0 +1,1091 @@
+/* gy-trigram-index.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gy-trigram-index.h"
+#include "gy-varint.h"
+
+/*
+ * An index of the byte trigrams of the folded search keys, for
+ * wildcard patterns like "*tion", "*graph*" or "un?able". Every form of
+ * a key, as #GySearchKeys expands them at the '|', is indexed with a
+ * start and an end marker around it, so the literal parts at the ends
+ * of an anchored pattern narrow the search as well, for an alternate
+ * form as for the first one.
+ *
+ * The rows which contain every trigram of the literal parts of a
+ * pattern are the candidates; only they are matched against the whole
+ * pattern, a form at a time. A pattern without three consecutive
+ * literal bytes has to be matched against every key.
+ *
+ * The posting list of a trigram is its number of rows followed by the
+ * deltas between them, as varints. The layout, with every section at a
+ * multiple of eight bytes so that it can be used from a mapped file:
+ *
+ *   header
+ *   trigrams       guint32[n_trigrams], sorted
+ *   postings       the posting lists of the trigrams, in the same order
+ *   posting index  guint64[n_trigrams + 1], offsets into postings
+ */
+#define INDEX_MAGIC      "GYTRI\0\0\0"
+#define INDEX_BYTE_ORDER 0x01020304
+#define INDEX_ALIGN      8
+
+#define KEY_START '\001'
+#define KEY_END   '\002'
+
+/* The rows handed to the results function of a streaming search at once. */
+#define SEARCH_BATCH 64
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 n_keys;
+  guint32 n_trigrams;
+  guint64 trigrams_offset;
+  guint64 postings_offset;
+  guint64 postings_size;
+  guint64 posting_index_offset;
+} IndexHeader;
+
+struct _GyTrigramIndex
+{
+  GObject parent_instance;
+
+  GySearchKeys  *keys;
+  GBytes        *bytes;
+  const guint32 *trigrams;
+  const guint8  *postings;
+  gsize          postings_size;
+  const guint64 *posting_index;
+  guint          n_trigrams;
+};
+
+G_DEFINE_TYPE (GyTrigramIndex, gy_trigram_index, G_TYPE_OBJECT)
+
+G_DEFINE_QUARK (gy-trigram-index-error-quark, gy_trigram_index_error)
+
+static void
+gy_trigram_index_finalize (GObject *object)
+{
+  GyTrigramIndex *self = (GyTrigramIndex *)object;
+
+  g_clear_pointer (&self->keys, gy_search_keys_unref);
+  g_clear_pointer (&self->bytes, g_bytes_unref);
+
+  G_OBJECT_CLASS (gy_trigram_index_parent_class)->finalize (object);
+}
+
+static void
+gy_trigram_index_class_init (GyTrigramIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gy_trigram_index_finalize;
+}
+
+static void
+gy_trigram_index_init (GyTrigramIndex *self)
+{
+}
+
+/**
+ * gy_trigram_index_is_pattern:
+ * @text: a query
+ *
+ * Returns: whether @text has a '*' or a '?' and is a wildcard pattern
+ */
+gboolean
+gy_trigram_index_is_pattern (const gchar *text)
+{
+  g_return_val_if_fail (text != NULL, FALSE);
+
+  return strpbrk (text, "*?") != NULL;
+}
+
+/* Called with every form of a key; returns %TRUE to stop at that form. */
+typedef gboolean (*FormFunc) (const gchar *form,
+                              gsize        length,
+                              gpointer     user_data);
+
+/*
+ * Calls @func with every form of the key of @row: the key without the
+ * '|' and, if it has any, each part between them. The forms are
+ * NUL-terminated; a part is copied into @buf for that. Returns %TRUE
+ * if @func stopped at a form.
+ */
+static gboolean
+foreach_form (GySearchKeys *keys,
+              guint         row,
+              GString      *buf,
+              FormFunc      func,
+              gpointer      user_data)
+{
+  gsize len;
+  const gchar *key = gy_search_keys_get_key (keys, row, &len);
+  const gchar *end = key + len;
+
+  if (memchr (key, '|', len) == NULL)
+    return func (key, len, user_data);
+
+  g_string_truncate (buf, 0);
+
+  for (const gchar *p = key; p < end; p++)
+    if (*p != '|')
+      g_string_append_c (buf, *p);
+
+  if (func (buf->str, buf->len, user_data))
+    return TRUE;
+
+  for (const gchar *p = key; p <= end;)
+    {
+      const gchar *bar = memchr (p, '|', end - p);
+
+      if (bar == NULL)
+        bar = end;
+
+      if (bar > p)
+        {
+          g_string_truncate (buf, 0);
+          g_string_append_len (buf, p, bar - p);
+
+          if (func (buf->str, buf->len, user_data))
+            return TRUE;
+        }
+
+      p = bar + 1;
+    }
+
+  return FALSE;
+}
+
+static inline guint32
+trigram_at (const gchar *p)
+{
+  return ((guint32) (guint8) p[0] << 16) | ((guint32) (guint8) p[1] << 8) | (guint8) p[2];
+}
+
+/* Building */
+
+static gint
+compare_pairs (gconstpointer a,
+               gconstpointer b)
+{
+  guint64 p1 = *(const guint64 *) a;
+  guint64 p2 = *(const guint64 *) b;
+
+  return p1 < p2 ? -1 : p1 > p2;
+}
+
+static gint
+compare_trigrams (gconstpointer a,
+                  gconstpointer b)
+{
+  guint32 t1 = *(const guint32 *) a;
+  guint32 t2 = *(const guint32 *) b;
+
+  return t1 < t2 ? -1 : t1 > t2;
+}
+
+static void
+align_section (GByteArray *data)
+{
+  static const guint8 padding[INDEX_ALIGN] = { 0 };
+
+  if (data->len % INDEX_ALIGN != 0)
+    g_byte_array_append (data, padding, INDEX_ALIGN - data->len % INDEX_ALIGN);
+}
+
+typedef struct
+{
+  GArray  *trigrams;
+  GString *padded;
+} RowTrigrams;
+
+static gboolean
+add_form_trigrams (const gchar *form,
+                   gsize        length,
+                   gpointer     user_data)
+{
+  RowTrigrams *row = user_data;
+  GString *padded = row->padded;
+
+  g_string_truncate (padded, 0);
+  g_string_append_c (padded, KEY_START);
+  g_string_append_len (padded, form, length);
+  g_string_append_c (padded, KEY_END);
+
+  for (gsize j = 0; j + 3 <= padded->len; j++)
+    {
+      guint32 trigram = trigram_at (padded->str + j);
+
+      g_array_append_val (row->trigrams, trigram);
+    }
+
+  return FALSE;
+}
+
+static GBytes *
+build_index (GySearchKeys *keys)
+{
+  g_autoptr(GByteArray) data = NULL;
+  g_autoptr(GByteArray) postings = NULL;
+  g_autoptr(GArray) pairs = NULL;
+  g_autoptr(GArray) trigrams = NULL;
+  g_autoptr(GArray) posting_offsets = NULL;
+  g_autoptr(GArray) row_trigrams = NULL;
+  g_autoptr(GString) padded = NULL;
+  g_autoptr(GString) buf = NULL;
+  IndexHeader header = { 0 };
+  RowTrigrams row_data;
+  guint n_keys = gy_search_keys_get_n_keys (keys);
+  guint i = 0;
+
+  pairs = g_array_new (FALSE, FALSE, sizeof (guint64));
+  row_trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+  padded = g_string_new (NULL);
+  buf = g_string_new (NULL);
+  row_data.trigrams = row_trigrams;
+  row_data.padded = padded;
+
+  /* Every distinct trigram of every form of a key, as (trigram << 32 | row). */
+  for (guint row = 0; row < n_keys; row++)
+    {
+      g_array_set_size (row_trigrams, 0);
+      foreach_form (keys, row, buf, add_form_trigrams, &row_data);
+
+      g_array_sort (row_trigrams, compare_trigrams);
+
+      for (guint j = 0; j < row_trigrams->len; j++)
+        {
+          guint32 trigram = g_array_index (row_trigrams, guint32, j);
+          guint64 pair = ((guint64) trigram << 32) | row;
+
+          if (j == 0 || trigram != g_array_index (row_trigrams, guint32, j - 1))
+            g_array_append_val (pairs, pair);
+        }
+    }
+
+  g_array_sort (pairs, compare_pairs);
+
+  trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+  posting_offsets = g_array_new (FALSE, FALSE, sizeof (guint64));
+  postings = g_byte_array_new ();
+
+  while (i < pairs->len)
+    {
+      guint32 trigram = g_array_index (pairs, guint64, i) >> 32;
+      guint64 offset = postings->len;
+      guint32 last_row = 0;
+      guint end = i;
+
+      while (end < pairs->len && (g_array_index (pairs, guint64, end) >> 32) == trigram)
+        end++;
+
+      g_array_append_val (trigrams, trigram);
+      g_array_append_val (posting_offsets, offset);
+      gy_varint_write (postings, end - i);
+
+      for (; i < end; i++)
+        {
+          guint32 row = g_array_index (pairs, guint64, i) & G_MAXUINT32;
+
+          gy_varint_write (postings, row - last_row);
+          last_row = row;
+        }
+    }
+
+  {
+    guint64 offset = postings->len;
+
+    g_array_append_val (posting_offsets, offset);
+  }
+
+  data = g_byte_array_new ();
+  g_byte_array_append (data, (const guint8 *) &header, sizeof (IndexHeader));
+
+  memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+  header.version = GY_TRIGRAM_INDEX_VERSION;
+  header.byte_order = INDEX_BYTE_ORDER;
+  header.n_keys = n_keys;
+  header.n_trigrams = trigrams->len;
+
+  header.trigrams_offset = data->len;
+  g_byte_array_append (data, (const guint8 *) trigrams->data, trigrams->len * sizeof (guint32));
+  align_section (data);
+
+  header.postings_offset = data->len;
+  g_byte_array_append (data, postings->data, postings->len);
+  header.postings_size = postings->len;
+  align_section (data);
+
+  header.posting_index_offset = data->len;
+  g_byte_array_append (data, (const guint8 *) posting_offsets->data,
+                       posting_offsets->len * sizeof (guint64));
+
+  memcpy (data->data, &header, sizeof (IndexHeader));
+
+  return g_byte_array_free_to_bytes (g_steal_pointer (&data));
+}
+
+/* Loading */
+
+static gboolean
+check_section (gsize    size,
+               guint64  offset,
+               guint64  length,
+               GError **err)
+{
+  if (offset % INDEX_ALIGN != 0 || offset > size || length > size - offset)
+    {
+      g_set_error (err, GY_TRIGRAM_INDEX_ERROR, GY_TRIGRAM_INDEX_ERROR_INVALID,
+                   "A section of the trigram index is out of bounds.");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static GyTrigramIndex *
+index_new_from_bytes (GBytes        *bytes,
+                      GySearchKeys  *keys,
+                      GError       **err)
+{
+  GyTrigramIndex *self;
+  const IndexHeader *header;
+  const gchar *contents;
+  gsize size;
+
+  contents = g_bytes_get_data (bytes, &size);
+
+  if (size < sizeof (IndexHeader) || memcmp (contents, INDEX_MAGIC, 8) != 0)
+    {
+      g_set_error (err, GY_TRIGRAM_INDEX_ERROR, GY_TRIGRAM_INDEX_ERROR_INVALID,
+                   "The data is not a trigram index.");
+      return NULL;
+    }
+
+  header = (const IndexHeader *) contents;
+
+  if (header->byte_order != INDEX_BYTE_ORDER)
+    {
+      g_set_error (err, GY_TRIGRAM_INDEX_ERROR, GY_TRIGRAM_INDEX_ERROR_BYTE_ORDER,
+                   "The trigram index was written on a host of different byte order.");
+      return NULL;
+    }
+
+  if (header->version != GY_TRIGRAM_INDEX_VERSION)
+    {
+      g_set_error (err, GY_TRIGRAM_INDEX_ERROR, GY_TRIGRAM_INDEX_ERROR_VERSION,
+                   "The trigram index has version %u; version %u is supported.",
+                   header->version, GY_TRIGRAM_INDEX_VERSION);
+      return NULL;
+    }
+
+  if (header->n_keys != gy_search_keys_get_n_keys (keys))
+    {
+      g_set_error (err, GY_TRIGRAM_INDEX_ERROR, GY_TRIGRAM_INDEX_ERROR_INVALID,
+                   "The trigram index was built for other keys.");
+      return NULL;
+    }
+
+  if (!check_section (size, header->trigrams_offset, (guint64) header->n_trigrams * sizeof (guint32), err) ||
+      !check_section (size, header->postings_offset, header->postings_size, err) ||
+      !check_section (size, header->posting_index_offset, ((guint64) header->n_trigrams + 1) * sizeof (guint64), err))
+    return NULL;
+
+  self = g_object_new (GY_TYPE_TRIGRAM_INDEX, NULL);
+  self->keys = gy_search_keys_ref (keys);
+  self->bytes = g_bytes_ref (bytes);
+  self->trigrams = (const guint32 *) (contents + header->trigrams_offset);
+  self->postings = (const guint8 *) contents + header->postings_offset;
+  self->postings_size = header->postings_size;
+  self->posting_index = (const guint64 *) (contents + header->posting_index_offset);
+  self->n_trigrams = header->n_trigrams;
+
+  return self;
+}
+
+/**
+ * gy_trigram_index_new_for_keys:
+ * @keys: the folded search keys of a model
+ *
+ * Builds the trigram index of @keys in memory. It reads every key, so
+ * it is better run on a worker thread for a large model.
+ *
+ * Returns: (transfer full): a new #GyTrigramIndex
+ */
+GyTrigramIndex *
+gy_trigram_index_new_for_keys (GySearchKeys *keys)
+{
+  g_autoptr(GBytes) bytes = NULL;
+
+  g_return_val_if_fail (keys != NULL, NULL);
+
+  bytes = build_index (keys);
+
+  return index_new_from_bytes (bytes, keys, NULL);
+}
+
+/**
+ * gy_trigram_index_new:
+ * @filename: the index file
+ * @keys: the keys the index was built for
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Maps an index saved with gy_trigram_index_save() into memory.
+ *
+ * Returns: (transfer full) (nullable): a new #GyTrigramIndex, or %NULL on error
+ */
+GyTrigramIndex *
+gy_trigram_index_new (const gchar   *filename,
+                      GySearchKeys  *keys,
+                      GError       **err)
+{
+  g_autoptr(GMappedFile) file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (keys != NULL, NULL);
+
+  file = g_mapped_file_new (filename, FALSE, err);
+
+  if (file == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+
+  return index_new_from_bytes (bytes, keys, err);
+}
+
+/**
+ * gy_trigram_index_save:
+ * @self: a #GyTrigramIndex
+ * @filename: the file to write the index to
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gy_trigram_index_save (GyTrigramIndex  *self,
+                       const gchar     *filename,
+                       GError         **err)
+{
+  gconstpointer data;
+  gsize size;
+
+  g_return_val_if_fail (GY_IS_TRIGRAM_INDEX (self), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  data = g_bytes_get_data (self->bytes, &size);
+
+  return g_file_set_contents (filename, data, size, err);
+}
+
+/* Searching */
+
+typedef struct
+{
+  const guint8 *p;
+  const guint8 *end;
+  guint64       remaining;
+  guint64       row;
+} Cursor;
+
+static gboolean
+cursor_next (Cursor *cursor)
+{
+  guint64 delta;
+
+  if (cursor->remaining == 0 ||
+      (cursor->p = gy_varint_read (cursor->p, cursor->end, &delta)) == NULL)
+    {
+      cursor->remaining = 0;
+      return FALSE;
+    }
+
+  cursor->row += delta;
+  cursor->remaining--;
+
+  return TRUE;
+}
+
+static gboolean
+cursor_init (GyTrigramIndex *self,
+             guint32         trigram,
+             Cursor         *cursor)
+{
+  guint lo = 0;
+  guint hi = self->n_trigrams;
+  guint64 begin, end;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (self->trigrams[mid] < trigram)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo == self->n_trigrams || self->trigrams[lo] != trigram)
+    return FALSE;
+
+  begin = self->posting_index[lo];
+  end = self->posting_index[lo + 1];
+
+  if (begin > end || end > self->postings_size)
+    return FALSE;
+
+  cursor->end = self->postings + end;
+  cursor->p = gy_varint_read (self->postings + begin, cursor->end, &cursor->remaining);
+  cursor->row = 0;
+
+  return cursor->p != NULL && cursor_next (cursor);
+}
+
+static gint
+compare_cursors (gconstpointer a,
+                 gconstpointer b)
+{
+  const Cursor *c1 = a;
+  const Cursor *c2 = b;
+
+  return c1->remaining < c2->remaining ? -1 : c1->remaining > c2->remaining;
+}
+
+/*
+ * Collects the distinct trigrams of the literal parts of @pattern. A part
+ * at the start or at the end of the pattern is anchored by the marker.
+ */
+static GArray *
+get_pattern_trigrams (const gchar *pattern)
+{
+  g_autoptr(GString) part = g_string_new (NULL);
+  GArray *trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+  const gchar *p = pattern;
+
+  g_string_append_c (part, KEY_START);
+
+  for (;; p++)
+    {
+      if (*p == '*' || *p == '?' || *p == '\0')
+        {
+          if (*p == '\0')
+            g_string_append_c (part, KEY_END);
+
+          for (gsize j = 0; j + 3 <= part->len; j++)
+            {
+              guint32 trigram = trigram_at (part->str + j);
+
+              g_array_append_val (trigrams, trigram);
+            }
+
+          if (*p == '\0')
+            break;
+
+          g_string_truncate (part, 0);
+        }
+      else if (*p != '|')
+        {
+          g_string_append_c (part, *p);
+        }
+    }
+
+  g_array_sort (trigrams, compare_trigrams);
+
+  for (guint i = 1; i < trigrams->len;)
+    {
+      if (g_array_index (trigrams, guint32, i) == g_array_index (trigrams, guint32, i - 1))
+        g_array_remove_index (trigrams, i);
+      else
+        i++;
+    }
+
+  return trigrams;
+}
+
+static gboolean
+match_pattern (const gchar *form,
+               gsize        length,
+               gpointer     user_data)
+{
+  GPatternSpec *spec = user_data;
+
+#if GLIB_CHECK_VERSION (2, 70, 0)
+  return g_pattern_spec_match (spec, length, form, NULL);
+#else
+  return g_pattern_match (spec, length, form, NULL);
+#endif
+}
+
+/* Whether any form of the key of @row matches @spec. */
+static inline gboolean
+match_row (GyTrigramIndex *self,
+           guint           row,
+           GPatternSpec   *spec,
+           GString        *buf)
+{
+  return foreach_form (self->keys, row, buf, match_pattern, spec);
+}
+
+/* Called with every matching row, in order; returns %FALSE to stop the search. */
+typedef gboolean (*MatchFunc) (guint32  row,
+                               gpointer user_data);
+
+static void
+search (GyTrigramIndex *self,
+        const gchar    *pattern,
+        GCancellable   *cancellable,
+        MatchFunc       func,
+        gpointer        user_data)
+{
+  g_autofree gchar *folded = NULL;
+  g_autofree Cursor *cursors = NULL;
+  g_autoptr(GArray) trigrams = NULL;
+  g_autoptr(GString) buf = NULL;
+  g_autoptr(GString) plain = NULL;
+  GPatternSpec *spec;
+  guint n_keys = gy_search_keys_get_n_keys (self->keys);
+  guint64 target = 0;
+  guint n;
+
+  if ((folded = gy_search_keys_fold (self->keys, pattern, -1)) == NULL)
+    return;
+
+  /* The pattern is matched against the forms of the keys, which have no '|'. */
+  plain = g_string_new (NULL);
+  for (const gchar *p = folded; *p != '\0'; p++)
+    if (*p != '|')
+      g_string_append_c (plain, *p);
+
+  spec = g_pattern_spec_new (plain->str);
+  buf = g_string_new (NULL);
+  trigrams = get_pattern_trigrams (plain->str);
+  n = trigrams->len;
+
+  if (n == 0)
+    {
+      for (guint row = 0; row < n_keys; row++)
+        {
+          if (row % 4096 == 0 && g_cancellable_is_cancelled (cancellable))
+            break;
+
+          if (match_row (self, row, spec, buf) && !func (row, user_data))
+            break;
+        }
+
+      g_pattern_spec_free (spec);
+      return;
+    }
+
+  cursors = g_new0 (Cursor, n);
+
+  for (guint i = 0; i < n; i++)
+    {
+      if (!cursor_init (self, g_array_index (trigrams, guint32, i), &cursors[i]))
+        goto out;
+    }
+
+  /* The rarest trigram leads, so the others are stepped as little as possible. */
+  qsort (cursors, n, sizeof (Cursor), compare_cursors);
+  target = cursors[0].row;
+
+  for (guint checked = 0;; checked++)
+    {
+      gboolean aligned = TRUE;
+
+      for (guint i = 0; i < n; i++)
+        {
+          while (cursors[i].row < target)
+            if (!cursor_next (&cursors[i]))
+              goto out;
+
+          if (cursors[i].row > target)
+            {
+              target = cursors[i].row;
+              aligned = FALSE;
+              break;
+            }
+        }
+
+      if (!aligned)
+        continue;
+
+      if (checked % 1024 == 0 && g_cancellable_is_cancelled (cancellable))
+        goto out;
+
+      if (target < n_keys && match_row (self, target, spec, buf) && !func (target, user_data))
+        goto out;
+
+      target++;
+    }
+
+out:
+  g_pattern_spec_free (spec);
+}
+
+typedef struct
+{
+  GArray *rows;
+  guint   limit;
+} CollectData;
+
+static gboolean
+collect_row (guint32  row,
+             gpointer user_data)
+{
+  CollectData *data = user_data;
+
+  g_array_append_val (data->rows, row);
+
+  return data->rows->len < data->limit;
+}
+
+/**
+ * gy_trigram_index_search:
+ * @self: a #GyTrigramIndex
+ * @pattern: a pattern in which '*' stands for any text and '?' for one character
+ * @limit: the greatest number of rows to return
+ *
+ * Finds the rows whose folded keys match @pattern as a whole.
+ *
+ * Returns: (transfer full) (element-type guint32): the rows, in order
+ */
+GArray *
+gy_trigram_index_search (GyTrigramIndex *self,
+                         const gchar    *pattern,
+                         guint           limit)
+{
+  CollectData data;
+
+  g_return_val_if_fail (GY_IS_TRIGRAM_INDEX (self), NULL);
+  g_return_val_if_fail (pattern != NULL, NULL);
+
+  data.rows = g_array_new (FALSE, FALSE, sizeof (guint32));
+  data.limit = limit;
+
+  if (limit > 0)
+    search (self, pattern, NULL, collect_row, &data);
+
+  return data.rows;
+}
+
+typedef struct
+{
+  gchar                     *pattern;
+  guint                      limit;
+  guint                      n_found;
+  GArray                    *batch;
+  GyTrigramIndexResultsFunc  results_func;
+  gpointer                   results_data;
+  GDestroyNotify             results_destroy;
+} SearchData;
+
+typedef struct
+{
+  GTask  *task;
+  GArray *rows;
+} SearchBatch;
+
+static void
+search_data_free (gpointer data)
+{
+  SearchData *search_data = data;
+
+  if (search_data->results_destroy != NULL)
+    search_data->results_destroy (search_data->results_data);
+
+  g_free (search_data->pattern);
+  g_clear_pointer (&search_data->batch, g_array_unref);
+  g_slice_free (SearchData, search_data);
+}
+
+static gboolean
+search_batch_dispatch (gpointer user_data)
+{
+  SearchBatch *batch = user_data;
+  SearchData *data = g_task_get_task_data (batch->task);
+
+  if (!g_cancellable_is_cancelled (g_task_get_cancellable (batch->task)))
+    data->results_func ((const guint32 *) batch->rows->data, batch->rows->len, data->results_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+search_batch_free (gpointer user_data)
+{
+  SearchBatch *batch = user_data;
+
+  g_object_unref (batch->task);
+  g_array_unref (batch->rows);
+  g_slice_free (SearchBatch, batch);
+}
+
+/* Hands the rows found so far to the main context of @task. */
+static void
+flush_batch (GTask *task)
+{
+  SearchData *data = g_task_get_task_data (task);
+  SearchBatch *batch;
+
+  if (data->batch->len == 0)
+    return;
+
+  batch = g_slice_new (SearchBatch);
+  batch->task = g_object_ref (task);
+  batch->rows = g_steal_pointer (&data->batch);
+  data->batch = g_array_sized_new (FALSE, FALSE, sizeof (guint32), SEARCH_BATCH);
+
+  g_main_context_invoke_full (g_task_get_context (task), g_task_get_priority (task),
+                              search_batch_dispatch, batch, search_batch_free);
+}
+
+static gboolean
+stream_row (guint32  row,
+            gpointer user_data)
+{
+  GTask *task = user_data;
+  SearchData *data = g_task_get_task_data (task);
+
+  g_array_append_val (data->batch, row);
+  data->n_found++;
+
+  if (data->batch->len == SEARCH_BATCH)
+    flush_batch (task);
+
+  return data->n_found < data->limit;
+}
+
+static void
+search_worker (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+  GyTrigramIndex *self = source_object;
+  SearchData *data = task_data;
+
+  if (data->limit > 0)
+    search (self, data->pattern, cancellable, stream_row, task);
+
+  flush_batch (task);
+
+  if (!g_task_return_error_if_cancelled (task))
+    g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * gy_trigram_index_search_async:
+ * @self: a #GyTrigramIndex
+ * @pattern: a pattern in which '*' stands for any text and '?' for one character
+ * @limit: the greatest number of rows to find
+ * @results_func: the function which receives the rows as they are found
+ * @results_data: data to pass to @results_func
+ * @results_destroy: (nullable): a function to free @results_data
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the search is over
+ * @user_data: data to pass to @callback
+ *
+ * Runs gy_trigram_index_search() on a worker thread. The rows are
+ * handed to @results_func in the thread-default main context, in
+ * batches as they are found, before @callback is called; none are
+ * handed over once @cancellable is cancelled.
+ */
+void
+gy_trigram_index_search_async (GyTrigramIndex            *self,
+                               const gchar               *pattern,
+                               guint                      limit,
+                               GyTrigramIndexResultsFunc  results_func,
+                               gpointer                   results_data,
+                               GDestroyNotify             results_destroy,
+                               GCancellable              *cancellable,
+                               GAsyncReadyCallback        callback,
+                               gpointer                   user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  SearchData *data;
+
+  g_return_if_fail (GY_IS_TRIGRAM_INDEX (self));
+  g_return_if_fail (pattern != NULL);
+  g_return_if_fail (results_func != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  data = g_slice_new0 (SearchData);
+  data->pattern = g_strdup (pattern);
+  data->limit = limit;
+  data->batch = g_array_sized_new (FALSE, FALSE, sizeof (guint32), SEARCH_BATCH);
+  data->results_func = results_func;
+  data->results_data = results_data;
+  data->results_destroy = results_destroy;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gy_trigram_index_search_async);
+  g_task_set_task_data (task, data, search_data_free);
+  g_task_run_in_thread (task, search_worker);
+}
+
+/**
+ * gy_trigram_index_search_finish:
+ * @self: a #GyTrigramIndex
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Completes a search started with gy_trigram_index_search_async().
+ *
+ * Returns: %TRUE if the search ran to its end
+ */
+gboolean
+gy_trigram_index_search_finish (GyTrigramIndex  *self,
+                                GAsyncResult    *result,
+                                GError         **err)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), err);
+}
+
+/* Loading or building in the background */
+
+typedef struct
+{
+  GySearchKeys *keys;
+  gchar        *path;
+} LoadData;
+
+static void
+load_data_free (gpointer data)
+{
+  LoadData *load_data = data;
+
+  gy_search_keys_unref (load_data->keys);
+  g_free (load_data->path);
+  g_slice_free (LoadData, load_data);
+}
+
+static void
+load_worker (GTask        *task,
+             gpointer      source_object,
+             gpointer      task_data,
+             GCancellable *cancellable)
+{
+  LoadData *data = task_data;
+  GyTrigramIndex *index = NULL;
+  GError *error = NULL;
+
+  if (data->path != NULL)
+    index = gy_trigram_index_new (data->path, data->keys, NULL);
+
+  if (index == NULL)
+    {
+      if (g_task_return_error_if_cancelled (task))
+        return;
+
+      index = gy_trigram_index_new_for_keys (data->keys);
+
+      if (data->path != NULL)
+        {
+          g_autofree gchar *dirname = g_path_get_dirname (data->path);
+
+          if (g_mkdir_with_parents (dirname, 0700) != 0 ||
+              !gy_trigram_index_save (index, data->path, &error))
+            {
+              g_debug ("Failed to save the trigram index to %s: %s",
+                       data->path, error ? error->message : g_strerror (errno));
+              g_clear_error (&error);
+            }
+        }
+    }
+
+  g_task_return_pointer (task, index, g_object_unref);
+}
+
+/**
+ * gy_trigram_index_load_async:
+ * @service: the dictionary service the keys come from
+ * @keys: the folded search keys of the model of @service
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the index is ready
+ * @user_data: data to pass to @callback
+ *
+ * Loads the trigram index of @keys from the cache of @service, or
+ * builds it on a worker thread and saves it there. Services without
+ * a fingerprint have their index built every time.
+ */
+void
+gy_trigram_index_load_async (GyDictService       *service,
+                             GySearchKeys        *keys,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autofree gchar *kind = NULL;
+  const GyFoldTable *fold_table;
+  LoadData *data;
+
+  g_return_if_fail (GY_IS_DICT_SERVICE (service));
+  g_return_if_fail (keys != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  /* The service is asked here, as it may not be safe to use from the worker. */
+  data = g_slice_new0 (LoadData);
+  data->keys = gy_search_keys_ref (keys);
+
+  /* Keys folded without diacritics have trigrams of their own. */
+  if ((fold_table = gy_search_keys_get_fold_table (keys)) == NULL)
+    kind = g_strdup ("trigram");
+  else if (*gy_fold_table_get_language (fold_table) == '\0')
+    kind = g_strdup ("trigram-fold");
+  else
+    kind = g_strdup_printf ("trigram-fold-%s", gy_fold_table_get_language (fold_table));
+
+  data->path = gy_dict_service_get_cache_filename (service, kind);
+
+  task = g_task_new (service, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gy_trigram_index_load_async);
+  g_task_set_task_data (task, data, load_data_free);
+  g_task_set_return_on_cancel (task, TRUE);
+  g_task_run_in_thread (task, load_worker);
+}
+
+/**
+ * gy_trigram_index_load_finish:
+ * @result: a #GAsyncResult
+ * @err: addres of return location for errors, or %NULL
+ *
+ * Completes a request started with gy_trigram_index_load_async().
+ *
+ * Returns: (transfer full) (nullable): the index, or %NULL on error
+ */
+GyTrigramIndex *
+gy_trigram_index_load_finish (GAsyncResult  *result,
+                              GError       **err)
+{
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), err);
+}
@@ -0,0 +1,101 @@
+/* gy-trigram-index.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#if !defined (GYDICT_INSIDE) && !defined (GYDICT_COMPILATION)
+#error "Only <gydict.h> can be included directly."
+#endif
+
+#include <gtk/gtk.h>
+#include "gy-dict-service.h"
+#include "gy-search-keys.h"
+
+G_BEGIN_DECLS
+
+#define GY_TRIGRAM_INDEX_VERSION 2
+
+#define GY_TRIGRAM_INDEX_ERROR (gy_trigram_index_error_quark ())
+
+/**
+ * GyTrigramIndexError:
+ * @GY_TRIGRAM_INDEX_ERROR_INVALID: the data is not a trigram index, is damaged or belongs to other keys
+ * @GY_TRIGRAM_INDEX_ERROR_VERSION: the index was written in an unsupported version
+ * @GY_TRIGRAM_INDEX_ERROR_BYTE_ORDER: the index was written on a host of different byte order
+ *
+ * Errors returned while loading a trigram index.
+ */
+typedef enum
+{
+  GY_TRIGRAM_INDEX_ERROR_INVALID,
+  GY_TRIGRAM_INDEX_ERROR_VERSION,
+  GY_TRIGRAM_INDEX_ERROR_BYTE_ORDER,
+} GyTrigramIndexError;
+
+#define GY_TYPE_TRIGRAM_INDEX (gy_trigram_index_get_type())
+
+G_DECLARE_FINAL_TYPE (GyTrigramIndex, gy_trigram_index, GY, TRIGRAM_INDEX, GObject)
+
+/**
+ * GyTrigramIndexResultsFunc:
+ * @rows: (array length=n_rows): rows matching the pattern, in order
+ * @n_rows: the number of rows
+ * @user_data: the data passed to gy_trigram_index_search_async()
+ *
+ * Receives a batch of the rows found by gy_trigram_index_search_async().
+ */
+typedef void (*GyTrigramIndexResultsFunc) (const guint32 *rows,
+                                           guint          n_rows,
+                                           gpointer       user_data);
+
+GQuark gy_trigram_index_error_quark (void);
+
+GyTrigramIndex *gy_trigram_index_new_for_keys   (GySearchKeys               *keys);
+GyTrigramIndex *gy_trigram_index_new            (const gchar                *filename,
+                                                 GySearchKeys               *keys,
+                                                 GError                    **err);
+gboolean        gy_trigram_index_save           (GyTrigramIndex             *self,
+                                                 const gchar                *filename,
+                                                 GError                    **err);
+GArray         *gy_trigram_index_search         (GyTrigramIndex             *self,
+                                                 const gchar                *pattern,
+                                                 guint                       limit);
+void            gy_trigram_index_search_async   (GyTrigramIndex             *self,
+                                                 const gchar                *pattern,
+                                                 guint                       limit,
+                                                 GyTrigramIndexResultsFunc   results_func,
+                                                 gpointer                    results_data,
+                                                 GDestroyNotify              results_destroy,
+                                                 GCancellable               *cancellable,
+                                                 GAsyncReadyCallback         callback,
+                                                 gpointer                    user_data);
+gboolean        gy_trigram_index_search_finish  (GyTrigramIndex             *self,
+                                                 GAsyncResult               *result,
+                                                 GError                    **err);
+void            gy_trigram_index_load_async     (GyDictService              *service,
+                                                 GySearchKeys               *keys,
+                                                 GCancellable               *cancellable,
+                                                 GAsyncReadyCallback         callback,
+                                                 gpointer                    user_data);
+GyTrigramIndex *gy_trigram_index_load_finish    (GAsyncResult               *result,
+                                                 GError                    **err);
+gboolean        gy_trigram_index_is_pattern     (const gchar                *text);
+
+G_END_DECLS
@@ -0,0 +1,79 @@
+/* gy-varint.h
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Base-128 varints, as used by the posting lists of the on-disk
+ * indexes: seven bits per byte, least significant first, with the
+ * high bit set on every byte but the last.
+ */
+
+static inline void
+gy_varint_write (GByteArray *data,
+                 guint64     value)
+{
+  guint8 buf[10];
+  guint n = 0;
+
+  do
+    {
+      buf[n] = value & 0x7f;
+      value >>= 7;
+
+      if (value != 0)
+        buf[n] |= 0x80;
+
+      n++;
+    }
+  while (value != 0);
+
+  g_byte_array_append (data, buf, n);
+}
+
+/* Returns the byte after the varint, or %NULL if it runs past @end. */
+static inline const guint8 *
+gy_varint_read (const guint8 *p,
+                const guint8 *end,
+                guint64      *value)
+{
+  guint64 result = 0;
+
+  for (guint shift = 0; p < end && shift < 64; shift += 7)
+    {
+      guint8 byte = *p++;
+
+      result |= (guint64) (byte & 0x7f) << shift;
+
+      if ((byte & 0x80) == 0)
+        {
+          *value = result;
+          return p;
+        }
+    }
+
+  return NULL;
+}
+
+G_END_DECLS
@@ -414,6 +414,54 @@ prepend_to_list (void)
   g_slist_free (l);
 }
 
+static void
+append_out_of_order (void)
+{
+  static const guint starts[] = { 40, 10, 30, 10, 0 };
+  static const gint expected[] = { 4, 1, 3, 2, 0 };
+  GyTextAttribute *attr;
+  GyTextAttrList *attr_list;
+  GSList *l = NULL;
+
+  attr_list = gy_text_attr_list_new ();
+
+  for (guint i = 0; i < G_N_ELEMENTS (starts); i++)
+    {
+      attr = gy_text_attribute_size_new (i);
+      gy_text_attribute_set_start_index (attr, starts[i]);
+      gy_text_attr_list_append (attr_list, attr);
+    }
+
+  mutest_expect ("every appended text attribute is counted",
+                 mutest_int_value (gy_text_attr_list_get_length (attr_list)),
+                 mutest_to_be, 5, NULL);
+
+  l = gy_text_attr_list_get_attributes (attr_list);
+
+  for (guint i = 0; i < G_N_ELEMENTS (expected); i++)
+    {
+      attr = g_slist_nth_data (l, i);
+      mutest_expect ("the text attributes are sorted by their start, keeping the order of equal ones",
+                     mutest_int_value (gy_text_attribute_get_int (attr)),
+                     mutest_to_be, expected[i], NULL);
+    }
+
+  g_slist_free_full (l, (GDestroyNotify) gy_text_attribute_unref);
+
+  attr = gy_text_attribute_size_new (5);
+  gy_text_attribute_set_start_index (attr, 10);
+  gy_text_attr_list_insert_before (attr_list, attr);
+
+  l = gy_text_attr_list_get_attributes (attr_list);
+  attr = g_slist_nth_data (l, 1);
+  mutest_expect ("an attribute inserted afterwards goes before the others with its start",
+                 mutest_int_value (gy_text_attribute_get_int (attr)),
+                 mutest_to_be, 5, NULL);
+
+  g_slist_free_full (l, (GDestroyNotify) gy_text_attribute_unref);
+  gy_text_attr_list_unref (attr_list);
+}
+
 static void
 attr_iter_order_text_attrs (void)
 {
@@ -532,6 +580,272 @@ attr_iter_order_text_attrs (void)
 
 }
 
+static void
+attr_iter_nested_text_attrs (void)
+{
+  static const struct {
+    guint start;
+    guint end;
+    gint size;
+  } spans[] = { { 0, 30, 10 }, { 5, 20, 20 }, { 10, 15, 30 }, { 12, 25, 40 } };
+  static const struct {
+    gint start;
+    gint size;
+  } expected[] = { { 0, 10 }, { 5, 20 }, { 10, 30 }, { 12, 40 }, { 15, 40 }, { 20, 40 }, { 25, 10 } };
+  GyTextAttribute *attr = NULL;
+  GyTextAttrList *attr_list = NULL;
+  GyTextAttrIterator *iter = NULL;
+  guint i = 0;
+  gint start;
+
+  attr_list = gy_text_attr_list_new ();
+
+  for (guint j = 0; j < G_N_ELEMENTS (spans); j++)
+    {
+      attr = gy_text_attribute_size_new (spans[j].size);
+      gy_text_attribute_set_start_index (attr, spans[j].start);
+      gy_text_attribute_set_end_index (attr, spans[j].end);
+      gy_text_attr_list_insert (attr_list, attr);
+    }
+
+  iter = gy_text_attr_list_get_iterator (attr_list);
+
+  do
+    {
+      gy_text_attr_iterator_range (iter, &start, NULL);
+      attr = gy_text_attr_iterator_get (iter, GY_TEXT_ATTR_SIZE);
+
+      mutest_expect ("the segment starts where the styles change",
+                     mutest_int_value (start),
+                     mutest_to_be, expected[i].start, NULL);
+      mutest_expect ("the size which started last applies, or the one it covered once it ends",
+                     mutest_int_value (attr != NULL ? gy_text_attribute_get_int (attr) : -1),
+                     mutest_to_be, expected[i].size, NULL);
+      mutest_expect ("no weight applies",
+                     mutest_pointer (gy_text_attr_iterator_get (iter, GY_TEXT_ATTR_WEIGHT)),
+                     mutest_to_be_null, NULL);
+      i++;
+    }
+  while (gy_text_attr_iterator_next (iter) && i < G_N_ELEMENTS (expected));
+
+  mutest_expect ("The iterator has stopped at every change.", mutest_int_value (i),
+                 mutest_to_be, 7, NULL);
+
+  gy_text_attr_iterator_destroy (iter);
+  gy_text_attr_list_unref (attr_list);
+}
+
+static void
+scheme_arena (void)
+{
+  GyFormatScheme *scheme, *copy;
+  GyTextAttribute *attr;
+  GyTextAttrIterator *iter;
+  GSList *l = NULL;
+
+  scheme = gy_format_scheme_new ();
+  gy_format_scheme_append_text (scheme, "abandon");
+
+  attr = gy_text_attribute_family_new ("Times");
+  gy_text_attribute_set_start_index (attr, 2);
+  gy_format_scheme_add_text_attr (scheme, attr);
+  gy_text_attribute_set_end_index (attr, 7);
+  gy_text_attribute_unref (attr);
+
+  attr = gy_format_scheme_new_attribute (scheme, GY_TEXT_ATTR_WEIGHT);
+  gy_text_attribute_set_int (attr, PANGO_WEIGHT_BOLD);
+  gy_text_attribute_set_start_index (attr, 0);
+  gy_text_attribute_set_end_index (attr, 4);
+
+  iter = gy_text_attr_list_get_iterator ((GyTextAttrList *) gy_format_scheme_get_attrs (scheme));
+  attr = gy_text_attr_iterator_get (iter, GY_TEXT_ATTR_WEIGHT);
+  mutest_expect ("the attribute allocated from the arena keeps its value",
+                 mutest_int_value (attr != NULL ? gy_text_attribute_get_int (attr) : -1),
+                 mutest_to_be, PANGO_WEIGHT_BOLD, NULL);
+  gy_text_attr_iterator_destroy (iter);
+
+  copy = gy_format_scheme_copy (scheme);
+  l = gy_text_attr_list_get_attributes ((GyTextAttrList *) gy_format_scheme_get_attrs (scheme));
+  gy_format_scheme_unref (scheme);
+
+  attr = g_slist_nth_data (l, 0);
+  mutest_expect ("an attribute copied out outlives the scheme",
+                 mutest_int_value (gy_text_attribute_get_int (attr)),
+                 mutest_to_be, PANGO_WEIGHT_BOLD, NULL);
+
+  attr = g_slist_nth_data (l, 1);
+  mutest_expect ("an index set after the attribute was added is kept",
+                 mutest_int_value (gy_text_attribute_get_end_index (attr)),
+                 mutest_to_be, 7, NULL);
+
+  mutest_expect ("a copy of the scheme keeps its attributes",
+                 mutest_int_value (gy_text_attr_list_get_length ((GyTextAttrList *) gy_format_scheme_get_attrs (copy))),
+                 mutest_to_be, 2, NULL);
+
+  mutest_expect ("a copy of the scheme keeps its text",
+                 mutest_bool_value (g_strcmp0 (gy_format_scheme_get_lexical_unit (copy), "abandon") == 0),
+                 mutest_to_be, true, NULL);
+
+  g_slist_free_full (l, (GDestroyNotify) gy_text_attribute_unref);
+  gy_format_scheme_unref (copy);
+}
+
+static void
+scheme_arena_strings (void)
+{
+  PangoFontDescription *desc;
+  GyFormatScheme *scheme;
+  GyTextAttribute *attr;
+  gchar family[] = "Times";
+  GSList *l = NULL;
+
+  scheme = gy_format_scheme_new ();
+  gy_format_scheme_append_text (scheme, "abandon");
+
+  attr = gy_format_scheme_new_attribute (scheme, GY_TEXT_ATTR_FAMILY);
+  gy_format_scheme_set_attribute_string (scheme, attr, family);
+  gy_text_attribute_set_end_index (attr, 4);
+
+  attr = gy_format_scheme_new_attribute (scheme, GY_TEXT_ATTR_FONT_FEATURES);
+  gy_format_scheme_set_attribute_string (scheme, attr, "smcp");
+  gy_text_attribute_set_start_index (attr, 4);
+
+  desc = pango_font_description_from_string ("Serif Bold 12");
+  attr = gy_format_scheme_new_attribute (scheme, GY_TEXT_ATTR_FONT_DESC);
+  gy_format_scheme_set_attribute_font_desc (scheme, attr, desc);
+  gy_text_attribute_set_start_index (attr, 5);
+  pango_font_description_free (desc);
+
+  /* The scheme keeps a copy of the string, not the one it was given. */
+  family[0] = 'L';
+
+  l = gy_text_attr_list_get_attributes ((GyTextAttrList *) gy_format_scheme_get_attrs (scheme));
+  gy_format_scheme_unref (scheme);
+
+  mutest_expect ("the family is copied into the arena",
+                 mutest_bool_value (g_strcmp0 (gy_text_attribute_get_string (g_slist_nth_data (l, 0)), "Times") == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("the font features outlive the scheme in a copy",
+                 mutest_bool_value (g_strcmp0 (gy_text_attribute_get_string (g_slist_nth_data (l, 1)), "smcp") == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("the font description outlives the scheme in a copy",
+                 mutest_int_value (pango_font_description_get_weight (gy_text_attribute_get_font_desc (g_slist_nth_data (l, 2)))),
+                 mutest_to_be, PANGO_WEIGHT_BOLD, NULL);
+
+  g_slist_free_full (l, (GDestroyNotify) gy_text_attribute_unref);
+}
+
+static void
+scheme_insert_text (void)
+{
+  GyFormatScheme *scheme;
+  GyTextAttribute *attr;
+  GSList *l = NULL;
+
+  scheme = gy_format_scheme_new ();
+  gy_format_scheme_reserve_text (scheme, 64);
+  gy_format_scheme_append_text (scheme, "bandon");
+
+  attr = gy_text_attribute_weight_new (PANGO_WEIGHT_BOLD);
+  gy_text_attribute_set_start_index (attr, 0);
+  gy_text_attribute_set_end_index (attr, 3);
+  gy_format_scheme_add_text_attr (scheme, attr);
+  gy_text_attribute_unref (attr);
+
+  attr = gy_text_attribute_style_new (PANGO_STYLE_ITALIC);
+  gy_text_attribute_set_start_index (attr, 3);
+  gy_format_scheme_add_text_attr (scheme, attr);
+  gy_text_attribute_unref (attr);
+
+  gy_format_scheme_prepend_char (scheme, 'a');
+  gy_format_scheme_prepend_text (scheme, "to ");
+  gy_format_scheme_insert_text (scheme, 7, "-");
+  gy_format_scheme_append_unichar (scheme, 0x2026);
+
+  mutest_expect ("the text is put together in order",
+                 mutest_bool_value (g_strcmp0 (gy_format_scheme_get_lexical_unit (scheme), "to aban-don…") == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("the length counts the bytes of the text",
+                 mutest_int_value (gy_format_scheme_length_lexical_unit (scheme)),
+                 mutest_to_be, 14, NULL);
+
+  l = gy_text_attr_list_get_attributes ((GyTextAttrList *) gy_format_scheme_get_attrs (scheme));
+
+  attr = g_slist_nth_data (l, 0);
+  mutest_expect ("the prepended text moves the attributes after it",
+                 mutest_bool_value (gy_text_attribute_get_start_index (attr) == 4 &&
+                                    gy_text_attribute_get_end_index (attr) == 7),
+                 mutest_to_be, true, NULL);
+
+  attr = g_slist_nth_data (l, 1);
+  mutest_expect ("the inserted text moves the start, but not the open end",
+                 mutest_bool_value (gy_text_attribute_get_start_index (attr) == 8 &&
+                                    gy_text_attribute_get_end_index (attr) == PANGO_ATTR_INDEX_TO_TEXT_END),
+                 mutest_to_be, true, NULL);
+
+  g_slist_free_full (l, (GDestroyNotify) gy_text_attribute_unref);
+  gy_format_scheme_unref (scheme);
+
+  scheme = gy_format_scheme_new ();
+  gy_format_scheme_append_text (scheme, "don");
+
+  attr = gy_format_scheme_new_attribute (scheme, GY_TEXT_ATTR_UNDERLINE);
+  gy_text_attribute_set_start_index (attr, 0);
+  gy_format_scheme_prepend_text (scheme, "aban");
+  gy_text_attribute_set_end_index (attr, 7);
+
+  l = gy_text_attr_list_get_attributes ((GyTextAttrList *) gy_format_scheme_get_attrs (scheme));
+
+  attr = g_slist_nth_data (l, 0);
+  mutest_expect ("an index set after the text was prepended is not moved again",
+                 mutest_bool_value (gy_text_attribute_get_start_index (attr) == 4 &&
+                                    gy_text_attribute_get_end_index (attr) == 7),
+                 mutest_to_be, true, NULL);
+
+  g_slist_free_full (l, (GDestroyNotify) gy_text_attribute_unref);
+  gy_format_scheme_unref (scheme);
+
+  scheme = gy_format_scheme_new ();
+  gy_format_scheme_append_text (scheme, "abandon");
+
+  attr = gy_format_scheme_new_attribute (scheme, GY_TEXT_ATTR_SIZE);
+  gy_text_attribute_set_start_index (attr, 4);
+  gy_text_attribute_set_end_index (attr, 7);
+
+  attr = gy_format_scheme_new_attribute (scheme, GY_TEXT_ATTR_RISE);
+  gy_text_attribute_set_start_index (attr, 0);
+  gy_text_attribute_set_end_index (attr, 5);
+
+  gy_format_scheme_prepend_text (scheme, "to ");
+
+  mutest_expect ("an attribute read after text was prepended is already moved",
+                 mutest_bool_value (gy_text_attribute_get_start_index (attr) == 3 &&
+                                    gy_text_attribute_get_end_index (attr) == 8),
+                 mutest_to_be, true, NULL);
+
+  gy_format_scheme_insert_text (scheme, 7, "-");
+
+  l = gy_text_attr_list_get_attributes ((GyTextAttrList *) gy_format_scheme_get_attrs (scheme));
+
+  attr = g_slist_nth_data (l, 0);
+  mutest_expect ("the text inserted inside moves the end running past it",
+                 mutest_bool_value (gy_text_attribute_get_start_index (attr) == 3 &&
+                                    gy_text_attribute_get_end_index (attr) == 9),
+                 mutest_to_be, true, NULL);
+
+  attr = g_slist_nth_data (l, 1);
+  mutest_expect ("the text inserted inside moves the attributes starting at it",
+                 mutest_bool_value (gy_text_attribute_get_start_index (attr) == 8 &&
+                                    gy_text_attribute_get_end_index (attr) == 11),
+                 mutest_to_be, true, NULL);
+
+  g_slist_free_full (l, (GDestroyNotify) gy_text_attribute_unref);
+  gy_format_scheme_unref (scheme);
+}
+
 static void
 attributes_suite (void)
 {
@@ -543,16 +857,27 @@ attributes_list_suite (void)
 {
   mutest_it ("appending an text attribute to the attr list", append_to_list);
   mutest_it ("prepending an text attribute to the attr list", prepend_to_list);
+  mutest_it ("appending text attributes out of order to the attr list", append_out_of_order);
 }
 
 static void
 attr_iter_suite (void)
 {
   mutest_it ("returns valid order of text attrs:", attr_iter_order_text_attrs);
+  mutest_it ("finds the covered text attr once the covering one ends", attr_iter_nested_text_attrs);
+}
+
+static void
+format_scheme_suite (void)
+{
+  mutest_it ("frees the attributes of its arena at once", scheme_arena);
+  mutest_it ("frees the strings of the attributes of its arena", scheme_arena_strings);
+  mutest_it ("moves the attributes along with the inserted text", scheme_insert_text);
 }
 
 MUTEST_MAIN (
   mutest_describe ("Text Attributes [GyTextAttributes]", attributes_suite);
   mutest_describe ("Attributes List", attributes_list_suite);
   mutest_describe ("Attrs Iterator", attr_iter_suite);
+  mutest_describe ("Format Scheme", format_scheme_suite);
 )
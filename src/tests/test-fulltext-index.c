@@ -0,0 +1,151 @@
+/* test-fulltext-index.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include <mutest.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gydict.h>
+
+static const gchar * const definitions[] = {
+  "The quick brown fox jumps.",
+  "A lazy dog sleeps; the fox watches.",
+  "Brown dogs, brown FOXES.",
+  "quick quick fox",
+  NULL
+};
+
+static GyFulltextIndex *
+build_index (void)
+{
+  g_autoptr(GBytes) bytes = NULL;
+  GyFulltextIndexBuilder *builder;
+
+  builder = gy_fulltext_index_builder_new ();
+
+  /* Every other row, so the rows differ from the order of the calls. */
+  for (guint i = 0; definitions[i] != NULL; i++)
+    gy_fulltext_index_builder_add (builder, i * 2, definitions[i]);
+
+  bytes = gy_fulltext_index_builder_end (builder);
+
+  return gy_fulltext_index_new_from_bytes (bytes, NULL);
+}
+
+static gboolean
+rows_are (GArray        *rows,
+          const guint32 *expected,
+          guint          n_expected)
+{
+  if (rows->len != n_expected)
+    return FALSE;
+
+  for (guint i = 0; i < n_expected; i++)
+    if (g_array_index (rows, guint32, i) != expected[i])
+      return FALSE;
+
+  return TRUE;
+}
+
+static void
+index_and_query (void)
+{
+  g_autoptr(GyFulltextIndex) index = build_index ();
+  g_autoptr(GArray) rows = NULL;
+
+  mutest_expect ("the index is built",
+                 mutest_pointer (index),
+                 mutest_not, mutest_to_be_null, NULL);
+
+  rows = gy_fulltext_index_query (index, "FOX", 10);
+  mutest_expect ("a word is found in every definition containing it, folded",
+                 mutest_bool_value (rows_are (rows, (const guint32[]) { 0, 2, 6 }, 3)),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_fulltext_index_query (index, "brown fox", 10);
+  mutest_expect ("all the words must occur",
+                 mutest_bool_value (rows_are (rows, (const guint32[]) { 0 }, 1)),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_fulltext_index_query (index, "\"quick fox\"", 10);
+  mutest_expect ("a phrase must occur in order",
+                 mutest_bool_value (rows_are (rows, (const guint32[]) { 6 }, 1)),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_fulltext_index_query (index, "fox cat", 10);
+  mutest_expect ("a missing word finds nothing",
+                 mutest_int_value (rows->len),
+                 mutest_to_be, 0, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_fulltext_index_query (index, "fox", 2);
+  mutest_expect ("the results are limited",
+                 mutest_int_value (rows->len),
+                 mutest_to_be, 2, NULL);
+}
+
+static void
+index_round_trip (void)
+{
+  g_autoptr(GyFulltextIndex) index = build_index ();
+  g_autoptr(GyFulltextIndex) loaded = NULL;
+  g_autoptr(GArray) rows = NULL;
+  g_autofree gchar *filename = NULL;
+  GError *error = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("gydict-fulltext-XXXXXX", &filename, NULL);
+  close (fd);
+
+  gy_fulltext_index_save (index, filename, &error);
+  mutest_expect ("the index is saved",
+                 mutest_pointer (error),
+                 mutest_to_be_null, NULL);
+
+  loaded = gy_fulltext_index_new (filename, &error);
+  mutest_expect ("the index is mapped",
+                 mutest_pointer (loaded),
+                 mutest_not, mutest_to_be_null, NULL);
+
+  mutest_expect ("the terms survive",
+                 mutest_int_value (gy_fulltext_index_get_n_terms (loaded)),
+                 mutest_to_be, gy_fulltext_index_get_n_terms (index), NULL);
+
+  rows = gy_fulltext_index_query (loaded, "\"brown fox\"", 10);
+  mutest_expect ("the mapped index answers queries",
+                 mutest_bool_value (rows_are (rows, (const guint32[]) { 0 }, 1)),
+                 mutest_to_be, true, NULL);
+
+  g_unlink (filename);
+}
+
+static void
+fulltext_index_suite (void)
+{
+  mutest_it ("answers word and phrase queries", index_and_query);
+  mutest_it ("is saved and mapped back", index_round_trip);
+}
+
+MUTEST_MAIN (
+  mutest_describe ("Full-text Index [GyFulltextIndex]", fulltext_index_suite);
+)
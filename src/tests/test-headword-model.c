@@ -0,0 +1,495 @@
+/* test-headword-model.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include <mutest.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gydict.h>
+
+static const gchar * const headwords[] = { "abandon", "abbey", "żółw", "zebra", NULL };
+
+static void
+model_rows (void)
+{
+  GyHeadwordModel *model;
+  GtkTreeIter iter;
+  gint n;
+
+  model = gy_headword_model_new_from_strv (headwords);
+
+  n = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (model), NULL);
+  mutest_expect ("the model has four rows",
+                 mutest_int_value (n),
+                 mutest_to_be, 4, NULL);
+
+  mutest_expect ("the third headword is kept intact",
+                 mutest_bool_value (g_strcmp0 (gy_headword_model_get_headword (model, 2), "żółw") == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("the fifth row does not exist",
+                 mutest_bool_value (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (model), &iter, NULL, 4)),
+                 mutest_to_be, false, NULL);
+
+  g_object_unref (model);
+}
+
+static void
+model_iterates (void)
+{
+  GyHeadwordModel *model;
+  GtkTreeIter iter;
+  GtkTreePath *path;
+  gchar *value = NULL;
+  gint n = 0;
+
+  model = gy_headword_model_new_from_strv (headwords);
+
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (model), &iter, NULL, 3);
+  path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), &iter);
+  mutest_expect ("the path of the fourth row has index 3",
+                 mutest_int_value (gtk_tree_path_get_indices (path)[0]),
+                 mutest_to_be, 3, NULL);
+  gtk_tree_path_free (path);
+
+  gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 0, &value, -1);
+  mutest_expect ("the value of the fourth row is zebra",
+                 mutest_bool_value (g_strcmp0 (value, "zebra") == 0),
+                 mutest_to_be, true, NULL);
+  g_free (value);
+
+  if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (model), &iter))
+    {
+      do
+        n++;
+      while (gtk_tree_model_iter_next (GTK_TREE_MODEL (model), &iter));
+    }
+
+  mutest_expect ("the iterator visits every row",
+                 mutest_int_value (n),
+                 mutest_to_be, 4, NULL);
+
+  g_object_unref (model);
+}
+
+static void
+index_round_trip (void)
+{
+  static const gchar * const words[] = { "Zebra", "abbey", "Żółw", "abandon" };
+  static const guint64 entry_offsets[] = { 300, 100, 400, 0 };
+  g_autofree gchar *filename = NULL;
+  GyHeadwordIndex *index;
+  GtkTreeModel *model;
+  GError *error = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("gydict-index-XXXXXX", &filename, NULL);
+  close (fd);
+
+  gy_headword_index_write (words, entry_offsets, G_N_ELEMENTS (words), filename, &error);
+  mutest_expect ("the index is written",
+                 mutest_pointer (error),
+                 mutest_to_be_null, NULL);
+
+  index = gy_headword_index_new (filename, &error);
+  mutest_expect ("the index is loaded",
+                 mutest_pointer (index),
+                 mutest_not, mutest_to_be_null, NULL);
+
+  model = gy_headword_index_get_model (index);
+  mutest_expect ("the model has a row for every headword",
+                 mutest_int_value (gtk_tree_model_iter_n_children (model, NULL)),
+                 mutest_to_be, 4, NULL);
+
+  mutest_expect ("the headwords are sorted by their search keys",
+                 mutest_bool_value (g_strcmp0 (gy_headword_model_get_headword (GY_HEADWORD_MODEL (model), 0), "abandon") == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("a folded word is found",
+                 mutest_int_value (gy_headword_index_lookup (index, "ZEBRA")),
+                 mutest_to_be, 2, NULL);
+
+  mutest_expect ("the entry offset follows its headword",
+                 mutest_int_value (gy_headword_index_get_entry_offset (index, 2)),
+                 mutest_to_be, 300, NULL);
+
+  mutest_expect ("a missing word is not found",
+                 mutest_int_value (gy_headword_index_lookup (index, "abc")),
+                 mutest_to_be, -1, NULL);
+
+  g_object_unref (index);
+  g_unlink (filename);
+}
+
+static void
+index_alternate_forms (void)
+{
+  static const gchar * const words[] = { "zebra", "colour|color" };
+  static const guint64 entry_offsets[] = { 100, 0 };
+  g_autofree gchar *filename = NULL;
+  g_autoptr(GArray) rows = NULL;
+  GyHeadwordIndex *index;
+  GySearchKeys *keys;
+  GError *error = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("gydict-index-XXXXXX", &filename, NULL);
+  close (fd);
+
+  gy_headword_index_write (words, entry_offsets, G_N_ELEMENTS (words), filename, &error);
+  index = gy_headword_index_new (filename, &error);
+  mutest_expect ("the index is loaded",
+                 mutest_pointer (index),
+                 mutest_not, mutest_to_be_null, NULL);
+
+  keys = gy_headword_model_get_search_keys (GY_HEADWORD_MODEL (gy_headword_index_get_model (index)));
+  rows = gy_search_keys_find_equal (keys, "color");
+
+  mutest_expect ("an alternate form stored in the index finds its row",
+                 mutest_bool_value (rows->len == 1 && g_array_index (rows, guint32, 0) == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("the joined form is found by its prefix",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "colourc", FALSE)),
+                 mutest_to_be, 0, NULL);
+
+  g_object_unref (index);
+  g_unlink (filename);
+}
+
+static void
+keys_find_prefix (void)
+{
+  static const gchar * const unsorted[] = { "zebra", "Abbey", "ab|andon", "żółw", NULL };
+  g_autoptr(GyHeadwordModel) model = NULL;
+  GySearchKeys *keys;
+
+  model = gy_headword_model_new_from_strv (unsorted);
+  keys = gy_headword_model_get_search_keys (model);
+
+  mutest_expect ("every row has a key",
+                 mutest_int_value (gy_search_keys_get_n_keys (keys)),
+                 mutest_to_be, 4, NULL);
+
+  mutest_expect ("the keys are folded",
+                 mutest_bool_value (g_strcmp0 (gy_search_keys_get_key (keys, 1, NULL), "abbey") == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("the first row from the top matching the prefix is found",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "ab", FALSE)),
+                 mutest_to_be, 1, NULL);
+
+  mutest_expect ("the separator of alternate forms is skipped",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "aban", FALSE)),
+                 mutest_to_be, 2, NULL);
+
+  mutest_expect ("a key of non-ASCII letters is found",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "żó", FALSE)),
+                 mutest_to_be, 3, NULL);
+
+  mutest_expect ("a missing prefix is not found",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "abc", FALSE)),
+                 mutest_to_be, -1, NULL);
+}
+
+static void
+keys_sorted (void)
+{
+  static const gchar * const sorted[] = { "abandon", "abbey", "zebra", "zebu", NULL };
+  g_autoptr(GyHeadwordModel) model = NULL;
+  GySearchKeys *keys;
+
+  model = gy_headword_model_new_from_strv (sorted);
+  keys = gy_headword_model_get_search_keys (model);
+
+  mutest_expect ("the first row with the prefix is found by bisection",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "zeb", TRUE)),
+                 mutest_to_be, 2, NULL);
+
+  mutest_expect ("a prefix past the last row is not found",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "zz", TRUE)),
+                 mutest_to_be, -1, NULL);
+}
+
+static void
+prefix_cmp (void)
+{
+  static const gchar long_word[] = "pneumonoultramicroscopicsilicovolcanoconiosis";
+
+  mutest_expect ("a long common prefix matches",
+                 mutest_int_value (gy_utility_prefix_cmp ("pneumonoultramicroscopicsilico", long_word)),
+                 mutest_to_be, 0, NULL);
+
+  mutest_expect ("a difference after a long common run is ordered",
+                 mutest_bool_value (gy_utility_prefix_cmp ("pneumonoultramicroscopicsilicz", long_word) > 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("a separator inside a long run is an ordinary byte",
+                 mutest_bool_value (gy_utility_prefix_cmp ("pneumonoultramicroscopicsilico",
+                                                           "pneumonoultra|microscopicsilicovolcano") < 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("a prefix longer than the headword does not match",
+                 mutest_bool_value (gy_utility_prefix_cmp ("abbeys", "abbey") > 0),
+                 mutest_to_be, true, NULL);
+}
+
+static void
+completion_ranked (void)
+{
+  static const gchar * const headwords[] = { "zebra", "abbey", "abandon", "abbot", "zebu", NULL };
+  static const guint32 weights[] = { 0, 5, 1, 9, 0 };
+  g_autoptr(GyHeadwordModel) model = NULL;
+  g_autoptr(GyCompletionIndex) plain = NULL;
+  g_autoptr(GyCompletionIndex) ranked = NULL;
+  g_autoptr(GArray) rows = NULL;
+  GySearchKeys *keys;
+
+  model = gy_headword_model_new_from_strv (headwords);
+  keys = gy_headword_model_get_search_keys (model);
+  plain = gy_completion_index_new (keys, NULL);
+  ranked = gy_completion_index_new (keys, weights);
+
+  rows = gy_completion_index_complete (plain, "ab", 2);
+
+  mutest_expect ("the completions are limited",
+                 mutest_int_value (rows->len),
+                 mutest_to_be, 2, NULL);
+
+  mutest_expect ("without weights the completions follow the order of the keys",
+                 mutest_bool_value (g_array_index (rows, guint32, 0) == 2 &&
+                                    g_array_index (rows, guint32, 1) == 1),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_completion_index_complete (ranked, "ab", 2);
+
+  mutest_expect ("the heaviest completions come first",
+                 mutest_bool_value (g_array_index (rows, guint32, 0) == 3 &&
+                                    g_array_index (rows, guint32, 1) == 1),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_completion_index_complete (ranked, "x", 10);
+
+  mutest_expect ("a missing prefix has no completions",
+                 mutest_int_value (rows->len),
+                 mutest_to_be, 0, NULL);
+}
+
+static void
+keys_fuzzy (void)
+{
+  static const gchar * const headwords[] = { "house", "horse", "hose", "mouse", "ho|use", "zebra", NULL };
+  g_autoptr(GyHeadwordModel) model = NULL;
+  g_autoptr(GArray) rows = NULL;
+  GySearchKeys *keys;
+
+  model = gy_headword_model_new_from_strv (headwords);
+  keys = gy_headword_model_get_search_keys (model);
+
+  rows = gy_search_keys_find_fuzzy (keys, "uohse", 1, 10);
+
+  mutest_expect ("a query too far from every key finds nothing",
+                 mutest_int_value (rows->len),
+                 mutest_to_be, 0, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_search_keys_find_fuzzy (keys, "hous", 1, 10);
+
+  mutest_expect ("the keys within one edit are found, ignoring the separator",
+                 mutest_bool_value (rows->len == 2 &&
+                                    g_array_index (rows, guint32, 0) == 0 &&
+                                    g_array_index (rows, guint32, 1) == 4),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_search_keys_find_fuzzy (keys, "hous", 2, 3);
+
+  mutest_expect ("the nearest keys come first and the results are limited",
+                 mutest_bool_value (rows->len == 3 &&
+                                    g_array_index (rows, guint32, 0) == 0 &&
+                                    g_array_index (rows, guint32, 1) == 4 &&
+                                    g_array_index (rows, guint32, 2) == 1),
+                 mutest_to_be, true, NULL);
+}
+
+static void
+keys_alternate_forms (void)
+{
+  static const gchar * const headwords[] = { "colour|color", "collar", "col|umn", "zebra", NULL };
+  g_autoptr(GyHeadwordModel) model = NULL;
+  g_autoptr(GyCompletionIndex) completion = NULL;
+  g_autoptr(GArray) rows = NULL;
+  GySearchKeys *keys;
+
+  model = gy_headword_model_new_from_strv (headwords);
+  keys = gy_headword_model_get_search_keys (model);
+
+  mutest_expect ("a later alternate form is found by its prefix",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "color", FALSE)),
+                 mutest_to_be, 0, NULL);
+
+  mutest_expect ("a part of a split headword is found on its own",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, "umn", FALSE)),
+                 mutest_to_be, 2, NULL);
+
+  rows = gy_search_keys_find_equal (keys, "color");
+
+  mutest_expect ("an alternate form equals its row only",
+                 mutest_bool_value (rows->len == 1 && g_array_index (rows, guint32, 0) == 0),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  completion = gy_completion_index_new (keys, NULL);
+  rows = gy_completion_index_complete (completion, "col", 10);
+
+  mutest_expect ("a row matched by several forms is completed once",
+                 mutest_int_value (rows->len),
+                 mutest_to_be, 3, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_search_keys_find_fuzzy (keys, "colur", 1, 10);
+
+  mutest_expect ("the nearest alternate form finds its row once",
+                 mutest_bool_value (rows->len == 1 && g_array_index (rows, guint32, 0) == 0),
+                 mutest_to_be, true, NULL);
+}
+
+static void
+keys_wildcard (void)
+{
+  static const gchar * const headwords[] = { "nation", "Station", "graphic", "paragraph", "unable", "unstable", "un|usable", "colour|color", NULL };
+  g_autoptr(GyHeadwordModel) model = NULL;
+  g_autoptr(GyTrigramIndex) index = NULL;
+  g_autoptr(GArray) rows = NULL;
+
+  model = gy_headword_model_new_from_strv (headwords);
+  index = gy_trigram_index_new_for_keys (gy_headword_model_get_search_keys (model));
+
+  rows = gy_trigram_index_search (index, "*TION", 10);
+  mutest_expect ("a suffix pattern finds the keys ending with it",
+                 mutest_bool_value (rows->len == 2 &&
+                                    g_array_index (rows, guint32, 0) == 0 &&
+                                    g_array_index (rows, guint32, 1) == 1),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_trigram_index_search (index, "*graph*", 10);
+  mutest_expect ("an infix pattern finds the keys containing it",
+                 mutest_int_value (rows->len),
+                 mutest_to_be, 2, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_trigram_index_search (index, "un??able", 10);
+  mutest_expect ("'?' stands for exactly one character, across a separator",
+                 mutest_bool_value (rows->len == 2 &&
+                                    g_array_index (rows, guint32, 0) == 5 &&
+                                    g_array_index (rows, guint32, 1) == 6),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_trigram_index_search (index, "us*", 10);
+  mutest_expect ("a prefix pattern finds a later alternate form",
+                 mutest_bool_value (rows->len == 1 && g_array_index (rows, guint32, 0) == 6),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_trigram_index_search (index, "*our", 10);
+  mutest_expect ("a suffix pattern finds the end of an earlier alternate form",
+                 mutest_bool_value (rows->len == 1 && g_array_index (rows, guint32, 0) == 7),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_trigram_index_search (index, "u*", 10);
+  mutest_expect ("a pattern too short for trigrams is matched against every key",
+                 mutest_int_value (rows->len),
+                 mutest_to_be, 3, NULL);
+}
+
+static void
+keys_folded (void)
+{
+  static const gchar * const headwords[] = { "Straße", "żółw", "Käse", "Ørsted", NULL };
+  g_autoptr(GyHeadwordModel) model = NULL;
+  g_autoptr(GySearchKeys) keys = NULL;
+  g_autoptr(GySearchKeys) german = NULL;
+  g_autofree gchar *query = NULL;
+  g_autofree gchar *swedish = NULL;
+
+  model = gy_headword_model_new_from_strv (headwords);
+  keys = gy_search_keys_new_from_model_full (GTK_TREE_MODEL (model), 0, gy_fold_table_get (NULL));
+
+  mutest_expect ("the diacritics of the keys are dropped",
+                 mutest_bool_value (g_strcmp0 (gy_search_keys_get_key (keys, 1, NULL), "zolw") == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("the letters without a decomposition are spelled plainly",
+                 mutest_bool_value (g_strcmp0 (gy_search_keys_get_key (keys, 3, NULL), "orsted") == 0),
+                 mutest_to_be, true, NULL);
+
+  query = gy_search_keys_fold (keys, "STRAS", -1);
+  mutest_expect ("the query is folded the way the keys were",
+                 mutest_int_value (gy_search_keys_find_prefix (keys, query, FALSE)),
+                 mutest_to_be, 0, NULL);
+
+  german = gy_search_keys_new_from_model_full (GTK_TREE_MODEL (model), 0, gy_fold_table_get ("de_DE.UTF-8"));
+  mutest_expect ("German spells umlauts with an e",
+                 mutest_bool_value (g_strcmp0 (gy_search_keys_get_key (german, 2, NULL), "kaese") == 0),
+                 mutest_to_be, true, NULL);
+
+  swedish = gy_fold_table_fold (gy_fold_table_get ("sv"), "Ka\xcc\x88se", -1);
+  mutest_expect ("Swedish keeps ä apart, written composed or not",
+                 mutest_bool_value (g_strcmp0 (swedish, "k\xc3\xa4se") == 0),
+                 mutest_to_be, true, NULL);
+}
+
+static void
+search_keys_suite (void)
+{
+  mutest_it ("finds the first row beginning with a prefix", keys_find_prefix);
+  mutest_it ("bisects the keys of a sorted model", keys_sorted);
+  mutest_it ("compares prefixes in blocks", prefix_cmp);
+  mutest_it ("ranks the completions of a prefix", completion_ranked);
+  mutest_it ("finds the keys within a few typos", keys_fuzzy);
+  mutest_it ("indexes every alternate form of a headword", keys_alternate_forms);
+  mutest_it ("matches wildcard patterns through trigrams", keys_wildcard);
+  mutest_it ("folds the keys without diacritics", keys_folded);
+}
+
+static void
+headword_index_suite (void)
+{
+  mutest_it ("maps the index written by the indexer", index_round_trip);
+  mutest_it ("stores the alternate forms of the keys", index_alternate_forms);
+}
+
+static void
+headword_model_suite (void)
+{
+  mutest_it ("exposes every headword as a row", model_rows);
+  mutest_it ("iterates over the rows", model_iterates);
+}
+
+MUTEST_MAIN (
+  mutest_describe ("Headword Model [GyHeadwordModel]", headword_model_suite);
+  mutest_describe ("Headword Index [GyHeadwordIndex]", headword_index_suite);
+  mutest_describe ("Search Keys [GySearchKeys]", search_keys_suite);
+)
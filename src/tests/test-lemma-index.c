@@ -0,0 +1,130 @@
+/* test-lemma-index.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include <mutest.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gydict.h>
+
+static const gchar * const forms[]  = { "went", "gone", "goes", "domami", "domy", "Domy", "lepszy", "saw", "saw" };
+static const gchar * const lemmas[] = { "go",   "go",   "go",   "dom",    "dom",  "dom",  "dobry",  "see", "saw" };
+
+static GyLemmaIndex *
+write_index (gchar **filename)
+{
+  GError *error = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("gydict-lemmas-XXXXXX", filename, NULL);
+  close (fd);
+
+  gy_lemma_index_write (forms, lemmas, G_N_ELEMENTS (forms), *filename, &error);
+  mutest_expect ("the index is written",
+                 mutest_pointer (error),
+                 mutest_to_be_null, NULL);
+
+  return gy_lemma_index_new (*filename, NULL);
+}
+
+static void
+index_lookup (void)
+{
+  g_autofree gchar *filename = NULL;
+  g_autoptr(GyLemmaIndex) index = NULL;
+  g_auto(GStrv) found = NULL;
+
+  index = write_index (&filename);
+  mutest_expect ("the index is mapped",
+                 mutest_pointer (index),
+                 mutest_not, mutest_to_be_null, NULL);
+
+  found = gy_lemma_index_lookup (index, "WENT");
+  mutest_expect ("a folded form finds its lemma",
+                 mutest_bool_value (found != NULL && g_strv_length (found) == 1 && g_strcmp0 (found[0], "go") == 0),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&found, g_strfreev);
+  found = gy_lemma_index_lookup (index, "saw");
+  mutest_expect ("an ambiguous form finds every lemma",
+                 mutest_int_value (found != NULL ? g_strv_length (found) : 0),
+                 mutest_to_be, 2, NULL);
+
+  g_clear_pointer (&found, g_strfreev);
+  found = gy_lemma_index_lookup (index, "lepszy");
+  mutest_expect ("a suppletive form keeps its whole lemma",
+                 mutest_bool_value (found != NULL && g_strcmp0 (found[0], "dobry") == 0),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("a prefix of a form is not a form",
+                 mutest_pointer (gy_lemma_index_lookup (index, "wen")),
+                 mutest_to_be_null, NULL);
+
+  mutest_expect ("a missing form is not found",
+                 mutest_pointer (gy_lemma_index_lookup (index, "walked")),
+                 mutest_to_be_null, NULL);
+
+  g_unlink (filename);
+}
+
+static void
+index_resolve (void)
+{
+  static const gchar * const headwords[] = { "dobry", "dom", "go", "goal", "see", NULL };
+  g_autofree gchar *filename = NULL;
+  g_autoptr(GyLemmaIndex) index = NULL;
+  g_autoptr(GyHeadwordModel) model = NULL;
+  g_autoptr(GArray) rows = NULL;
+  GySearchKeys *keys;
+
+  index = write_index (&filename);
+  model = gy_headword_model_new_from_strv (headwords);
+  keys = gy_headword_model_get_search_keys (model);
+
+  rows = gy_lemma_index_resolve (index, keys, "Domami");
+  mutest_expect ("the lemma resolves to its row",
+                 mutest_bool_value (rows->len == 1 && g_array_index (rows, guint32, 0) == 1),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_lemma_index_resolve (index, keys, "saw");
+  mutest_expect ("a lemma missing from the model is skipped",
+                 mutest_bool_value (rows->len == 1 && g_array_index (rows, guint32, 0) == 4),
+                 mutest_to_be, true, NULL);
+
+  g_clear_pointer (&rows, g_array_unref);
+  rows = gy_lemma_index_resolve (index, keys, "goes");
+  mutest_expect ("the lemma does not match longer headwords",
+                 mutest_bool_value (rows->len == 1 && g_array_index (rows, guint32, 0) == 2),
+                 mutest_to_be, true, NULL);
+
+  g_unlink (filename);
+}
+
+static void
+lemma_index_suite (void)
+{
+  mutest_it ("maps inflected forms to their lemmas", index_lookup);
+  mutest_it ("resolves the lemmas to rows", index_resolve);
+}
+
+MUTEST_MAIN (
+  mutest_describe ("Lemma Index [GyLemmaIndex]", lemma_index_suite);
+)
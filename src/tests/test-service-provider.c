@@ -0,0 +1,623 @@
+/* test-service-provider.c
+ *
+ * Copyright 2020 Jakub Czartek <kuba@linux.pl>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+
+#include <mutest.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gydict.h>
+
+#include "services/gy-definition-cache.h"
+
+/* A formatter which takes its time, so that lookups overlap. */
+
+#define TEST_TYPE_FORMATTER (test_formatter_get_type ())
+G_DECLARE_FINAL_TYPE (TestFormatter, test_formatter, TEST, FORMATTER, GObject)
+
+struct _TestFormatter
+{
+  GObject parent_instance;
+  gint    n_formats;
+};
+
+static void test_formatter_iface_init (GyDictFormatterInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestFormatter, test_formatter, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GY_TYPE_DICT_FORMATTER, test_formatter_iface_init))
+
+static GyFormatScheme *
+test_formatter_format (GyDictFormatter  *formatter,
+                       const gchar      *text,
+                       GError          **err)
+{
+  TestFormatter *self = TEST_FORMATTER (formatter);
+  GyFormatScheme *scheme;
+
+  g_atomic_int_inc (&self->n_formats);
+  g_usleep (100 * G_TIME_SPAN_MILLISECOND);
+
+  if (g_str_has_prefix (text, "broken"))
+    {
+      g_set_error (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "The entry is broken.");
+      return NULL;
+    }
+
+  scheme = gy_format_scheme_new ();
+  gy_format_scheme_append_text (scheme, text);
+
+  return scheme;
+}
+
+static void
+test_formatter_iface_init (GyDictFormatterInterface *iface)
+{
+  iface->format = test_formatter_format;
+}
+
+static void
+test_formatter_class_init (TestFormatterClass *klass)
+{
+}
+
+static void
+test_formatter_init (TestFormatter *self)
+{
+}
+
+/* A service over a list of headwords, whose definitions are long copies of them. */
+
+#define TEST_TYPE_SERVICE (test_service_get_type ())
+G_DECLARE_FINAL_TYPE (TestService, test_service, TEST, SERVICE, GObject)
+
+struct _TestService
+{
+  GObject          parent_instance;
+  gchar           *service_id;
+  gchar           *filename;
+  GyHeadwordModel *model;
+  TestFormatter   *formatter;
+};
+
+static void test_service_iface_init (GyServiceInterface *iface);
+static void test_dict_service_iface_init (GyDictServiceInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestService, test_service, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GY_TYPE_SERVICE, test_service_iface_init)
+                         G_IMPLEMENT_INTERFACE (GY_TYPE_DICT_SERVICE, test_dict_service_iface_init))
+
+static const gchar *
+test_service_get_service_id (GyService *service)
+{
+  return TEST_SERVICE (service)->service_id;
+}
+
+static GyServiceCapabilities
+test_service_get_capabilities (GyService *service)
+{
+  return GY_SERVICE_CAPABILITY_THREAD_SAFE;
+}
+
+static void
+test_service_iface_init (GyServiceInterface *iface)
+{
+  iface->get_service_id = test_service_get_service_id;
+  iface->get_capabilities = test_service_get_capabilities;
+}
+
+static GtkTreeModel *
+test_service_get_model (GyDictService  *service,
+                        GError        **err)
+{
+  return GTK_TREE_MODEL (TEST_SERVICE (service)->model);
+}
+
+static gchar *
+test_service_get_lexical_unit (GyDictService  *service,
+                               guint           idx,
+                               GError        **err)
+{
+  TestService *self = TEST_SERVICE (service);
+  g_autofree gchar *headword = NULL;
+  GtkTreeIter iter;
+  GString *text;
+
+  if (!gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (self->model), &iter, NULL, idx))
+    {
+      g_set_error (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No entry %u.", idx);
+      return NULL;
+    }
+
+  gtk_tree_model_get (GTK_TREE_MODEL (self->model), &iter, 0, &headword, -1);
+
+  text = g_string_new (NULL);
+  for (guint i = 0; i < 50; i++)
+    g_string_append_printf (text, "%s ", headword);
+
+  return g_string_free (text, FALSE);
+}
+
+static GyDictFormatter *
+test_service_get_formatter (GyDictService *service)
+{
+  return g_object_ref (GY_DICT_FORMATTER (TEST_SERVICE (service)->formatter));
+}
+
+static void
+test_dict_service_iface_init (GyDictServiceInterface *iface)
+{
+  iface->get_model = test_service_get_model;
+  iface->get_lexical_unit = test_service_get_lexical_unit;
+  iface->get_formatter = test_service_get_formatter;
+}
+
+enum
+{
+  PROP_0,
+  PROP_FILENAME
+};
+
+static void
+test_service_get_property (GObject    *object,
+                           guint       prop_id,
+                           GValue     *value,
+                           GParamSpec *pspec)
+{
+  g_value_set_string (value, TEST_SERVICE (object)->filename);
+}
+
+static void
+test_service_set_property (GObject      *object,
+                           guint         prop_id,
+                           const GValue *value,
+                           GParamSpec   *pspec)
+{
+  TestService *self = TEST_SERVICE (object);
+
+  g_free (self->filename);
+  self->filename = g_value_dup_string (value);
+}
+
+static void
+test_service_finalize (GObject *object)
+{
+  TestService *self = TEST_SERVICE (object);
+
+  g_free (self->service_id);
+  g_free (self->filename);
+  g_clear_object (&self->model);
+  g_clear_object (&self->formatter);
+
+  G_OBJECT_CLASS (test_service_parent_class)->finalize (object);
+}
+
+static void
+test_service_class_init (TestServiceClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = test_service_finalize;
+  object_class->get_property = test_service_get_property;
+  object_class->set_property = test_service_set_property;
+
+  g_object_class_install_property (object_class, PROP_FILENAME,
+                                   g_param_spec_string ("filename", NULL, NULL, NULL,
+                                                        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+test_service_init (TestService *self)
+{
+  self->formatter = g_object_new (TEST_TYPE_FORMATTER, NULL);
+}
+
+static TestService *
+test_service_new (const gchar         *service_id,
+                  const gchar * const *headwords)
+{
+  TestService *self = g_object_new (TEST_TYPE_SERVICE, NULL);
+
+  self->service_id = g_strdup (service_id);
+  self->model = gy_headword_model_new_from_strv (headwords);
+
+  return self;
+}
+
+static const gchar * const headwords[] = { "abandon", "abbey", "broken", "zebra", NULL };
+
+/* The dictionary service */
+
+static void
+service_fingerprint (void)
+{
+  g_autoptr(TestService) service = test_service_new ("test", headwords);
+  g_autofree gchar *filename = NULL;
+  g_autofree gchar *before = NULL;
+  g_autofree gchar *after = NULL;
+  g_autofree gchar *none = NULL;
+  gint fd;
+
+  none = gy_dict_service_get_fingerprint (GY_DICT_SERVICE (service));
+  mutest_expect ("a service without a file has no fingerprint",
+                 mutest_pointer (none),
+                 mutest_to_be_null, NULL);
+
+  fd = g_file_open_tmp ("test-dictionary-XXXXXX", &filename, NULL);
+  close (fd);
+  g_file_set_contents (filename, "abandon", -1, NULL);
+  g_object_set (service, "filename", filename, NULL);
+
+  before = gy_dict_service_get_fingerprint (GY_DICT_SERVICE (service));
+  mutest_expect ("the file of the dictionary gives it a fingerprint",
+                 mutest_pointer (before),
+                 mutest_not, mutest_to_be_null, NULL);
+
+  g_file_set_contents (filename, "abandon abbey", -1, NULL);
+  after = gy_dict_service_get_fingerprint (GY_DICT_SERVICE (service));
+  mutest_expect ("the fingerprint changes with the file",
+                 mutest_bool_value (g_strcmp0 (before, after) != 0),
+                 mutest_to_be, true, NULL);
+
+  g_unlink (filename);
+}
+
+static void
+dict_service_suite (void)
+{
+  mutest_it ("takes its fingerprint from the file of the dictionary", service_fingerprint);
+}
+
+/* The definition cache */
+
+typedef struct
+{
+  GyDefinitionCache *cache;
+  TestService       *service;
+  guint              idx;
+  GyFormatScheme    *scheme;
+  GError            *error;
+} Lookup;
+
+static gpointer
+lookup_thread (gpointer data)
+{
+  Lookup *lookup = data;
+
+  lookup->scheme = gy_definition_cache_lookup (lookup->cache, GY_DICT_SERVICE (lookup->service),
+                                               lookup->idx, &lookup->error);
+
+  return NULL;
+}
+
+static void
+lookup_twice (GyDefinitionCache *cache,
+              TestService       *service,
+              guint              idx,
+              Lookup            *lookups)
+{
+  GThread *threads[2];
+
+  for (guint i = 0; i < 2; i++)
+    {
+      lookups[i].cache = cache;
+      lookups[i].service = service;
+      lookups[i].idx = idx;
+      threads[i] = g_thread_new ("test-lookup", lookup_thread, &lookups[i]);
+    }
+
+  for (guint i = 0; i < 2; i++)
+    g_thread_join (threads[i]);
+}
+
+static void
+cache_eviction (void)
+{
+  g_autoptr(TestService) service = test_service_new ("test", headwords);
+  GyDefinitionCache *cache;
+  GyFormatScheme *scheme;
+  guint64 hits = 0;
+
+  /* An entry is kept both read and formatted, which takes most of the budget. */
+  cache = gy_definition_cache_new (1024);
+
+  scheme = gy_definition_cache_lookup (cache, GY_DICT_SERVICE (service), 0, NULL);
+  gy_format_scheme_unref (scheme);
+  scheme = gy_definition_cache_lookup (cache, GY_DICT_SERVICE (service), 1, NULL);
+  gy_format_scheme_unref (scheme);
+
+  scheme = gy_definition_cache_lookup (cache, GY_DICT_SERVICE (service), 1, NULL);
+  mutest_expect ("the entry used last is kept",
+                 mutest_bool_value (g_str_has_prefix (gy_format_scheme_get_lexical_unit (scheme), "abbey")),
+                 mutest_to_be, true, NULL);
+  gy_format_scheme_unref (scheme);
+
+  gy_definition_cache_get_stats (cache, &hits, NULL, NULL);
+  mutest_expect ("the entry used last is found in the cache",
+                 mutest_int_value (hits),
+                 mutest_to_be, 1, NULL);
+
+  scheme = gy_definition_cache_lookup (cache, GY_DICT_SERVICE (service), 0, NULL);
+  gy_format_scheme_unref (scheme);
+  mutest_expect ("the entry used first is evicted to stay within the budget",
+                 mutest_int_value (g_atomic_int_get (&service->formatter->n_formats)),
+                 mutest_to_be, 3, NULL);
+
+  gy_definition_cache_free (cache);
+}
+
+static void
+cache_single_flight (void)
+{
+  g_autoptr(TestService) service = test_service_new ("test", headwords);
+  GyDefinitionCache *cache;
+  Lookup lookups[2] = { { 0, }, };
+  guint64 hits = 0, merged = 0;
+
+  cache = gy_definition_cache_new (1024 * 1024);
+  lookup_twice (cache, service, 3, lookups);
+
+  mutest_expect ("both lookups get the entry",
+                 mutest_bool_value (lookups[0].scheme != NULL && lookups[1].scheme != NULL),
+                 mutest_to_be, true, NULL);
+
+  mutest_expect ("the entry is formatted once",
+                 mutest_int_value (g_atomic_int_get (&service->formatter->n_formats)),
+                 mutest_to_be, 1, NULL);
+
+  gy_definition_cache_get_stats (cache, &hits, NULL, &merged);
+  mutest_expect ("the second lookup waits for the first or finds its result",
+                 mutest_int_value (hits + merged),
+                 mutest_to_be, 1, NULL);
+
+  for (guint i = 0; i < 2; i++)
+    gy_format_scheme_unref (lookups[i].scheme);
+  gy_definition_cache_free (cache);
+}
+
+static void
+cache_error (void)
+{
+  g_autoptr(TestService) service = test_service_new ("test", headwords);
+  GyDefinitionCache *cache;
+  Lookup lookups[2] = { { 0, }, };
+
+  cache = gy_definition_cache_new (1024 * 1024);
+  lookup_twice (cache, service, 2, lookups);
+
+  for (guint i = 0; i < 2; i++)
+    mutest_expect ("the error reaches every lookup",
+                   mutest_bool_value (lookups[i].scheme == NULL &&
+                                      g_error_matches (lookups[i].error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA)),
+                   mutest_to_be, true, NULL);
+
+  mutest_expect ("the failed entry is formatted once",
+                 mutest_int_value (g_atomic_int_get (&service->formatter->n_formats)),
+                 mutest_to_be, 1, NULL);
+
+  for (guint i = 0; i < 2; i++)
+    g_clear_error (&lookups[i].error);
+  gy_definition_cache_free (cache);
+}
+
+static void
+definition_cache_suite (void)
+{
+  mutest_it ("evicts the least recently used entries", cache_eviction);
+  mutest_it ("formats an entry once for concurrent lookups", cache_single_flight);
+  mutest_it ("passes an error to every waiting lookup", cache_error);
+}
+
+/* The provider */
+
+typedef struct
+{
+  GyServiceProvider *provider;
+  gint               stop;
+  gint               n_missing;
+} Reader;
+
+static gpointer
+reader_thread (gpointer data)
+{
+  Reader *reader = data;
+
+  while (!g_atomic_int_get (&reader->stop))
+    {
+      g_autoptr(GyService) service = gy_service_provider_ref_service_by_id (reader->provider, "stable");
+
+      if (service == NULL)
+        g_atomic_int_inc (&reader->n_missing);
+    }
+
+  return NULL;
+}
+
+static void
+provider_snapshot (void)
+{
+  g_autoptr(GyServiceProvider) provider = gy_service_provider_new ();
+  g_autoptr(TestService) stable = test_service_new ("stable", headwords);
+  g_autoptr(GyService) held = NULL;
+  Reader reader = { provider, 0, 0 };
+  GThread *thread;
+
+  gy_service_provider_register_service (provider, GY_SERVICE (stable));
+  thread = g_thread_new ("test-reader", reader_thread, &reader);
+
+  /* Every registration publishes a new snapshot under the reader. */
+  for (guint i = 0; i < 200; i++)
+    {
+      g_autofree gchar *service_id = g_strdup_printf ("other-%u", i % 4);
+      g_autoptr(TestService) other = test_service_new (service_id, headwords);
+
+      if (i >= 4)
+        gy_service_provider_unregister_service_by_id (provider, service_id);
+      gy_service_provider_register_service (provider, GY_SERVICE (other));
+    }
+
+  g_atomic_int_set (&reader.stop, TRUE);
+  g_thread_join (thread);
+
+  mutest_expect ("a reader always finds a service registered before",
+                 mutest_int_value (g_atomic_int_get (&reader.n_missing)),
+                 mutest_to_be, 0, NULL);
+
+  held = gy_service_provider_ref_service_by_id (provider, "other-0");
+  gy_service_provider_unregister_service_by_id (provider, "other-0");
+
+  mutest_expect ("an unregistered service is not found",
+                 mutest_pointer (gy_service_provider_get_service_by_id (provider, "other-0")),
+                 mutest_to_be_null, NULL);
+
+  mutest_expect ("a service taken before it was unregistered stays usable",
+                 mutest_bool_value (g_strcmp0 (gy_service_get_service_id (held), "other-0") == 0),
+                 mutest_to_be, true, NULL);
+}
+
+static GyService *
+build_service (const gchar *service_id,
+               gpointer     user_data)
+{
+  g_atomic_int_inc ((gint *) user_data);
+
+  return GY_SERVICE (test_service_new (service_id, headwords));
+}
+
+static void
+provider_idle_unload (void)
+{
+  g_autoptr(GyServiceProvider) provider = gy_service_provider_new ();
+  GyService *service;
+  gint64 deadline;
+  gint n_built = 0;
+
+  g_object_set (provider, "idle-timeout", 1, NULL);
+  gy_service_provider_register_factory_func (provider, "lazy", build_service, &n_built, NULL);
+
+  service = gy_service_provider_get_service_by_id (provider, "lazy");
+  g_object_add_weak_pointer (G_OBJECT (service), (gpointer *) &service);
+
+  mutest_expect ("the service is built on the first request",
+                 mutest_int_value (n_built),
+                 mutest_to_be, 1, NULL);
+
+  deadline = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+  while (service != NULL && g_get_monotonic_time () < deadline)
+    g_main_context_iteration (NULL, TRUE);
+
+  mutest_expect ("the idle service is released",
+                 mutest_pointer (service),
+                 mutest_to_be_null, NULL);
+
+  if (service != NULL)
+    g_object_remove_weak_pointer (G_OBJECT (service), (gpointer *) &service);
+
+  service = gy_service_provider_get_service_by_id (provider, "lazy");
+  mutest_expect ("a released service is built again on demand",
+                 mutest_bool_value (service != NULL && n_built == 2),
+                 mutest_to_be, true, NULL);
+}
+
+static void
+provider_suite (void)
+{
+  mutest_it ("publishes registrations to lock-free readers", provider_snapshot);
+  mutest_it ("releases the services left idle", provider_idle_unload);
+}
+
+/* The federated search */
+
+typedef struct
+{
+  GHashTable *rows; /* service id -> the number of rows */
+  gboolean    done;
+} Search;
+
+static void
+search_results (const gchar   *service_id,
+                GtkTreeModel  *model,
+                const guint32 *rows,
+                guint          n_rows,
+                gpointer       user_data)
+{
+  Search *search = user_data;
+
+  g_hash_table_insert (search->rows, g_strdup (service_id), GUINT_TO_POINTER (n_rows));
+}
+
+static void
+search_done (GObject      *object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  Search *search = user_data;
+
+  gy_service_provider_search_all_finish (GY_SERVICE_PROVIDER (object), result, NULL);
+  search->done = TRUE;
+}
+
+static void
+federated_search (void)
+{
+  static const gchar * const others[] = { "abacus", "cab", NULL };
+  g_autoptr(GyServiceProvider) provider = gy_service_provider_new ();
+  g_autoptr(TestService) first = test_service_new ("first", headwords);
+  g_autoptr(TestService) second = test_service_new ("second", others);
+  g_autoptr(TestService) third = test_service_new ("third", others);
+  Search search = { 0, };
+
+  gy_service_provider_register_service (provider, GY_SERVICE (first));
+  gy_service_provider_register_service (provider, GY_SERVICE (second));
+  gy_service_provider_register_service (provider, GY_SERVICE (third));
+
+  search.rows = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  gy_service_provider_search_all_async (provider, "AB", 10, 5000,
+                                        search_results, &search, NULL,
+                                        NULL, search_done, &search);
+
+  while (!search.done)
+    g_main_context_iteration (NULL, TRUE);
+
+  mutest_expect ("every service with a match answers",
+                 mutest_int_value (g_hash_table_size (search.rows)),
+                 mutest_to_be, 3, NULL);
+
+  mutest_expect ("the rows of a service begin with the folded query",
+                 mutest_int_value (GPOINTER_TO_UINT (g_hash_table_lookup (search.rows, "first"))),
+                 mutest_to_be, 2, NULL);
+
+  mutest_expect ("a service answers only for its own rows",
+                 mutest_int_value (GPOINTER_TO_UINT (g_hash_table_lookup (search.rows, "second"))),
+                 mutest_to_be, 1, NULL);
+
+  g_hash_table_unref (search.rows);
+}
+
+static void
+federated_search_suite (void)
+{
+  mutest_it ("searches every registered service", federated_search);
+}
+
+MUTEST_MAIN (
+  mutest_describe ("Dictionary Service [GyDictService]", dict_service_suite);
+  mutest_describe ("Definition Cache [GyDefinitionCache]", definition_cache_suite);
+  mutest_describe ("Service Provider [GyServiceProvider]", provider_suite);
+  mutest_describe ("Federated Search [GyServiceProvider]", federated_search_suite);
+)